@@ -11,6 +11,9 @@
 #include "mcp_server.h"
 #include "assets.h"
 #include "settings.h"
+#include "event_bus.h"
+#include "memory_budget.h"
+#include "task_profiler.h"
 
 #include <algorithm>
 #include <cstring>
@@ -74,7 +77,6 @@ Application::~Application() {
 
 void Application::CheckAssetsVersion() {
     auto& board = Board::GetInstance();
-    auto display = board.GetDisplay();
     auto& assets = Assets::GetInstance();
 
     if (!assets.partition_valid()) {
@@ -97,14 +99,13 @@ void Application::CheckAssetsVersion() {
         vTaskDelay(pdMS_TO_TICKS(3000));
         SetDeviceState(kDeviceStateUpgrading);
         board.SetPowerSaveMode(false);
-        display->SetChatMessage("system", Lang::Strings::PLEASE_WAIT);
-
-        bool success = assets.Download(download_url, [display](int progress, size_t speed) -> void {
-            std::thread([display, progress, speed]() {
-                char buffer[32];
-                snprintf(buffer, sizeof(buffer), "%d%% %uKB/s", progress, speed / 1024);
-                display->SetChatMessage("system", buffer);
-            }).detach();
+        display_queue_.SetChatMessage("system", Lang::Strings::PLEASE_WAIT);
+
+        bool success = assets.Download(download_url, [this](int progress, size_t speed) -> void {
+            // Posting does not wait for the display, no need for a thread
+            char buffer[32];
+            snprintf(buffer, sizeof(buffer), "%d%% %uKB/s", progress, speed / 1024);
+            display_queue_.SetChatMessage("system", buffer);
         });
 
         board.SetPowerSaveMode(true);
@@ -119,8 +120,8 @@ void Application::CheckAssetsVersion() {
 
     // Apply assets
     assets.Apply();
-    display->SetChatMessage("system", "");
-    display->SetEmotion("microchip_ai");
+    display_queue_.SetChatMessage("system", "");
+    display_queue_.SetEmotion("microchip_ai");
 }
 
 void Application::CheckNewVersion(Ota& ota) {
@@ -131,8 +132,7 @@ void Application::CheckNewVersion(Ota& ota) {
     auto& board = Board::GetInstance();
     while (true) {
         SetDeviceState(kDeviceStateActivating);
-        auto display = board.GetDisplay();
-        display->SetStatus(Lang::Strings::CHECKING_NEW_VERSION);
+        display_queue_.SetStatus(Lang::Strings::CHECKING_NEW_VERSION);
 
         if (!ota.CheckVersion()) {
             retry_count++;
@@ -173,7 +173,7 @@ void Application::CheckNewVersion(Ota& ota) {
             break;
         }
 
-        display->SetStatus(Lang::Strings::ACTIVATION);
+        display_queue_.SetStatus(Lang::Strings::ACTIVATION);
         // Activation code is shown to the user and waiting for the user to input
         if (ota.HasActivationCode()) {
             ShowActivationCode(ota.GetActivationCode(), ota.GetActivationMessage());
@@ -230,10 +230,9 @@ void Application::ShowActivationCode(const std::string& code, const std::string&
 
 void Application::Alert(const char* status, const char* message, const char* emotion, const std::string_view& sound) {
     ESP_LOGW(TAG, "Alert [%s] %s: %s", emotion, status, message);
-    auto display = Board::GetInstance().GetDisplay();
-    display->SetStatus(status);
-    display->SetEmotion(emotion);
-    display->SetChatMessage("system", message);
+    display_queue_.SetStatus(status);
+    display_queue_.SetEmotion(emotion);
+    display_queue_.SetChatMessage("system", message);
     if (!sound.empty()) {
         audio_service_.PlaySound(sound);
     }
@@ -241,10 +240,9 @@ void Application::Alert(const char* status, const char* message, const char* emo
 
 void Application::DismissAlert() {
     if (device_state_ == kDeviceStateIdle) {
-        auto display = Board::GetInstance().GetDisplay();
-        display->SetStatus(Lang::Strings::STANDBY);
-        display->SetEmotion("neutral");
-        display->SetChatMessage("system", "");
+        display_queue_.SetStatus(Lang::Strings::STANDBY);
+        display_queue_.SetEmotion("neutral");
+        display_queue_.SetChatMessage("system", "");
     }
 }
 
@@ -351,12 +349,17 @@ void Application::StopListening() {
 void Application::Start() {
     auto& board = Board::GetInstance();
     SetDeviceState(kDeviceStateStarting);
+    // Timestamps of the startup stages, printed once the device is ready
+    int64_t boot_start_time = esp_timer_get_time();
+    // Task CPU and stack sampling, served on /api/stats by the config server
+    TaskProfiler::GetInstance().Start();
 
     /* Setup the display */
     auto display = board.GetDisplay();
+    display_queue_.Start(display);
 
     // Print board name/version info
-    display->SetChatMessage("system", SystemInfo::GetUserAgent().c_str());
+    display_queue_.SetChatMessage("system", SystemInfo::GetUserAgent().c_str());
 
     /* Setup the audio service */
     auto codec = board.GetAudioCodec();
@@ -374,6 +377,7 @@ void Application::Start() {
         xEventGroupSetBits(event_group_, MAIN_EVENT_VAD_CHANGE);
     };
     audio_service_.SetCallbacks(callbacks);
+    int64_t audio_ready_time = esp_timer_get_time();
 
     // Start the main event loop task with priority 3
     xTaskCreate([](void* arg) {
@@ -388,17 +392,20 @@ void Application::Start() {
     board.StartNetwork();
 
     // Update the status bar immediately to show the network state
-    display->UpdateStatusBar(true);
+    display_queue_.UpdateStatusBar(true);
+    int64_t network_ready_time = esp_timer_get_time();
 
     // Check for new assets version
     CheckAssetsVersion();
+    int64_t assets_ready_time = esp_timer_get_time();
 
     // Check for new firmware version or get the MQTT broker address
     Ota ota;
     CheckNewVersion(ota);
+    int64_t ota_checked_time = esp_timer_get_time();
 
     // Initialize the protocol
-    display->SetStatus(Lang::Strings::LOADING_PROTOCOL);
+    display_queue_.SetStatus(Lang::Strings::LOADING_PROTOCOL);
 
     // Add MCP common tools before initializing the protocol
     auto& mcp_server = McpServer::GetInstance();
@@ -406,6 +413,9 @@ void Application::Start() {
     mcp_server.AddUserOnlyTools();
 
     // =========== 【修改开始】 ===========
+    // 0. 传感器/监控事件总线，RegisterHomeDeviceTools 里会订阅
+    EventBus::GetInstance().Start();
+
     // 1. 注册 HA 控制工具 (你原来已经有的)
     MyHomeDevice::GetInstance().RegisterHomeDeviceTools();
 
@@ -443,6 +453,8 @@ void Application::Start() {
     });
     protocol_->OnAudioChannelOpened([this, codec, &board]() {
         board.SetPowerSaveMode(false);
+        int uplink_frame_duration = protocol_->server_uplink_frame_duration();
+        audio_service_.SetUplinkFrameDuration(uplink_frame_duration > 0 ? uplink_frame_duration : OPUS_FRAME_DURATION_MS);
         if (protocol_->server_sample_rate() != codec->output_sample_rate()) {
             ESP_LOGW(TAG, "Server sample rate %d does not match device output sample rate %d, resampling may cause distortion",
                 protocol_->server_sample_rate(), codec->output_sample_rate());
@@ -452,91 +464,28 @@ void Application::Start() {
         board.SetPowerSaveMode(true);
         Schedule([this]() {
             if (protocol_->IsAudioChannelOpened()) return;
-            auto display = Board::GetInstance().GetDisplay();
-            display->SetChatMessage("system", "");
+            display_queue_.SetChatMessage("system", "");
             SetDeviceState(kDeviceStateIdle);
         });
     });
-    protocol_->OnIncomingJson([this, display](const cJSON* root) {
-        // Parse JSON data
+    protocol_->OnIncomingMessage([this](const ServerMessage& message) {
+        OnIncomingMessage(message);
+    });
+    // Only messages with nested payloads (mcp, custom) reach the cJSON path
+    protocol_->OnIncomingJson([this](const cJSON* root) {
         auto type = cJSON_GetObjectItem(root, "type");
-        if (strcmp(type->valuestring, "tts") == 0) {
-            auto state = cJSON_GetObjectItem(root, "state");
-            if (strcmp(state->valuestring, "start") == 0) {
-                Schedule([this]() {
-                    aborted_ = false;
-                    if (device_state_ == kDeviceStateIdle || device_state_ == kDeviceStateListening || device_state_ == kDeviceStateConnecting) {
-                        SetDeviceState(kDeviceStateSpeaking);
-                    }
-                });
-            } else if (strcmp(state->valuestring, "stop") == 0) {
-                Schedule([this]() {
-                    if (device_state_ == kDeviceStateSpeaking) {
-                        if (listening_mode_ == kListeningModeManualStop) {
-                            SetDeviceState(kDeviceStateIdle);
-                        } else {
-                            SetDeviceState(kDeviceStateListening);
-                        }
-                    }
-                });
-            } else if (strcmp(state->valuestring, "sentence_start") == 0) {
-                auto text = cJSON_GetObjectItem(root, "text");
-                if (cJSON_IsString(text)) {
-                    ESP_LOGI(TAG, "<< %s", text->valuestring);
-                    Schedule([this, display, message = std::string(text->valuestring)]() {
-                        display->SetChatMessage("assistant", message.c_str());
-                    });
-                }
-            }
-        } else if (strcmp(type->valuestring, "stt") == 0) {
-            auto text = cJSON_GetObjectItem(root, "text");
-            if (cJSON_IsString(text)) {
-                ESP_LOGI(TAG, ">> %s", text->valuestring);
-                Schedule([this, display, message = std::string(text->valuestring)]() {
-                    display->SetChatMessage("user", message.c_str());
-                });
-            }
-        } else if (strcmp(type->valuestring, "llm") == 0) {
-            auto emotion = cJSON_GetObjectItem(root, "emotion");
-            if (cJSON_IsString(emotion)) {
-                Schedule([this, display, emotion_str = std::string(emotion->valuestring)]() {
-                    display->SetEmotion(emotion_str.c_str());
-                });
-            }
-        } else if (strcmp(type->valuestring, "mcp") == 0) {
+        if (strcmp(type->valuestring, "mcp") == 0) {
             auto payload = cJSON_GetObjectItem(root, "payload");
             if (cJSON_IsObject(payload)) {
                 McpServer::GetInstance().ParseMessage(payload);
             }
-        } else if (strcmp(type->valuestring, "system") == 0) {
-            auto command = cJSON_GetObjectItem(root, "command");
-            if (cJSON_IsString(command)) {
-                ESP_LOGI(TAG, "System command: %s", command->valuestring);
-                if (strcmp(command->valuestring, "reboot") == 0) {
-                    // Do a reboot if user requests a OTA update
-                    Schedule([this]() {
-                        Reboot();
-                    });
-                } else {
-                    ESP_LOGW(TAG, "Unknown system command: %s", command->valuestring);
-                }
-            }
-        } else if (strcmp(type->valuestring, "alert") == 0) {
-            auto status = cJSON_GetObjectItem(root, "status");
-            auto message = cJSON_GetObjectItem(root, "message");
-            auto emotion = cJSON_GetObjectItem(root, "emotion");
-            if (cJSON_IsString(status) && cJSON_IsString(message) && cJSON_IsString(emotion)) {
-                Alert(status->valuestring, message->valuestring, emotion->valuestring, Lang::Sounds::OGG_VIBRATION);
-            } else {
-                ESP_LOGW(TAG, "Alert command requires status, message and emotion");
-            }
 #if CONFIG_RECEIVE_CUSTOM_MESSAGE
         } else if (strcmp(type->valuestring, "custom") == 0) {
             auto payload = cJSON_GetObjectItem(root, "payload");
             ESP_LOGI(TAG, "Received custom message: %s", cJSON_PrintUnformatted(root));
             if (cJSON_IsObject(payload)) {
-                Schedule([this, display, payload_str = std::string(cJSON_PrintUnformatted(payload))]() {
-                    display->SetChatMessage("system", payload_str.c_str());
+                Schedule([this, payload_str = std::string(cJSON_PrintUnformatted(payload))]() {
+                    display_queue_.SetChatMessage("system", payload_str.c_str());
                 });
             } else {
                 ESP_LOGW(TAG, "Invalid custom message format: missing payload");
@@ -547,6 +496,11 @@ void Application::Start() {
         }
     });
     bool protocol_started = protocol_->Start();
+    int64_t protocol_ready_time = esp_timer_get_time();
+    ESP_LOGI(TAG, "Boot time: %d ms since power on, audio %d ms, network %d ms, assets %d ms, ota %d ms, protocol %d ms",
+        int(protocol_ready_time / 1000), int((audio_ready_time - boot_start_time) / 1000),
+        int((network_ready_time - audio_ready_time) / 1000), int((assets_ready_time - network_ready_time) / 1000),
+        int((ota_checked_time - assets_ready_time) / 1000), int((protocol_ready_time - ota_checked_time) / 1000));
 
     SystemInfo::PrintHeapStats();
     SetDeviceState(kDeviceStateIdle);
@@ -554,13 +508,110 @@ void Application::Start() {
     has_server_time_ = ota.HasServerTime();
     if (protocol_started) {
         std::string message = std::string(Lang::Strings::VERSION) + ota.GetCurrentVersion();
-        display->ShowNotification(message.c_str());
-        display->SetChatMessage("system", "");
+        display_queue_.ShowNotification(message.c_str());
+        display_queue_.SetChatMessage("system", "");
         // Play the success sound to indicate the device is ready
         audio_service_.PlaySound(Lang::Sounds::OGG_SUCCESS);
     }
 }
 
+void Application::OnIncomingMessage(const ServerMessage& message) {
+    using Handler = void (Application::*)(const ServerMessage&);
+    struct Route {
+        ServerMessageType type;
+        Handler handler;
+    };
+    // Ordered by how often the server sends them
+    static constexpr Route kRoutes[] = {
+        {kServerMessageTts, &Application::HandleTtsMessage},
+        {kServerMessageLlm, &Application::HandleLlmMessage},
+        {kServerMessageStt, &Application::HandleSttMessage},
+        {kServerMessageSystem, &Application::HandleSystemMessage},
+        {kServerMessageAlert, &Application::HandleAlertMessage},
+    };
+
+    for (const auto& route : kRoutes) {
+        if (route.type == message.type) {
+            (this->*route.handler)(message);
+            return;
+        }
+    }
+    ESP_LOGW(TAG, "Unknown message type: %.*s", (int)message.type_name.size(), message.type_name.data());
+}
+
+void Application::HandleTtsMessage(const ServerMessage& message) {
+    if (message.state == "start") {
+        Schedule([this]() {
+            aborted_ = false;
+            if (device_state_ == kDeviceStateIdle || device_state_ == kDeviceStateListening || device_state_ == kDeviceStateConnecting) {
+                SetDeviceState(kDeviceStateSpeaking);
+            }
+        });
+    } else if (message.state == "stop") {
+        Schedule([this]() {
+            if (device_state_ == kDeviceStateSpeaking) {
+                if (listening_mode_ == kListeningModeManualStop) {
+                    SetDeviceState(kDeviceStateIdle);
+                } else {
+                    SetDeviceState(kDeviceStateListening);
+                }
+            }
+        });
+    } else if (message.state == "sentence_start" && message.text.data() != nullptr) {
+        auto text = UnescapeJsonString(message.text);
+        ESP_LOGI(TAG, "<< %s", text.c_str());
+        Schedule([this, text = std::move(text)]() {
+            display_queue_.SetChatMessage("assistant", text.c_str());
+        });
+    }
+}
+
+void Application::HandleSttMessage(const ServerMessage& message) {
+    if (message.text.data() == nullptr) {
+        return;
+    }
+    auto text = UnescapeJsonString(message.text);
+    ESP_LOGI(TAG, ">> %s", text.c_str());
+    Schedule([this, text = std::move(text)]() {
+        display_queue_.SetChatMessage("user", text.c_str());
+    });
+}
+
+void Application::HandleLlmMessage(const ServerMessage& message) {
+    if (message.emotion.data() == nullptr) {
+        return;
+    }
+    Schedule([this, emotion = std::string(message.emotion)]() {
+        display_queue_.SetEmotion(emotion.c_str());
+    });
+}
+
+void Application::HandleSystemMessage(const ServerMessage& message) {
+    if (message.command.data() == nullptr) {
+        return;
+    }
+    ESP_LOGI(TAG, "System command: %.*s", (int)message.command.size(), message.command.data());
+    if (message.command == "reboot") {
+        // Do a reboot if user requests a OTA update
+        Schedule([this]() {
+            Reboot();
+        });
+    } else {
+        ESP_LOGW(TAG, "Unknown system command: %.*s", (int)message.command.size(), message.command.data());
+    }
+}
+
+void Application::HandleAlertMessage(const ServerMessage& message) {
+    if (message.status.data() == nullptr || message.message.data() == nullptr || message.emotion.data() == nullptr) {
+        ESP_LOGW(TAG, "Alert command requires status, message and emotion");
+        return;
+    }
+    auto status = UnescapeJsonString(message.status);
+    auto text = UnescapeJsonString(message.message);
+    auto emotion = std::string(message.emotion);
+    Alert(status.c_str(), text.c_str(), emotion.c_str(), Lang::Sounds::OGG_VIBRATION);
+}
+
 // Add a async task to MainLoop
 void Application::Schedule(std::function<void()> callback) {
     {
@@ -588,8 +639,13 @@ void Application::MainEventLoop() {
         }
 
         if (bits & MAIN_EVENT_SEND_AUDIO) {
-            while (auto packet = audio_service_.PopPacketFromSendQueue()) {
-                if (protocol_ && !protocol_->SendAudio(std::move(packet))) {
+            // After a stall the queue holds several frames, they are handed to the protocol in batches
+            while (audio_service_.PopPacketsFromSendQueue(send_batch_, MAX_AUDIO_PACKETS_PER_SEND) > 0) {
+                if (!protocol_) {
+                    send_batch_.clear();
+                    continue;
+                }
+                if (!protocol_->SendAudioBatch(send_batch_)) {
                     break;
                 }
             }
@@ -617,14 +673,21 @@ void Application::MainEventLoop() {
 
         if (bits & MAIN_EVENT_CLOCK_TICK) {
             clock_ticks_++;
-            auto display = Board::GetInstance().GetDisplay();
-            display->UpdateStatusBar();
+            display_queue_.UpdateStatusBar();
         
             // Print the debug info every 10 seconds
             if (clock_ticks_ % 10 == 0) {
                 // SystemInfo::PrintTaskCpuUsage(pdMS_TO_TICKS(1000));
                 // SystemInfo::PrintTaskList();
                 SystemInfo::PrintHeapStats();
+                display_queue_.LogStats();
+                EventBus::GetInstance().LogStats();
+            }
+            // Heap, per subsystem memory, task CPU, stack and settings writes every minute
+            if (clock_ticks_ % 60 == 0) {
+                MemoryBudget::GetInstance().LogStats();
+                TaskProfiler::GetInstance().LogStats();
+                Settings::LogStats();
             }
         }
     }
@@ -746,25 +809,25 @@ void Application::SetDeviceState(DeviceState state) {
     DeviceStateEventManager::GetInstance().PostStateChangeEvent(previous_state, state);
 
     auto& board = Board::GetInstance();
-    auto display = board.GetDisplay();
     auto led = board.GetLed();
     led->OnStateChanged();
     switch (state) {
         case kDeviceStateUnknown:
         case kDeviceStateIdle:
-            display->SetStatus(Lang::Strings::STANDBY);
-            display->SetEmotion("neutral");
+            display_queue_.SetStatus(Lang::Strings::STANDBY);
+            display_queue_.SetEmotion("neutral");
             audio_service_.EnableVoiceProcessing(false);
             audio_service_.EnableWakeWordDetection(true);
             break;
         case kDeviceStateConnecting:
-            display->SetStatus(Lang::Strings::CONNECTING);
-            display->SetEmotion("neutral");
-            display->SetChatMessage("system", "");
+            display_queue_.SetStatus(Lang::Strings::CONNECTING);
+            display_queue_.SetEmotion("neutral");
+            display_queue_.SetChatMessage("system", "");
             break;
         case kDeviceStateListening:
-            display->SetStatus(Lang::Strings::LISTENING);
-            display->SetEmotion("neutral");
+            display_queue_.SetStatus(Lang::Strings::LISTENING);
+            display_queue_.SetEmotion("neutral");
+            audio_service_.EnableSilenceSuppression(protocol_->server_dtx() && listening_mode_ == kListeningModeRealtime);
 
             // Make sure the audio processor is running
             if (!audio_service_.IsAudioProcessorRunning()) {
@@ -775,7 +838,7 @@ void Application::SetDeviceState(DeviceState state) {
             }
             break;
         case kDeviceStateSpeaking:
-            display->SetStatus(Lang::Strings::SPEAKING);
+            display_queue_.SetStatus(Lang::Strings::SPEAKING);
 
             if (listening_mode_ != kListeningModeRealtime) {
                 audio_service_.EnableVoiceProcessing(false);
@@ -806,7 +869,6 @@ void Application::Reboot() {
 
 bool Application::UpgradeFirmware(Ota& ota, const std::string& url) {
     auto& board = Board::GetInstance();
-    auto display = board.GetDisplay();
     
     // Use provided URL or get from OTA object
     std::string upgrade_url = url.empty() ? ota.GetFirmwareUrl() : url;
@@ -825,18 +887,17 @@ bool Application::UpgradeFirmware(Ota& ota, const std::string& url) {
     SetDeviceState(kDeviceStateUpgrading);
     
     std::string message = std::string(Lang::Strings::NEW_VERSION) + version_info;
-    display->SetChatMessage("system", message.c_str());
+    display_queue_.SetChatMessage("system", message.c_str());
 
     board.SetPowerSaveMode(false);
     audio_service_.Stop();
     vTaskDelay(pdMS_TO_TICKS(1000));
 
-    bool upgrade_success = ota.StartUpgradeFromUrl(upgrade_url, [display](int progress, size_t speed) {
-        std::thread([display, progress, speed]() {
-            char buffer[32];
-            snprintf(buffer, sizeof(buffer), "%d%% %uKB/s", progress, speed / 1024);
-            display->SetChatMessage("system", buffer);
-        }).detach();
+    bool upgrade_success = ota.StartUpgradeFromUrl(upgrade_url, [this](int progress, size_t speed) {
+        // Posting does not wait for the display, no need for a thread
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "%d%% %uKB/s", progress, speed / 1024);
+        display_queue_.SetChatMessage("system", buffer);
     });
 
     if (!upgrade_success) {
@@ -850,7 +911,7 @@ bool Application::UpgradeFirmware(Ota& ota, const std::string& url) {
     } else {
         // Upgrade success, reboot immediately
         ESP_LOGI(TAG, "Firmware upgrade successful, rebooting...");
-        display->SetChatMessage("system", "Upgrade successful, rebooting...");
+        display_queue_.SetChatMessage("system", "Upgrade successful, rebooting...");
         vTaskDelay(pdMS_TO_TICKS(1000)); // Brief pause to show message
         Reboot();
         return true;
@@ -913,20 +974,18 @@ void Application::SendMcpMessage(const std::string& payload) {
 void Application::SetAecMode(AecMode mode) {
     aec_mode_ = mode;
     Schedule([this]() {
-        auto& board = Board::GetInstance();
-        auto display = board.GetDisplay();
         switch (aec_mode_) {
         case kAecOff:
             audio_service_.EnableDeviceAec(false);
-            display->ShowNotification(Lang::Strings::RTC_MODE_OFF);
+            display_queue_.ShowNotification(Lang::Strings::RTC_MODE_OFF);
             break;
         case kAecOnServerSide:
             audio_service_.EnableDeviceAec(false);
-            display->ShowNotification(Lang::Strings::RTC_MODE_ON);
+            display_queue_.ShowNotification(Lang::Strings::RTC_MODE_ON);
             break;
         case kAecOnDeviceSide:
             audio_service_.EnableDeviceAec(true);
-            display->ShowNotification(Lang::Strings::RTC_MODE_ON);
+            display_queue_.ShowNotification(Lang::Strings::RTC_MODE_ON);
             break;
         }
 
@@ -15,6 +15,7 @@
 #include "ota.h"
 #include "audio_service.h"
 #include "device_state_event.h"
+#include "display_command_queue.h"
 
 
 #define MAIN_EVENT_SCHEDULE (1 << 0)
@@ -63,6 +64,8 @@ public:
     AecMode GetAecMode() const { return aec_mode_; }
     void PlaySound(const std::string_view& sound);
     AudioService& GetAudioService() { return audio_service_; }
+    // Display updates from the main loop go through here so they never wait for LVGL
+    DisplayCommandQueue& GetDisplayQueue() { return display_queue_; }
 
     Protocol* GetProtocol() { return protocol_.get(); }
 
@@ -80,6 +83,8 @@ private:
     AecMode aec_mode_ = kAecOff;
     std::string last_error_message_;
     AudioService audio_service_;
+    DisplayCommandQueue display_queue_;
+    std::vector<std::unique_ptr<AudioStreamPacket>> send_batch_;
 
     bool has_server_time_ = false;
     bool aborted_ = false;
@@ -92,6 +97,14 @@ private:
     void CheckAssetsVersion();
     void ShowActivationCode(const std::string& code, const std::string& message);
     void SetListeningMode(ListeningMode mode);
+
+    // Fast path handlers for flat server messages, see OnIncomingMessage
+    void OnIncomingMessage(const ServerMessage& message);
+    void HandleTtsMessage(const ServerMessage& message);
+    void HandleSttMessage(const ServerMessage& message);
+    void HandleLlmMessage(const ServerMessage& message);
+    void HandleSystemMessage(const ServerMessage& message);
+    void HandleAlertMessage(const ServerMessage& message);
 };
 
 
@@ -8,7 +8,9 @@
 #include <esp_log.h>
 #include <spi_flash_mmap.h>
 #include <esp_timer.h>
+#include <esp_rom_crc.h>
 #include <cbin_font.h>
+#include <cstring>
 
 
 #define TAG "Assets"
@@ -34,9 +36,30 @@ Assets::~Assets() {
 }
 
 uint32_t Assets::CalculateChecksum(const char* data, uint32_t length) {
+    auto bytes = reinterpret_cast<const uint8_t*>(data);
     uint32_t checksum = 0;
-    for (uint32_t i = 0; i < length; i++) {
-        checksum += data[i];
+    // Walk up to a word boundary, then sum four bytes per 32-bit flash read
+    while (length > 0 && (reinterpret_cast<uintptr_t>(bytes) & 3) != 0) {
+        checksum += *bytes++;
+        length--;
+    }
+    auto words = reinterpret_cast<const uint32_t*>(bytes);
+    uint32_t word_count = length / 4;
+    while (word_count > 0) {
+        // Two 16-bit lanes, each gains at most 510 per word, so flush every 128 words
+        uint32_t block = word_count < 128 ? word_count : 128;
+        uint32_t lanes = 0;
+        for (uint32_t i = 0; i < block; i++) {
+            uint32_t word = words[i];
+            lanes += (word & 0x00FF00FF) + ((word >> 8) & 0x00FF00FF);
+        }
+        checksum += (lanes & 0xFFFF) + (lanes >> 16);
+        words += block;
+        word_count -= block;
+    }
+    bytes = reinterpret_cast<const uint8_t*>(words);
+    for (uint32_t i = 0; i < (length & 3); i++) {
+        checksum += bytes[i];
     }
     return checksum & 0xFFFF;
 }
@@ -44,6 +67,8 @@ uint32_t Assets::CalculateChecksum(const char* data, uint32_t length) {
 bool Assets::InitializePartition() {
     partition_valid_ = false;
     checksum_valid_ = false;
+    package_checksum_checked_ = false;
+    has_checksum_table_ = false;
     assets_.clear();
 
     partition_ = esp_partition_find_first(ESP_PARTITION_TYPE_ANY, ESP_PARTITION_SUBTYPE_ANY, "assets");
@@ -61,46 +86,113 @@ bool Assets::InitializePartition() {
         return false;
     }
 
+    auto start_time = esp_timer_get_time();
     esp_err_t err = esp_partition_mmap(partition_, 0, partition_->size, ESP_PARTITION_MMAP_DATA, (const void**)&mmap_root_, &mmap_handle_);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to mmap assets partition: %s", esp_err_to_name(err));
         return false;
     }
+    auto mmap_time = esp_timer_get_time();
 
     partition_valid_ = true;
 
     uint32_t stored_files = *(uint32_t*)(mmap_root_ + 0);
-    uint32_t stored_chksum = *(uint32_t*)(mmap_root_ + 4);
-    uint32_t stored_len = *(uint32_t*)(mmap_root_ + 8);
+    stored_checksum_ = *(uint32_t*)(mmap_root_ + 4);
+    stored_len_ = *(uint32_t*)(mmap_root_ + 8);
 
-    if (stored_len > partition_->size - 12) {
-        ESP_LOGD(TAG, "The stored_len (0x%lx) is greater than the partition size (0x%lx) - 12", stored_len, partition_->size);
+    if (stored_len_ > partition_->size - 12) {
+        ESP_LOGD(TAG, "The stored_len (0x%lx) is greater than the partition size (0x%lx) - 12", stored_len_, partition_->size);
         return false;
     }
-
-    auto start_time = esp_timer_get_time();
-    uint32_t calculated_checksum = CalculateChecksum(mmap_root_ + 12, stored_len);
-    auto end_time = esp_timer_get_time();
-    ESP_LOGI(TAG, "The checksum calculation time is %d ms", int((end_time - start_time) / 1000));
-
-    if (calculated_checksum != stored_chksum) {
-        ESP_LOGE(TAG, "The calculated checksum (0x%lx) does not match the stored checksum (0x%lx)", calculated_checksum, stored_chksum);
+    if (stored_files > stored_len_ / sizeof(mmap_assets_table)) {
+        ESP_LOGE(TAG, "The file table (%lu files) does not fit in the stored length (0x%lx)", stored_files, stored_len_);
         return false;
     }
 
-    checksum_valid_ = true;
-
+    // Only the header and the file table are checked at boot, file contents are verified on first access
+    size_t data_start = 12 + sizeof(mmap_assets_table) * stored_files;
     for (uint32_t i = 0; i < stored_files; i++) {
         auto item = (const mmap_assets_table*)(mmap_root_ + 12 + i * sizeof(mmap_assets_table));
         auto asset = Asset{
             .size = static_cast<size_t>(item->asset_size),
-            .offset = static_cast<size_t>(12 + sizeof(mmap_assets_table) * stored_files + item->asset_offset)
+            .offset = static_cast<size_t>(data_start + item->asset_offset)
         };
-        assets_[item->asset_name] = asset;
+        if (asset.offset + 2 + asset.size > 12 + stored_len_) {
+            ESP_LOGE(TAG, "The asset %.32s is out of the stored range", item->asset_name);
+            assets_.clear();
+            return false;
+        }
+        assets_[std::string(item->asset_name, strnlen(item->asset_name, sizeof(item->asset_name)))] = asset;
+    }
+    checksum_valid_ = true;
+
+    LoadChecksumTable();
+    auto end_time = esp_timer_get_time();
+    ESP_LOGI(TAG, "Assets partition ready in %d ms (mmap %d ms, %lu files, %s)", int((end_time - start_time) / 1000),
+        int((mmap_time - start_time) / 1000), stored_files, has_checksum_table_ ? "per-file CRC32" : "package checksum");
+    return checksum_valid_;
+}
+
+void Assets::LoadChecksumTable() {
+    auto it = assets_.find(ASSETS_CHECKSUM_FILE);
+    if (it == assets_.end()) {
+        return;
+    }
+
+    struct ChecksumEntry {
+        char name[32];
+        uint32_t crc32;
+    };
+    auto data = mmap_root_ + it->second.offset + 2;
+    size_t count = it->second.size / sizeof(ChecksumEntry);
+    for (size_t i = 0; i < count; i++) {
+        ChecksumEntry entry;
+        memcpy(&entry, data + i * sizeof(ChecksumEntry), sizeof(entry));
+        auto asset = assets_.find(std::string(entry.name, strnlen(entry.name, sizeof(entry.name))));
+        if (asset != assets_.end()) {
+            asset->second.crc32 = entry.crc32;
+            asset->second.has_crc32 = true;
+        }
+    }
+    has_checksum_table_ = true;
+}
+
+bool Assets::VerifyPackageChecksum() {
+    if (!package_checksum_checked_) {
+        package_checksum_checked_ = true;
+        auto start_time = esp_timer_get_time();
+        uint32_t calculated_checksum = CalculateChecksum(mmap_root_ + 12, stored_len_);
+        ESP_LOGI(TAG, "The checksum calculation time is %d ms", int((esp_timer_get_time() - start_time) / 1000));
+        if (calculated_checksum != stored_checksum_) {
+            ESP_LOGE(TAG, "The calculated checksum (0x%lx) does not match the stored checksum (0x%lx)", calculated_checksum, stored_checksum_);
+            checksum_valid_ = false;
+        }
     }
     return checksum_valid_;
 }
 
+bool Assets::VerifyAsset(const std::string& name, Asset& asset) {
+    std::lock_guard<std::mutex> lock(verify_mutex_);
+    if (asset.verified) {
+        return true;
+    }
+    if (!asset.has_crc32) {
+        // Packages without a CRC32 table (or files missing from it) fall back to the whole package checksum, once
+        if (!VerifyPackageChecksum()) {
+            return false;
+        }
+    } else {
+        auto data = reinterpret_cast<const uint8_t*>(mmap_root_ + asset.offset + 2);
+        uint32_t crc32 = esp_rom_crc32_le(0, data, asset.size);
+        if (crc32 != asset.crc32) {
+            ESP_LOGE(TAG, "The asset %s is corrupted, crc32 0x%08lx != 0x%08lx", name.c_str(), crc32, asset.crc32);
+            return false;
+        }
+    }
+    asset.verified = true;
+    return true;
+}
+
 bool Assets::Apply() {
     void* ptr = nullptr;
     size_t size = 0;
@@ -502,7 +594,7 @@ bool Assets::Download(std::string url, std::function<void(int progress, size_t s
 
 bool Assets::GetAssetData(const std::string& name, void*& ptr, size_t& size) {
     auto asset = assets_.find(name);
-    if (asset == assets_.end()) {
+    if (asset == assets_.end() || !checksum_valid_) {
         return false;
     }
     auto data = (const char*)(mmap_root_ + asset->second.offset);
@@ -511,6 +603,10 @@ bool Assets::GetAssetData(const std::string& name, void*& ptr, size_t& size) {
         return false;
     }
 
+    if (!VerifyAsset(name, asset->second)) {
+        return false;
+    }
+
     ptr = static_cast<void*>(const_cast<char*>(data + 2));
     size = asset->second.size;
     return true;
@@ -4,15 +4,22 @@
 #include <map>
 #include <string>
 #include <functional>
+#include <mutex>
 
 #include <cJSON.h>
 #include <esp_partition.h>
 #include <model_path.h>
 
 
+// Optional per-file CRC32 table packed with the assets, entries of {char name[32]; uint32_t crc32;}
+#define ASSETS_CHECKSUM_FILE "checksums.bin"
+
 struct Asset {
     size_t size;
     size_t offset;
+    uint32_t crc32 = 0;
+    bool has_crc32 = false;
+    bool verified = false;
 };
 
 class Assets {
@@ -37,6 +44,9 @@ private:
     Assets& operator=(const Assets&) = delete;
 
     bool InitializePartition();
+    void LoadChecksumTable();
+    bool VerifyAsset(const std::string& name, Asset& asset);
+    bool VerifyPackageChecksum();
     uint32_t CalculateChecksum(const char* data, uint32_t length);
 
     const esp_partition_t* partition_ = nullptr;
@@ -44,6 +54,11 @@ private:
     const char* mmap_root_ = nullptr;
     bool partition_valid_ = false;
     bool checksum_valid_ = false;
+    bool package_checksum_checked_ = false;
+    bool has_checksum_table_ = false;
+    uint32_t stored_checksum_ = 0;
+    uint32_t stored_len_ = 0;
+    std::mutex verify_mutex_;
     std::string default_assets_url_;
     srmodel_list_t* models_list_ = nullptr;
     std::map<std::string, Asset> assets_;
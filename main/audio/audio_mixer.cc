@@ -0,0 +1,177 @@
+#include "audio_mixer.h"
+
+#include <esp_log.h>
+
+#include <algorithm>
+#include <cstring>
+
+#define TAG "AudioMixer"
+
+#define UNITY_GAIN (1 << 15)
+
+static int32_t PercentToGain(int percent) {
+    return std::min(std::max(percent, 0), 100) * UNITY_GAIN / 100;
+}
+
+void AudioMixer::SetSampleRate(int sample_rate) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ramp_samples_ = std::max(sample_rate * AUDIO_MIXER_RAMP_MS / 1000, 1);
+}
+
+void AudioMixer::SetGain(int voice, int percent) {
+    if (voice < 0 || voice >= AUDIO_MIXER_MAX_VOICES) {
+        ESP_LOGE(TAG, "Invalid voice %d", voice);
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    voices_[voice].gain = PercentToGain(percent);
+}
+
+void AudioMixer::SetDucking(int voice, int percent) {
+    if (voice < 0 || voice >= AUDIO_MIXER_MAX_VOICES) {
+        ESP_LOGE(TAG, "Invalid voice %d", voice);
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    voices_[voice].duck_gain = PercentToGain(percent);
+}
+
+void AudioMixer::Write(int voice, const int16_t* pcm, size_t samples) {
+    if (voice < 0 || voice >= AUDIO_MIXER_MAX_VOICES) {
+        ESP_LOGE(TAG, "Invalid voice %d", voice);
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& v = voices_[voice];
+    // Drop the consumed head before the buffer grows, the capacity is kept
+    if (v.read_pos > 0) {
+        v.buffer.erase(v.buffer.begin(), v.buffer.begin() + v.read_pos);
+        v.read_pos = 0;
+    }
+    v.buffer.insert(v.buffer.end(), pcm, pcm + samples);
+}
+
+void AudioMixer::Clear(int voice) {
+    if (voice < 0 || voice >= AUDIO_MIXER_MAX_VOICES) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    voices_[voice].buffer.clear();
+    voices_[voice].read_pos = 0;
+}
+
+void AudioMixer::ClearAll() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& v : voices_) {
+        v.buffer.clear();
+        v.read_pos = 0;
+    }
+}
+
+size_t AudioMixer::Available(int voice) {
+    if (voice < 0 || voice >= AUDIO_MIXER_MAX_VOICES) {
+        return 0;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    return voices_[voice].available();
+}
+
+bool AudioMixer::HasData() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& v : voices_) {
+        if (v.available() > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t AudioMixer::Read(int16_t* out, size_t samples) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    size_t produced = 0;
+    int active = 0;
+    int32_t duck = UNITY_GAIN;
+    for (auto& v : voices_) {
+        size_t n = std::min(v.available(), samples);
+        if (n > 0) {
+            produced = std::max(produced, n);
+            active++;
+            if (v.duck_gain >= 0) {
+                duck = std::min(duck, v.duck_gain);
+            }
+        }
+    }
+
+    // Target gains, voices that are silent jump to theirs so they do not fade in later
+    int32_t targets[AUDIO_MIXER_MAX_VOICES];
+    for (int i = 0; i < AUDIO_MIXER_MAX_VOICES; i++) {
+        auto& v = voices_[i];
+        targets[i] = v.duck_gain >= 0 ? v.gain : v.gain * duck >> 15;
+        if (v.available() == 0) {
+            v.applied_gain = targets[i];
+            v.ramp_target = targets[i];
+        }
+    }
+    if (produced == 0) {
+        return 0;
+    }
+
+    // Single voice at unity gain, the common speech only case
+    if (active == 1) {
+        for (int i = 0; i < AUDIO_MIXER_MAX_VOICES; i++) {
+            auto& v = voices_[i];
+            if (v.available() > 0 && v.applied_gain == UNITY_GAIN && targets[i] == UNITY_GAIN) {
+                memcpy(out, v.buffer.data() + v.read_pos, produced * sizeof(int16_t));
+                v.read_pos += produced;
+                if (v.read_pos == v.buffer.size()) {
+                    v.buffer.clear();
+                    v.read_pos = 0;
+                }
+                return produced;
+            }
+        }
+    }
+
+    mix_buffer_.assign(produced, 0);
+    int32_t* mix = mix_buffer_.data();
+    for (int i = 0; i < AUDIO_MIXER_MAX_VOICES; i++) {
+        auto& v = voices_[i];
+        size_t n = std::min(v.available(), produced);
+        if (n == 0) {
+            continue;
+        }
+        const int16_t* pcm = v.buffer.data() + v.read_pos;
+        int32_t target = targets[i];
+        // A new target restarts the ramp from where the gain is, otherwise it goes on
+        if (target != v.ramp_target) {
+            v.ramp_start = v.applied_gain;
+            v.ramp_target = target;
+            v.ramp_pos = 0;
+        }
+        int32_t start = v.ramp_start;
+        size_t ramp = v.applied_gain == target ? 0 : std::min(n, ramp_samples_ - std::min(v.ramp_pos, ramp_samples_));
+        for (size_t j = 0; j < ramp; j++) {
+            int64_t pos = (int64_t)(v.ramp_pos + j);
+            int32_t gain = start + (int32_t)((int64_t)(target - start) * pos / (int64_t)ramp_samples_);
+            mix[j] += pcm[j] * gain >> 15;
+        }
+        for (size_t j = ramp; j < n; j++) {
+            mix[j] += pcm[j] * target >> 15;
+        }
+        v.ramp_pos += ramp;
+        v.applied_gain = v.ramp_pos < ramp_samples_ ?
+            start + (int32_t)((int64_t)(target - start) * (int64_t)v.ramp_pos / (int64_t)ramp_samples_) : target;
+
+        v.read_pos += n;
+        if (v.read_pos == v.buffer.size()) {
+            v.buffer.clear();
+            v.read_pos = 0;
+        }
+    }
+
+    for (size_t j = 0; j < produced; j++) {
+        out[j] = (int16_t)std::min(std::max(mix[j], (int32_t)INT16_MIN), (int32_t)INT16_MAX);
+    }
+    return produced;
+}
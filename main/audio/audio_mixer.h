@@ -0,0 +1,60 @@
+#ifndef AUDIO_MIXER_H
+#define AUDIO_MIXER_H
+
+#include <cstdint>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+#define AUDIO_MIXER_MAX_VOICES 4
+// Gain changes, including ducking, are ramped over this time to avoid clicks
+#define AUDIO_MIXER_RAMP_MS 30
+
+/*
+ * Software mixer in front of AudioCodec::OutputData.
+ *
+ * Every voice is a PCM FIFO at the codec output sample rate, writers resample
+ * before Write(). Read() sums what the voices hold with their gain and
+ * saturates to 16 bits. A voice can duck the others while it has data, which
+ * lowers the speech under notification sounds instead of cutting it.
+ */
+class AudioMixer {
+public:
+    AudioMixer() = default;
+
+    void SetSampleRate(int sample_rate);
+    // Gain of a voice, 0-100
+    void SetGain(int voice, int percent);
+    // While this voice has data, the other voices are scaled to percent (0-100)
+    void SetDucking(int voice, int percent);
+
+    void Write(int voice, const int16_t* pcm, size_t samples);
+    void Clear(int voice);
+    void ClearAll();
+    size_t Available(int voice);
+    bool HasData();
+
+    // Mixes up to samples from all voices, returns the number of samples written to out
+    size_t Read(int16_t* out, size_t samples);
+
+private:
+    struct Voice {
+        std::vector<int16_t> buffer;
+        size_t read_pos = 0;
+        int32_t gain = 1 << 15;             // Q15
+        int32_t applied_gain = 1 << 15;     // Q15 gain reached at the end of the last read
+        int32_t duck_gain = -1;             // Q15 gain applied to the others, negative if the voice does not duck
+        // The ramp towards ramp_target spans reads, ramp_pos samples of it are done
+        int32_t ramp_start = 1 << 15;
+        int32_t ramp_target = 1 << 15;
+        size_t ramp_pos = 0;
+        size_t available() const { return buffer.size() - read_pos; }
+    };
+
+    std::mutex mutex_;
+    Voice voices_[AUDIO_MIXER_MAX_VOICES];
+    std::vector<int32_t> mix_buffer_;
+    size_t ramp_samples_ = 16000 * AUDIO_MIXER_RAMP_MS / 1000;
+};
+
+#endif // AUDIO_MIXER_H
@@ -1,6 +1,9 @@
 #include "audio_service.h"
 #include <esp_log.h>
 #include <cstring>
+#include <algorithm>
+
+#include "output_level_meter.h"
 
 #if CONFIG_USE_AUDIO_PROCESSOR
 #include "processors/afe_audio_processor.h"
@@ -35,8 +38,10 @@ void AudioService::Initialize(AudioCodec* codec) {
 
     /* Setup the audio codec */
     opus_decoder_ = std::make_unique<OpusDecoderWrapper>(codec->output_sample_rate(), 1, OPUS_FRAME_DURATION_MS);
-    opus_encoder_ = std::make_unique<OpusEncoderWrapper>(16000, 1, OPUS_FRAME_DURATION_MS);
-    opus_encoder_->SetComplexity(0);
+    SetEncodeFrameDuration(OPUS_FRAME_DURATION_MS);
+
+    mixer_.SetSampleRate(codec->output_sample_rate());
+    mixer_.SetDucking(AUDIO_MIXER_VOICE_SOUND, SOUND_DUCKING_PERCENT);
 
     if (codec->input_sample_rate() != 16000) {
         input_resampler_.Configure(codec->input_sample_rate(), 16000);
@@ -129,6 +134,8 @@ void AudioService::Stop() {
     audio_decode_queue_.clear();
     audio_playback_queue_.clear();
     audio_testing_queue_.clear();
+    sound_decode_queue_.clear();
+    mixer_.ClearAll();
     audio_queue_cv_.notify_all();
 }
 
@@ -259,22 +266,40 @@ void AudioService::AudioInputTask() {
 void AudioService::AudioOutputTask() {
     while (true) {
         std::unique_lock<std::mutex> lock(audio_queue_mutex_);
-        audio_queue_cv_.wait(lock, [this]() { return !audio_playback_queue_.empty() || service_stopped_; });
+        audio_queue_cv_.wait(lock, [this]() {
+            return !audio_playback_queue_.empty() || mixer_.HasData() || service_stopped_;
+        });
         if (service_stopped_) {
             break;
         }
 
-        auto task = std::move(audio_playback_queue_.front());
-        audio_playback_queue_.pop_front();
-        audio_queue_cv_.notify_all();
+        /* Speech sets the frame size, sounds alone are played in frames of OPUS_FRAME_DURATION_MS */
+        std::unique_ptr<AudioTask> task;
+        size_t frame_samples = OPUS_FRAME_DURATION_MS * codec_->output_sample_rate() / 1000;
+        if (!audio_playback_queue_.empty()) {
+            task = std::move(audio_playback_queue_.front());
+            audio_playback_queue_.pop_front();
+            audio_queue_cv_.notify_all();
+            frame_samples = task->pcm.size();
+        }
         lock.unlock();
 
+        if (task) {
+            mixer_.Write(AUDIO_MIXER_VOICE_SPEECH, task->pcm.data(), task->pcm.size());
+        }
+        output_frame_.resize(frame_samples);
+        output_frame_.resize(mixer_.Read(output_frame_.data(), frame_samples));
+        if (output_frame_.empty()) {
+            continue;
+        }
+
         if (!codec_->output_enabled()) {
             esp_timer_stop(audio_power_timer_);
             esp_timer_start_periodic(audio_power_timer_, AUDIO_POWER_CHECK_INTERVAL_MS * 1000);
             codec_->EnableOutput(true);
         }
-        codec_->OutputData(task->pcm);
+        codec_->OutputData(output_frame_);
+        OutputLevelMeter::GetInstance().Feed(output_frame_.data(), output_frame_.size(), codec_->output_sample_rate());
 
         /* Update the last output time */
         last_output_time_ = std::chrono::steady_clock::now();
@@ -282,7 +307,7 @@ void AudioService::AudioOutputTask() {
 
 #if CONFIG_USE_SERVER_AEC
         /* Record the timestamp for server AEC */
-        if (task->timestamp > 0) {
+        if (task && task->timestamp > 0) {
             lock.lock();
             timestamp_queue_.push_back(task->timestamp);
         }
@@ -297,13 +322,37 @@ void AudioService::OpusCodecTask() {
         std::unique_lock<std::mutex> lock(audio_queue_mutex_);
         audio_queue_cv_.wait(lock, [this]() {
             return service_stopped_ ||
-                (!audio_encode_queue_.empty() && audio_send_queue_.size() < MAX_SEND_PACKETS_IN_QUEUE) ||
-                (!audio_decode_queue_.empty() && audio_playback_queue_.size() < MAX_PLAYBACK_TASKS_IN_QUEUE);
+                (!audio_encode_queue_.empty() && audio_send_queue_.size() < max_send_packets_) ||
+                (!audio_decode_queue_.empty() && audio_playback_queue_.size() < MAX_PLAYBACK_TASKS_IN_QUEUE) ||
+                (!sound_decode_queue_.empty() && !IsSoundBacklogFull());
         });
         if (service_stopped_) {
             break;
         }
 
+        /* Decode sounds straight into the mixer */
+        if (!sound_decode_queue_.empty() && !IsSoundBacklogFull()) {
+            auto packet = std::move(sound_decode_queue_.front());
+            sound_decode_queue_.pop_front();
+            audio_queue_cv_.notify_all();
+            lock.unlock();
+
+            std::vector<int16_t> pcm;
+            SetSoundDecodeSampleRate(packet->sample_rate, packet->frame_duration);
+            if (sound_decoder_->Decode(std::move(packet->payload), pcm)) {
+                if (sound_decoder_->sample_rate() != codec_->output_sample_rate()) {
+                    std::vector<int16_t> resampled(sound_resampler_.GetOutputSamples(pcm.size()));
+                    sound_resampler_.Process(pcm.data(), pcm.size(), resampled.data());
+                    pcm = std::move(resampled);
+                }
+                mixer_.Write(AUDIO_MIXER_VOICE_SOUND, pcm.data(), pcm.size());
+            } else {
+                ESP_LOGE(TAG, "Failed to decode sound");
+            }
+            lock.lock();
+            audio_queue_cv_.notify_all();
+        }
+
         /* Decode the audio from decode queue */
         if (!audio_decode_queue_.empty() && audio_playback_queue_.size() < MAX_PLAYBACK_TASKS_IN_QUEUE) {
             auto packet = std::move(audio_decode_queue_.front());
@@ -339,28 +388,57 @@ void AudioService::OpusCodecTask() {
         }
         
         /* Encode the audio to send queue */
-        if (!audio_encode_queue_.empty() && audio_send_queue_.size() < MAX_SEND_PACKETS_IN_QUEUE) {
+        if (!audio_encode_queue_.empty() && audio_send_queue_.size() < max_send_packets_) {
             auto task = std::move(audio_encode_queue_.front());
             audio_encode_queue_.pop_front();
             audio_queue_cv_.notify_all();
+            size_t send_queue_depth = audio_send_queue_.size();
+            size_t max_send_packets = max_send_packets_;
+            bool silence_suppression = silence_suppression_;
             lock.unlock();
 
+            // The encoder settings are only changed from this task, between two frames.
+            // The encoder follows the frame size the processor delivers.
+            int frame_duration = task->pcm.size() * 1000 / 16000;
+            if (frame_duration != encoder_frame_duration_) {
+                if (frame_duration != 20 && frame_duration != 40 && frame_duration != 60) {
+                    ESP_LOGE(TAG, "Invalid encode frame of %u samples", (unsigned)task->pcm.size());
+                    continue;
+                }
+                SetEncodeFrameDuration(frame_duration);
+            }
+            encode_governor_->OnSendQueueDepth(send_queue_depth, max_send_packets);
+            if (silence_suppression != uplink_gate_.enabled()) {
+                uplink_gate_.SetEnabled(silence_suppression);
+                encode_governor_->SetDtxForced(silence_suppression);
+            }
             auto packet = std::make_unique<AudioStreamPacket>();
-            packet->frame_duration = OPUS_FRAME_DURATION_MS;
+            packet->frame_duration = encoder_frame_duration_;
             packet->sample_rate = 16000;
             packet->timestamp = task->timestamp;
+            int64_t encode_start = esp_timer_get_time();
             if (!opus_encoder_->Encode(std::move(task->pcm), packet->payload)) {
                 ESP_LOGE(TAG, "Failed to encode audio");
                 continue;
             }
+            encode_governor_->OnFrameEncoded(esp_timer_get_time() - encode_start);
 
             if (task->type == kAudioTaskTypeEncodeToSendQueue) {
-                {
-                    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-                    audio_send_queue_.push_back(std::move(packet));
-                }
-                if (callbacks_.on_send_queue_available) {
-                    callbacks_.on_send_queue_available();
+                // Without a running VAD only the encoder's DTX frames count as silence
+                bool speech = !audio_processor_->IsVadEnabled() || voice_detected_;
+                uplink_packets_.clear();
+                uplink_gate_.Process(std::move(packet), speech, uplink_packets_);
+                debug_statistics_.suppressed_count = uplink_gate_.suppressed_frames();
+                if (!uplink_packets_.empty()) {
+                    {
+                        std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+                        for (auto& uplink_packet : uplink_packets_) {
+                            audio_send_queue_.push_back(std::move(uplink_packet));
+                        }
+                    }
+                    if (callbacks_.on_send_queue_available) {
+                        callbacks_.on_send_queue_available();
+                    }
                 }
             } else if (task->type == kAudioTaskTypeEncodeToTestingQueue) {
                 std::lock_guard<std::mutex> lock(audio_queue_mutex_);
@@ -389,6 +467,38 @@ void AudioService::SetDecodeSampleRate(int sample_rate, int frame_duration) {
     }
 }
 
+void AudioService::SetEncodeFrameDuration(int frame_duration) {
+    ESP_LOGI(TAG, "Uplink frame duration %d ms", frame_duration);
+    encode_governor_.reset();
+    opus_encoder_ = std::make_unique<OpusEncoderWrapper>(16000, 1, frame_duration);
+#if CONFIG_OPUS_ENCODE_DTX
+    encode_governor_ = std::make_unique<OpusEncodeGovernor>(opus_encoder_.get(), frame_duration, true);
+#else
+    encode_governor_ = std::make_unique<OpusEncodeGovernor>(opus_encoder_.get(), frame_duration, false);
+#endif
+    encode_governor_->SetDtxForced(uplink_gate_.enabled());
+    uplink_gate_.Configure(frame_duration);
+    encoder_frame_duration_ = frame_duration;
+}
+
+void AudioService::SetSoundDecodeSampleRate(int sample_rate, int frame_duration) {
+    if (sound_decoder_ && sound_decoder_->sample_rate() == sample_rate && sound_decoder_->duration_ms() == frame_duration) {
+        return;
+    }
+
+    sound_decoder_.reset();
+    sound_decoder_ = std::make_unique<OpusDecoderWrapper>(sample_rate, 1, frame_duration);
+    if (sample_rate != codec_->output_sample_rate()) {
+        sound_resampler_.Configure(sample_rate, codec_->output_sample_rate());
+    }
+}
+
+/* Keeps about MAX_PLAYBACK_TASKS_IN_QUEUE frames of decoded sound ahead of the speaker */
+bool AudioService::IsSoundBacklogFull() {
+    size_t frame_samples = OPUS_FRAME_DURATION_MS * codec_->output_sample_rate() / 1000;
+    return mixer_.Available(AUDIO_MIXER_VOICE_SOUND) >= MAX_PLAYBACK_TASKS_IN_QUEUE * frame_samples;
+}
+
 void AudioService::PushTaskToEncodeQueue(AudioTaskType type, std::vector<int16_t>&& pcm) {
     auto task = std::make_unique<AudioTask>();
     task->type = type;
@@ -413,10 +523,11 @@ void AudioService::PushTaskToEncodeQueue(AudioTaskType type, std::vector<int16_t
 }
 
 bool AudioService::PushPacketToDecodeQueue(std::unique_ptr<AudioStreamPacket> packet, bool wait) {
+    size_t max_packets = MAX_DECODE_QUEUE_DURATION_MS / std::max(packet->frame_duration, 10);
     std::unique_lock<std::mutex> lock(audio_queue_mutex_);
-    if (audio_decode_queue_.size() >= MAX_DECODE_PACKETS_IN_QUEUE) {
+    if (audio_decode_queue_.size() >= max_packets) {
         if (wait) {
-            audio_queue_cv_.wait(lock, [this]() { return audio_decode_queue_.size() < MAX_DECODE_PACKETS_IN_QUEUE; });
+            audio_queue_cv_.wait(lock, [this, max_packets]() { return audio_decode_queue_.size() < max_packets; });
         } else {
             ESP_LOGW(TAG, "Decode queue full, dropping packet");
             return false;
@@ -441,6 +552,19 @@ std::unique_ptr<AudioStreamPacket> AudioService::PopPacketFromSendQueue() {
     return packet;
 }
 
+size_t AudioService::PopPacketsFromSendQueue(std::vector<std::unique_ptr<AudioStreamPacket>>& packets, size_t max_packets) {
+    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+    size_t count = std::min(audio_send_queue_.size(), max_packets);
+    for (size_t i = 0; i < count; i++) {
+        packets.push_back(std::move(audio_send_queue_.front()));
+        audio_send_queue_.pop_front();
+    }
+    if (count > 0) {
+        audio_queue_cv_.notify_all();
+    }
+    return count;
+}
+
 void AudioService::EncodeWakeWord() {
     if (wake_word_) {
         wake_word_->EncodeWakeWordData();
@@ -484,9 +608,16 @@ void AudioService::EnableWakeWordDetection(bool enable) {
 void AudioService::EnableVoiceProcessing(bool enable) {
     ESP_LOGD(TAG, "%s voice processing", enable ? "Enabling" : "Disabling");
     if (enable) {
+        int frame_duration;
+        {
+            std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+            frame_duration = uplink_frame_duration_;
+        }
         if (!audio_processor_initialized_) {
-            audio_processor_->Initialize(codec_, OPUS_FRAME_DURATION_MS, models_list_);
+            audio_processor_->Initialize(codec_, frame_duration, models_list_);
             audio_processor_initialized_ = true;
+        } else {
+            audio_processor_->SetFrameDuration(frame_duration);
         }
 
         /* We should make sure no audio is playing */
@@ -500,6 +631,26 @@ void AudioService::EnableVoiceProcessing(bool enable) {
     }
 }
 
+void AudioService::EnableSilenceSuppression(bool enable) {
+    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+    if (silence_suppression_ != enable) {
+        ESP_LOGI(TAG, "%s uplink silence suppression", enable ? "Enabling" : "Disabling");
+        silence_suppression_ = enable;
+    }
+}
+
+bool AudioService::SetUplinkFrameDuration(int frame_duration_ms) {
+    if (frame_duration_ms != 20 && frame_duration_ms != 40 && frame_duration_ms != 60) {
+        ESP_LOGW(TAG, "Unsupported uplink frame duration %d ms", frame_duration_ms);
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+    uplink_frame_duration_ = frame_duration_ms;
+    max_send_packets_ = MAX_SEND_QUEUE_DURATION_MS / frame_duration_ms;
+    audio_queue_cv_.notify_all();
+    return true;
+}
+
 void AudioService::EnableAudioTesting(bool enable) {
     ESP_LOGI(TAG, "%s audio testing", enable ? "Enabling" : "Disabling");
     if (enable) {
@@ -619,7 +770,16 @@ void AudioService::PlaySound(const std::string_view& ogg) {
             packet->frame_duration = 60;
             packet->payload.resize(pkt_len);
             std::memcpy(packet->payload.data(), pkt_ptr, pkt_len);
-            PushPacketToDecodeQueue(std::move(packet), true);
+
+            std::unique_lock<std::mutex> lock(audio_queue_mutex_);
+            audio_queue_cv_.wait(lock, [this]() {
+                return sound_decode_queue_.size() < MAX_SOUND_PACKETS_IN_QUEUE || service_stopped_;
+            });
+            if (service_stopped_) {
+                return;
+            }
+            sound_decode_queue_.push_back(std::move(packet));
+            audio_queue_cv_.notify_all();
         }
 
         offset = body_off + body_size;
@@ -628,7 +788,8 @@ void AudioService::PlaySound(const std::string_view& ogg) {
 
 bool AudioService::IsIdle() {
     std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-    return audio_encode_queue_.empty() && audio_decode_queue_.empty() && audio_playback_queue_.empty() && audio_testing_queue_.empty();
+    return audio_encode_queue_.empty() && audio_decode_queue_.empty() && audio_playback_queue_.empty() && audio_testing_queue_.empty() &&
+        sound_decode_queue_.empty() && !mixer_.HasData();
 }
 
 void AudioService::PrepareOutput() {
@@ -647,6 +808,8 @@ void AudioService::ResetDecoder() {
     audio_decode_queue_.clear();
     audio_playback_queue_.clear();
     audio_testing_queue_.clear();
+    /* Sounds keep playing, they do not belong to the session being reset */
+    mixer_.Clear(AUDIO_MIXER_VOICE_SPEECH);
     audio_queue_cv_.notify_all();
 }
 
@@ -18,6 +18,9 @@
 #include <opus_resampler.h>
 
 #include "audio_codec.h"
+#include "audio_mixer.h"
+#include "opus_encode_governor.h"
+#include "uplink_silence_gate.h"
 #include "audio_processor.h"
 #include "processors/audio_debugger.h"
 #include "wake_word.h"
@@ -27,7 +30,11 @@
 /*
  * There are two types of audio data flow:
  * 1. (MIC) -> [Processors] -> {Encode Queue} -> [Opus Encoder] -> {Send Queue} -> (Server)
- * 2. (Server) -> {Decode Queue} -> [Opus Decoder] -> {Playback Queue} -> (Speaker)
+ * 2. (Server) -> {Decode Queue} -> [Opus Decoder] -> {Playback Queue} -> [Mixer] -> (Speaker)
+ * 3. (PlaySound) -> {Sound Queue} -> [Opus Decoder] -> [Mixer]
+ *
+ * Sounds are decoded by their own decoder and mixed over the speech, which is
+ * ducked while a sound plays, so alerts do not wait for or interrupt the TTS.
  *
  * We use one task for MIC / Speaker / Processors, and one task for Opus Encoder / Opus Decoder.
  * 
@@ -35,14 +42,21 @@
  * 
  */
 
+// Default uplink frame duration, also used for sounds and wake word data
 #define OPUS_FRAME_DURATION_MS 60
 #define MAX_ENCODE_TASKS_IN_QUEUE 2
 #define MAX_PLAYBACK_TASKS_IN_QUEUE 2
-#define MAX_DECODE_PACKETS_IN_QUEUE (2400 / OPUS_FRAME_DURATION_MS)
-#define MAX_SEND_PACKETS_IN_QUEUE (2400 / OPUS_FRAME_DURATION_MS)
+// Queue limits are durations, the packet counts follow the frame duration of the stream
+#define MAX_DECODE_QUEUE_DURATION_MS 2400
+#define MAX_SEND_QUEUE_DURATION_MS 2400
+#define MAX_SOUND_PACKETS_IN_QUEUE (MAX_DECODE_QUEUE_DURATION_MS / OPUS_FRAME_DURATION_MS)
 #define AUDIO_TESTING_MAX_DURATION_MS 10000
 #define MAX_TIMESTAMPS_IN_QUEUE 3
 
+#define AUDIO_MIXER_VOICE_SPEECH 0
+#define AUDIO_MIXER_VOICE_SOUND 1
+#define SOUND_DUCKING_PERCENT 30
+
 #define AUDIO_POWER_TIMEOUT_MS 15000
 #define AUDIO_POWER_CHECK_INTERVAL_MS 1000
 
@@ -77,6 +91,7 @@ struct DebugStatistics {
     uint32_t decode_count = 0;
     uint32_t encode_count = 0;
     uint32_t playback_count = 0;
+    uint32_t suppressed_count = 0;
 };
 
 class AudioService {
@@ -98,6 +113,10 @@ public:
 
     void EnableWakeWordDetection(bool enable);
     void EnableVoiceProcessing(bool enable);
+    // Leave silent frames out of the uplink, only when the server accepts it (Protocol::server_dtx)
+    void EnableSilenceSuppression(bool enable);
+    // Uplink frame duration negotiated with the server (20, 40 or 60 ms), applied when voice processing starts
+    bool SetUplinkFrameDuration(int frame_duration_ms);
     void EnableAudioTesting(bool enable);
     void EnableDeviceAec(bool enable);
 
@@ -105,11 +124,15 @@ public:
 
     bool PushPacketToDecodeQueue(std::unique_ptr<AudioStreamPacket> packet, bool wait = false);
     std::unique_ptr<AudioStreamPacket> PopPacketFromSendQueue();
+    // Moves up to max_packets from the send queue into packets, returns the number moved
+    size_t PopPacketsFromSendQueue(std::vector<std::unique_ptr<AudioStreamPacket>>& packets, size_t max_packets);
     void PlaySound(const std::string_view& sound);
     void PrepareOutput();
     bool ReadAudioData(std::vector<int16_t>& data, int sample_rate, int samples);
     void ResetDecoder();
     void SetModelsList(srmodel_list_t* models_list);
+    // Per voice gain and ducking, see AUDIO_MIXER_VOICE_*
+    AudioMixer& GetMixer() { return mixer_; }
 
 private:
     AudioCodec* codec_ = nullptr;
@@ -118,10 +141,17 @@ private:
     std::unique_ptr<WakeWord> wake_word_;
     std::unique_ptr<AudioDebugger> audio_debugger_;
     std::unique_ptr<OpusEncoderWrapper> opus_encoder_;
+    std::unique_ptr<OpusEncodeGovernor> encode_governor_;
+    UplinkSilenceGate uplink_gate_;
+    std::vector<std::unique_ptr<AudioStreamPacket>> uplink_packets_;
     std::unique_ptr<OpusDecoderWrapper> opus_decoder_;
     OpusResampler input_resampler_;
     OpusResampler reference_resampler_;
     OpusResampler output_resampler_;
+    std::unique_ptr<OpusDecoderWrapper> sound_decoder_;
+    OpusResampler sound_resampler_;
+    AudioMixer mixer_;
+    std::vector<int16_t> output_frame_;
     DebugStatistics debug_statistics_;
     srmodel_list_t* models_list_ = nullptr;
 
@@ -138,12 +168,17 @@ private:
     std::deque<std::unique_ptr<AudioStreamPacket>> audio_testing_queue_;
     std::deque<std::unique_ptr<AudioTask>> audio_encode_queue_;
     std::deque<std::unique_ptr<AudioTask>> audio_playback_queue_;
+    std::deque<std::unique_ptr<AudioStreamPacket>> sound_decode_queue_;
     // For server AEC
     std::deque<uint32_t> timestamp_queue_;
 
     bool wake_word_initialized_ = false;
     bool audio_processor_initialized_ = false;
     bool voice_detected_ = false;
+    bool silence_suppression_ = false;
+    int uplink_frame_duration_ = OPUS_FRAME_DURATION_MS;
+    size_t max_send_packets_ = MAX_SEND_QUEUE_DURATION_MS / OPUS_FRAME_DURATION_MS;
+    int encoder_frame_duration_ = 0;
     bool service_stopped_ = true;
     bool audio_input_need_warmup_ = false;
 
@@ -156,6 +191,9 @@ private:
     void OpusCodecTask();
     void PushTaskToEncodeQueue(AudioTaskType type, std::vector<int16_t>&& pcm);
     void SetDecodeSampleRate(int sample_rate, int frame_duration);
+    void SetEncodeFrameDuration(int frame_duration);
+    void SetSoundDecodeSampleRate(int sample_rate, int frame_duration);
+    bool IsSoundBacklogFull();
     void CheckAndUpdateAudioPowerState();
 };
 
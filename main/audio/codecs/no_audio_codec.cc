@@ -1,12 +1,50 @@
 #include "no_audio_codec.h"
+#include "memory_budget.h"
 
 #include <esp_log.h>
+#include <esp_heap_caps.h>
 #include <cmath>
 #include <cstring>
-#include "audio_led_hook.h"
+#include <algorithm>
 
 #define TAG "NoAudioCodec"
 
+#define SCRATCH_BUFFER_ALIGNMENT 16
+
+// Scale 16-bit samples to the 32-bit I2S slot, bit-exact with a saturating 64-bit multiply
+static void ScaleSamplesToI32(const int16_t* src, int32_t* dst, int samples, int32_t factor) {
+    int i = 0;
+    if (factor >= 0 && factor <= 65536) {
+        // |sample * factor| <= 2^31 cannot overflow, a plain 32-bit multiply is exact
+        for (; i + 4 <= samples; i += 4) {
+            int32_t s0 = src[i], s1 = src[i + 1], s2 = src[i + 2], s3 = src[i + 3];
+            dst[i] = s0 * factor;
+            dst[i + 1] = s1 * factor;
+            dst[i + 2] = s2 * factor;
+            dst[i + 3] = s3 * factor;
+        }
+    }
+    for (; i < samples; i++) {
+        int64_t temp = int64_t(src[i]) * factor;
+        dst[i] = (int32_t)std::clamp<int64_t>(temp, INT32_MIN, INT32_MAX);
+    }
+}
+
+// Take the top bits of the 32-bit slot and saturate to [-INT16_MAX, INT16_MAX]
+static void ShiftSamplesToI16(const int32_t* src, int16_t* dst, int samples) {
+    int i = 0;
+    for (; i + 4 <= samples; i += 4) {
+        int32_t v0 = src[i] >> 12, v1 = src[i + 1] >> 12, v2 = src[i + 2] >> 12, v3 = src[i + 3] >> 12;
+        dst[i] = (int16_t)std::clamp<int32_t>(v0, -INT16_MAX, INT16_MAX);
+        dst[i + 1] = (int16_t)std::clamp<int32_t>(v1, -INT16_MAX, INT16_MAX);
+        dst[i + 2] = (int16_t)std::clamp<int32_t>(v2, -INT16_MAX, INT16_MAX);
+        dst[i + 3] = (int16_t)std::clamp<int32_t>(v3, -INT16_MAX, INT16_MAX);
+    }
+    for (; i < samples; i++) {
+        dst[i] = (int16_t)std::clamp<int32_t>(src[i] >> 12, -INT16_MAX, INT16_MAX);
+    }
+}
+
 NoAudioCodec::~NoAudioCodec() {
     if (rx_handle_ != nullptr) {
         ESP_ERROR_CHECK(i2s_channel_disable(rx_handle_));
@@ -14,6 +52,35 @@ NoAudioCodec::~NoAudioCodec() {
     if (tx_handle_ != nullptr) {
         ESP_ERROR_CHECK(i2s_channel_disable(tx_handle_));
     }
+    MemoryBudget::GetInstance().Free(kMemoryTagAudio, write_buffer_);
+    MemoryBudget::GetInstance().Free(kMemoryTagAudio, read_buffer_);
+}
+
+int32_t* NoAudioCodec::ReserveBuffer(int32_t*& buffer, size_t& capacity, size_t samples) {
+    if (samples > capacity) {
+        auto& budget = MemoryBudget::GetInstance();
+        budget.Free(kMemoryTagAudio, buffer);
+        buffer = (int32_t*)budget.AlignedMalloc(kMemoryTagAudio, SCRATCH_BUFFER_ALIGNMENT, samples * sizeof(int32_t),
+            MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        capacity = buffer != nullptr ? samples : 0;
+        if (buffer == nullptr) {
+            ESP_LOGE(TAG, "Failed to allocate %u samples scratch buffer", samples);
+        }
+    }
+    return buffer;
+}
+
+void NoAudioCodec::UpdateVolumeFactor() {
+    // output_volume_: 0-100
+    // volume_factor_: 0-65536
+    cached_volume_ = output_volume_;
+    volume_factor_ = pow(double(output_volume_) / 100.0, 2) * 65536;
+}
+
+void NoAudioCodec::SetOutputVolume(int volume) {
+    AudioCodec::SetOutputVolume(volume);
+    std::lock_guard<std::mutex> lock(data_if_mutex_);
+    UpdateVolumeFactor();
 }
 
 NoAudioCodecDuplex::NoAudioCodecDuplex(int input_sample_rate, int output_sample_rate, gpio_num_t bclk, gpio_num_t ws, gpio_num_t dout, gpio_num_t din) {
@@ -359,45 +426,38 @@ NoAudioCodecSimplexPdm::NoAudioCodecSimplexPdm(int input_sample_rate, int output
 
 int NoAudioCodec::Write(const int16_t* data, int samples) {
     std::lock_guard<std::mutex> lock(data_if_mutex_);
-    std::vector<int32_t> buffer(samples);
+    auto buffer = ReserveBuffer(write_buffer_, write_buffer_samples_, samples);
+    if (buffer == nullptr) {
+        return 0;
+    }
 
-    // output_volume_: 0-100
-    // volume_factor_: 0-65536
-    int32_t volume_factor = pow(double(output_volume_) / 100.0, 2) * 65536;
-    for (int i = 0; i < samples; i++) {
-        int64_t temp = int64_t(data[i]) * volume_factor; // 使用 int64_t 进行乘法运算
-        if (temp > INT32_MAX) {
-            buffer[i] = INT32_MAX;
-        } else if (temp < INT32_MIN) {
-            buffer[i] = INT32_MIN;
-        } else {
-            buffer[i] = static_cast<int32_t>(temp);
-        }
+    // output_volume_ may also be restored from settings without SetOutputVolume()
+    if (cached_volume_ != output_volume_) {
+        UpdateVolumeFactor();
     }
+    ScaleSamplesToI32(data, buffer, samples, volume_factor_);
 
-    // ... existing code ...
     size_t bytes_written;
-    ESP_ERROR_CHECK(i2s_channel_write(tx_handle_, buffer.data(),
+    ESP_ERROR_CHECK(i2s_channel_write(tx_handle_, buffer,
                                       samples * sizeof(int32_t), &bytes_written,
                                       portMAX_DELAY));
-    audio_output_level_update(data, static_cast<size_t>(samples));
     return bytes_written / sizeof(int32_t);
 }
 
 int NoAudioCodec::Read(int16_t* dest, int samples) {
     size_t bytes_read;
 
-    std::vector<int32_t> bit32_buffer(samples);
-    if (i2s_channel_read(rx_handle_, bit32_buffer.data(), samples * sizeof(int32_t), &bytes_read, portMAX_DELAY) != ESP_OK) {
+    auto buffer = ReserveBuffer(read_buffer_, read_buffer_samples_, samples);
+    if (buffer == nullptr) {
+        return 0;
+    }
+    if (i2s_channel_read(rx_handle_, buffer, samples * sizeof(int32_t), &bytes_read, portMAX_DELAY) != ESP_OK) {
         ESP_LOGE(TAG, "Read Failed!");
         return 0;
     }
 
     samples = bytes_read / sizeof(int32_t);
-    for (int i = 0; i < samples; i++) {
-        int32_t value = bit32_buffer[i] >> 12;
-        dest[i] = (value > INT16_MAX) ? INT16_MAX : (value < -INT16_MAX) ? -INT16_MAX : (int16_t)value;
-    }
+    ShiftSamplesToI16(buffer, dest, samples);
     return samples;
 }
 
@@ -10,12 +10,23 @@
 class NoAudioCodec : public AudioCodec {
 protected:
     std::mutex data_if_mutex_;
-
+    // 32-bit I2S scratch buffers, kept across frames and only grown when a larger frame arrives
+    int32_t* write_buffer_ = nullptr;
+    size_t write_buffer_samples_ = 0;
+    int32_t* read_buffer_ = nullptr;
+    size_t read_buffer_samples_ = 0;
+    // Output gain for output_volume_, 65536 is unity
+    int cached_volume_ = -1;
+    int32_t volume_factor_ = 0;
+
+    int32_t* ReserveBuffer(int32_t*& buffer, size_t& capacity, size_t samples);
+    void UpdateVolumeFactor();
     virtual int Write(const int16_t* data, int samples) override;
     virtual int Read(int16_t* dest, int samples) override;
 
 public:
     virtual ~NoAudioCodec();
+    virtual void SetOutputVolume(int volume) override;
 };
 
 class NoAudioCodecDuplex : public NoAudioCodec {
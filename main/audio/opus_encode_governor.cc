@@ -0,0 +1,81 @@
+#include "opus_encode_governor.h"
+
+#include <esp_log.h>
+
+#include <algorithm>
+
+#define TAG "OpusEncodeGovernor"
+
+OpusEncodeGovernor::OpusEncodeGovernor(OpusEncoderWrapper* encoder, int frame_duration_ms, bool dtx)
+    : encoder_(encoder), dtx_default_(dtx) {
+    frame_us_ = (int64_t)frame_duration_ms * 1000;
+    budget_us_ = frame_us_ * CONFIG_OPUS_ENCODE_BUDGET_PERCENT / 100;
+    dtx_enabled_ = dtx_default_;
+    encoder_->SetComplexity(complexity_);
+    encoder_->SetDtx(dtx_enabled_);
+    ESP_LOGI(TAG, "Encode budget %d us per %d ms frame, max complexity %d",
+        (int)budget_us_, frame_duration_ms, OPUS_GOVERNOR_MAX_COMPLEXITY);
+}
+
+void OpusEncodeGovernor::OnFrameEncoded(int64_t encode_us) {
+    // A frame that took longer than real time cannot wait for the end of the window
+    if (encode_us > frame_us_ && complexity_ > 0) {
+        ESP_LOGW(TAG, "Encode took %d us, over the frame duration", (int)encode_us);
+        SetComplexity(std::max(complexity_ - 2, 0));
+        average_us_ = encode_us;
+        frames_in_window_ = 0;
+        holdoff_ = OPUS_GOVERNOR_HOLDOFF_WINDOWS;
+        return;
+    }
+
+    // Exponential average over about 8 frames
+    average_us_ = average_us_ == 0 ? encode_us : average_us_ + (encode_us - average_us_) / 8;
+    if (++frames_in_window_ < OPUS_GOVERNOR_WINDOW_FRAMES) {
+        return;
+    }
+    frames_in_window_ = 0;
+
+    if (average_us_ > budget_us_) {
+        if (complexity_ > 0) {
+            SetComplexity(complexity_ - 1);
+        }
+        holdoff_ = OPUS_GOVERNOR_HOLDOFF_WINDOWS;
+    } else if (holdoff_ > 0) {
+        holdoff_--;
+    } else if (average_us_ < budget_us_ / 2 && complexity_ < OPUS_GOVERNOR_MAX_COMPLEXITY) {
+        SetComplexity(complexity_ + 1);
+    }
+}
+
+void OpusEncodeGovernor::OnSendQueueDepth(size_t queued, size_t capacity) {
+    // Congested above half of the queue, cleared below a quarter
+    bool congested = uplink_congested_ ? queued * 4 > capacity : queued * 2 > capacity;
+    if (congested != uplink_congested_) {
+        uplink_congested_ = congested;
+        ESP_LOGI(TAG, "Uplink %s, %u/%u packets queued", congested ? "congested" : "recovered",
+            (unsigned)queued, (unsigned)capacity);
+        UpdateDtx();
+    }
+}
+
+void OpusEncodeGovernor::SetDtxForced(bool forced) {
+    dtx_forced_ = forced;
+    UpdateDtx();
+}
+
+void OpusEncodeGovernor::SetComplexity(int complexity) {
+    if (complexity == complexity_) {
+        return;
+    }
+    ESP_LOGI(TAG, "Complexity %d -> %d, average encode %d us", complexity_, complexity, (int)average_us_);
+    complexity_ = complexity;
+    encoder_->SetComplexity(complexity_);
+}
+
+void OpusEncodeGovernor::UpdateDtx() {
+    bool dtx = dtx_default_ || uplink_congested_ || dtx_forced_;
+    if (dtx != dtx_enabled_) {
+        dtx_enabled_ = dtx;
+        encoder_->SetDtx(dtx_enabled_);
+    }
+}
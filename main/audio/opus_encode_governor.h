@@ -0,0 +1,76 @@
+#ifndef OPUS_ENCODE_GOVERNOR_H
+#define OPUS_ENCODE_GOVERNOR_H
+
+#include <cstdint>
+#include <cstddef>
+
+#include <opus_encoder.h>
+
+// Highest complexity the chip is allowed to reach, the governor starts at 0
+#if CONFIG_IDF_TARGET_ESP32P4
+#define OPUS_GOVERNOR_MAX_COMPLEXITY 8
+#elif CONFIG_IDF_TARGET_ESP32S3
+#define OPUS_GOVERNOR_MAX_COMPLEXITY 5
+#elif CONFIG_IDF_TARGET_ESP32C3
+#define OPUS_GOVERNOR_MAX_COMPLEXITY 2
+#else
+#define OPUS_GOVERNOR_MAX_COMPLEXITY 3
+#endif
+
+#ifndef CONFIG_OPUS_ENCODE_BUDGET_PERCENT
+#define CONFIG_OPUS_ENCODE_BUDGET_PERCENT 30
+#endif
+
+// Frames averaged between two decisions
+#define OPUS_GOVERNOR_WINDOW_FRAMES 16
+// Windows to wait after a step down before trying to step up again
+#define OPUS_GOVERNOR_HOLDOFF_WINDOWS 8
+
+/*
+ * Keeps the uplink Opus encoder inside a real-time budget.
+ *
+ * The wall time of every Encode() call, which includes the time the codec task
+ * was preempted, is compared to CONFIG_OPUS_ENCODE_BUDGET_PERCENT of the frame
+ * duration. Complexity steps up one level while the average stays under half of
+ * the budget, and down as soon as it is over, or by two levels when a single
+ * frame takes longer than the frame itself.
+ *
+ * The uplink side is fed with the send queue depth: when packets pile up (a
+ * weak 4G link on ML307 boards, a congested WiFi) DTX is forced on so that
+ * silence is sent as a few bytes per frame until the queue drains.
+ */
+class OpusEncodeGovernor {
+public:
+    OpusEncodeGovernor(OpusEncoderWrapper* encoder, int frame_duration_ms, bool dtx);
+
+    // Call after every Encode() with its duration
+    void OnFrameEncoded(int64_t encode_us);
+    // Call when the send queue changes, queued out of capacity packets
+    void OnSendQueueDepth(size_t queued, size_t capacity);
+    // Keeps DTX on regardless of the uplink, used while silent frames are suppressed
+    void SetDtxForced(bool forced);
+
+    int complexity() const { return complexity_; }
+    bool dtx() const { return dtx_enabled_; }
+    bool uplink_congested() const { return uplink_congested_; }
+    uint32_t average_encode_us() const { return (uint32_t)average_us_; }
+
+private:
+    OpusEncoderWrapper* encoder_;
+    int64_t budget_us_;
+    int64_t frame_us_;
+    bool dtx_default_;
+
+    int complexity_ = 0;
+    bool dtx_enabled_ = false;
+    bool uplink_congested_ = false;
+    bool dtx_forced_ = false;
+    int64_t average_us_ = 0;
+    int frames_in_window_ = 0;
+    int holdoff_ = 0;
+
+    void SetComplexity(int complexity);
+    void UpdateDtx();
+};
+
+#endif // OPUS_ENCODE_GOVERNOR_H
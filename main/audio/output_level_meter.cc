@@ -0,0 +1,100 @@
+#include "output_level_meter.h"
+
+#include <esp_timer.h>
+
+#include <algorithm>
+#include <cmath>
+
+#define LOW_BAND_CUTOFF_HZ 300
+#define HIGH_BAND_CUTOFF_HZ 2000
+// RMS that maps to level 255
+#define FULL_SCALE_RMS 20400
+
+static uint32_t SquareRoot(uint32_t value) {
+    uint32_t result = 0;
+    uint32_t bit = 1u << 30;
+    while (bit > value) {
+        bit >>= 2;
+    }
+    while (bit != 0) {
+        if (value >= result + bit) {
+            value -= result + bit;
+            result = (result >> 1) + bit;
+        } else {
+            result >>= 1;
+        }
+        bit >>= 2;
+    }
+    return result;
+}
+
+static uint8_t ToLevel(uint64_t sum_of_squares, size_t samples) {
+    uint32_t rms = SquareRoot((uint32_t)std::min<uint64_t>(sum_of_squares / samples, UINT32_MAX));
+    return (uint8_t)std::min<uint32_t>(rms * 255 / FULL_SCALE_RMS, 255);
+}
+
+static int32_t OnePoleAlpha(int cutoff_hz, int sample_rate) {
+    return (int32_t)std::lround((1.0 - std::exp(-2.0 * M_PI * cutoff_hz / sample_rate)) * 4096);
+}
+
+void OutputLevelMeter::Acquire() {
+    users_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void OutputLevelMeter::Release() {
+    if (users_.fetch_sub(1, std::memory_order_relaxed) == 1) {
+        levels_.store(0, std::memory_order_relaxed);
+    }
+}
+
+void OutputLevelMeter::Feed(const int16_t* pcm, size_t samples, int sample_rate) {
+    if (!active() || samples == 0 || sample_rate <= 0) {
+        return;
+    }
+    if (sample_rate != sample_rate_) {
+        sample_rate_ = sample_rate;
+        low_alpha_ = OnePoleAlpha(LOW_BAND_CUTOFF_HZ, sample_rate);
+        mid_alpha_ = OnePoleAlpha(HIGH_BAND_CUTOFF_HZ, sample_rate);
+        low_state_ = mid_state_ = 0;
+    }
+
+    uint64_t total = 0, low = 0, mid = 0, high = 0;
+    uint32_t magnitude = 0;
+    int32_t low_state = low_state_;
+    int32_t mid_state = mid_state_;
+    for (size_t i = 0; i < samples; i++) {
+        int32_t x = (int32_t)pcm[i] << 3;
+        low_state += ((x - low_state) * low_alpha_) >> 12;
+        mid_state += ((x - mid_state) * mid_alpha_) >> 12;
+        int32_t l = low_state >> 3;
+        int32_t m = (mid_state - low_state) >> 3;
+        int32_t h = (x - mid_state) >> 3;
+        total += (int64_t)pcm[i] * pcm[i];
+        magnitude += std::abs(pcm[i]);
+        low += (int64_t)l * l;
+        mid += (int64_t)m * m;
+        high += (int64_t)h * h;
+    }
+    low_state_ = low_state;
+    mid_state_ = mid_state;
+
+    uint32_t packed = ToLevel(total, samples) | (ToLevel(low, samples) << 8) |
+        (ToLevel(mid, samples) << 16) | ((uint32_t)ToLevel(high, samples) << 24);
+    levels_.store(packed, std::memory_order_relaxed);
+    average_.store(magnitude / samples, std::memory_order_relaxed);
+    last_feed_time_.store(esp_timer_get_time(), std::memory_order_relaxed);
+}
+
+OutputLevels OutputLevelMeter::GetLevels() const {
+    OutputLevels levels;
+    if (esp_timer_get_time() - last_feed_time_.load(std::memory_order_relaxed) > OUTPUT_LEVEL_HOLD_US) {
+        return levels;
+    }
+    uint32_t packed = levels_.load(std::memory_order_relaxed);
+    levels.rms = packed & 0xFF;
+    for (int i = 0; i < OUTPUT_LEVEL_BAND_COUNT; i++) {
+        levels.bands[i] = (packed >> (8 * (i + 1))) & 0xFF;
+    }
+    levels.average = average_.load(std::memory_order_relaxed);
+    return levels;
+}
@@ -0,0 +1,57 @@
+#ifndef OUTPUT_LEVEL_METER_H
+#define OUTPUT_LEVEL_METER_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+#define OUTPUT_LEVEL_BAND_COUNT 3
+#define OUTPUT_LEVEL_HOLD_US (100 * 1000)
+
+// Loudness of the audio sent to the speaker, 0-255 where 255 is about -4 dBFS RMS
+struct OutputLevels {
+    uint8_t rms = 0;
+    uint8_t bands[OUTPUT_LEVEL_BAND_COUNT] = {};    // Below 300 Hz, 300 Hz to 2 kHz, above 2 kHz
+    uint16_t average = 0;                           // Mean of |pcm|, 0-32768
+};
+
+/*
+ * Tap on the playback path for audio reactive effects.
+ *
+ * AudioService feeds every PCM frame it hands to the codec. The frame is only
+ * analyzed while a consumer holds a reference (Acquire / Release), so the cost
+ * is one atomic load per frame otherwise. Bands are split with two one pole
+ * low pass filters in fixed point.
+ */
+class OutputLevelMeter {
+public:
+    static OutputLevelMeter& GetInstance() {
+        static OutputLevelMeter instance;
+        return instance;
+    }
+
+    void Acquire();
+    void Release();
+    bool active() const { return users_.load(std::memory_order_relaxed) > 0; }
+
+    // Called from the audio output task
+    void Feed(const int16_t* pcm, size_t samples, int sample_rate);
+    // Levels of the latest frame, zero once playback has stopped
+    OutputLevels GetLevels() const;
+
+private:
+    OutputLevelMeter() = default;
+
+    std::atomic<int> users_{0};
+    std::atomic<uint32_t> levels_{0};           // rms | low << 8 | mid << 16 | high << 24
+    std::atomic<uint32_t> average_{0};
+    std::atomic<int64_t> last_feed_time_{0};
+
+    int sample_rate_ = 0;
+    int32_t low_alpha_ = 0;                     // Q12 filter coefficients
+    int32_t mid_alpha_ = 0;
+    int32_t low_state_ = 0;                     // Q3 filter states, the products fit in 32 bits
+    int32_t mid_state_ = 0;
+};
+
+#endif // OUTPUT_LEVEL_METER_H
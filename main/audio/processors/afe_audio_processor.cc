@@ -63,6 +63,7 @@ void AfeAudioProcessor::Initialize(AudioCodec* codec, int frame_duration_ms, srm
     afe_config->aec_init = false;
     afe_config->vad_init = true;
 #endif
+    vad_enabled_ = afe_config->vad_init;
 
     afe_iface_ = esp_afe_handle_from_config(afe_config);
     afe_data_ = afe_iface_->create_from_config(afe_config);
@@ -88,6 +89,11 @@ size_t AfeAudioProcessor::GetFeedSize() {
     return afe_iface_->get_feed_chunksize(afe_data_);
 }
 
+void AfeAudioProcessor::SetFrameDuration(int frame_duration_ms) {
+    frame_samples_ = frame_duration_ms * 16000 / 1000;
+    output_buffer_.reserve(frame_samples_);
+}
+
 void AfeAudioProcessor::Feed(std::vector<int16_t>&& data) {
     if (afe_data_ == nullptr) {
         return;
@@ -177,11 +183,17 @@ void AfeAudioProcessor::EnableDeviceAec(bool enable) {
 #if CONFIG_USE_DEVICE_AEC
         afe_iface_->disable_vad(afe_data_);
         afe_iface_->enable_aec(afe_data_);
+        vad_enabled_ = false;
 #else
         ESP_LOGE(TAG, "Device AEC is not supported");
 #endif
     } else {
         afe_iface_->disable_aec(afe_data_);
         afe_iface_->enable_vad(afe_data_);
+        vad_enabled_ = true;
     }
 }
+
+bool AfeAudioProcessor::IsVadEnabled() {
+    return vad_enabled_;
+}
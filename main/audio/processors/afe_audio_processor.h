@@ -19,6 +19,7 @@ public:
     ~AfeAudioProcessor();
 
     void Initialize(AudioCodec* codec, int frame_duration_ms, srmodel_list_t* models_list) override;
+    void SetFrameDuration(int frame_duration_ms) override;
     void Feed(std::vector<int16_t>&& data) override;
     void Start() override;
     void Stop() override;
@@ -27,6 +28,7 @@ public:
     void OnVadStateChange(std::function<void(bool speaking)> callback) override;
     size_t GetFeedSize() override;
     void EnableDeviceAec(bool enable) override;
+    bool IsVadEnabled() override;
 
 private:
     EventGroupHandle_t event_group_ = nullptr;
@@ -37,6 +39,7 @@ private:
     AudioCodec* codec_ = nullptr;
     int frame_samples_ = 0;
     bool is_speaking_ = false;
+    bool vad_enabled_ = false;
     std::vector<int16_t> output_buffer_;
 
     void AudioProcessorTask();
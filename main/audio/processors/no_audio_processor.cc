@@ -8,6 +8,10 @@ void NoAudioProcessor::Initialize(AudioCodec* codec, int frame_duration_ms, srmo
     frame_samples_ = frame_duration_ms * 16000 / 1000;
 }
 
+void NoAudioProcessor::SetFrameDuration(int frame_duration_ms) {
+    frame_samples_ = frame_duration_ms * 16000 / 1000;
+}
+
 void NoAudioProcessor::Feed(std::vector<int16_t>&& data) {
     if (!is_running_ || !output_callback_) {
         return;
@@ -57,3 +61,7 @@ void NoAudioProcessor::EnableDeviceAec(bool enable) {
         ESP_LOGE(TAG, "Device AEC is not supported");
     }
 }
+
+bool NoAudioProcessor::IsVadEnabled() {
+    return false;
+}
@@ -0,0 +1,65 @@
+#include "uplink_silence_gate.h"
+
+#include <esp_log.h>
+
+#include <algorithm>
+
+#define TAG "UplinkSilenceGate"
+
+void UplinkSilenceGate::Configure(int frame_duration_ms) {
+    frame_duration_ms = std::max(frame_duration_ms, 1);
+    hangover_frames_ = (UPLINK_SILENCE_HANGOVER_MS + frame_duration_ms - 1) / frame_duration_ms;
+    keepalive_frames_ = std::max(UPLINK_SILENCE_KEEPALIVE_MS / frame_duration_ms, 1);
+}
+
+void UplinkSilenceGate::SetEnabled(bool enabled) {
+    if (enabled == enabled_) {
+        return;
+    }
+    enabled_ = enabled;
+    silent_frames_ = 0;
+    suppressed_frames_ += preroll_.size();
+    preroll_.clear();
+    if (enabled) {
+        suppressed_frames_ = 0;
+        total_frames_ = 0;
+    } else {
+        ESP_LOGI(TAG, "Suppressed %u of %u uplink frames", (unsigned)suppressed_frames_, (unsigned)total_frames_);
+    }
+}
+
+void UplinkSilenceGate::Process(std::unique_ptr<AudioStreamPacket> packet, bool speech,
+    std::vector<std::unique_ptr<AudioStreamPacket>>& out) {
+    if (!enabled_) {
+        out.push_back(std::move(packet));
+        return;
+    }
+    total_frames_++;
+
+    bool silent = !speech || packet->payload.size() <= OPUS_DTX_FRAME_MAX_BYTES;
+    if (!silent) {
+        silent_frames_ = 0;
+        while (!preroll_.empty()) {
+            out.push_back(std::move(preroll_.front()));
+            preroll_.pop_front();
+        }
+        out.push_back(std::move(packet));
+        return;
+    }
+
+    silent_frames_++;
+    int suppressed = silent_frames_ - hangover_frames_;
+    if (suppressed <= 0 || suppressed % keepalive_frames_ == 0) {
+        // A frame went out, the held ones are older than it and no longer useful as preroll
+        suppressed_frames_ += preroll_.size();
+        preroll_.clear();
+        out.push_back(std::move(packet));
+        return;
+    }
+
+    preroll_.push_back(std::move(packet));
+    if (preroll_.size() > UPLINK_SILENCE_PREROLL_FRAMES) {
+        preroll_.pop_front();
+        suppressed_frames_++;
+    }
+}
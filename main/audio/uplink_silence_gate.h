@@ -0,0 +1,53 @@
+#ifndef UPLINK_SILENCE_GATE_H
+#define UPLINK_SILENCE_GATE_H
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "protocol.h"
+
+// Silent frames still sent after speech ends, so word endings are not cut
+#define UPLINK_SILENCE_HANGOVER_MS 300
+// One frame is sent this often during silence, it carries the DTX comfort noise update
+#define UPLINK_SILENCE_KEEPALIVE_MS 400
+// Suppressed frames kept back and sent ahead of the speech that follows them
+#define UPLINK_SILENCE_PREROLL_FRAMES 2
+// Opus packets of this size or less are DTX frames without audio
+#define OPUS_DTX_FRAME_MAX_BYTES 2
+
+/*
+ * Drops silent uplink frames once the server has opted in to it.
+ *
+ * A frame is silent when the VAD reports no speech, or when the encoder
+ * produced a DTX frame. After UPLINK_SILENCE_HANGOVER_MS of silence frames are
+ * held back instead of sent, except one every UPLINK_SILENCE_KEEPALIVE_MS so the
+ * server keeps its comfort noise and knows the stream is alive. The last held
+ * frames are flushed in front of the next speech frame to cover the VAD onset
+ * delay. Timestamps are kept, so the server sees the gaps.
+ */
+class UplinkSilenceGate {
+public:
+    void Configure(int frame_duration_ms);
+    void SetEnabled(bool enabled);
+    bool enabled() const { return enabled_; }
+
+    // Appends the packets to send now to out, in order
+    void Process(std::unique_ptr<AudioStreamPacket> packet, bool speech,
+        std::vector<std::unique_ptr<AudioStreamPacket>>& out);
+
+    uint32_t suppressed_frames() const { return suppressed_frames_; }
+    uint32_t total_frames() const { return total_frames_; }
+
+private:
+    bool enabled_ = false;
+    int hangover_frames_ = 5;
+    int keepalive_frames_ = 7;
+    int silent_frames_ = 0;
+    std::deque<std::unique_ptr<AudioStreamPacket>> preroll_;
+    uint32_t suppressed_frames_ = 0;
+    uint32_t total_frames_ = 0;
+};
+
+#endif // UPLINK_SILENCE_GATE_H
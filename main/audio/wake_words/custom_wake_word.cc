@@ -2,6 +2,7 @@
 #include "audio_service.h"
 #include "system_info.h"
 #include "assets.h"
+#include "memory_budget.h"
 
 #include <esp_log.h>
 #include <esp_mn_iface.h>
@@ -24,11 +25,11 @@ CustomWakeWord::~CustomWakeWord() {
     }
 
     if (wake_word_encode_task_stack_ != nullptr) {
-        heap_caps_free(wake_word_encode_task_stack_);
+        MemoryBudget::GetInstance().Free(kMemoryTagAudio, wake_word_encode_task_stack_);
     }
 
     if (wake_word_encode_task_buffer_ != nullptr) {
-        heap_caps_free(wake_word_encode_task_buffer_);
+        MemoryBudget::GetInstance().Free(kMemoryTagAudio, wake_word_encode_task_buffer_);
     }
 
     if (models_ != nullptr) {
@@ -206,11 +207,11 @@ void CustomWakeWord::EncodeWakeWordData() {
     const size_t stack_size = 4096 * 7;
     wake_word_opus_.clear();
     if (wake_word_encode_task_stack_ == nullptr) {
-        wake_word_encode_task_stack_ = (StackType_t*)heap_caps_malloc(stack_size, MALLOC_CAP_SPIRAM);
+        wake_word_encode_task_stack_ = (StackType_t*)MemoryBudget::GetInstance().Malloc(kMemoryTagAudio, stack_size, MALLOC_CAP_SPIRAM);
         assert(wake_word_encode_task_stack_ != nullptr);
     }
     if (wake_word_encode_task_buffer_ == nullptr) {
-        wake_word_encode_task_buffer_ = (StaticTask_t*)heap_caps_malloc(sizeof(StaticTask_t), MALLOC_CAP_INTERNAL);
+        wake_word_encode_task_buffer_ = (StaticTask_t*)MemoryBudget::GetInstance().Malloc(kMemoryTagAudio, sizeof(StaticTask_t), MALLOC_CAP_INTERNAL);
         assert(wake_word_encode_task_buffer_ != nullptr);
     }
 
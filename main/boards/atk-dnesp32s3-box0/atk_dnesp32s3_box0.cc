@@ -3,6 +3,7 @@
 #include "display/lcd_display.h"
 #include "system_reset.h"
 #include "application.h"
+#include "settings.h"
 #include "button.h"
 #include "config.h"
 #include "power_save_timer.h"
@@ -104,6 +105,7 @@ private:
                         if (self->power_manager_->low_voltage_ < 2877 && self->power_status_ != kDeviceTypecSupply) {
                             esp_timer_stop(self->power_manager_->timer_handle_);
                             gpio_set_level(CHG_CTRL_PIN, 0);
+                            Settings::Flush();
                             vTaskDelay(pdMS_TO_TICKS(100));
                             gpio_set_level(SYS_POW_PIN, 0);     
                             vTaskDelay(pdMS_TO_TICKS(100));
@@ -216,6 +218,7 @@ private:
             if (XiaozhiStatus_ == kDevice_Distributionnetwork || XiaozhiStatus_ == kDevice_Exit_Sleep) {
                 esp_timer_stop(power_manager_->timer_handle_);
                 gpio_set_level(CHG_CTRL_PIN, 0);
+                Settings::Flush();
                 vTaskDelay(pdMS_TO_TICKS(100));
                 gpio_set_level(SYS_POW_PIN, 0);
                 vTaskDelay(pdMS_TO_TICKS(100));
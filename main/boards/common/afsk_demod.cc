@@ -1,6 +1,7 @@
 #include "afsk_demod.h"
 #include <cstring>
 #include <algorithm>
+#include <limits>
 #include "esp_log.h"
 #include "display.h"
 
@@ -19,10 +20,44 @@ namespace audio_wifi_config
                                     )
     {
         const int kInputSampleRate = 16000;                                    // Input sampling rate
-        const float kDownsampleStep = static_cast<float>(kInputSampleRate) / static_cast<float>(kAudioSampleRate); // Downsampling step
+        const size_t kDecimation = kInputSampleRate / kAudioSampleRate;         // Pairs of samples are averaged
+        const size_t kFrameSamples = 480;                                       // 16kHz, 480 samples corresponds to 30ms data
+        static_assert(kInputSampleRate % kAudioSampleRate == 0, "Input rate must be a multiple of the demodulator rate");
+
+        // All buffers are allocated once, the loop below runs allocation free
         std::vector<int16_t> audio_data;
+        audio_data.reserve(kFrameSamples * input_channels);
+        std::array<int16_t, kFrameSamples / kDecimation> downsampled_data;
+        std::array<float, kFrameSamples / kDecimation / kWindowSize + 2> probabilities;
+        std::array<uint8_t, kFrameSamples / kDecimation / kMultiToneWindowSize + 2> symbols;
+
         AudioSignalProcessor signal_processor(kAudioSampleRate, kMarkFrequency, kSpaceFrequency, kBitRate, kWindowSize);
+        MultiToneSignalProcessor multi_tone_processor(kAudioSampleRate, kMultiToneBaseFrequency, kMultiToneSpacing,
+                                                      kMultiToneCount, kMultiToneSymbolRate);
         AudioDataBuffer data_buffer;
+        MultiToneDataBuffer multi_tone_buffer;
+
+        auto apply_credentials = [&](const std::string &text) {
+            ESP_LOGI(kLogTag, "Received text data: %s", text.c_str());
+            display->SetChatMessage("system", text.c_str());
+
+            // Split SSID and password by newline character
+            size_t newline_position = text.find('\n');
+            if (newline_position == std::string::npos) {
+                ESP_LOGE(kLogTag, "Invalid data format, no newline character found");
+                return;
+            }
+            std::string wifi_ssid = text.substr(0, newline_position);
+            std::string wifi_password = text.substr(newline_position + 1);
+            ESP_LOGI(kLogTag, "WiFi SSID: %s, Password: %s", wifi_ssid.c_str(), wifi_password.c_str());
+
+            if (wifi_ap->ConnectToWifi(wifi_ssid, wifi_password)) {
+                wifi_ap->Save(wifi_ssid, wifi_password);  // Save WiFi credentials
+                esp_restart();                            // Restart device to apply new WiFi configuration
+            } else {
+                ESP_LOGE(kLogTag, "Failed to connect to WiFi with received credentials");
+            }
+        };
 
         while (true)
         {
@@ -33,71 +68,40 @@ namespace audio_wifi_config
                 continue;
             }
             
-            if (!app->GetAudioService().ReadAudioData(audio_data, 16000, 480)) { // 16kHz, 480 samples corresponds to 30ms data
+            if (!app->GetAudioService().ReadAudioData(audio_data, kInputSampleRate, kFrameSamples)) {
                 // 读取音频失败，短暂延迟后重试
                 ESP_LOGI(kLogTag, "Failed to read audio data, retrying.");
                 vTaskDelay(pdMS_TO_TICKS(10));
                 continue;
             }
 
-            if (input_channels == 2) { // 如果是双声道输入，转换为单声道
-                auto mono_data = std::vector<int16_t>(audio_data.size() / 2);
-                for (size_t i = 0, j = 0; i < mono_data.size(); ++i, j += 2) {
-                    mono_data[i] = audio_data[j];
+            // Take the first channel and decimate by averaging, which also acts as a simple low-pass filter
+            size_t frames = std::min(audio_data.size() / input_channels, kFrameSamples);
+            size_t downsampled_count = frames / kDecimation;
+            for (size_t i = 0; i < downsampled_count; ++i) {
+                int32_t sum = 0;
+                for (size_t j = 0; j < kDecimation; ++j) {
+                    sum += audio_data[(i * kDecimation + j) * input_channels];
                 }
-                audio_data = std::move(mono_data);
+                downsampled_data[i] = static_cast<int16_t>(sum / static_cast<int32_t>(kDecimation));
             }
-            
-            // Downsample the audio data
-            std::vector<float> downsampled_data;
-            size_t last_index = 0;
-
-            if (kDownsampleStep > 1.0f) {
-                downsampled_data.reserve(audio_data.size() / static_cast<size_t>(kDownsampleStep));
-                for (size_t i = 0; i < audio_data.size(); ++i) {
-                    size_t sample_index = static_cast<size_t>(i / kDownsampleStep);
-                    if ((sample_index + 1) > last_index) {
-                        downsampled_data.push_back(static_cast<float>(audio_data[i]));
-                        last_index = sample_index + 1;
-                    }
-                }
-            } else {
-                downsampled_data.reserve(audio_data.size());
-                for (int16_t sample : audio_data) {
-                    downsampled_data.push_back(static_cast<float>(sample));
-                }
+
+            // Legacy 100 bit/s AFSK
+            size_t probability_count = signal_processor.ProcessAudioSamples(downsampled_data.data(), downsampled_count,
+                                                                             probabilities.data(), probabilities.size());
+            if (data_buffer.ProcessProbabilityData(probabilities.data(), probability_count, 0.5f) &&
+                data_buffer.decoded_text.has_value()) {
+                apply_credentials(*data_buffer.decoded_text);
+                data_buffer.decoded_text.reset();  // Clear processed data
             }
-            
-            // Process audio samples to get probability data
-            auto probabilities = signal_processor.ProcessAudioSamples(downsampled_data);
-            
-            // Feed probability data to the data buffer
-            if (data_buffer.ProcessProbabilityData(probabilities, 0.5f)) {
-                // If complete data was received, extract WiFi credentials
-                if (data_buffer.decoded_text.has_value()) {
-                    ESP_LOGI(kLogTag, "Received text data: %s", data_buffer.decoded_text->c_str());
-                    display->SetChatMessage("system", data_buffer.decoded_text->c_str());
-                    
-                    // Split SSID and password by newline character
-                    std::string wifi_ssid, wifi_password;
-                    size_t newline_position = data_buffer.decoded_text->find('\n');
-                    if (newline_position != std::string::npos) {
-                        wifi_ssid = data_buffer.decoded_text->substr(0, newline_position);
-                        wifi_password = data_buffer.decoded_text->substr(newline_position + 1);
-                        ESP_LOGI(kLogTag, "WiFi SSID: %s, Password: %s", wifi_ssid.c_str(), wifi_password.c_str());
-                    } else {
-                        ESP_LOGE(kLogTag, "Invalid data format, no newline character found");
-                        continue;
-                    }
-                    
-                    if (wifi_ap->ConnectToWifi(wifi_ssid, wifi_password)) {
-                        wifi_ap->Save(wifi_ssid, wifi_password);  // Save WiFi credentials
-                        esp_restart();                            // Restart device to apply new WiFi configuration
-                    } else {
-                        ESP_LOGE(kLogTag, "Failed to connect to WiFi with received credentials");
-                    }
-                    data_buffer.decoded_text.reset();  // Clear processed data
-                }
+
+            // Fast 4-FSK mode
+            size_t symbol_count = multi_tone_processor.ProcessAudioSamples(downsampled_data.data(), downsampled_count,
+                                                                           symbols.data(), symbols.size());
+            if (multi_tone_buffer.ProcessSymbols(symbols.data(), symbol_count) &&
+                multi_tone_buffer.decoded_text.has_value()) {
+                apply_credentials(*multi_tone_buffer.decoded_text);
+                multi_tone_buffer.decoded_text.reset();
             }
             vTaskDelay(pdMS_TO_TICKS(1));  // 1ms delay
         }
@@ -114,134 +118,226 @@ namespace audio_wifi_config
 
     // FrequencyDetector implementation
     FrequencyDetector::FrequencyDetector(float frequency, size_t window_size)
-        : frequency_(frequency), window_size_(window_size) {
-        frequency_bin_ = std::floor(frequency_ * static_cast<float>(window_size_));
-        angular_frequency_ = 2.0f * M_PI * frequency_;
-        cos_coefficient_ = std::cos(angular_frequency_);
-        sin_coefficient_ = std::sin(angular_frequency_);
-        filter_coefficient_ = 2.0f * cos_coefficient_;
-
-        // Initialize state buffer
-        state_buffer_.push_back(0.0f);
-        state_buffer_.push_back(0.0f);
+        : window_size_(window_size), phase_(0), real_(0), imaginary_(0),
+          cos_table_(window_size), sin_table_(window_size) {
+        // Round to the nearest bin so the twiddle sequence is periodic in the window
+        size_t bin = static_cast<size_t>(std::lround(frequency * static_cast<float>(window_size_)));
+        for (size_t n = 0; n < window_size_; ++n) {
+            float angle = 2.0f * static_cast<float>(M_PI) * static_cast<float>((bin * n) % window_size_) /
+                          static_cast<float>(window_size_);
+            cos_table_[n] = static_cast<int16_t>(std::lround(std::cos(angle) * 16384.0f));
+            sin_table_[n] = static_cast<int16_t>(std::lround(std::sin(angle) * 16384.0f));
+        }
     }
 
     void FrequencyDetector::Reset() {
-        state_buffer_.clear();
-        state_buffer_.push_back(0.0f);
-        state_buffer_.push_back(0.0f);
+        phase_ = 0;
+        real_ = 0;
+        imaginary_ = 0;
     }
 
-    void FrequencyDetector::ProcessSample(float sample) {
-        if (state_buffer_.size() < 2) {
-            return;
+    void FrequencyDetector::ProcessSample(int16_t sample, int16_t expired) {
+        // The expired sample entered at the same phase one window ago, so subtracting
+        // the identically rounded product removes its contribution exactly
+        int32_t c = cos_table_[phase_];
+        int32_t s = sin_table_[phase_];
+        real_ += ((sample * c) >> 14) - ((expired * c) >> 14);
+        imaginary_ -= ((sample * s) >> 14) - ((expired * s) >> 14);
+        if (++phase_ == window_size_) {
+            phase_ = 0;
         }
+    }
 
-        float s_minus_2 = state_buffer_.front();  // S[-2]
-        state_buffer_.pop_front();
-        float s_minus_1 = state_buffer_.front();  // S[-1]
-        state_buffer_.pop_front();
-
-        float s_current = sample + filter_coefficient_ * s_minus_1 - s_minus_2;
-
-        state_buffer_.push_back(s_minus_1);  // Put S[-1] back
-        state_buffer_.push_back(s_current);  // Add new S[0]
+    int64_t FrequencyDetector::GetEnergy() const {
+        return static_cast<int64_t>(real_) * real_ + static_cast<int64_t>(imaginary_) * imaginary_;
     }
 
     float FrequencyDetector::GetAmplitude() const {
-        if (state_buffer_.size() < 2) {
-            return 0.0f;
-        }
+        return std::sqrt(static_cast<float>(GetEnergy())) / (static_cast<float>(window_size_) / 2.0f);
+    }
 
-        float s_minus_1 = state_buffer_[1];                      // S[-1]
-        float s_minus_2 = state_buffer_[0];                      // S[-2]
-        float real_part = cos_coefficient_ * s_minus_1 - s_minus_2;  // Real part
-        float imaginary_part = sin_coefficient_ * s_minus_1;         // Imaginary part
+    // SampleWindow implementation
+    int16_t SampleWindow::Push(int16_t sample) {
+        int16_t expired = samples_[write_index_];
+        samples_[write_index_] = sample;
+        if (++write_index_ == samples_.size()) {
+            write_index_ = 0;
+        }
+        if (filled_ < samples_.size()) {
+            filled_++;
+        }
+        return expired;
+    }
 
-        return std::sqrt(real_part * real_part + imaginary_part * imaginary_part) / 
-               (static_cast<float>(window_size_) / 2.0f);
+    void SampleWindow::Reset() {
+        std::fill(samples_.begin(), samples_.end(), 0);
+        write_index_ = 0;
+        filled_ = 0;
     }
 
     // AudioSignalProcessor implementation
     AudioSignalProcessor::AudioSignalProcessor(size_t sample_rate, size_t mark_frequency, size_t space_frequency,
                                              size_t bit_rate, size_t window_size)
-        : input_buffer_size_(window_size), output_sample_count_(0) {
+        : window_(window_size), output_sample_count_(0),
+          mark_detector_(static_cast<float>(mark_frequency) / static_cast<float>(sample_rate), window_size),
+          space_detector_(static_cast<float>(space_frequency) / static_cast<float>(sample_rate), window_size) {
         if (sample_rate % bit_rate != 0) {
             // On ESP32 we can continue execution, but log the error
             ESP_LOGW(kLogTag, "Sample rate %zu is not divisible by bit rate %zu", sample_rate, bit_rate);
         }
 
-        float normalized_mark_freq = static_cast<float>(mark_frequency) / static_cast<float>(sample_rate);
-        float normalized_space_freq = static_cast<float>(space_frequency) / static_cast<float>(sample_rate);
+        samples_per_bit_ = sample_rate / bit_rate;  // Number of samples per bit
+    }
 
-        mark_detector_ = std::make_unique<FrequencyDetector>(normalized_mark_freq, window_size);
-        space_detector_ = std::make_unique<FrequencyDetector>(normalized_space_freq, window_size);
+    size_t AudioSignalProcessor::ProcessAudioSamples(const int16_t *samples, size_t count,
+                                                     float *probabilities, size_t max_probabilities) {
+        size_t result_count = 0;
+
+        for (size_t i = 0; i < count; ++i) {
+            bool was_full = window_.IsFull();
+            int16_t expired = window_.Push(samples[i]);
+            mark_detector_.ProcessSample(samples[i], expired);
+            space_detector_.ProcessSample(samples[i], expired);
+            if (!was_full) {
+                continue;  // Just fill the window, don't output yet
+            }
 
-        samples_per_bit_ = sample_rate / bit_rate;  // Number of samples per bit
+            if (++output_sample_count_ >= samples_per_bit_) {
+                output_sample_count_ = 0;  // Reset output counter
+                if (result_count >= max_probabilities) {
+                    ESP_LOGW(kLogTag, "Probability output full, dropping bit");
+                    continue;
+                }
+
+                float mark_amplitude = mark_detector_.GetAmplitude();   // Mark amplitude
+                float space_amplitude = space_detector_.GetAmplitude(); // Space amplitude
+
+                // Avoid division by zero
+                probabilities[result_count++] = mark_amplitude /
+                    (space_amplitude + mark_amplitude + std::numeric_limits<float>::epsilon());
+            }
+        }
+
+        return result_count;
     }
 
-    std::vector<float> AudioSignalProcessor::ProcessAudioSamples(const std::vector<float> &samples) {
-        std::vector<float> result;
+    // MultiToneSignalProcessor implementation
+    MultiToneSignalProcessor::MultiToneSignalProcessor(size_t sample_rate, size_t base_frequency, size_t spacing,
+                                                       size_t tone_count, size_t symbol_rate)
+        : window_(sample_rate / symbol_rate),
+          phase_confidence_(sample_rate / symbol_rate, 0),
+          samples_per_symbol_(sample_rate / symbol_rate),
+          phase_(0),
+          best_phase_(0),
+          samples_since_symbol_(0) {
+        detectors_.reserve(tone_count);
+        for (size_t i = 0; i < tone_count; ++i) {
+            float frequency = static_cast<float>(base_frequency + i * spacing) / static_cast<float>(sample_rate);
+            detectors_.emplace_back(frequency, samples_per_symbol_);
+        }
+    }
 
-        for (float sample : samples) {
-            if (input_buffer_.size() < input_buffer_size_) {
-                input_buffer_.push_back(sample);  // Just add, don't process yet
-            } else {
-                // Input buffer is full, process the data
-                input_buffer_.pop_front();   // Remove oldest sample
-                input_buffer_.push_back(sample);  // Add new sample
-                output_sample_count_++;
-
-                if (output_sample_count_ >= samples_per_bit_) {
-                    // Process all samples in the window using Goertzel algorithm
-                    for (float window_sample : input_buffer_) {
-                        mark_detector_->ProcessSample(window_sample);
-                        space_detector_->ProcessSample(window_sample);
-                    }
+    size_t MultiToneSignalProcessor::ProcessAudioSamples(const int16_t *samples, size_t count,
+                                                         uint8_t *symbols, size_t max_symbols) {
+        const int kConfidenceSmoothingShift = 3;    // Averages the timing metric over about 8 symbols
+        size_t result_count = 0;
 
-                    float mark_amplitude = mark_detector_->GetAmplitude();   // Mark amplitude
-                    float space_amplitude = space_detector_->GetAmplitude(); // Space amplitude
+        for (size_t i = 0; i < count; ++i) {
+            bool was_full = window_.IsFull();
+            int16_t expired = window_.Push(samples[i]);
+            for (auto &detector : detectors_) {
+                detector.ProcessSample(samples[i], expired);
+            }
+            if (!was_full) {
+                continue;
+            }
 
-                    // Avoid division by zero
-                    float mark_probability = mark_amplitude / 
-                                           (space_amplitude + mark_amplitude + std::numeric_limits<float>::epsilon());
-                    result.push_back(mark_probability);
+            // Pick the strongest tone and how much of the total energy it holds
+            int64_t total_energy = 0;
+            int64_t best_energy = -1;
+            uint8_t best_tone = 0;
+            for (size_t t = 0; t < detectors_.size(); ++t) {
+                int64_t energy = detectors_[t].GetEnergy();
+                total_energy += energy;
+                if (energy > best_energy) {
+                    best_energy = energy;
+                    best_tone = static_cast<uint8_t>(t);
+                }
+            }
+            // Q8 confidence with a 32-bit division, energies are scaled down to 24 bits first
+            int32_t confidence = 0;
+            if (total_energy > 0) {
+                int shift = std::max(0, 64 - __builtin_clzll(static_cast<uint64_t>(total_energy)) - 24);
+                uint32_t total = static_cast<uint32_t>(total_energy >> shift);
+                uint32_t best = static_cast<uint32_t>(best_energy >> shift);
+                confidence = total > 0 ? static_cast<int32_t>((best << 8) / total) : 0;
+            }
+            int32_t &average = phase_confidence_[phase_];
+            average += (confidence - average) >> kConfidenceSmoothingShift;
+
+            // Half a symbol away from the sampling instant, re-evaluate where the window lines
+            // up with a whole symbol so a small timing drift moves the next instant by one sample
+            if (phase_ == (best_phase_ + samples_per_symbol_ / 2) % samples_per_symbol_) {
+                size_t candidate = best_phase_;
+                for (size_t p = 0; p < samples_per_symbol_; ++p) {
+                    if (phase_confidence_[p] > phase_confidence_[candidate]) {
+                        candidate = p;
+                    }
+                }
+                // Switch sampling phase only on a clear (~10%) improvement
+                int32_t current = phase_confidence_[best_phase_];
+                if (phase_confidence_[candidate] > current + current / 10) {
+                    best_phase_ = candidate;
+                }
+            }
 
-                    // Reset detector windows
-                    mark_detector_->Reset();
-                    space_detector_->Reset();
-                    output_sample_count_ = 0;  // Reset output counter
+            samples_since_symbol_++;
+            if (phase_ == best_phase_ && samples_since_symbol_ > samples_per_symbol_ / 2) {
+                samples_since_symbol_ = 0;
+                if (result_count < max_symbols) {
+                    symbols[result_count++] = best_tone;
+                } else {
+                    ESP_LOGW(kLogTag, "Symbol output full, dropping symbol");
                 }
             }
+
+            if (++phase_ == samples_per_symbol_) {
+                phase_ = 0;
+            }
         }
 
-        return result;
+        return result_count;
     }
 
     // AudioDataBuffer implementation
     AudioDataBuffer::AudioDataBuffer()
-        : current_state_(DataReceptionState::kInactive),
-          start_of_transmission_(kDefaultStartTransmissionPattern),
-          end_of_transmission_(kDefaultEndTransmissionPattern),
-          enable_checksum_validation_(true) {
-        identifier_buffer_size_ = std::max(start_of_transmission_.size(), end_of_transmission_.size());
-        max_bit_buffer_size_ = 776;  // Preset bit buffer size, 776 bits = (32 + 1 + 63 + 1) * 8 = 776
-
-        bit_buffer_.reserve(max_bit_buffer_size_);
+        : AudioDataBuffer(97, kDefaultStartTransmissionPattern, kDefaultEndTransmissionPattern, true) {
+        // Preset bit buffer size, 776 bits = (32 + 1 + 63 + 1) * 8 = 776
     }
 
     AudioDataBuffer::AudioDataBuffer(size_t max_byte_size, const std::vector<uint8_t> &start_identifier,
                                    const std::vector<uint8_t> &end_identifier, bool enable_checksum)
         : current_state_(DataReceptionState::kInactive),
-          start_of_transmission_(start_identifier),
-          end_of_transmission_(end_identifier),
+          identifier_bits_(0),
+          identifier_bit_count_(0),
+          start_identifier_(PackIdentifier(start_identifier)),
+          end_identifier_(PackIdentifier(end_identifier)),
           enable_checksum_validation_(enable_checksum) {
-        identifier_buffer_size_ = std::max(start_of_transmission_.size(), end_of_transmission_.size());
+        identifier_buffer_size_ = std::min<size_t>(std::max(start_identifier.size(), end_identifier.size()), 32);
+        identifier_mask_ = identifier_buffer_size_ >= 32 ? 0xFFFFFFFFu : ((1u << identifier_buffer_size_) - 1);
         max_bit_buffer_size_ = max_byte_size * 8;  // Bit buffer size in bytes
 
         bit_buffer_.reserve(max_bit_buffer_size_);
     }
 
+    uint32_t AudioDataBuffer::PackIdentifier(const std::vector<uint8_t> &identifier) {
+        uint32_t bits = 0;
+        for (uint8_t bit : identifier) {
+            bits = (bits << 1) | (bit & 1);
+        }
+        return bits;
+    }
+
     uint8_t AudioDataBuffer::CalculateChecksum(const std::string &text) {
         uint8_t checksum = 0;
         for (char character : text) {
@@ -251,23 +347,28 @@ namespace audio_wifi_config
     }
 
     void AudioDataBuffer::ClearBuffers() {
-        identifier_buffer_.clear();
+        identifier_bits_ = 0;
+        identifier_bit_count_ = 0;
         bit_buffer_.clear();
     }
 
-    bool AudioDataBuffer::ProcessProbabilityData(const std::vector<float> &probabilities, float threshold) {
-        for (float probability : probabilities) {
-            uint8_t bit = (probability > threshold) ? 1 : 0;
+    bool AudioDataBuffer::ProcessProbabilityData(const float *probabilities, size_t count, float threshold) {
+        // Identifier length in bytes, the trailing end identifier is stripped from the data
+        const size_t identifier_bytes = identifier_buffer_size_ / 8;
 
-            if (identifier_buffer_.size() >= identifier_buffer_size_) {
-                identifier_buffer_.pop_front();  // Maintain buffer size
+        for (size_t i = 0; i < count; ++i) {
+            uint8_t bit = (probabilities[i] > threshold) ? 1 : 0;
+
+            identifier_bits_ = ((identifier_bits_ << 1) | bit) & identifier_mask_;
+            if (identifier_bit_count_ < identifier_buffer_size_) {
+                identifier_bit_count_++;
             }
-            identifier_buffer_.push_back(bit);
+            bool identifier_ready = identifier_bit_count_ >= identifier_buffer_size_;
 
             // Process received bit based on state machine
             switch (current_state_) {
             case DataReceptionState::kInactive:
-                if (identifier_buffer_.size() >= start_of_transmission_.size()) {
+                if (identifier_ready) {
                     current_state_ = DataReceptionState::kWaiting;  // Enter waiting state
                     ESP_LOGI(kLogTag, "Entering Waiting state");
                 }
@@ -275,22 +376,17 @@ namespace audio_wifi_config
 
             case DataReceptionState::kWaiting:
                 // Waiting state, possibly waiting for transmission end
-                if (identifier_buffer_.size() >= start_of_transmission_.size()) {
-                    std::vector<uint8_t> identifier_snapshot(identifier_buffer_.begin(), identifier_buffer_.end());
-                    if (identifier_snapshot == start_of_transmission_)
-                    {
-                        ClearBuffers();                                // Clear buffers
-                        current_state_ = DataReceptionState::kReceiving;  // Enter receiving state
-                        ESP_LOGI(kLogTag, "Entering Receiving state");
-                    }
+                if (identifier_ready && identifier_bits_ == start_identifier_) {
+                    ClearBuffers();                                // Clear buffers
+                    current_state_ = DataReceptionState::kReceiving;  // Enter receiving state
+                    ESP_LOGI(kLogTag, "Entering Receiving state");
                 }
                 break;
 
             case DataReceptionState::kReceiving:
                 bit_buffer_.push_back(bit);
-                if (identifier_buffer_.size() >= end_of_transmission_.size()) {
-                    std::vector<uint8_t> identifier_snapshot(identifier_buffer_.begin(), identifier_buffer_.end());
-                    if (identifier_snapshot == end_of_transmission_) {
+                if (identifier_ready) {
+                    if (identifier_bits_ == end_identifier_) {
                         current_state_ = DataReceptionState::kInactive;  // Enter inactive state
 
                         // Convert bits to bytes
@@ -301,13 +397,13 @@ namespace audio_wifi_config
 
                         if (enable_checksum_validation_) {
                             // If checksum is required, last byte is checksum
-                            minimum_length = 1 + start_of_transmission_.size() / 8;
+                            minimum_length = 1 + identifier_bytes;
                             if (bytes.size() >= minimum_length)
                             {
-                                received_checksum = bytes[bytes.size() - start_of_transmission_.size() / 8 - 1];
+                                received_checksum = bytes[bytes.size() - identifier_bytes - 1];
                             }
                         } else {
-                            minimum_length = start_of_transmission_.size() / 8;
+                            minimum_length = identifier_bytes;
                         }
 
                         if (bytes.size() < minimum_length) {
@@ -317,10 +413,7 @@ namespace audio_wifi_config
                         }
 
                         // Extract text data (remove trailing identifier part)
-                        std::vector<uint8_t> text_bytes(
-                            bytes.begin(), bytes.begin() + bytes.size() - minimum_length);
-
-                        std::string result(text_bytes.begin(), text_bytes.end());
+                        std::string result(bytes.begin(), bytes.begin() + bytes.size() - minimum_length);
 
                         // Validate checksum if required
                         if (enable_checksum_validation_) {
@@ -368,4 +461,117 @@ namespace audio_wifi_config
 
         return bytes;
     }
+
+    // MultiToneDataBuffer implementation
+    MultiToneDataBuffer::MultiToneDataBuffer() {
+        payload_.reserve(128);
+    }
+
+    void MultiToneDataBuffer::Reset() {
+        state_ = State::kSearching;
+        sync_bits_ = 0;
+        symbol_count_ = 0;
+        expected_length_ = 0;
+        payload_.clear();
+        corrected_bits_ = 0;
+    }
+
+    uint8_t MultiToneDataBuffer::EncodeHamming84(uint8_t nibble) {
+        uint8_t d0 = nibble & 1, d1 = (nibble >> 1) & 1, d2 = (nibble >> 2) & 1, d3 = (nibble >> 3) & 1;
+        uint8_t p0 = d0 ^ d1 ^ d3;
+        uint8_t p1 = d0 ^ d2 ^ d3;
+        uint8_t p2 = d1 ^ d2 ^ d3;
+        uint8_t codeword = static_cast<uint8_t>(((nibble & 0x0F) << 4) | (p0 << 3) | (p1 << 2) | (p2 << 1));
+        return codeword | (__builtin_popcount(codeword) & 1);  // Overall parity
+    }
+
+    int MultiToneDataBuffer::DecodeHamming84(uint8_t codeword, bool *corrected) {
+        // Minimum distance is 4: distance 1 is corrected, distance 2 is rejected
+        for (uint8_t nibble = 0; nibble < 16; ++nibble) {
+            int distance = __builtin_popcount(EncodeHamming84(nibble) ^ codeword);
+            if (distance <= 1) {
+                if (corrected != nullptr) {
+                    *corrected = distance == 1;
+                }
+                return nibble;
+            }
+        }
+        return -1;
+    }
+
+    bool MultiToneDataBuffer::ProcessSymbols(const uint8_t *symbols, size_t count) {
+        const size_t kMaxTextLength = 127;
+
+        for (size_t i = 0; i < count; ++i) {
+            uint8_t dibit = symbols[i] ^ (symbols[i] >> 1);  // Gray decode
+
+            if (state_ == State::kSearching) {
+                sync_bits_ = static_cast<uint16_t>((sync_bits_ << 2) | dibit);
+                if (sync_bits_ == kMultiToneSyncWord) {
+                    ESP_LOGI(kLogTag, "Multi-tone sync word detected");
+                    state_ = State::kLength;
+                    symbol_count_ = 0;
+                    payload_.clear();
+                    corrected_bits_ = 0;
+                }
+                continue;
+            }
+
+            symbols_[symbol_count_++] = dibit;
+            if (symbol_count_ < symbols_.size()) {
+                continue;
+            }
+            symbol_count_ = 0;
+
+            // De-interleave: each symbol holds one bit of the high and one of the low codeword
+            uint8_t high_codeword = 0, low_codeword = 0;
+            for (uint8_t symbol : symbols_) {
+                high_codeword = static_cast<uint8_t>((high_codeword << 1) | (symbol >> 1));
+                low_codeword = static_cast<uint8_t>((low_codeword << 1) | (symbol & 1));
+            }
+            bool high_corrected = false, low_corrected = false;
+            int high = DecodeHamming84(high_codeword, &high_corrected);
+            int low = DecodeHamming84(low_codeword, &low_corrected);
+            if (high < 0 || low < 0) {
+                ESP_LOGW(kLogTag, "Uncorrectable symbol error, waiting for next frame");
+                Reset();
+                continue;
+            }
+            corrected_bits_ += high_corrected + low_corrected;
+            uint8_t byte = static_cast<uint8_t>((high << 4) | low);
+
+            if (state_ == State::kLength) {
+                if (byte == 0 || byte > kMaxTextLength) {
+                    ESP_LOGW(kLogTag, "Invalid multi-tone frame length %u", byte);
+                    Reset();
+                    continue;
+                }
+                expected_length_ = byte + 1;  // Text plus checksum
+                state_ = State::kPayload;
+                continue;
+            }
+
+            payload_.push_back(static_cast<char>(byte));
+            if (payload_.size() < expected_length_) {
+                continue;
+            }
+
+            uint8_t received_checksum = static_cast<uint8_t>(payload_.back());
+            payload_.pop_back();
+            uint8_t calculated_checksum = AudioDataBuffer::CalculateChecksum(payload_);
+            if (calculated_checksum != received_checksum) {
+                ESP_LOGW(kLogTag, "Checksum mismatch: expected %d, got %d", received_checksum, calculated_checksum);
+                Reset();
+                continue;
+            }
+
+            ESP_LOGI(kLogTag, "Multi-tone frame received, %u bytes, %u bits corrected",
+                     static_cast<unsigned>(payload_.size()), static_cast<unsigned>(corrected_bits_));
+            decoded_text = payload_;
+            Reset();
+            return true;
+        }
+
+        return false;
+    }
 }
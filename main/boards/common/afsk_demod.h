@@ -1,47 +1,55 @@
 #pragma once
 
 #include <vector>
-#include <deque>
+#include <array>
 #include <string>
-#include <memory>
 #include <optional>
+#include <cstdint>
 #include <cmath>
 #include "wifi_configuration_ap.h"
 #include "application.h"
 
 // Audio signal processing constants for WiFi configuration via audio
-const size_t kAudioSampleRate = 6400;
+// The 16 kHz input is decimated by 2, all tones sit exactly on a DFT bin at this rate
+const size_t kAudioSampleRate = 8000;
 const size_t kMarkFrequency = 1800;
 const size_t kSpaceFrequency = 1500;
 const size_t kBitRate = 100;
-const size_t kWindowSize = 64;
+const size_t kWindowSize = kAudioSampleRate / kBitRate;
+
+// Fast mode: 4-FSK, 2 bits per symbol, Hamming(8,4) coded and interleaved
+const size_t kMultiToneSymbolRate = 200;
+const size_t kMultiToneBaseFrequency = 1200;
+const size_t kMultiToneSpacing = 200;
+const size_t kMultiToneCount = 4;
+const size_t kMultiToneWindowSize = kAudioSampleRate / kMultiToneSymbolRate;
+const uint16_t kMultiToneSyncWord = 0x2DD4;
 
 namespace audio_wifi_config
 {
     // Main function to receive WiFi credentials through audio signal
-    void ReceiveWifiCredentialsFromAudio(Application *app, WifiConfigurationAp *wifi_ap, Display *display, 
+    void ReceiveWifiCredentialsFromAudio(Application *app, WifiConfigurationAp *wifi_ap, Display *display,
                                          size_t input_channels = 1);
 
     /**
-     * Goertzel algorithm implementation for single frequency detection
-     * Used to detect specific audio frequencies in the AFSK demodulation process
+     * Fixed-point sliding Goertzel (single bin sliding DFT) for one frequency
+     * The bin is phase referenced to the window period, so the sample leaving the
+     * window cancels exactly what it added and the integer state never drifts.
      */
     class FrequencyDetector
     {
     private:
-        float frequency_;              // Target frequency (normalized, i.e., f / fs)
-        size_t window_size_;           // Window size for analysis
-        float frequency_bin_;          // Frequency bin
-        float angular_frequency_;      // Angular frequency
-        float cos_coefficient_;        // cos(w)
-        float sin_coefficient_;        // sin(w)
-        float filter_coefficient_;     // 2 * cos(w)
-        std::deque<float> state_buffer_;  // Circular buffer for storing S[-1] and S[-2]
+        size_t window_size_;              // Window size for analysis
+        size_t phase_;                    // Current index into the twiddle tables
+        int32_t real_;                    // Accumulated real part
+        int32_t imaginary_;               // Accumulated imaginary part
+        std::vector<int16_t> cos_table_;  // Q14 cos(2*pi*k*n/N)
+        std::vector<int16_t> sin_table_;  // Q14 sin(2*pi*k*n/N)
 
     public:
         /**
          * Constructor
-         * @param frequency Normalized frequency (f / fs)
+         * @param frequency Normalized frequency (f / fs), rounded to the nearest bin
          * @param window_size Window size for analysis
          */
         FrequencyDetector(float frequency, size_t window_size);
@@ -52,18 +60,46 @@ namespace audio_wifi_config
         void Reset();
 
         /**
-         * Process one audio sample
-         * @param sample Input audio sample
+         * Slide the window by one sample
+         * @param sample Sample entering the window
+         * @param expired Sample leaving the window (0 while the window fills)
+         */
+        void ProcessSample(int16_t sample, int16_t expired);
+
+        /**
+         * Squared magnitude of the bin
          */
-        void ProcessSample(float sample);
+        int64_t GetEnergy() const;
 
         /**
          * Calculate current amplitude
-         * @return Amplitude value
+         * @return Amplitude value in sample units
          */
         float GetAmplitude() const;
     };
 
+    /**
+     * Fixed-size sample window shared by the detectors of one processor
+     */
+    class SampleWindow
+    {
+    private:
+        std::vector<int16_t> samples_;
+        size_t write_index_ = 0;
+        size_t filled_ = 0;
+
+    public:
+        explicit SampleWindow(size_t size) : samples_(size, 0) {}
+
+        /**
+         * Push a sample
+         * @return The sample that left the window
+         */
+        int16_t Push(int16_t sample);
+        bool IsFull() const { return filled_ >= samples_.size(); }
+        void Reset();
+    };
+
     /**
      * Audio signal processor for Mark/Space frequency pair detection
      * Processes audio signals to extract digital data using AFSK demodulation
@@ -71,12 +107,11 @@ namespace audio_wifi_config
     class AudioSignalProcessor
     {
     private:
-        std::deque<float> input_buffer_;             // Input sample buffer
-        size_t input_buffer_size_;                   // Input buffer size = window size
+        SampleWindow window_;                        // Last window_size input samples
         size_t output_sample_count_;                 // Output sample counter
         size_t samples_per_bit_;                     // Samples per bit threshold
-        std::unique_ptr<FrequencyDetector> mark_detector_;   // Mark frequency detector
-        std::unique_ptr<FrequencyDetector> space_detector_;  // Space frequency detector
+        FrequencyDetector mark_detector_;            // Mark frequency detector
+        FrequencyDetector space_detector_;           // Space frequency detector
 
     public:
         /**
@@ -92,10 +127,52 @@ namespace audio_wifi_config
 
         /**
          * Process input audio samples
-         * @param samples Input audio sample vector
-         * @return Vector of Mark probability values (0.0 to 1.0)
+         * @param samples Input audio samples
+         * @param count Number of input samples
+         * @param probabilities Output Mark probability values (0.0 to 1.0)
+         * @param max_probabilities Capacity of the output array
+         * @return Number of probability values written
          */
-        std::vector<float> ProcessAudioSamples(const std::vector<float> &samples);
+        size_t ProcessAudioSamples(const int16_t *samples, size_t count, float *probabilities, size_t max_probabilities);
+    };
+
+    /**
+     * Multi-tone (M-FSK) symbol demodulator with symbol timing recovery
+     * Every sample updates one sliding detector per tone; a per-phase confidence
+     * average picks the sampling instant where the window covers a whole symbol.
+     */
+    class MultiToneSignalProcessor
+    {
+    private:
+        SampleWindow window_;
+        std::vector<FrequencyDetector> detectors_;   // One detector per tone
+        std::vector<int32_t> phase_confidence_;      // Averaged Q8 confidence per symbol phase
+        size_t samples_per_symbol_;
+        size_t phase_;                               // Current phase within the symbol period
+        size_t best_phase_;                          // Phase where symbols are sampled
+        size_t samples_since_symbol_;                // Guards against double sampling on phase changes
+
+    public:
+        /**
+         * Constructor
+         * @param sample_rate Audio sampling rate
+         * @param base_frequency Frequency of symbol 0
+         * @param spacing Frequency step between symbols
+         * @param tone_count Number of tones
+         * @param symbol_rate Symbols per second
+         */
+        MultiToneSignalProcessor(size_t sample_rate, size_t base_frequency, size_t spacing,
+                                 size_t tone_count, size_t symbol_rate);
+
+        /**
+         * Process input audio samples
+         * @param samples Input audio samples
+         * @param count Number of input samples
+         * @param symbols Output tone indices
+         * @param max_symbols Capacity of the output array
+         * @return Number of symbols written
+         */
+        size_t ProcessAudioSamples(const int16_t *samples, size_t count, uint8_t *symbols, size_t max_symbols);
     };
 
     /**
@@ -116,12 +193,14 @@ namespace audio_wifi_config
     {
     private:
         DataReceptionState current_state_;       // Current reception state
-        std::deque<uint8_t> identifier_buffer_;  // Buffer for start/end identifier detection
-        size_t identifier_buffer_size_;          // Identifier buffer size
+        uint32_t identifier_bits_;               // Shift register of the last received bits
+        size_t identifier_bit_count_;            // Number of valid bits in the shift register
+        uint32_t start_identifier_;              // Start-of-transmission identifier as bits
+        uint32_t end_identifier_;                // End-of-transmission identifier as bits
+        uint32_t identifier_mask_;               // Mask covering identifier_buffer_size_ bits
+        size_t identifier_buffer_size_;          // Identifier length in bits (at most 32)
         std::vector<uint8_t> bit_buffer_;        // Buffer for storing bit stream
         size_t max_bit_buffer_size_;             // Maximum bit buffer size
-        const std::vector<uint8_t> start_of_transmission_;  // Start-of-transmission identifier
-        const std::vector<uint8_t> end_of_transmission_;    // End-of-transmission identifier
         bool enable_checksum_validation_;       // Whether to validate checksum
 
     public:
@@ -144,11 +223,12 @@ namespace audio_wifi_config
 
         /**
          * Process probability data and attempt to decode
-         * @param probabilities Vector of Mark probabilities
+         * @param probabilities Mark probabilities
+         * @param count Number of probabilities
          * @param threshold Decision threshold for bit detection
          * @return true if complete data was successfully received and decoded
          */
-        bool ProcessProbabilityData(const std::vector<float> &probabilities, float threshold = 0.5f);
+        bool ProcessProbabilityData(const float *probabilities, size_t count, float threshold = 0.5f);
 
         /**
          * Calculate checksum for ASCII text
@@ -169,9 +249,62 @@ namespace audio_wifi_config
          * Clear all buffers and reset state
          */
         void ClearBuffers();
+
+        /**
+         * Pack an identifier bit pattern into an integer
+         */
+        static uint32_t PackIdentifier(const std::vector<uint8_t> &identifier);
+    };
+
+    /**
+     * Frame decoder for the multi-tone fast mode
+     * Frame: preamble | sync word | length | text | checksum
+     * Every byte after the sync word is sent as two Hamming(8,4) codewords whose
+     * bits are interleaved over 8 Gray coded symbols, so one wrong symbol costs
+     * at most one correctable bit per codeword.
+     */
+    class MultiToneDataBuffer
+    {
+    private:
+        enum class State
+        {
+            kSearching,
+            kLength,
+            kPayload,
+        };
+
+        State state_ = State::kSearching;
+        uint16_t sync_bits_ = 0;                 // Shift register for sync word search
+        std::array<uint8_t, 8> symbols_{};       // Symbols of the byte being received
+        size_t symbol_count_ = 0;
+        size_t expected_length_ = 0;             // Text length plus checksum byte
+        std::string payload_;
+        size_t corrected_bits_ = 0;              // Corrected bits in the current frame
+
+        void Reset();
+
+    public:
+        std::optional<std::string> decoded_text; // Successfully decoded text data
+
+        MultiToneDataBuffer();
+
+        /**
+         * Process demodulated symbols and attempt to decode
+         * @param symbols Tone indices
+         * @param count Number of symbols
+         * @return true if complete data was successfully received and decoded
+         */
+        bool ProcessSymbols(const uint8_t *symbols, size_t count);
+
+        /**
+         * Hamming(8,4) SECDED helpers
+         * @return Decoded nibble, or -1 if an uncorrectable error is detected
+         */
+        static uint8_t EncodeHamming84(uint8_t nibble);
+        static int DecodeHamming84(uint8_t codeword, bool *corrected = nullptr);
     };
 
     // Default start and end transmission identifiers
     extern const std::vector<uint8_t> kDefaultStartTransmissionPattern;
     extern const std::vector<uint8_t> kDefaultEndTransmissionPattern;
-}
\ No newline at end of file
+}
@@ -3,16 +3,82 @@
 #include "display.h"
 #include "board.h"
 #include "system_info.h"
+#include "memory_budget.h"
 #include "lvgl_display.h"
 #include "jpg/image_to_jpeg.h"
 
 #include <esp_log.h>
 #include <esp_heap_caps.h>
+#include <esp_timer.h>
+#include <esp_pthread.h>
+#include <freertos/stream_buffer.h>
+#include <atomic>
 #include <cstring>
+#include <strings.h>
 #include <network_interface.h>
 
 #define TAG "Esp32Camera"
 
+// ExplainFromUrl relays the HA image through this ring instead of buffering all of it
+#define HA_RELAY_RING_SIZE (8 * 1024)
+#define HA_RELAY_CHUNK_SIZE 1024
+#define HA_RELAY_TASK_STACK_SIZE 6144
+
+#ifndef CONFIG_CAMERA_STREAMING_INTERVAL_MS
+#define CONFIG_CAMERA_STREAMING_INTERVAL_MS 200
+#endif
+// How long Capture() waits for the stream to deliver its first frame
+#define CAMERA_STREAM_WAIT_MS 1000
+#define CAMERA_STREAM_TASK_STACK_SIZE 4096
+
+// Points LVGL at a preview buffer, the buffer stays alive while the image is on screen
+class CameraPreviewImage : public LvglImage {
+public:
+    CameraPreviewImage(std::shared_ptr<CameraPreviewBuffer> buffer, size_t size, int width, int height)
+        : buffer_(std::move(buffer)) {
+        bzero(&image_dsc_, sizeof(image_dsc_));
+        image_dsc_.data_size = size;
+        image_dsc_.data = buffer_->data;
+        image_dsc_.header.magic = LV_IMAGE_HEADER_MAGIC;
+        image_dsc_.header.cf = LV_COLOR_FORMAT_RGB565;
+        image_dsc_.header.w = width;
+        image_dsc_.header.h = height;
+        image_dsc_.header.stride = width * 2;
+    }
+    virtual const lv_img_dsc_t* image_dsc() const override { return &image_dsc_; }
+
+private:
+    std::shared_ptr<CameraPreviewBuffer> buffer_;
+    lv_img_dsc_t image_dsc_;
+};
+
+// The sensor sends RGB565 big endian, LVGL wants it little endian. Two pixels per word.
+static void SwapRgb565(const uint8_t* src, uint8_t* dst, size_t len) {
+    auto src_words = (const uint32_t*)src;
+    auto dst_words = (uint32_t*)dst;
+    size_t word_count = len / 4;
+    for (size_t i = 0; i < word_count; i++) {
+        uint32_t v = src_words[i];
+        dst_words[i] = ((v & 0x00FF00FF) << 8) | ((v >> 8) & 0x00FF00FF);
+    }
+    if (len & 2) {
+        size_t last = len / 2 - 1;
+        ((uint16_t*)dst)[last] = __builtin_bswap16(((const uint16_t*)src)[last]);
+    }
+}
+
+// Grows a 16 byte aligned PSRAM buffer, the old content is dropped
+static bool ReserveBuffer(uint8_t*& data, size_t& capacity, size_t size) {
+    if (size <= capacity) {
+        return true;
+    }
+    auto& budget = MemoryBudget::GetInstance();
+    budget.Free(kMemoryTagCamera, data);
+    data = (uint8_t*)budget.AlignedMalloc(kMemoryTagCamera, 16, size, MALLOC_CAP_SPIRAM);
+    capacity = data != nullptr ? size : 0;
+    return data != nullptr;
+}
+
 Esp32Camera::Esp32Camera(const camera_config_t& config) {
     // camera init
     esp_err_t err = esp_camera_init(&config); // 配置上面定义的参数
@@ -25,13 +91,18 @@ Esp32Camera::Esp32Camera(const camera_config_t& config) {
     if (s->id.PID == GC0308_PID) {
         s->set_hmirror(s, 0);  // 这里控制摄像头镜像 写1镜像 写0不镜像
     }
+
+#if CONFIG_CAMERA_STREAMING
+    StartStreaming();
+#endif
 }
 
 Esp32Camera::~Esp32Camera() {
-    if (fb_) {
-        esp_camera_fb_return(fb_);
-        fb_ = nullptr;
+    StopStreaming();
+    if (encoder_thread_.joinable()) {
+        encoder_thread_.join();
     }
+    frame_.reset();
     esp_camera_deinit();
 }
 
@@ -40,47 +111,187 @@ void Esp32Camera::SetExplainUrl(const std::string& url, const std::string& token
     explain_token_ = token;
 }
 
+std::shared_ptr<CameraFrame> Esp32Camera::StoreFrame(const camera_fb_t* fb) {
+    std::lock_guard<std::mutex> lock(ring_mutex_);
+    // A slot can be written when nobody but the ring holds it, and it is not the latest frame
+    int slot = -1;
+    for (int i = 0; i < CAMERA_RING_SLOTS; i++) {
+        if (i == latest_slot_) {
+            continue;
+        }
+        if (ring_[i] == nullptr) {
+            ring_[i] = std::shared_ptr<CameraFrame>(new CameraFrame(), [](CameraFrame* frame) {
+                MemoryBudget::GetInstance().Free(kMemoryTagCamera, frame->data);
+                delete frame;
+            });
+        }
+        if (ring_[i].use_count() == 1) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot < 0) {
+        ESP_LOGW(TAG, "All capture slots are in use, frame dropped");
+        return nullptr;
+    }
+
+    auto& frame = ring_[slot];
+    if (!ReserveBuffer(frame->data, frame->capacity, fb->len)) {
+        ESP_LOGE(TAG, "Failed to allocate %u bytes for a capture slot", (unsigned)fb->len);
+        return nullptr;
+    }
+    memcpy(frame->data, fb->buf, fb->len);
+    frame->len = fb->len;
+    frame->width = fb->width;
+    frame->height = fb->height;
+    frame->format = fb->format;
+    frame->timestamp_us = esp_timer_get_time();
+    latest_slot_ = slot;
+    ring_cv_.notify_all();
+    return frame;
+}
+
+std::shared_ptr<CameraFrame> Esp32Camera::GetLatestFrame(int timeout_ms) {
+    std::unique_lock<std::mutex> lock(ring_mutex_);
+    ring_cv_.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this]() { return latest_slot_ >= 0; });
+    if (latest_slot_ < 0) {
+        return nullptr;
+    }
+    return ring_[latest_slot_];
+}
+
+void Esp32Camera::StreamLoop() {
+    while (streaming_) {
+        camera_fb_t* fb = esp_camera_fb_get();
+        if (fb == nullptr) {
+            ESP_LOGE(TAG, "Camera capture failed");
+        } else {
+            StoreFrame(fb);
+            esp_camera_fb_return(fb);
+        }
+
+        std::unique_lock<std::mutex> lock(ring_mutex_);
+        ring_cv_.wait_for(lock, std::chrono::milliseconds(CONFIG_CAMERA_STREAMING_INTERVAL_MS),
+            [this]() { return !streaming_; });
+    }
+}
+
+bool Esp32Camera::StartStreaming() {
+    if (streaming_) {
+        return true;
+    }
+    if (esp_camera_sensor_get() == nullptr) {
+        ESP_LOGE(TAG, "Camera is not initialized, streaming not started");
+        return false;
+    }
+    streaming_ = true;
+
+    esp_pthread_cfg_t default_cfg = esp_pthread_get_default_config();
+    esp_pthread_cfg_t stream_cfg = default_cfg;
+    stream_cfg.stack_size = CAMERA_STREAM_TASK_STACK_SIZE;
+    stream_cfg.thread_name = "cam_stream";
+    stream_cfg.prio = 1;
+    esp_pthread_set_cfg(&stream_cfg);
+    stream_thread_ = std::thread(&Esp32Camera::StreamLoop, this);
+    esp_pthread_set_cfg(&default_cfg);
+    ESP_LOGI(TAG, "Camera streaming started, interval %d ms", CONFIG_CAMERA_STREAMING_INTERVAL_MS);
+    return true;
+}
+
+void Esp32Camera::StopStreaming() {
+    {
+        std::lock_guard<std::mutex> lock(ring_mutex_);
+        if (!streaming_) {
+            return;
+        }
+        streaming_ = false;
+    }
+    ring_cv_.notify_all();
+    stream_thread_.join();
+
+    // Slots still held by Explain() or frame_ are freed when released
+    std::lock_guard<std::mutex> lock(ring_mutex_);
+    for (auto& slot : ring_) {
+        slot.reset();
+    }
+    latest_slot_ = -1;
+    ESP_LOGI(TAG, "Camera streaming stopped");
+}
+
+void Esp32Camera::ShowPreview(const std::shared_ptr<CameraFrame>& frame) {
+    auto display = dynamic_cast<LvglDisplay*>(Board::GetInstance().GetDisplay());
+    if (display == nullptr || frame->format != PIXFORMAT_RGB565) {
+        return;
+    }
+
+    // The buffer referenced by the image on screen is never written
+    std::shared_ptr<CameraPreviewBuffer> buffer;
+    for (auto& preview : previews_) {
+        if (preview == nullptr) {
+            preview = std::shared_ptr<CameraPreviewBuffer>(new CameraPreviewBuffer(), [](CameraPreviewBuffer* buffer) {
+                MemoryBudget::GetInstance().Free(kMemoryTagCamera, buffer->data);
+                delete buffer;
+            });
+        }
+        if (preview.use_count() == 1) {
+            buffer = preview;
+            break;
+        }
+    }
+    if (buffer == nullptr) {
+        ESP_LOGW(TAG, "No free preview buffer");
+        return;
+    }
+    if (!ReserveBuffer(buffer->data, buffer->capacity, frame->len)) {
+        ESP_LOGE(TAG, "Failed to allocate memory for preview image");
+        return;
+    }
+
+    SwapRgb565(frame->data, buffer->data, frame->len);
+    display->SetPreviewImage(std::make_unique<CameraPreviewImage>(buffer, frame->len, frame->width, frame->height));
+}
+
 bool Esp32Camera::Capture() {
     if (encoder_thread_.joinable()) {
         encoder_thread_.join();
     }
 
     auto start_time = esp_timer_get_time();
-    int frames_to_get = 2;
-    // Try to get a stable frame
-    for (int i = 0; i < frames_to_get; i++) {
-        if (fb_ != nullptr) {
-            esp_camera_fb_return(fb_);
+    std::shared_ptr<CameraFrame> frame;
+    if (streaming_) {
+        frame = GetLatestFrame(CAMERA_STREAM_WAIT_MS);
+        if (frame == nullptr) {
+            ESP_LOGE(TAG, "No frame from the camera stream");
+            return false;
         }
-        fb_ = esp_camera_fb_get();
-        if (fb_ == nullptr) {
-            ESP_LOGE(TAG, "Camera capture failed");
+        ESP_LOGI(TAG, "Camera frame taken from the stream, %d ms old",
+            int((esp_timer_get_time() - frame->timestamp_us) / 1000));
+    } else {
+        int frames_to_get = 2;
+        camera_fb_t* fb = nullptr;
+        // Try to get a stable frame
+        for (int i = 0; i < frames_to_get; i++) {
+            if (fb != nullptr) {
+                esp_camera_fb_return(fb);
+            }
+            fb = esp_camera_fb_get();
+            if (fb == nullptr) {
+                ESP_LOGE(TAG, "Camera capture failed");
+                return false;
+            }
+        }
+        frame = StoreFrame(fb);
+        esp_camera_fb_return(fb);
+        if (frame == nullptr) {
             return false;
         }
+        auto end_time = esp_timer_get_time();
+        ESP_LOGI(TAG, "Camera captured %d frames in %d ms", frames_to_get, int((end_time - start_time) / 1000));
     }
-    auto end_time = esp_timer_get_time();
-    ESP_LOGI(TAG, "Camera captured %d frames in %d ms", frames_to_get, int((end_time - start_time) / 1000));
+    frame_ = frame;
 
     // 显示预览图片
-    auto display = dynamic_cast<LvglDisplay*>(Board::GetInstance().GetDisplay());
-    if (display != nullptr) {
-        auto data = (uint8_t*)heap_caps_malloc(fb_->len, MALLOC_CAP_SPIRAM);
-        if (data == nullptr) {
-            ESP_LOGE(TAG, "Failed to allocate memory for preview image");
-            return false;
-        }
-
-        auto src = (uint16_t*)fb_->buf;
-        auto dst = (uint16_t*)data;
-        size_t pixel_count = fb_->len / 2;
-        for (size_t i = 0; i < pixel_count; i++) {
-            // 交换每个16位字内的字节
-            dst[i] = __builtin_bswap16(src[i]);
-        }
-
-        auto image = std::make_unique<LvglAllocatedImage>(data, fb_->len, fb_->width, fb_->height, fb_->width * 2, LV_COLOR_FORMAT_RGB565);
-        display->SetPreviewImage(std::move(image));
-    }
+    ShowPreview(frame_);
     return true;
 }
 
@@ -145,6 +356,9 @@ std::string Esp32Camera::Explain(const std::string& question) {
     if (explain_url_.empty()) {
         throw std::runtime_error("Image explain URL or token is not set");
     }
+    if (frame_ == nullptr) {
+        throw std::runtime_error("No photo captured");
+    }
 
     // 创建局部的 JPEG 队列, 40 entries is about to store 512 * 40 = 20480 bytes of JPEG data
     QueueHandle_t jpeg_queue = xQueueCreate(40, sizeof(JpegChunk));
@@ -154,12 +368,13 @@ std::string Esp32Camera::Explain(const std::string& question) {
     }
 
     // We spawn a thread to encode the image to JPEG using optimized encoder (cost about 500ms and 8KB SRAM)
-    encoder_thread_ = std::thread([this, jpeg_queue]() {
-        image_to_jpeg_cb(fb_->buf, fb_->len, fb_->width, fb_->height, fb_->format, 80,
+    // The thread holds its own reference, a Capture() in the meantime does not touch the frame
+    encoder_thread_ = std::thread([frame = frame_, jpeg_queue]() {
+        image_to_jpeg_cb(frame->data, frame->len, frame->width, frame->height, frame->format, 80,
             [](void* arg, size_t index, const void* data, size_t len) -> size_t {
             auto jpeg_queue = (QueueHandle_t)arg;
             JpegChunk chunk = {
-                .data = (uint8_t*)heap_caps_aligned_alloc(16, len, MALLOC_CAP_SPIRAM),
+                .data = (uint8_t*)MemoryBudget::GetInstance().AlignedMalloc(kMemoryTagCamera, 16, len, MALLOC_CAP_SPIRAM),
                 .len = len
             };
             memcpy(chunk.data, data, len);
@@ -188,7 +403,7 @@ std::string Esp32Camera::Explain(const std::string& question) {
         JpegChunk chunk;
         while (xQueueReceive(jpeg_queue, &chunk, portMAX_DELAY) == pdPASS) {
             if (chunk.data != nullptr) {
-                heap_caps_free(chunk.data);
+                MemoryBudget::GetInstance().Free(kMemoryTagCamera, chunk.data);
             } else {
                 break;
             }
@@ -229,7 +444,7 @@ std::string Esp32Camera::Explain(const std::string& question) {
         }
         http->Write((const char*)chunk.data, chunk.len);
         total_sent += chunk.len;
-        heap_caps_free(chunk.data);
+        MemoryBudget::GetInstance().Free(kMemoryTagCamera, chunk.data);
     }
     // Wait for the encoder thread to finish
     encoder_thread_.join();
@@ -256,43 +471,92 @@ std::string Esp32Camera::Explain(const std::string& question) {
     // Get remain task stack size
     size_t remain_stack_size = uxTaskGetStackHighWaterMark(nullptr);
     ESP_LOGI(TAG, "Explain image size=%dx%d, compressed size=%d, remain stack size=%d, question=%s\n%s",
-        fb_->width, fb_->height, total_sent, remain_stack_size, question.c_str(), result.c_str());
+        frame_->width, frame_->height, total_sent, remain_stack_size, question.c_str(), result.c_str());
     return result;
 }
 
+/**
+ * @brief 把 HA camera proxy 的 JPEG 边下载边转发给 AI 视觉服务器
+ *
+ * 下载线程把 HA 响应体写入一个小的环形缓冲区（StreamBuffer），调用线程同时
+ * 连接视觉服务器并以 chunked multipart 上传，下载与上传重叠进行，
+ * 整张图片不会在 PSRAM 中完整保存。结束时打印各阶段耗时。
+ */
 std::string Esp32Camera::ExplainFromUrl(const std::string& image_url, const std::string& image_token, const std::string& question) {
     if (explain_url_.empty()) {
         throw std::runtime_error("Vision server URL not configured");
     }
 
     auto network = Board::GetInstance().GetNetwork();
+    int64_t start_time = esp_timer_get_time();
 
-    // Step 1: 从 HA camera proxy 下载 JPEG
-    std::string jpeg_data;
-    {
-        auto http = network->CreateHttp();
-        if (!image_token.empty()) {
-            http->SetHeader("Authorization", "Bearer " + image_token);
-        }
-        if (!http->Open("GET", image_url)) {
-            throw std::runtime_error("Failed to connect to HA camera proxy");
-        }
-        int status = http->GetStatusCode();
-        if (status != 200) {
-            http->Close();
-            throw std::runtime_error(std::string("HA camera proxy error, status: ") + std::to_string(status));
-        }
-        jpeg_data = http->ReadAll();
-        http->Close();
+    // Step 1: 连接 HA camera proxy，响应体由转发线程读取
+    // Both connections are open at the same time, so they need distinct connection ids on 4G modems
+    auto download = network->CreateHttp(4);
+    if (!image_token.empty()) {
+        download->SetHeader("Authorization", "Bearer " + image_token);
+    }
+    if (!download->Open("GET", image_url)) {
+        throw std::runtime_error("Failed to connect to HA camera proxy");
     }
+    int status = download->GetStatusCode();
+    if (status != 200) {
+        download->Close();
+        throw std::runtime_error(std::string("HA camera proxy error, status: ") + std::to_string(status));
+    }
+    int64_t download_open_time = esp_timer_get_time();
 
-    if (jpeg_data.empty()) {
-        throw std::runtime_error("HA camera returned empty image");
+    StreamBufferHandle_t ring = xStreamBufferCreate(HA_RELAY_RING_SIZE, 1);
+    if (ring == nullptr) {
+        download->Close();
+        throw std::runtime_error("Failed to create relay buffer");
     }
-    ESP_LOGI(TAG, "Downloaded JPEG from HA: %d bytes", (int)jpeg_data.size());
 
-    // Step 2: 发送 JPEG 到 AI 视觉服务器（与 Explain() 同样的 multipart/form-data 格式）
-    auto http = network->CreateHttp();
+    std::atomic<bool> download_done = false;
+    std::atomic<bool> download_failed = false;
+    std::atomic<bool> aborted = false;
+    size_t downloaded = 0;
+    int64_t download_end_time = 0;
+
+    // TLS reads need more than the default pthread stack
+    esp_pthread_cfg_t default_cfg = esp_pthread_get_default_config();
+    esp_pthread_cfg_t relay_cfg = default_cfg;
+    relay_cfg.stack_size = HA_RELAY_TASK_STACK_SIZE;
+    relay_cfg.thread_name = "ha_relay";
+    esp_pthread_set_cfg(&relay_cfg);
+    std::thread relay_thread([&]() {
+        auto buffer = std::make_unique<char[]>(HA_RELAY_CHUNK_SIZE);
+        while (!aborted) {
+            int ret = download->Read(buffer.get(), HA_RELAY_CHUNK_SIZE);
+            if (ret < 0) {
+                ESP_LOGE(TAG, "Failed to read from HA camera proxy, ret: %d", ret);
+                download_failed = true;
+                break;
+            }
+            if (ret == 0) {
+                break;
+            }
+            size_t offset = 0;
+            while (offset < (size_t)ret && !aborted) {
+                offset += xStreamBufferSend(ring, buffer.get() + offset, ret - offset, pdMS_TO_TICKS(100));
+            }
+            downloaded += ret;
+        }
+        download->Close();
+        download_end_time = esp_timer_get_time();
+        download_done = true;
+    });
+    esp_pthread_set_cfg(&default_cfg);
+
+    // Stops the download and releases the ring, used on every exit path
+    auto finish_relay = [&]() {
+        aborted = true;
+        relay_thread.join();
+        vStreamBufferDelete(ring);
+    };
+
+    // Step 2: 下载进行的同时连接视觉服务器（与 Explain() 同样的 multipart/form-data 格式）
+    auto http = network->CreateHttp(3);
     std::string boundary = "----ESP32_HA_CAM_BOUNDARY";
 
     http->SetHeader("Device-Id", SystemInfo::GetMacAddress().c_str());
@@ -304,8 +568,10 @@ std::string Esp32Camera::ExplainFromUrl(const std::string& image_url, const std:
     http->SetHeader("Transfer-Encoding", "chunked");
 
     if (!http->Open("POST", explain_url_)) {
+        finish_relay();
         throw std::runtime_error("Failed to connect to vision server");
     }
+    int64_t upload_open_time = esp_timer_get_time();
 
     std::string q_field = "--" + boundary + "\r\n"
         "Content-Disposition: form-data; name=\"question\"\r\n\r\n"
@@ -317,11 +583,31 @@ std::string Esp32Camera::ExplainFromUrl(const std::string& image_url, const std:
         "Content-Type: image/jpeg\r\n\r\n";
     http->Write(f_header.c_str(), f_header.size());
 
-    http->Write(jpeg_data.c_str(), jpeg_data.size());
+    // Step 3: 从环形缓冲区取出数据直接写入上传连接
+    auto chunk = std::make_unique<char[]>(HA_RELAY_CHUNK_SIZE);
+    size_t relayed = 0;
+    while (true) {
+        // download_done is read before draining, so nothing sent before it was set can be missed
+        bool done = download_done;
+        size_t len = xStreamBufferReceive(ring, chunk.get(), HA_RELAY_CHUNK_SIZE, pdMS_TO_TICKS(100));
+        if (len > 0) {
+            http->Write(chunk.get(), len);
+            relayed += len;
+        } else if (done) {
+            break;
+        }
+    }
+    finish_relay();
+
+    if (download_failed || relayed == 0) {
+        http->Close();
+        throw std::runtime_error(relayed == 0 ? "HA camera returned empty image" : "HA camera download failed");
+    }
 
     std::string footer = "\r\n--" + boundary + "--\r\n";
     http->Write(footer.c_str(), footer.size());
     http->Write("", 0);
+    int64_t upload_end_time = esp_timer_get_time();
 
     if (http->GetStatusCode() != 200) {
         throw std::runtime_error(std::string("Vision server error, status: ") + std::to_string(http->GetStatusCode()));
@@ -329,7 +615,12 @@ std::string Esp32Camera::ExplainFromUrl(const std::string& image_url, const std:
 
     std::string result = http->ReadAll();
     http->Close();
+    int64_t end_time = esp_timer_get_time();
 
+    ESP_LOGI(TAG, "HA relay %u bytes: HA open %d ms, vision open %d ms, download %d ms, upload done %d ms, response %d ms",
+        (unsigned)relayed, (int)((download_open_time - start_time) / 1000), (int)((upload_open_time - start_time) / 1000),
+        (int)((download_end_time - start_time) / 1000), (int)((upload_end_time - start_time) / 1000),
+        (int)((end_time - upload_end_time) / 1000));
     ESP_LOGI(TAG, "HA camera describe result: %s", result.c_str());
     return result;
 }
@@ -5,24 +5,66 @@
 #include <lvgl.h>
 #include <thread>
 #include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <array>
+#include <atomic>
 
 #include <freertos/FreeRTOS.h>
 #include <freertos/queue.h>
 
 #include "camera.h"
 
+// Frames kept by the capture ring, one is written while the others can be read
+#define CAMERA_RING_SLOTS 3
+// Preview buffers, the one on screen is never written
+#define CAMERA_PREVIEW_BUFFERS 2
+
 struct JpegChunk {
     uint8_t* data;
     size_t len;
 };
 
+// A frame copied out of the driver, in the sensor byte order
+struct CameraFrame {
+    uint8_t* data = nullptr;
+    size_t len = 0;
+    size_t capacity = 0;
+    uint16_t width = 0;
+    uint16_t height = 0;
+    pixformat_t format = PIXFORMAT_RGB565;
+    int64_t timestamp_us = 0;
+};
+
+// RGB565 in LVGL byte order, shown on screen without a copy
+struct CameraPreviewBuffer {
+    uint8_t* data = nullptr;
+    size_t capacity = 0;
+};
+
 class Esp32Camera : public Camera {
 private:
-    camera_fb_t* fb_ = nullptr;
     std::string explain_url_;
     std::string explain_token_;
     std::thread encoder_thread_;
 
+    // Frame used by Explain(), set by Capture()
+    std::shared_ptr<CameraFrame> frame_;
+
+    std::mutex ring_mutex_;
+    std::condition_variable ring_cv_;
+    std::array<std::shared_ptr<CameraFrame>, CAMERA_RING_SLOTS> ring_;
+    int latest_slot_ = -1;
+    std::atomic<bool> streaming_ = false;
+    std::thread stream_thread_;
+
+    std::array<std::shared_ptr<CameraPreviewBuffer>, CAMERA_PREVIEW_BUFFERS> previews_;
+
+    void StreamLoop();
+    std::shared_ptr<CameraFrame> StoreFrame(const camera_fb_t* fb);
+    std::shared_ptr<CameraFrame> GetLatestFrame(int timeout_ms);
+    void ShowPreview(const std::shared_ptr<CameraFrame>& frame);
+
 public:
     Esp32Camera(const camera_config_t& config);
     ~Esp32Camera();
@@ -34,6 +76,11 @@ public:
     virtual bool SetVFlip(bool enabled) override;
     virtual std::string Explain(const std::string& question);
     virtual std::string ExplainFromUrl(const std::string& image_url, const std::string& image_token, const std::string& question) override;
+
+    // Keeps filling the capture ring in the background, Capture() then returns the latest frame
+    bool StartStreaming();
+    void StopStreaming();
+    bool streaming() const { return streaming_; }
 };
 
-#endif // ESP32_CAMERA_H
\ No newline at end of file
+#endif // ESP32_CAMERA_H
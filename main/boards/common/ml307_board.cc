@@ -2,6 +2,7 @@
 
 #include "application.h"
 #include "display.h"
+#include "memory_budget.h"
 #include "assets/lang_config.h"
 
 #include <esp_log.h>
@@ -131,6 +132,10 @@ std::string Ml307Board::GetDeviceStatusJson() {
      *         "type": "cellular",
      *         "carrier": "CHINA MOBILE",
      *         "csq": 10
+     *     },
+     *     "memory": {
+     *         "internal": { "free_kb": 80, "largest_free_block_kb": 40 },
+     *         "psram": { "free_kb": 6000, "largest_free_block_kb": 4000 }
      *     }
      * }
      */
@@ -189,6 +194,9 @@ std::string Ml307Board::GetDeviceStatusJson() {
     }
     cJSON_AddItemToObject(root, "network", network);
 
+    // Free heap and largest free block, internal RAM and PSRAM
+    MemoryBudget::GetInstance().AddStatusJson(root);
+
     auto json_str = cJSON_PrintUnformatted(root);
     std::string json(json_str);
     cJSON_free(json_str);
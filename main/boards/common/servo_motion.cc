@@ -0,0 +1,317 @@
+#include "servo_motion.h"
+
+#include <esp_log.h>
+
+#include <algorithm>
+#include <cmath>
+
+#define TAG "ServoMotion"
+
+#define SERVO_MOTION_IDLE_EVENT (1 << 0)
+
+// Same mapping as the board oscillators: 0.5 ms to 2.5 ms pulse in a 20 ms period with 13 bit duty.
+// The angle is Q16, so interpolated poses get the full duty resolution (about 0.22 degree per step).
+static uint32_t AngleToDuty(int32_t angle) {
+    angle = std::min(std::max(angle, 0), 180 << 16);
+    // 9 * pulse_us in Q16 = 9 * 500 + angle * 2000 / 20
+    int64_t pulse = 9LL * 500 * 65536 + (int64_t)angle * 100;
+    return (uint32_t)(pulse * 8191 / (9LL * 20000 * 65536));
+}
+
+ServoMotion ServoMotion::MoveTo(uint32_t channel_mask, const int* target, int time_ms) {
+    ServoMotion motion;
+    motion.channel_mask = channel_mask;
+    motion.duration_ms = std::max(time_ms, 0);
+    // A single constant keyframe, the blend from the current pose is the linear move
+    motion.blend_ms = motion.duration_ms;
+    motion.keyframes.resize(1);
+    auto& frame = motion.keyframes[0];
+    frame.time_ms = 0;
+    for (int i = 0; i < SERVO_MOTION_MAX_CHANNELS; i++) {
+        frame.position[i] = (channel_mask & (1 << i)) ? target[i] << 16 : 0;
+    }
+    return motion;
+}
+
+ServoMotion ServoMotion::Oscillate(uint32_t channel_mask, const int* amplitude, const int* offset,
+    int period_ms, const double* phase, float cycles) {
+    ServoMotion motion;
+    if (period_ms <= 0 || cycles <= 0) {
+        return motion;
+    }
+    motion.channel_mask = channel_mask;
+    motion.loop_ms = period_ms;
+    motion.duration_ms = std::lround(period_ms * cycles);
+    motion.blend_ms = period_ms / SERVO_MOTION_GAIT_SAMPLES;
+
+    // One period is enough, the track loops for as many cycles as requested
+    motion.keyframes.resize(SERVO_MOTION_GAIT_SAMPLES + 1);
+    for (int k = 0; k <= SERVO_MOTION_GAIT_SAMPLES; k++) {
+        auto& frame = motion.keyframes[k];
+        frame.time_ms = period_ms * k / SERVO_MOTION_GAIT_SAMPLES;
+        double angle = 2 * M_PI * frame.time_ms / period_ms;
+        for (int i = 0; i < SERVO_MOTION_MAX_CHANNELS; i++) {
+            if (channel_mask & (1 << i)) {
+                double position = 90 + offset[i] + amplitude[i] * std::sin(angle + phase[i]);
+                frame.position[i] = (int32_t)std::lround(position * 65536);
+            } else {
+                frame.position[i] = 0;
+            }
+        }
+    }
+    return motion;
+}
+
+ServoMotionEngine::ServoMotionEngine(int channel_count)
+    : channel_count_(std::min(channel_count, SERVO_MOTION_MAX_CHANNELS)) {
+    event_group_ = xEventGroupCreate();
+    xEventGroupSetBits(event_group_, SERVO_MOTION_IDLE_EVENT);
+
+    esp_timer_create_args_t timer_args = {
+        .callback = [](void* arg) {
+            auto self = static_cast<ServoMotionEngine*>(arg);
+            self->OnTick();
+        },
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "servo_motion",
+        .skip_unhandled_events = true,
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &timer_));
+}
+
+ServoMotionEngine::~ServoMotionEngine() {
+    esp_timer_stop(timer_);
+    esp_timer_delete(timer_);
+    for (int i = 0; i < channel_count_; i++) {
+        Detach(i);
+    }
+    vEventGroupDelete(event_group_);
+}
+
+void ServoMotionEngine::Attach(int channel, int pin) {
+    if (channel < 0 || channel >= channel_count_) {
+        ESP_LOGE(TAG, "Invalid servo channel: %d", channel);
+        return;
+    }
+    Detach(channel);
+
+    ledc_timer_config_t ledc_timer = {
+        .speed_mode = LEDC_LOW_SPEED_MODE,
+        .duty_resolution = LEDC_TIMER_13_BIT,
+        .timer_num = LEDC_TIMER_1,
+        .freq_hz = 50,
+        .clk_cfg = LEDC_AUTO_CLK,
+    };
+    ESP_ERROR_CHECK(ledc_timer_config(&ledc_timer));
+
+    ledc_channel_config_t ledc_channel = {
+        .gpio_num = pin,
+        .speed_mode = LEDC_LOW_SPEED_MODE,
+        .channel = (ledc_channel_t)(LEDC_CHANNEL_1 + channel),
+        .intr_type = LEDC_INTR_DISABLE,
+        .timer_sel = LEDC_TIMER_1,
+        .duty = 0,
+        .hpoint = 0,
+    };
+    ESP_ERROR_CHECK(ledc_channel_config(&ledc_channel));
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    // The servo stays unpowered until the next pose is written
+    channels_[channel].attached = true;
+    channels_[channel].duty = 0;
+}
+
+void ServoMotionEngine::Detach(int channel) {
+    if (channel < 0 || channel >= channel_count_) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!channels_[channel].attached) {
+        return;
+    }
+    ESP_ERROR_CHECK(ledc_stop(LEDC_LOW_SPEED_MODE, (ledc_channel_t)(LEDC_CHANNEL_1 + channel), 0));
+    channels_[channel].attached = false;
+}
+
+void ServoMotionEngine::SetTrim(int channel, int trim) {
+    if (channel >= 0 && channel < channel_count_) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        channels_[channel].trim = trim;
+    }
+}
+
+void ServoMotionEngine::SetSpeedLimit(int channel, int degree_per_second) {
+    if (channel >= 0 && channel < channel_count_) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        channels_[channel].speed_limit = std::max(degree_per_second, 0) << 16;
+    }
+}
+
+void ServoMotionEngine::Queue(ServoMotion&& motion) {
+    if (motion.keyframes.empty()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    xEventGroupClearBits(event_group_, SERVO_MOTION_IDLE_EVENT);
+    queue_.push_back(std::move(motion));
+    StartTimer();
+}
+
+void ServoMotionEngine::Cancel() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_.clear();
+    current_ = ServoMotion();
+    playing_ = false;
+    for (int i = 0; i < channel_count_; i++) {
+        channels_[i].target = channels_[i].output;
+    }
+    // The timer stops itself on the next tick
+    xEventGroupSetBits(event_group_, SERVO_MOTION_IDLE_EVENT);
+}
+
+void ServoMotionEngine::SetPosition(int channel, int position) {
+    if (channel < 0 || channel >= channel_count_) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    channels_[channel].target = position << 16;
+    xEventGroupClearBits(event_group_, SERVO_MOTION_IDLE_EVENT);
+    StartTimer();
+}
+
+bool ServoMotionEngine::WaitUntilIdle(TickType_t timeout) {
+    auto bits = xEventGroupWaitBits(event_group_, SERVO_MOTION_IDLE_EVENT, pdFALSE, pdTRUE, timeout);
+    return (bits & SERVO_MOTION_IDLE_EVENT) != 0;
+}
+
+bool ServoMotionEngine::IsIdle() const {
+    return (xEventGroupGetBits(event_group_) & SERVO_MOTION_IDLE_EVENT) != 0;
+}
+
+int ServoMotionEngine::GetPosition(int channel) {
+    if (channel < 0 || channel >= channel_count_) {
+        return 90;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    return (channels_[channel].output + 0x8000) >> 16;
+}
+
+void ServoMotionEngine::StartTimer() {
+    if (!timer_running_) {
+        last_tick_time_ = esp_timer_get_time();
+        ESP_ERROR_CHECK(esp_timer_start_periodic(timer_, SERVO_MOTION_TICK_US));
+        timer_running_ = true;
+    }
+}
+
+void ServoMotionEngine::OnTick() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    int64_t now = esp_timer_get_time();
+    int64_t next_start = now;
+
+    while (true) {
+        if (!playing_) {
+            if (queue_.empty()) {
+                break;
+            }
+            current_ = std::move(queue_.front());
+            queue_.pop_front();
+            Begin(next_start);
+        }
+        int64_t elapsed = now - start_time_;
+        int64_t duration = current_.duration_ms * 1000LL;
+        if (elapsed < duration) {
+            Sample(elapsed);
+            break;
+        }
+        // Land exactly on the final pose, the next motion starts where this one ended
+        // rather than at this tick, so back to back motions keep their timing
+        Sample(duration);
+        playing_ = false;
+        next_start = start_time_ + duration;
+    }
+
+    WriteOutputs(now);
+}
+
+void ServoMotionEngine::Begin(int64_t start_time) {
+    playing_ = true;
+    start_time_ = start_time;
+    cursor_ = 0;
+    for (int i = 0; i < channel_count_; i++) {
+        channels_[i].blend_from = channels_[i].target;
+    }
+}
+
+void ServoMotionEngine::Sample(int64_t elapsed_us) {
+    const auto& frames = current_.keyframes;
+    int64_t time_us = elapsed_us;
+    if (current_.loop_ms > 0) {
+        time_us %= current_.loop_ms * 1000LL;
+    }
+
+    // The cursor only moves forward, except when the loop wraps around
+    if (cursor_ >= frames.size() || time_us < frames[cursor_].time_ms * 1000LL) {
+        cursor_ = 0;
+    }
+    while (cursor_ + 1 < frames.size() && time_us >= frames[cursor_ + 1].time_ms * 1000LL) {
+        cursor_++;
+    }
+    const auto& from = frames[cursor_];
+    const ServoKeyframe* to = cursor_ + 1 < frames.size() ? &frames[cursor_ + 1] : nullptr;
+    int64_t span = to != nullptr ? (to->time_ms - from.time_ms) * 1000LL : 0;
+    int64_t offset = time_us - from.time_ms * 1000LL;
+    int64_t blend_us = current_.blend_ms * 1000LL;
+
+    for (int i = 0; i < channel_count_; i++) {
+        if (!(current_.channel_mask & (1 << i))) {
+            continue;
+        }
+        int32_t position = from.position[i];
+        if (span > 0) {
+            position += (int64_t)(to->position[i] - from.position[i]) * offset / span;
+        }
+        if (elapsed_us < blend_us) {
+            position += (int64_t)(channels_[i].blend_from - frames[0].position[i]) * (blend_us - elapsed_us) / blend_us;
+        }
+        channels_[i].target = position;
+    }
+}
+
+void ServoMotionEngine::WriteOutputs(int64_t now) {
+    // Bound the step after a late tick so the limiter cannot be bypassed
+    int64_t delta_us = std::min(now - last_tick_time_, (int64_t)SERVO_MOTION_TICK_US * 2);
+    last_tick_time_ = now;
+
+    bool settled = true;
+    for (int i = 0; i < channel_count_; i++) {
+        auto& channel = channels_[i];
+        int32_t output = channel.target;
+        if (channel.speed_limit > 0) {
+            int32_t max_step = std::max<int64_t>(channel.speed_limit * delta_us / 1000000, 1);
+            output = std::min(std::max(output, channel.output - max_step), channel.output + max_step);
+        }
+        channel.output = output;
+        if (output != channel.target) {
+            settled = false;
+        }
+
+        if (!channel.attached) {
+            continue;
+        }
+        uint32_t duty = AngleToDuty(output + (channel.trim << 16));
+        if (duty != channel.duty) {
+            auto ledc_channel = (ledc_channel_t)(LEDC_CHANNEL_1 + i);
+            ledc_set_duty(LEDC_LOW_SPEED_MODE, ledc_channel, duty);
+            ledc_update_duty(LEDC_LOW_SPEED_MODE, ledc_channel);
+            channel.duty = duty;
+        }
+    }
+
+    if (!playing_ && queue_.empty() && settled) {
+        esp_timer_stop(timer_);
+        timer_running_ = false;
+        xEventGroupSetBits(event_group_, SERVO_MOTION_IDLE_EVENT);
+    }
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <cstdint>
+#include <cmath>
+
+#include <driver/ledc.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
+
+// Servos use LEDC_CHANNEL_1..7 on LEDC_TIMER_1, channel 0 and timer 0 are left to the backlight
+#define SERVO_MOTION_MAX_CHANNELS 7
+#define SERVO_MOTION_TICK_US 10000
+// Keyframes per oscillation period, linear interpolation of 32 samples stays within 0.5% of the sine
+#define SERVO_MOTION_GAIT_SAMPLES 32
+
+#ifndef DEG2RAD
+#define DEG2RAD(g) ((g) * M_PI) / 180
+#endif
+
+/*
+ * Keyframe trajectory for a group of servos.
+ *
+ * Positions are Q16 degrees before trim. The track is interpolated linearly
+ * between keyframes and repeats every loop_ms when loop_ms is not zero.
+ * A motion always starts from the pose the servos are in when it begins, the
+ * difference to the first point of the track fades out over blend_ms, so
+ * queued motions, gaits and cancellations never jump.
+ */
+struct ServoKeyframe {
+    uint32_t time_ms;                               // Offset from the start of the loop
+    int32_t position[SERVO_MOTION_MAX_CHANNELS];
+};
+
+struct ServoMotion {
+    std::vector<ServoKeyframe> keyframes;
+    uint32_t loop_ms = 0;
+    uint32_t duration_ms = 0;       // May end in the middle of a loop
+    uint32_t blend_ms = 0;
+    uint32_t channel_mask = 0;      // Channels driven by the motion, the others hold their pose
+
+    // Move the masked channels to target (degrees) in time_ms
+    static ServoMotion MoveTo(uint32_t channel_mask, const int* target, int time_ms);
+    // 90 + offset + amplitude * sin(2 * pi * t / period + phase) for the given number of cycles
+    static ServoMotion Oscillate(uint32_t channel_mask, const int* amplitude, const int* offset,
+        int period_ms, const double* phase, float cycles);
+};
+
+/*
+ * Plays queued motions from a periodic esp_timer, the callers only block if they
+ * wait for the engine to become idle. The timer runs only while servos move.
+ */
+class ServoMotionEngine {
+public:
+    explicit ServoMotionEngine(int channel_count);
+    ~ServoMotionEngine();
+
+    void Attach(int channel, int pin);
+    void Detach(int channel);
+    void SetTrim(int channel, int trim);
+    // Limit the servo speed in degrees per second, 0 disables the limiter
+    void SetSpeedLimit(int channel, int degree_per_second);
+
+    // Appends a motion, it starts when the previous one ends
+    void Queue(ServoMotion&& motion);
+    // Drops the running and queued motions, the servos hold their current pose
+    void Cancel();
+    // Moves one channel without waiting for the queue
+    void SetPosition(int channel, int position);
+    bool WaitUntilIdle(TickType_t timeout = portMAX_DELAY);
+
+    bool IsIdle() const;
+    int GetPosition(int channel);
+
+private:
+    struct Channel {
+        bool attached = false;
+        int trim = 0;
+        int32_t speed_limit = 0;     // Q16 degrees per second
+        int32_t target = 90 << 16;   // Pose requested by the motion
+        int32_t output = 90 << 16;   // Pose sent to the servo after the limiter
+        int32_t blend_from = 90 << 16;
+        uint32_t duty = 0;
+    };
+
+    int channel_count_;
+    Channel channels_[SERVO_MOTION_MAX_CHANNELS];
+    std::mutex mutex_;
+    esp_timer_handle_t timer_ = nullptr;
+    EventGroupHandle_t event_group_ = nullptr;
+    bool timer_running_ = false;
+
+    std::deque<ServoMotion> queue_;
+    ServoMotion current_;
+    bool playing_ = false;
+    int64_t start_time_ = 0;
+    int64_t last_tick_time_ = 0;
+    size_t cursor_ = 0;
+
+    void OnTick();
+    void Begin(int64_t start_time);
+    void Sample(int64_t elapsed_us);
+    void WriteOutputs(int64_t now);
+    void StartTimer();
+};
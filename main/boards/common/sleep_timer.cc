@@ -118,6 +118,8 @@ void SleepTimer::CheckTimer() {
             on_enter_deep_sleep_mode_();
         }
 
+        // 深度睡眠不会执行 esp_restart 的 shutdown handler，先把缓存的设置写入 NVS
+        Settings::Flush();
         esp_deep_sleep_start();
     }
 }
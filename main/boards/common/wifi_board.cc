@@ -4,6 +4,7 @@
 #include "application.h"
 #include "system_info.h"
 #include "settings.h"
+#include "memory_budget.h"
 #include "assets/lang_config.h"
 
 #include <freertos/FreeRTOS.h>
@@ -195,6 +196,10 @@ std::string WifiBoard::GetDeviceStatusJson() {
      *         "ssid": "Xiaozhi",
      *         "rssi": -60
      *     },
+     *     "memory": {
+     *         "internal": { "free_kb": 80, "largest_free_block_kb": 40 },
+     *         "psram": { "free_kb": 6000, "largest_free_block_kb": 4000 }
+     *     },
      *     "chip": {
      *         "temperature": 25
      *     }
@@ -252,6 +257,9 @@ std::string WifiBoard::GetDeviceStatusJson() {
     }
     cJSON_AddItemToObject(root, "network", network);
 
+    // Free heap and largest free block, internal RAM and PSRAM
+    MemoryBudget::GetInstance().AddStatusJson(root);
+
     // Chip
     float esp32temp = 0.0f;
     if (board.GetTemperature(esp32temp)) {
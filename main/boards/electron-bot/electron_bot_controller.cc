@@ -5,7 +5,9 @@
 #include <cJSON.h>
 #include <esp_log.h>
 
+#include <atomic>
 #include <cstring>
+#include <mutex>
 
 #include "application.h"
 #include "board.h"
@@ -23,6 +25,7 @@ struct ElectronBotActionParams {
     int speed;
     int direction;
     int amount;
+    uint32_t generation;
 };
 
 class ElectronBotController {
@@ -31,6 +34,11 @@ private:
     TaskHandle_t action_task_handle_ = nullptr;
     QueueHandle_t action_queue_;
     bool is_action_in_progress_ = false;
+    // 停止时加一，之前排队或已取出的动作作废；任务不被删除，由它自己结束当前动作
+    std::mutex stop_mutex_;
+    uint32_t stop_generation_ = 0;
+    std::atomic<bool> exiting_{false};
+    std::atomic<bool> task_exited_{false};
 
     enum ActionType {
         // 手部动作 1-12
@@ -68,8 +76,15 @@ private:
         ElectronBotActionParams params;
         controller->electron_bot_.AttachServos();
 
-        while (true) {
+        while (!controller->exiting_) {
             if (xQueueReceive(controller->action_queue_, &params, pdMS_TO_TICKS(1000)) == pdTRUE) {
+                {
+                    std::lock_guard<std::mutex> lock(controller->stop_mutex_);
+                    if (params.generation != controller->stop_generation_) {
+                        continue;  // 停止前取出的动作
+                    }
+                    controller->electron_bot_.ResumeMotion();
+                }
                 ESP_LOGI(TAG, "执行动作: %d", params.action_type);
                 controller->is_action_in_progress_ = true;  // 开始执行动作
 
@@ -99,17 +114,31 @@ private:
             }
             vTaskDelay(pdMS_TO_TICKS(20));
         }
+        controller->task_exited_ = true;
+        vTaskDelete(nullptr);
     }
 
     void QueueAction(int action_type, int steps, int speed, int direction, int amount) {
         ESP_LOGI(TAG, "动作控制: 类型=%d, 步数=%d, 速度=%d, 方向=%d, 幅度=%d", action_type, steps,
                  speed, direction, amount);
 
-        ElectronBotActionParams params = {action_type, steps, speed, direction, amount};
+        ElectronBotActionParams params = {action_type, steps, speed, direction, amount, 0};
+        {
+            std::lock_guard<std::mutex> lock(stop_mutex_);
+            params.generation = stop_generation_;
+        }
         xQueueSend(action_queue_, &params, portMAX_DELAY);
         StartActionTaskIfNeeded();
     }
 
+    void StopActions() {
+        std::lock_guard<std::mutex> lock(stop_mutex_);
+        stop_generation_++;
+        xQueueReset(action_queue_);
+        electron_bot_.StopMotion();
+        is_action_in_progress_ = false;
+    }
+
     void StartActionTaskIfNeeded() {
         if (action_task_handle_ == nullptr) {
             xTaskCreate(ActionTask, "electron_bot_action", 1024 * 4, this, configMAX_PRIORITIES - 1,
@@ -249,9 +278,8 @@ public:
         // 系统工具
         mcp_server.AddTool("self.electron.stop", "立即停止", PropertyList(),
                            [this](const PropertyList& properties) -> ReturnValue {
-                               // 清空队列但保持任务常驻
-                               xQueueReset(action_queue_);
-                               is_action_in_progress_ = false;
+                               // 清空队列但保持任务常驻，并取消正在执行的动作
+                               StopActions();
                                QueueAction(ACTION_HOME, 1, 1000, 0, 0);
                                return true;
                            });
@@ -358,9 +386,10 @@ public:
     }
 
     ~ElectronBotController() {
-        if (action_task_handle_ != nullptr) {
-            vTaskDelete(action_task_handle_);
-            action_task_handle_ = nullptr;
+        exiting_ = true;
+        StopActions();
+        while (action_task_handle_ != nullptr && !task_exited_) {
+            vTaskDelay(pdMS_TO_TICKS(10));
         }
         vQueueDelete(action_queue_);
     }
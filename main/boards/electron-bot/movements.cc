@@ -3,9 +3,7 @@
 #include <algorithm>
 #include <cstring>
 
-#include "oscillator.h"
-
-Otto::Otto() {
+Otto::Otto() : motion_(SERVO_COUNT) {
     is_otto_resting_ = false;
     for (int i = 0; i < SERVO_COUNT; i++) {
         servo_pins_[i] = -1;
@@ -17,10 +15,6 @@ Otto::~Otto() {
     DetachServos();
 }
 
-unsigned long IRAM_ATTR millis() {
-    return (unsigned long)(esp_timer_get_time() / 1000ULL);
-}
-
 void Otto::Init(int right_pitch, int right_roll, int left_pitch, int left_roll, int body,
                 int head) {
     servo_pins_[RIGHT_PITCH] = right_pitch;
@@ -40,7 +34,7 @@ void Otto::Init(int right_pitch, int right_roll, int left_pitch, int left_roll,
 void Otto::AttachServos() {
     for (int i = 0; i < SERVO_COUNT; i++) {
         if (servo_pins_[i] != -1) {
-            servo_[i].Attach(servo_pins_[i]);
+            motion_.Attach(i, servo_pins_[i]);
         }
     }
 }
@@ -48,7 +42,7 @@ void Otto::AttachServos() {
 void Otto::DetachServos() {
     for (int i = 0; i < SERVO_COUNT; i++) {
         if (servo_pins_[i] != -1) {
-            servo_[i].Detach();
+            motion_.Detach(i);
         }
     }
 }
@@ -67,7 +61,7 @@ void Otto::SetTrims(int right_pitch, int right_roll, int left_pitch, int left_ro
 
     for (int i = 0; i < SERVO_COUNT; i++) {
         if (servo_pins_[i] != -1) {
-            servo_[i].SetTrim(servo_trim_[i]);
+            motion_.SetTrim(i, servo_trim_[i]);
         }
     }
 }
@@ -75,58 +69,27 @@ void Otto::SetTrims(int right_pitch, int right_roll, int left_pitch, int left_ro
 ///////////////////////////////////////////////////////////////////
 //-- BASIC MOTION FUNCTIONS -------------------------------------//
 ///////////////////////////////////////////////////////////////////
+uint32_t Otto::ServoMask() {
+    uint32_t mask = 0;
+    for (int i = 0; i < SERVO_COUNT; i++) {
+        if (servo_pins_[i] != -1) {
+            mask |= 1 << i;
+        }
+    }
+    return mask;
+}
+
 void Otto::MoveServos(int time, int servo_target[]) {
+    if (stop_requested_) {
+        return;
+    }
     if (GetRestState() == true) {
         SetRestState(false);
     }
 
-    final_time_ = millis() + time;
-    if (time > 10) {
-        for (int i = 0; i < SERVO_COUNT; i++) {
-            if (servo_pins_[i] != -1) {
-                increment_[i] = (servo_target[i] - servo_[i].GetPosition()) / (time / 10.0);
-            }
-        }
-
-        for (int iteration = 1; millis() < final_time_; iteration++) {
-            partial_time_ = millis() + 10;
-            for (int i = 0; i < SERVO_COUNT; i++) {
-                if (servo_pins_[i] != -1) {
-                    servo_[i].SetPosition(servo_[i].GetPosition() + increment_[i]);
-                }
-            }
-            vTaskDelay(pdMS_TO_TICKS(10));
-        }
-    } else {
-        for (int i = 0; i < SERVO_COUNT; i++) {
-            if (servo_pins_[i] != -1) {
-                servo_[i].SetPosition(servo_target[i]);
-            }
-        }
-        vTaskDelay(pdMS_TO_TICKS(time));
-    }
-
-    // final adjustment to the target.
-    bool f = true;
-    int adjustment_count = 0;
-    while (f && adjustment_count < 10) {
-        f = false;
-        for (int i = 0; i < SERVO_COUNT; i++) {
-            if (servo_pins_[i] != -1 && servo_target[i] != servo_[i].GetPosition()) {
-                f = true;
-                break;
-            }
-        }
-        if (f) {
-            for (int i = 0; i < SERVO_COUNT; i++) {
-                if (servo_pins_[i] != -1) {
-                    servo_[i].SetPosition(servo_target[i]);
-                }
-            }
-            vTaskDelay(pdMS_TO_TICKS(10));
-            adjustment_count++;
-        }
-    };
+    // The motion engine interpolates on its own timer, this task only waits for the move to end
+    motion_.Queue(ServoMotion::MoveTo(ServoMask(), servo_target, time));
+    motion_.WaitUntilIdle();
 }
 
 void Otto::MoveSingle(int position, int servo_number) {
@@ -139,34 +102,21 @@ void Otto::MoveSingle(int position, int servo_number) {
         SetRestState(false);
     }
 
+    if (stop_requested_) {
+        return;
+    }
     if (servo_number >= 0 && servo_number < SERVO_COUNT && servo_pins_[servo_number] != -1) {
-        servo_[servo_number].SetPosition(position);
+        motion_.SetPosition(servo_number, position);
     }
 }
 
 void Otto::OscillateServos(int amplitude[SERVO_COUNT], int offset[SERVO_COUNT], int period,
                            double phase_diff[SERVO_COUNT], float cycle = 1) {
-    for (int i = 0; i < SERVO_COUNT; i++) {
-        if (servo_pins_[i] != -1) {
-            servo_[i].SetO(offset[i]);
-            servo_[i].SetA(amplitude[i]);
-            servo_[i].SetT(period);
-            servo_[i].SetPh(phase_diff[i]);
-        }
-    }
-
-    double ref = millis();
-    double end_time = period * cycle + ref;
-
-    while (millis() < end_time) {
-        for (int i = 0; i < SERVO_COUNT; i++) {
-            if (servo_pins_[i] != -1) {
-                servo_[i].Refresh();
-            }
-        }
-        vTaskDelay(5);
+    if (stop_requested_) {
+        return;
     }
-    vTaskDelay(pdMS_TO_TICKS(10));
+    motion_.Queue(ServoMotion::Oscillate(ServoMask(), amplitude, offset, period, phase_diff, cycle));
+    motion_.WaitUntilIdle();
 }
 
 void Otto::Execute(int amplitude[SERVO_COUNT], int offset[SERVO_COUNT], int period,
@@ -175,16 +125,17 @@ void Otto::Execute(int amplitude[SERVO_COUNT], int offset[SERVO_COUNT], int peri
         SetRestState(false);
     }
 
-    int cycles = (int)steps;
+    //-- Complete and partial cycles play as one looped track, without a stop between cycles
+    OscillateServos(amplitude, offset, period, phase_diff, steps);
+}
 
-    //-- Execute complete cycles
-    if (cycles >= 1)
-        for (int i = 0; i < cycles; i++)
-            OscillateServos(amplitude, offset, period, phase_diff);
+void Otto::StopMotion() {
+    stop_requested_ = true;
+    motion_.Cancel();
+}
 
-    //-- Execute the final not complete cycle
-    OscillateServos(amplitude, offset, period, phase_diff, (float)steps - cycles);
-    vTaskDelay(pdMS_TO_TICKS(10));
+void Otto::ResumeMotion() {
+    stop_requested_ = false;
 }
 
 ///////////////////////////////////////////////////////////////////
@@ -193,7 +144,8 @@ void Otto::Execute(int amplitude[SERVO_COUNT], int offset[SERVO_COUNT], int peri
 void Otto::Home(bool hands_down) {
     if (is_otto_resting_ == false) {  // Go to rest position only if necessary
         MoveServos(1000, servo_initial_);
-        is_otto_resting_ = true;
+        // A stopped move did not get there
+        is_otto_resting_ = !stop_requested_;
     }
 
     vTaskDelay(pdMS_TO_TICKS(1000));
@@ -228,7 +180,7 @@ void Otto::HandAction(int action, int times, int amount, int period) {
 
     int current_positions[SERVO_COUNT];
     for (int i = 0; i < SERVO_COUNT; i++) {
-        current_positions[i] = (servo_pins_[i] != -1) ? servo_[i].GetPosition() : servo_initial_[i];
+        current_positions[i] = (servo_pins_[i] != -1) ? motion_.GetPosition(i) : servo_initial_[i];
     }
 
     switch (action) {
@@ -356,7 +308,7 @@ void Otto::BodyAction(int action, int times, int amount, int period) {
     int current_positions[SERVO_COUNT];
     for (int i = 0; i < SERVO_COUNT; i++) {
         if (servo_pins_[i] != -1) {
-            current_positions[i] = servo_[i].GetPosition();
+            current_positions[i] = motion_.GetPosition(i);
         } else {
             current_positions[i] = servo_initial_[i];
         }
@@ -403,7 +355,7 @@ void Otto::HeadAction(int action, int times, int amount, int period) {
     int current_positions[SERVO_COUNT];
     for (int i = 0; i < SERVO_COUNT; i++) {
         if (servo_pins_[i] != -1) {
-            current_positions[i] = servo_[i].GetPosition();
+            current_positions[i] = motion_.GetPosition(i);
         } else {
             current_positions[i] = servo_initial_[i];
         }
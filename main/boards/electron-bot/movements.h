@@ -6,7 +6,9 @@
 #include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "oscillator.h"
+#include "servo_motion.h"
+
+#include <atomic>
 
 //-- Constants
 #define FORWARD 1
@@ -51,6 +53,11 @@ public:
     void OscillateServos(int amplitude[SERVO_COUNT], int offset[SERVO_COUNT], int period,
                          double phase_diff[SERVO_COUNT], float cycle);
 
+    //-- Cancel the running and queued motions, the servos hold their pose. Later
+    //-- moves are skipped until ResumeMotion(), so a sequence in progress runs out
+    void StopMotion();
+    void ResumeMotion();
+
     //-- HOME = Otto at rest position
     void Home(bool hands_down = true);
     bool GetRestState();
@@ -70,18 +77,16 @@ public:
     // action: 1=抬头, 2=低头, 3=点头, 4=回中心, 5=连续点头
 
 private:
-    Oscillator servo_[SERVO_COUNT];
+    ServoMotionEngine motion_;
 
     int servo_pins_[SERVO_COUNT];
     int servo_trim_[SERVO_COUNT];
     int servo_initial_[SERVO_COUNT] = {180, 180, 0, 0, 90, 90};
 
-    unsigned long final_time_;
-    unsigned long partial_time_;
-    float increment_[SERVO_COUNT];
-
     bool is_otto_resting_;
+    std::atomic<bool> stop_requested_{false};
 
+    uint32_t ServoMask();
     void Execute(int amplitude[SERVO_COUNT], int offset[SERVO_COUNT], int period,
                  double phase_diff[SERVO_COUNT], float steps);
 };
@@ -2,6 +2,7 @@
 #include "codecs/es8311_audio_codec.h"
 #include "display/lcd_display.h"
 #include "application.h"
+#include "settings.h"
 #include "button.h"
 #include "config.h"
 #include "i2c_device.h"
@@ -106,6 +107,7 @@ private:
                 ESP_ERROR_CHECK(esp_sleep_enable_ext0_wakeup(PWR_BUTTON_GPIO, 0));
                 ESP_ERROR_CHECK(rtc_gpio_pullup_en(PWR_BUTTON_GPIO));  // 内部上拉
                 ESP_ERROR_CHECK(rtc_gpio_pulldown_dis(PWR_BUTTON_GPIO));
+                Settings::Flush();  // 不经过 PowerSaveTimer，自行写入缓存的设置
                 esp_deep_sleep_start();
             }
         }
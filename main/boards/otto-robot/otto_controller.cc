@@ -5,7 +5,9 @@
 #include <cJSON.h>
 #include <esp_log.h>
 
+#include <atomic>
 #include <cstring>
+#include <mutex>
 
 #include "application.h"
 #include "board.h"
@@ -24,6 +26,11 @@ private:
     QueueHandle_t action_queue_;
     bool has_hands_ = false;
     bool is_action_in_progress_ = false;
+    // 停止时加一，之前排队或已取出的动作作废；任务不被删除，由它自己结束当前动作
+    std::mutex stop_mutex_;
+    uint32_t stop_generation_ = 0;
+    std::atomic<bool> exiting_{false};
+    std::atomic<bool> task_exited_{false};
 
     struct OttoActionParams {
         int action_type;
@@ -31,6 +38,7 @@ private:
         int speed;
         int direction;
         int amount;
+        uint32_t generation;
     };
 
     enum ActionType {
@@ -58,8 +66,15 @@ private:
         OttoActionParams params;
         controller->otto_.AttachServos();
 
-        while (true) {
+        while (!controller->exiting_) {
             if (xQueueReceive(controller->action_queue_, &params, pdMS_TO_TICKS(1000)) == pdTRUE) {
+                {
+                    std::lock_guard<std::mutex> lock(controller->stop_mutex_);
+                    if (params.generation != controller->stop_generation_) {
+                        continue;  // 停止前取出的动作
+                    }
+                    controller->otto_.ResumeMotion();
+                }
                 ESP_LOGI(TAG, "执行动作: %d", params.action_type);
                 controller->is_action_in_progress_ = true;
 
@@ -134,6 +149,8 @@ private:
                 vTaskDelay(pdMS_TO_TICKS(20));
             }
         }
+        controller->task_exited_ = true;
+        vTaskDelete(nullptr);
     }
 
     void StartActionTaskIfNeeded() {
@@ -153,11 +170,23 @@ private:
         ESP_LOGI(TAG, "动作控制: 类型=%d, 步数=%d, 速度=%d, 方向=%d, 幅度=%d", action_type, steps,
                  speed, direction, amount);
 
-        OttoActionParams params = {action_type, steps, speed, direction, amount};
+        OttoActionParams params = {action_type, steps, speed, direction, amount, 0};
+        {
+            std::lock_guard<std::mutex> lock(stop_mutex_);
+            params.generation = stop_generation_;
+        }
         xQueueSend(action_queue_, &params, portMAX_DELAY);
         StartActionTaskIfNeeded();
     }
 
+    void StopActions() {
+        std::lock_guard<std::mutex> lock(stop_mutex_);
+        stop_generation_++;
+        xQueueReset(action_queue_);
+        otto_.StopMotion();
+        is_action_in_progress_ = false;
+    }
+
     void LoadTrimsFromNVS() {
         Settings settings("otto_trims", false);
 
@@ -358,12 +387,8 @@ public:
         // 系统工具
         mcp_server.AddTool("self.otto.stop", "立即停止", PropertyList(),
                            [this](const PropertyList& properties) -> ReturnValue {
-                               if (action_task_handle_ != nullptr) {
-                                   vTaskDelete(action_task_handle_);
-                                   action_task_handle_ = nullptr;
-                               }
-                               is_action_in_progress_ = false;
-                               xQueueReset(action_queue_);
+                               // 不删除任务（它可能正持有舵机引擎的锁），取消动作后让它自己跑完
+                               StopActions();
 
                                QueueAction(ACTION_HOME, 1, 1000, 1, 0);
                                return true;
@@ -475,9 +500,10 @@ public:
     }
 
     ~OttoController() {
-        if (action_task_handle_ != nullptr) {
-            vTaskDelete(action_task_handle_);
-            action_task_handle_ = nullptr;
+        exiting_ = true;
+        StopActions();
+        while (action_task_handle_ != nullptr && !task_exited_) {
+            vTaskDelay(pdMS_TO_TICKS(10));
         }
         vQueueDelete(action_queue_);
     }
@@ -2,13 +2,11 @@
 
 #include <algorithm>
 
-#include "oscillator.h"
-
 static const char* TAG = "OttoMovements";
 
 #define HAND_HOME_POSITION 45
 
-Otto::Otto() {
+Otto::Otto() : motion_(SERVO_COUNT) {
     is_otto_resting_ = false;
     has_hands_ = false;
     // 初始化所有舵机管脚为-1（未连接）
@@ -22,10 +20,6 @@ Otto::~Otto() {
     DetachServos();
 }
 
-unsigned long IRAM_ATTR millis() {
-    return (unsigned long)(esp_timer_get_time() / 1000ULL);
-}
-
 void Otto::Init(int left_leg, int right_leg, int left_foot, int right_foot, int left_hand,
                 int right_hand) {
     servo_pins_[LEFT_LEG] = left_leg;
@@ -48,7 +42,7 @@ void Otto::Init(int left_leg, int right_leg, int left_foot, int right_foot, int
 void Otto::AttachServos() {
     for (int i = 0; i < SERVO_COUNT; i++) {
         if (servo_pins_[i] != -1) {
-            servo_[i].Attach(servo_pins_[i]);
+            motion_.Attach(i, servo_pins_[i]);
         }
     }
 }
@@ -56,7 +50,7 @@ void Otto::AttachServos() {
 void Otto::DetachServos() {
     for (int i = 0; i < SERVO_COUNT; i++) {
         if (servo_pins_[i] != -1) {
-            servo_[i].Detach();
+            motion_.Detach(i);
         }
     }
 }
@@ -78,7 +72,7 @@ void Otto::SetTrims(int left_leg, int right_leg, int left_foot, int right_foot,
 
     for (int i = 0; i < SERVO_COUNT; i++) {
         if (servo_pins_[i] != -1) {
-            servo_[i].SetTrim(servo_trim_[i]);
+            motion_.SetTrim(i, servo_trim_[i]);
         }
     }
 }
@@ -86,58 +80,27 @@ void Otto::SetTrims(int left_leg, int right_leg, int left_foot, int right_foot,
 ///////////////////////////////////////////////////////////////////
 //-- BASIC MOTION FUNCTIONS -------------------------------------//
 ///////////////////////////////////////////////////////////////////
+uint32_t Otto::ServoMask() {
+    uint32_t mask = 0;
+    for (int i = 0; i < SERVO_COUNT; i++) {
+        if (servo_pins_[i] != -1) {
+            mask |= 1 << i;
+        }
+    }
+    return mask;
+}
+
 void Otto::MoveServos(int time, int servo_target[]) {
+    if (stop_requested_) {
+        return;
+    }
     if (GetRestState() == true) {
         SetRestState(false);
     }
 
-    final_time_ = millis() + time;
-    if (time > 10) {
-        for (int i = 0; i < SERVO_COUNT; i++) {
-            if (servo_pins_[i] != -1) {
-                increment_[i] = (servo_target[i] - servo_[i].GetPosition()) / (time / 10.0);
-            }
-        }
-
-        for (int iteration = 1; millis() < final_time_; iteration++) {
-            partial_time_ = millis() + 10;
-            for (int i = 0; i < SERVO_COUNT; i++) {
-                if (servo_pins_[i] != -1) {
-                    servo_[i].SetPosition(servo_[i].GetPosition() + increment_[i]);
-                }
-            }
-            vTaskDelay(pdMS_TO_TICKS(10));
-        }
-    } else {
-        for (int i = 0; i < SERVO_COUNT; i++) {
-            if (servo_pins_[i] != -1) {
-                servo_[i].SetPosition(servo_target[i]);
-            }
-        }
-        vTaskDelay(pdMS_TO_TICKS(time));
-    }
-
-    // final adjustment to the target.
-    bool f = true;
-    int adjustment_count = 0;
-    while (f && adjustment_count < 10) {
-        f = false;
-        for (int i = 0; i < SERVO_COUNT; i++) {
-            if (servo_pins_[i] != -1 && servo_target[i] != servo_[i].GetPosition()) {
-                f = true;
-                break;
-            }
-        }
-        if (f) {
-            for (int i = 0; i < SERVO_COUNT; i++) {
-                if (servo_pins_[i] != -1) {
-                    servo_[i].SetPosition(servo_target[i]);
-                }
-            }
-            vTaskDelay(pdMS_TO_TICKS(10));
-            adjustment_count++;
-        }
-    };
+    // The motion engine interpolates on its own timer, this task only waits for the move to end
+    motion_.Queue(ServoMotion::MoveTo(ServoMask(), servo_target, time));
+    motion_.WaitUntilIdle();
 }
 
 void Otto::MoveSingle(int position, int servo_number) {
@@ -150,34 +113,21 @@ void Otto::MoveSingle(int position, int servo_number) {
         SetRestState(false);
     }
 
+    if (stop_requested_) {
+        return;
+    }
     if (servo_number >= 0 && servo_number < SERVO_COUNT && servo_pins_[servo_number] != -1) {
-        servo_[servo_number].SetPosition(position);
+        motion_.SetPosition(servo_number, position);
     }
 }
 
 void Otto::OscillateServos(int amplitude[SERVO_COUNT], int offset[SERVO_COUNT], int period,
                            double phase_diff[SERVO_COUNT], float cycle = 1) {
-    for (int i = 0; i < SERVO_COUNT; i++) {
-        if (servo_pins_[i] != -1) {
-            servo_[i].SetO(offset[i]);
-            servo_[i].SetA(amplitude[i]);
-            servo_[i].SetT(period);
-            servo_[i].SetPh(phase_diff[i]);
-        }
-    }
-
-    double ref = millis();
-    double end_time = period * cycle + ref;
-
-    while (millis() < end_time) {
-        for (int i = 0; i < SERVO_COUNT; i++) {
-            if (servo_pins_[i] != -1) {
-                servo_[i].Refresh();
-            }
-        }
-        vTaskDelay(5);
+    if (stop_requested_) {
+        return;
     }
-    vTaskDelay(pdMS_TO_TICKS(10));
+    motion_.Queue(ServoMotion::Oscillate(ServoMask(), amplitude, offset, period, phase_diff, cycle));
+    motion_.WaitUntilIdle();
 }
 
 void Otto::Execute(int amplitude[SERVO_COUNT], int offset[SERVO_COUNT], int period,
@@ -186,16 +136,17 @@ void Otto::Execute(int amplitude[SERVO_COUNT], int offset[SERVO_COUNT], int peri
         SetRestState(false);
     }
 
-    int cycles = (int)steps;
+    //-- Complete and partial cycles play as one looped track, without a stop between cycles
+    OscillateServos(amplitude, offset, period, phase_diff, steps);
+}
 
-    //-- Execute complete cycles
-    if (cycles >= 1)
-        for (int i = 0; i < cycles; i++)
-            OscillateServos(amplitude, offset, period, phase_diff);
+void Otto::StopMotion() {
+    stop_requested_ = true;
+    motion_.Cancel();
+}
 
-    //-- Execute the final not complete cycle
-    OscillateServos(amplitude, offset, period, phase_diff, (float)steps - cycles);
-    vTaskDelay(pdMS_TO_TICKS(10));
+void Otto::ResumeMotion() {
+    stop_requested_ = false;
 }
 
 ///////////////////////////////////////////////////////////////////
@@ -216,7 +167,7 @@ void Otto::Home(bool hands_down) {
                     }
                 } else {
                     // 如果不需要复位手部，保持当前位置
-                    homes[i] = servo_[i].GetPosition();
+                    homes[i] = motion_.GetPosition(i);
                 }
             } else {
                 // 腿部和脚部舵机始终复位
@@ -225,7 +176,8 @@ void Otto::Home(bool hands_down) {
         }
 
         MoveServos(500, homes);
-        is_otto_resting_ = true;
+        // A stopped move did not get there
+        is_otto_resting_ = !stop_requested_;
     }
 
     vTaskDelay(pdMS_TO_TICKS(200));
@@ -607,10 +559,10 @@ void Otto::HandsUp(int period, int dir) {
         target[RIGHT_HAND] = 10;
     } else if (dir == 1) {
         target[LEFT_HAND] = 170;
-        target[RIGHT_HAND] = servo_[RIGHT_HAND].GetPosition();
+        target[RIGHT_HAND] = motion_.GetPosition(RIGHT_HAND);
     } else if (dir == -1) {
         target[RIGHT_HAND] = 10;
-        target[LEFT_HAND] = servo_[LEFT_HAND].GetPosition();
+        target[LEFT_HAND] = motion_.GetPosition(LEFT_HAND);
     }
 
     MoveServos(period, target);
@@ -630,9 +582,9 @@ void Otto::HandsDown(int period, int dir) {
     int target[SERVO_COUNT] = {90, 90, 90, 90, HAND_HOME_POSITION, 180 - HAND_HOME_POSITION};
 
     if (dir == 1) {
-        target[RIGHT_HAND] = servo_[RIGHT_HAND].GetPosition();
+        target[RIGHT_HAND] = motion_.GetPosition(RIGHT_HAND);
     } else if (dir == -1) {
-        target[LEFT_HAND] = servo_[LEFT_HAND].GetPosition();
+        target[LEFT_HAND] = motion_.GetPosition(LEFT_HAND);
     }
 
     MoveServos(period, target);
@@ -659,7 +611,7 @@ void Otto::HandWave(int period, int dir) {
     int current_positions[SERVO_COUNT];
     for (int i = 0; i < SERVO_COUNT; i++) {
         if (servo_pins_[i] != -1) {
-            current_positions[i] = servo_[i].GetPosition();
+            current_positions[i] = motion_.GetPosition(i);
         } else {
             current_positions[i] = 90;
         }
@@ -715,7 +667,7 @@ void Otto::HandWaveBoth(int period) {
     int current_positions[SERVO_COUNT];
     for (int i = 0; i < SERVO_COUNT; i++) {
         if (servo_pins_[i] != -1) {
-            current_positions[i] = servo_[i].GetPosition();
+            current_positions[i] = motion_.GetPosition(i);
         } else {
             current_positions[i] = 90;
         }
@@ -749,7 +701,7 @@ void Otto::HandWaveBoth(int period) {
 void Otto::EnableServoLimit(int diff_limit) {
     for (int i = 0; i < SERVO_COUNT; i++) {
         if (servo_pins_[i] != -1) {
-            servo_[i].SetLimiter(diff_limit);
+            motion_.SetSpeedLimit(i, diff_limit);
         }
     }
 }
@@ -757,7 +709,7 @@ void Otto::EnableServoLimit(int diff_limit) {
 void Otto::DisableServoLimit() {
     for (int i = 0; i < SERVO_COUNT; i++) {
         if (servo_pins_[i] != -1) {
-            servo_[i].DisableLimiter();
+            motion_.SetSpeedLimit(i, 0);
         }
     }
 }
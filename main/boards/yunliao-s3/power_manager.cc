@@ -199,5 +199,7 @@ void PowerManager::Sleep() {
     ESP_ERROR_CHECK(esp_sleep_enable_ext0_wakeup(BOOT_BUTTON_PIN, 0));
     ESP_ERROR_CHECK(rtc_gpio_pulldown_dis(BOOT_BUTTON_PIN));
     ESP_ERROR_CHECK(rtc_gpio_pullup_en(BOOT_BUTTON_PIN));
+    // sleep_flag 还在设置缓存里，深度睡眠前写入 NVS
+    Settings::Flush();
     esp_deep_sleep_start();
 } 
\ No newline at end of file
@@ -1,19 +1,19 @@
 #include "audio_led_meter.h"
-#include <mutex>
 #include <cstdint>
 #include <array>
+#include <atomic>
+#include <mutex>
 #include <tuple>
 #include <cstdlib>
 #include <ctime>
-#include "led_strip.h"
 #include "esp_log.h"
 
+// 每 1000 的平均幅度点亮一颗灯珠，与改用灯效引擎之前的响应一致
+#define AUDIO_LED_METER_LEVEL_STEP 1000
 
-
-static led_strip_handle_t g_led_strip = nullptr;
-static std::mutex g_led_mutex;
-
-static int g_led_meter_enabled = 0; // 开启关闭控制，默认关闭
+static std::mutex g_mutex;
+// 每次修改配色或亮度加一，律动内核据此在下一帧重建
+static std::atomic<uint32_t> g_version{0};
 
 static int g_brightness = 100; // 亮度百分比
 
@@ -23,6 +23,7 @@ static std::array<std::tuple<uint8_t, uint8_t, uint8_t>, WS2812_LED_NUM_USED> g_
 
 // 初始化颜色（可在初始化或切换到律动模式时调用一次）
 void audio_led_meter_init_colors() {
+    std::lock_guard<std::mutex> lock(g_mutex);
     std::srand(static_cast<unsigned int>(std::time(nullptr)));
     for (auto& color : g_led_colors) {
         uint8_t r = std::rand() % 256;
@@ -30,96 +31,9 @@ void audio_led_meter_init_colors() {
         uint8_t b = std::rand() % 256;
         color = std::make_tuple(r, g, b);
     }
+    g_version++;
 }
 
-void audio_led_meter_enable(int enable)
-{
-    g_led_meter_enabled = enable;
-    if (enable) {
-        audio_led_meter_init_colors(); // 开启时初始化颜色
-    }
-}
-
-void audio_led_meter_set_strip(void* led_strip) {
-    g_led_strip = reinterpret_cast<led_strip_handle_t>(led_strip);
-}
-
-#if 0
-void audio_led_meter_update(const int16_t* pcm, size_t samples) {
-    if (!g_led_meter_enabled)
-        return;
-
-    if (!g_led_strip)
-        return;
-
-    int64_t sum = 0;
-    for (size_t i = 0; i < samples; ++i) {
-        sum += abs(pcm[i]);
-    }
-    int avg = sum / samples;
-    int level = avg / 1000;
-    if (level > WS2812_LED_NUM_USED) level = WS2812_LED_NUM_USED;
-
-    std::lock_guard<std::mutex> lock(g_led_mutex);
-    for (int i = 0; i < WS2812_LED_NUM_USED; i++) {
-        if (i < level) {
-            auto [r, g, b] = g_led_colors[i];
-            led_strip_set_pixel(g_led_strip, i, r, g, b);
-        } else {
-            led_strip_set_pixel(g_led_strip, i, 0, 0, 0);
-        }
-    }
-
-    for (int i = WS2812_LED_NUM_USED; i < WS2812_LED_NUM; i++) {
-        led_strip_set_pixel(g_led_strip, i, 0, 0, 0);
-    }
-    led_strip_refresh(g_led_strip);
-}
-#else
-void audio_led_meter_update(const int16_t *pcm, size_t samples)
-{
-    if (!g_led_meter_enabled)
-        return;
-
-    if (!g_led_strip)
-        return;
-
-    int64_t sum = 0;
-    for (size_t i = 0; i < samples; ++i)
-    {
-        sum += abs(pcm[i]);
-    }
-    int avg = sum / samples;
-    int level = avg / 1000;
-    if (level > WS2812_LED_NUM_USED)
-        level = WS2812_LED_NUM_USED;
-
-    std::lock_guard<std::mutex> lock(g_led_mutex);
-    for (int i = 0; i < WS2812_LED_NUM_USED; i++)
-    {
-        if (i < level)
-        {
-            auto [r, g, b] = g_led_colors[i];
-            // 亮度缩放
-            r = r * g_brightness / 100;
-            g = g * g_brightness / 100;
-            b = b * g_brightness / 100;
-            led_strip_set_pixel(g_led_strip, i, r, g, b);
-        }
-        else
-        {
-            led_strip_set_pixel(g_led_strip, i, 0, 0, 0);
-        }
-    }
-
-    for (int i = WS2812_LED_NUM_USED; i < WS2812_LED_NUM; i++)
-    {
-        led_strip_set_pixel(g_led_strip, i, 0, 0, 0);
-    }
-    led_strip_refresh(g_led_strip);
-}
-#endif
-
 // 设置亮度，范围0-100
 void audio_led_meter_set_brightness(int percent)
 {
@@ -127,12 +41,15 @@ void audio_led_meter_set_brightness(int percent)
         percent = 0;
     if (percent > 100)
         percent = 100;
+    std::lock_guard<std::mutex> lock(g_mutex);
     g_brightness = percent;
+    g_version++;
 }
 
 // 支持外部设置颜色
 void audio_led_meter_set_colors(const std::vector<std::tuple<uint8_t, uint8_t, uint8_t>> &colors)
 {
+    std::lock_guard<std::mutex> lock(g_mutex);
     for (size_t i = 0; i < g_led_colors.size(); ++i)
     {
         if (i < colors.size())
@@ -140,11 +57,43 @@ void audio_led_meter_set_colors(const std::vector<std::tuple<uint8_t, uint8_t, u
             g_led_colors[i] = colors[i];
         }
     }
+    g_version++;
 }
 void audio_led_meter_set_single_color(uint8_t r, uint8_t g, uint8_t b)
 {
+    std::lock_guard<std::mutex> lock(g_mutex);
     for (auto &color : g_led_colors)
     {
         color = std::make_tuple(r, g, b);
     }
-}
\ No newline at end of file
+    g_version++;
+}
+
+static LedKernel BuildMeter()
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+    std::vector<StripColor> colors;
+    colors.reserve(g_led_colors.size());
+    for (const auto &[r, g, b] : g_led_colors)
+    {
+        colors.push_back({(uint8_t)(r * g_brightness / 100), (uint8_t)(g * g_brightness / 100), (uint8_t)(b * g_brightness / 100)});
+    }
+    return led_effects::AudioMeter(std::move(colors), led_effects::kMeterLeftToRight, AUDIO_LED_METER_LEVEL_STEP);
+}
+
+LedKernel audio_led_meter_kernel()
+{
+    LedKernel meter;
+    uint32_t version = 0;
+    return [meter, version](LedFrameContext &context, StripColor *pixels, int count) mutable
+    {
+        // 律动运行中修改配色或亮度，下一帧即生效
+        uint32_t current = g_version.load();
+        if (!meter || current != version)
+        {
+            version = current;
+            meter = BuildMeter();
+        }
+        meter(context, pixels, count);
+    };
+}
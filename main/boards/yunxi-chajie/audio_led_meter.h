@@ -1,22 +1,16 @@
 #pragma once
 #include <cstdint>
 #include <cstddef>
-#include "led_strip.h"
 #include "config.h"
+#include "led/led_effect_engine.h"
 
 #include <vector>
 #include <tuple>
 
-// 你需要在主控初始化时设置这个灯带句柄
-void audio_led_meter_set_strip(void* led_strip);
-
-// 传入PCM数据，自动分析音量并刷新灯带
-void audio_led_meter_update(const int16_t* pcm, size_t samples);
-
-// 新增：开关控制
-void audio_led_meter_enable(int enable);
-
 void audio_led_meter_set_brightness(int percent);
 void audio_led_meter_set_colors(const std::vector<std::tuple<uint8_t, uint8_t, uint8_t>> &colors);
 void audio_led_meter_init_colors();
-void audio_led_meter_set_single_color(uint8_t r, uint8_t g, uint8_t b);
\ No newline at end of file
+void audio_led_meter_set_single_color(uint8_t r, uint8_t g, uint8_t b);
+
+// 生成音量律动灯效，电平取自 AudioService 的播放输出；律动运行中修改配色或亮度也会在下一帧生效
+LedKernel audio_led_meter_kernel();
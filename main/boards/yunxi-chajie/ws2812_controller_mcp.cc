@@ -7,6 +7,8 @@
 
 #include "audio_led_meter.h"
 
+#include <algorithm>
+
 #include "application.h"
 #include "led/led.h"  // 确保引入 Led 接口定义
 
@@ -35,7 +37,7 @@ Ws2812ControllerMCP::Ws2812ControllerMCP() {
     ESP_ERROR_CHECK(led_strip_new_rmt_device(&strip_config, &rmt_config, &led_strip_));
     led_strip_clear(led_strip_);
 
-    audio_led_meter_set_strip(led_strip_);
+    engine_ = std::make_unique<LedEffectEngine>(led_strip_, WS2812_LED_NUM_USED);
     RegisterMcpTools();
     
 
@@ -43,168 +45,88 @@ Ws2812ControllerMCP::Ws2812ControllerMCP() {
 }
 
 Ws2812ControllerMCP::~Ws2812ControllerMCP() {
-    StopEffectTask();
+    StopEffect();
 }
 
 uint8_t Ws2812ControllerMCP::scale(uint8_t c) const {
     return (uint8_t)((int)c * brightness_ / 100);
 }
 
-void Ws2812ControllerMCP::EffectTask(void* arg) {
-    Ws2812ControllerMCP* self = static_cast<Ws2812ControllerMCP*>(arg);
-    int dir = 1, brightness = 0;
-    int rainbow_base = 0;
-    int marquee_pos = 0;
-
-    ESP_LOGI(TAG, "WS2812灯效任务开始运行");
-    while (self->running_) {
-        if (self->effect_type_ == EFFECT_BREATH) {
-            for (int i = 0; i < WS2812_LED_NUM_USED; i++) {
-                uint8_t r = self->scale(self->color_r_ * brightness / 80);
-                uint8_t g = self->scale(self->color_g_ * brightness / 80);
-                uint8_t b = self->scale(self->color_b_ * brightness / 80);
-                led_strip_set_pixel(self->led_strip_, i, r, g, b);
-            }
-            for (int i = WS2812_LED_NUM_USED; i < WS2812_LED_NUM; i++) {
-                led_strip_set_pixel(self->led_strip_, i, 0, 0, 0);
-            }
-            led_strip_refresh(self->led_strip_);
-            brightness += dir * 5;
-            if (brightness >= 80) {
-                brightness = 80;
-                dir = -1;
-            }
-            if (brightness <= 0) {
-                brightness = 0;
-                dir = 1;
-            }
-            vTaskDelay(pdMS_TO_TICKS(self->breath_delay_ms_));
-        } else if (self->effect_type_ == EFFECT_RAINBOW_FLOW) {
-            for (int i = 0; i < WS2812_LED_NUM_USED; i++) {
+std::vector<LedKernel> Ws2812ControllerMCP::BuildEffect() {
+    StripColor color = {color_r_, color_g_, color_b_};
+    LedKernel pattern;
+    switch (effect_type_) {
+        case EFFECT_BREATH: {
+            // 亮度 0~80 每步 5 往返，一步 breath_delay_ms_
+            int interval = std::max(breath_delay_ms_, 1);
+            pattern = [color, interval](LedFrameContext& context, StripColor* pixels, int count) {
+                int phase = (context.time_ms / interval) % 32;
+                int level = (phase <= 16 ? phase : 32 - phase) * 5;
+                StripColor c = {(uint8_t)(color.red * level / 80), (uint8_t)(color.green * level / 80),
+                    (uint8_t)(color.blue * level / 80)};
+                std::fill(pixels, pixels + count, c);
+            };
+            break;
+        }
+        case EFFECT_RAINBOW_FLOW: {
+            int interval = std::max(breath_delay_ms_, 1);
+            pattern = [this, interval](LedFrameContext& context, StripColor* pixels, int count) {
                 int group_size = RAINBOW_COLORS_COUNT + COLOR_GAP;
-                int pos = (self->rainbow_flow_pos_ + i) % group_size;
-
-                if (pos < RAINBOW_COLORS_COUNT) {
-                    uint8_t r = self->rainbow_colors_[pos][0];
-                    uint8_t g = self->rainbow_colors_[pos][1];
-                    uint8_t b = self->rainbow_colors_[pos][2];
-                    led_strip_set_pixel(self->led_strip_, i, self->scale(r), self->scale(g), self->scale(b));
-                } else {
-                    led_strip_set_pixel(self->led_strip_, i, 0, 0, 0);
-                }
-            }
-            for (int i = WS2812_LED_NUM_USED; i < WS2812_LED_NUM; i++) {
-                led_strip_set_pixel(self->led_strip_, i, 0, 0, 0);
-            }
-            led_strip_refresh(self->led_strip_);
-            self->rainbow_flow_pos_ = (self->rainbow_flow_pos_ + 1) % (RAINBOW_COLORS_COUNT + COLOR_GAP);
-            vTaskDelay(pdMS_TO_TICKS(self->breath_delay_ms_));
-        } else if (self->effect_type_ == EFFECT_RAINBOW) {
-            for (int i = 0; i < WS2812_LED_NUM_USED; i++) {
-                int pos = (rainbow_base + i * 256 / WS2812_LED_NUM_USED) % 256;
-                uint8_t r, g, b;
-                if (pos < 85) {
-                    r = pos * 3;
-                    g = 255 - pos * 3;
-                    b = 0;
-                } else if (pos < 170) {
-                    pos -= 85;
-                    r = 255 - pos * 3;
-                    g = 0;
-                    b = pos * 3;
-                } else {
-                    pos -= 170;
-                    r = 0;
-                    g = pos * 3;
-                    b = 255 - pos * 3;
+                int offset = context.time_ms / interval;
+                for (int i = 0; i < count; i++) {
+                    int pos = (offset + i) % group_size;
+                    if (pos < RAINBOW_COLORS_COUNT) {
+                        pixels[i] = {rainbow_colors_[pos][0], rainbow_colors_[pos][1], rainbow_colors_[pos][2]};
+                    } else {
+                        pixels[i] = StripColor();
+                    }
                 }
-                led_strip_set_pixel(self->led_strip_, i, self->scale(r), self->scale(g), self->scale(b));
-            }
-            for (int i = WS2812_LED_NUM_USED; i < WS2812_LED_NUM; i++) {
-                led_strip_set_pixel(self->led_strip_, i, 0, 0, 0);
-            }
-            led_strip_refresh(self->led_strip_);
-            rainbow_base = (rainbow_base + 5) % 256;
-            vTaskDelay(pdMS_TO_TICKS(50));
-        } else if (self->effect_type_ == EFFECT_MARQUEE) {
-            for (int i = 0; i < WS2812_LED_NUM_USED; i++) {
-                if (i == marquee_pos)
-                    led_strip_set_pixel(self->led_strip_, i, self->scale(self->color_r_), self->scale(self->color_g_), self->scale(self->color_b_));
-                else
-                    led_strip_set_pixel(self->led_strip_, i, 0, 0, 0);
-            }
-            for (int i = WS2812_LED_NUM_USED; i < WS2812_LED_NUM; i++) {
-                led_strip_set_pixel(self->led_strip_, i, 0, 0, 0);
-            }
-            led_strip_refresh(self->led_strip_);
-            marquee_pos = (marquee_pos + 1) % WS2812_LED_NUM_USED;
-            vTaskDelay(pdMS_TO_TICKS(80));
+            };
+            break;
         }
-        else if (self->effect_type_ == EFFECT_SCROLL)
-        {
-            // ✅ 滚动灯逻辑
-            for (int i = 0; i < WS2812_LED_NUM_USED; i++)
-            {
-                if (i == self->scroll_offset_)
-                {
-                    led_strip_set_pixel(self->led_strip_, i, self->scale(self->color_r_), self->scale(self->color_g_), self->scale(self->color_b_));
-                }
-                else
-                {
-                    led_strip_set_pixel(self->led_strip_, i, 0, 0, 0);
+        case EFFECT_RAINBOW:
+            // 色环每 50ms 前进 5
+            pattern = [](LedFrameContext& context, StripColor* pixels, int count) {
+                int base = (context.time_ms / 50 * 5) % 256;
+                for (int i = 0; i < count; i++) {
+                    int pos = (base + i * 256 / count) % 256;
+                    if (pos < 85) {
+                        pixels[i] = {(uint8_t)(pos * 3), (uint8_t)(255 - pos * 3), 0};
+                    } else if (pos < 170) {
+                        pos -= 85;
+                        pixels[i] = {(uint8_t)(255 - pos * 3), 0, (uint8_t)(pos * 3)};
+                    } else {
+                        pos -= 170;
+                        pixels[i] = {0, (uint8_t)(pos * 3), (uint8_t)(255 - pos * 3)};
+                    }
                 }
-            }
-            led_strip_refresh(self->led_strip_);
-            self->scroll_offset_ = (self->scroll_offset_ + 1) % WS2812_LED_NUM_USED;
-            vTaskDelay(pdMS_TO_TICKS(100)); // 可配置为参数
-        }
-        else if (self->effect_type_ == EFFECT_BLINK)
-        {
-            // ✅ 闪烁灯逻辑
-            for (int i = 0; i < WS2812_LED_NUM_USED; i++)
-            {
-                uint8_t r = self->blink_state_ ? self->scale(self->color_r_) : 0;
-                uint8_t g = self->blink_state_ ? self->scale(self->color_g_) : 0;
-                uint8_t b = self->blink_state_ ? self->scale(self->color_b_) : 0;
-                led_strip_set_pixel(self->led_strip_, i, r, g, b);
-            }
-            led_strip_refresh(self->led_strip_);
-            self->blink_state_ = !self->blink_state_;
-            vTaskDelay(pdMS_TO_TICKS(self->blink_interval_));
-        }
-        else
-        {
-            for (int i = 0; i < WS2812_LED_NUM; i++) {
-                led_strip_set_pixel(self->led_strip_, i, 0, 0, 0);
-            }
-            led_strip_refresh(self->led_strip_);
-            vTaskDelay(pdMS_TO_TICKS(100));
-        }
-    }
-
-    for (int i = 0; i < WS2812_LED_NUM; i++) {
-        led_strip_set_pixel(self->led_strip_, i, 0, 0, 0);
+            };
+            break;
+        case EFFECT_MARQUEE:
+            pattern = led_effects::Scroll(StripColor(), color, 1, 80);
+            break;
+        case EFFECT_SCROLL:
+            pattern = led_effects::Scroll(StripColor(), color, 1, 100);
+            break;
+        case EFFECT_BLINK:
+            pattern = led_effects::Blink(color, blink_interval_);
+            break;
+        case EFFECT_VOLUME:
+            // 音量律动自带配色与亮度
+            return {audio_led_meter_kernel()};
+        default:
+            return {led_effects::Fill(StripColor())};
     }
-    led_strip_refresh(self->led_strip_);
-    self->effect_task_handle_ = nullptr;
-    vTaskDelete(NULL);
+    return {pattern, led_effects::Brightness(brightness_)};
 }
 
-void Ws2812ControllerMCP::StartEffectTask() {
-    if (!running_) {
-        running_ = true;
-        xTaskCreate(EffectTask, "ws2812_effect", 4096, this, 5, &effect_task_handle_);
-    }
+void Ws2812ControllerMCP::RenderEffect() {
+    engine_->SetEffect(BuildEffect(), effect_type_ != EFFECT_OFF, effect_type_ == EFFECT_VOLUME);
 }
 
-
-
-void Ws2812ControllerMCP::StopEffectTask() {
-    running_ = false;
+void Ws2812ControllerMCP::StopEffect() {
     effect_type_ = EFFECT_OFF;
-    while (effect_task_handle_ != nullptr) {
-        vTaskDelay(pdMS_TO_TICKS(10));
-    }
+    engine_->Clear();
 }
 
 void Ws2812ControllerMCP::RegisterMcpTools() {
@@ -215,15 +137,10 @@ void Ws2812ControllerMCP::RegisterMcpTools() {
         "呼吸灯效果",
         PropertyList(),
         [this](const PropertyList& properties) -> ReturnValue {
-            audio_led_meter_enable(0);
             ESP_LOGI(TAG, "设置呼吸灯效果");
-            StopEffectTask();
-            for (int i = 0; i < WS2812_LED_NUM; i++) {
-                led_strip_set_pixel(led_strip_, i, 0, 0, 0);
-            }
-            led_strip_refresh(led_strip_);
+            StopEffect();
             effect_type_ = EFFECT_BREATH;
-            StartEffectTask();
+            RenderEffect();
             return true;
         });
 
@@ -258,6 +175,9 @@ void Ws2812ControllerMCP::RegisterMcpTools() {
             brightness_ = val;
             audio_led_meter_set_brightness(val);
             ESP_LOGI(TAG, "设置亮度为%d%%", brightness_);
+            if (effect_type_ != EFFECT_OFF) {
+                RenderEffect();
+            }
             return true;
         });
 
@@ -266,13 +186,11 @@ void Ws2812ControllerMCP::RegisterMcpTools() {
         "开启音量律动效果",
         PropertyList(),
         [this](const PropertyList& properties) -> ReturnValue {
-            StopEffectTask();
+            StopEffect();
             ESP_LOGI(TAG, "设置音量律动效果");
-            for (int i = 0; i < WS2812_LED_NUM; i++) {
-                led_strip_set_pixel(led_strip_, i, 0, 0, 0);
-            }
-            led_strip_refresh(led_strip_);
-            audio_led_meter_enable(1);
+            audio_led_meter_init_colors(); // 每次开启律动随机一组颜色
+            effect_type_ = EFFECT_VOLUME;
+            RenderEffect();
             return true;
         });
 
@@ -308,15 +226,10 @@ void Ws2812ControllerMCP::RegisterMcpTools() {
         "彩虹灯效",
         PropertyList(),
         [this](const PropertyList& properties) -> ReturnValue {
-            audio_led_meter_enable(0);
-            StopEffectTask();
+            StopEffect();
             ESP_LOGI(TAG, "设置彩虹灯效");
-            for (int i = 0; i < WS2812_LED_NUM; i++) {
-                led_strip_set_pixel(led_strip_, i, 0, 0, 0);
-            }
-            led_strip_refresh(led_strip_);
             effect_type_ = EFFECT_RAINBOW;
-            StartEffectTask();
+            RenderEffect();
             return true;
         });
 
@@ -325,16 +238,10 @@ void Ws2812ControllerMCP::RegisterMcpTools() {
         "彩虹流动灯效，7种颜色依次流动显示",
         PropertyList(),
         [this](const PropertyList& properties) -> ReturnValue {
-            audio_led_meter_enable(0);
-            StopEffectTask();
+            StopEffect();
             ESP_LOGI(TAG, "设置彩虹流动灯效");
-            for (int i = 0; i < WS2812_LED_NUM; i++) {
-                led_strip_set_pixel(led_strip_, i, 0, 0, 0);
-            }
-            led_strip_refresh(led_strip_);
-            rainbow_flow_pos_ = 0;
             effect_type_ = EFFECT_RAINBOW_FLOW;
-            StartEffectTask();
+            RenderEffect();
             return true;
         });
 
@@ -343,15 +250,10 @@ void Ws2812ControllerMCP::RegisterMcpTools() {
         "跑马灯",
         PropertyList(),
         [this](const PropertyList& properties) -> ReturnValue {
-            audio_led_meter_enable(0);
-            StopEffectTask();
+            StopEffect();
             ESP_LOGI(TAG, "设置跑马灯效果");
-            for (int i = 0; i < WS2812_LED_NUM; i++) {
-                led_strip_set_pixel(led_strip_, i, 0, 0, 0);
-            }
-            led_strip_refresh(led_strip_);
             effect_type_ = EFFECT_MARQUEE;
-            StartEffectTask();
+            RenderEffect();
             return true;
         });
 
@@ -373,14 +275,9 @@ void Ws2812ControllerMCP::RegisterMcpTools() {
         "关闭灯带",
         PropertyList(),
         [this](const PropertyList& properties) -> ReturnValue {
-            audio_led_meter_enable(0);
             effect_type_ = EFFECT_OFF;
-            StopEffectTask();
+            StopEffect();
             ESP_LOGI(TAG, "关闭灯带");
-            for (int i = 0; i < WS2812_LED_NUM; i++) {
-                led_strip_set_pixel(led_strip_, i, 0, 0, 0);
-            }
-            led_strip_refresh(led_strip_);
             return true;
         });
     mcp_server.AddTool(
@@ -389,9 +286,9 @@ void Ws2812ControllerMCP::RegisterMcpTools() {
     PropertyList(),
     [this](const PropertyList& properties) -> ReturnValue {
         ESP_LOGI(TAG, "设置滚动灯效果");
-        StopEffectTask();
+        StopEffect();
         effect_type_ = EFFECT_SCROLL;
-        StartEffectTask();
+        RenderEffect();
         return true;
     });
 
@@ -416,21 +313,19 @@ mcp_server.AddTool(
         
         int interval = properties["interval"].value<int>();
         ESP_LOGI(TAG, "设置闪烁灯效果: %d,%d,%d @ %dms", color_r_, color_g_, color_b_, interval);
-        StopEffectTask();
+        StopEffect();
         // blink_color_ = {color_r_, color_g_, color_b_};
         blink_interval_ = interval;
         effect_type_ = EFFECT_BLINK;
-        StartEffectTask();
+        RenderEffect();
         return true;
     });
-
-    audio_led_meter_enable(0);
 }
 
 void Ws2812ControllerMCP::StartEffect(Ws2812EffectType effect) {
     if (effect_type_ != effect) {
         effect_type_ = effect;
-        StartEffectTask();  // 启动灯效任务
+        RenderEffect();
     }
 }
 
@@ -439,19 +334,19 @@ void Ws2812ControllerMCP::SetColor(uint8_t r, uint8_t g, uint8_t b) {
     color_g_ = g;
     color_b_ = b;
 
-    // 如果当前没有运行灯效任务，则直接设置颜色
+    // 如果当前没有灯效，则直接设置颜色
     if (effect_type_ == EFFECT_OFF) {
-        for (int i = 0; i < WS2812_LED_NUM; i++) {
-            led_strip_set_pixel(led_strip_, i, scale(r), scale(g), scale(b));
-        }
+        engine_->Fill({scale(r), scale(g), scale(b)});
+    } else {
+        // 运行中的灯效改用新颜色
+        RenderEffect();
     }
 }
 
 void Ws2812ControllerMCP::StartScrollEffect(int interval_ms) {
     if (effect_type_ != EFFECT_SCROLL) {
         effect_type_ = EFFECT_SCROLL;
-        scroll_offset_ = 0;
-        StartEffectTask();
+        RenderEffect();
     }
 }
 
@@ -459,53 +354,38 @@ void Ws2812ControllerMCP::StartBlinkEffect(int interval_ms) {
     blink_interval_ = interval_ms;
     if (effect_type_ != EFFECT_BLINK) {
         effect_type_ = EFFECT_BLINK;
-        StartEffectTask();
+        RenderEffect();
     }
 }
 
 // 音量律动效果的实现
 void Ws2812ControllerMCP::StartVolumeEffect() {
-    StopEffectTask();
+    StopEffect();
     ESP_LOGI(TAG, "设置音量律动效果");
-    for (int i = 0; i < WS2812_LED_NUM; i++)
-    {
-        led_strip_set_pixel(led_strip_, i, 0, 0, 0);
-    }
-    led_strip_refresh(led_strip_);
-    audio_led_meter_enable(1);
+    audio_led_meter_init_colors(); // 每次开启律动随机一组颜色
+    effect_type_ = EFFECT_VOLUME;
+    RenderEffect();
 }
 
 // 设置彩色律动效果
 void Ws2812ControllerMCP::StartColorVolumeEffect()
 {
     StartVolumeEffect();
-    audio_led_meter_init_colors(); // 重新随机一组颜色
     ESP_LOGI(TAG, "已随机更换音量律动的灯带配色");
 }
 
 void Ws2812ControllerMCP::ClearLED()
 {
-    StopEffectTask();
+    StopEffect();
     ESP_LOGI(TAG, "设置音量律动效果");
-    for (int i = 0; i < WS2812_LED_NUM; i++)
-    {
-        led_strip_set_pixel(led_strip_, i, 0, 0, 0);
-    }
-    led_strip_refresh(led_strip_);
     ESP_LOGI(TAG, "清除所有LED灯");
 }
 
 void Ws2812ControllerMCP::TurnOff()
 {
-    audio_led_meter_enable(0);
     effect_type_ = EFFECT_OFF;
-    StopEffectTask();
+    StopEffect();
     ESP_LOGI(TAG, "关闭灯带");
-    for (int i = 0; i < WS2812_LED_NUM; i++)
-    {
-        led_strip_set_pixel(led_strip_, i, 0, 0, 0);
-    }
-    led_strip_refresh(led_strip_);
 }
 
 void Ws2812ControllerMCP::OnStateChanged() {
@@ -1,21 +1,12 @@
 #pragma once
 #include <cstdint>
 #include <cstddef>
-#include "led_strip.h"
 #include "config.h"
+#include "led/led_effect_engine.h"
 
 #include <vector>
 #include <tuple>
 
-// 你需要在主控初始化时设置这个灯带句柄
-void audio_led_meter_set_strip(void* led_strip);
-
-// 传入PCM数据，自动分析音量并刷新灯带
-void audio_led_meter_update(const int16_t* pcm, size_t samples);
-
-// 新增：开关控制
-void audio_led_meter_enable(int enable);
-
 void audio_led_meter_set_brightness(int percent);
 void audio_led_meter_set_colors(const std::vector<std::tuple<uint8_t, uint8_t, uint8_t>> &colors);
 void audio_led_meter_init_colors();
@@ -30,4 +21,7 @@ enum AudioLedMeterMode {
 };
 
 void audio_led_meter_set_mode(AudioLedMeterMode mode);
-AudioLedMeterMode audio_led_meter_get_mode();
\ No newline at end of file
+AudioLedMeterMode audio_led_meter_get_mode();
+
+// 生成音量律动灯效，电平取自 AudioService 的播放输出；律动运行中修改配色、亮度或模式也会在下一帧生效
+LedKernel audio_led_meter_kernel();
@@ -7,6 +7,8 @@
 #include <freertos/Task.h>
 #include <mcp_server.h>
 #include "led/led.h"
+#include "led/led_effect_engine.h"
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -37,9 +39,8 @@ namespace ws2812 {
     {
     private:
         led_strip_handle_t led_strip_ = nullptr;
-        TaskHandle_t effect_task_handle_ = nullptr;
+        std::unique_ptr<LedEffectEngine> engine_;
         volatile Ws2812EffectType effect_type_ = EFFECT_OFF;
-        volatile bool running_ = false;
 
     uint8_t color_r_ = 0;
     uint8_t color_g_ = 255;
@@ -53,10 +54,8 @@ namespace ws2812 {
         int breath_delay_ms_ = 40;
         int brightness_ = 50;
 
-        int scroll_offset_ = 0;    // 滚动灯偏移
         // StripColor blink_color_;   // 闪烁灯颜色
         int blink_interval_ = 500; // 闪烁间隔
-        bool blink_state_ = false; // 当前闪烁状态
 
         static const int RAINBOW_COLORS_COUNT = 7;
         static const int COLOR_GAP = 3;
@@ -69,7 +68,6 @@ namespace ws2812 {
             {75, 0, 130},  // 靛
             {148, 0, 211}  // 紫
         };
-        int rainbow_flow_pos_ = 0;
 
         // 小夜灯相关
         volatile bool nightlight_locked_ = false; // true=手动开启小夜灯，阻止其他灯效覆盖
@@ -85,9 +83,10 @@ namespace ws2812 {
 
         uint8_t scale(uint8_t c) const;
 
-        static void EffectTask(void *arg);
-        void StartEffectTask();
-        void StopEffectTask();
+        // 按 effect_type_ 生成灯效内核，由 engine_ 按固定帧率渲染
+        std::vector<LedKernel> BuildEffect();
+        void RenderEffect();
+        void StopEffect();
 
     public:
         explicit Ws2812ControllerMCP();
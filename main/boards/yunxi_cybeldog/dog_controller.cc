@@ -4,7 +4,9 @@
 */
 
 #include <esp_log.h>
+#include <atomic>
 #include <cstring>
+#include <mutex>
 
 #include "application.h"
 #include "board.h"
@@ -24,6 +26,7 @@ namespace iot
         int action_type; // 动作类型
         int steps;       // 步数或次数
         int speed;       // 速度（数值越小越快）
+        uint32_t generation; // 入队时的停止代数，停止后作废
         // int direction;   // 方向（1=左，-1=右，0=同时）
     };
 
@@ -34,6 +37,10 @@ namespace iot
         Dog dog_;                                 // 动作实现对象
         TaskHandle_t action_task_handle_ = nullptr; // 动作任务句柄
         QueueHandle_t action_queue_;                // 动作队列
+        // 停止时加一，之前排队或已取出的动作作废；任务不被删除，由它自己结束当前动作
+        std::mutex stop_mutex_;
+        uint32_t stop_generation_ = 0;
+        std::atomic<bool> exiting_{false};
         // bool has_hands_ = false;                    // 是否有手部舵机
 
         // 动作类型枚举
@@ -46,7 +53,8 @@ namespace iot
             ACTION_FROUNT_BACK = 5, // 前后摇摆
             ACTION_SHAKE_HAND = 6,  // 摇手
             ACTION_SIT = 7,         // 蹲下
-            ACTION_REST = 8         // 休息一下，趴在地上
+            ACTION_REST = 8,        // 休息一下，趴在地上
+            ACTION_HOME = 9         // 复位，仅供停止后使用，AIControl 不可调用
         };
 
         // 限制参数在[min, max]范围内
@@ -72,11 +80,19 @@ namespace iot
             DogActionParams params;
             // controller->dog_.AttachServos(); // 绑定所有舵机
 
-            while (true)
+            while (!controller->exiting_)
             {
                 // 从队列取出一个动作参数
                 if (xQueueReceive(controller->action_queue_, &params, pdMS_TO_TICKS(1000)) == pdTRUE)
                 {
+                    {
+                        std::lock_guard<std::mutex> lock(controller->stop_mutex_);
+                        if (params.generation != controller->stop_generation_)
+                        {
+                            continue; // 停止前取出的动作
+                        }
+                        controller->dog_.ResumeMotion();
+                    }
                     ESP_LOGI(TAG, "执行动作: %d", params.action_type);
 
                     // 根据动作类型调用对应的Otto动作
@@ -105,6 +121,10 @@ namespace iot
                         break;
                     case ACTION_REST:
                         controller->dog_.Rest(params.steps, params.speed);
+                        break;
+                    case ACTION_HOME:
+                        controller->dog_.Home();
+                        break;
                     }
                     vTaskDelay(pdMS_TO_TICKS(200));                               // 动作间隔
                     // controller->dog_.Home(params.action_type < ACTION_HANDS_UP); // 动作后复位
@@ -119,13 +139,33 @@ namespace iot
                         vTaskDelay(pdMS_TO_TICKS(500));
                         // controller->dog_.DetachServos();
                         vTaskDelay(pdMS_TO_TICKS(1000));
-                        controller->action_task_handle_ = nullptr;
-                        vTaskDelete(NULL);
                         break;
                     }
                 }
                 vTaskDelay(pdMS_TO_TICKS(20)); // 任务循环延时
             }
+            controller->action_task_handle_ = nullptr;
+            vTaskDelete(NULL);
+        }
+
+        // 作废排队和正在执行的动作，舵机停在当前位置
+        void StopActions()
+        {
+            std::lock_guard<std::mutex> lock(stop_mutex_);
+            stop_generation_++;
+            xQueueReset(action_queue_);
+            dog_.StopMotion();
+        }
+
+        void QueueAction(int action_type, int steps, int speed)
+        {
+            DogActionParams params = {action_type, steps, speed, 0};
+            {
+                std::lock_guard<std::mutex> lock(stop_mutex_);
+                params.generation = stop_generation_;
+            }
+            xQueueSend(action_queue_, &params, portMAX_DELAY);
+            StartActionTaskIfNeeded();
         }
 
     public:
@@ -149,13 +189,9 @@ namespace iot
                                [this](const ParameterList &parameters)
                                {
                                    ESP_LOGI(TAG, "停止Dog机器人动作");
-                                   if (action_task_handle_ != nullptr)
-                                   {
-                                       vTaskDelete(action_task_handle_);
-                                       action_task_handle_ = nullptr;
-                                   }
-                                   xQueueReset(action_queue_);
-                                   dog_.Home(); // 中断动作时完全复位
+                                   // 不删除任务（它可能正在设置舵机），取消动作后让它自己跑完，再由它复位
+                                   StopActions();
+                                   QueueAction(ACTION_HOME, 1, 1000); // 中断动作时完全复位
                                });
 
             // 添加AIControl方法：将动作加入队列
@@ -183,15 +219,7 @@ namespace iot
                     ESP_LOGI(TAG, "AI控制: 动作类型=%d, 步数=%d, 速度=%d",action_type, steps, speed);
 
                     // 封装参数并加入队列
-                    DogActionParams params;
-                    params.action_type = action_type;
-                    params.steps = steps;
-                    params.speed = speed;
-                    // params.direction = direction;
-
-                    xQueueSend(action_queue_, &params, portMAX_DELAY);
-
-                    StartActionTaskIfNeeded();
+                    QueueAction(action_type, steps, speed);
                 });
         }
 
@@ -207,9 +235,11 @@ namespace iot
         // 析构函数，释放资源
         ~DogController()
         {
-            if (action_task_handle_ != nullptr)
+            exiting_ = true;
+            StopActions();
+            while (action_task_handle_ != nullptr)
             {
-                vTaskDelete(action_task_handle_);
+                vTaskDelay(pdMS_TO_TICKS(10));
             }
             vQueueDelete(action_queue_);
         }
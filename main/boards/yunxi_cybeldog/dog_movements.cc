@@ -102,6 +102,10 @@ void Dog::MoveServos(int time, int servo_target[])
     ESP_LOGI(TAG, "MoveServos time = %d servo_target =%d  %d %d %d servo_now = %d %d %d %d", time, servo_target[0],
              servo_target[1], servo_target[2], servo_target[3],
              servo_[0].GetPosition(), servo_[1].GetPosition(), servo_[2].GetPosition(), servo_[3].GetPosition());
+    if (stop_requested_)
+    {
+        return;
+    }
     if (GetRestState() == true)
     {
         SetRestState(false);
@@ -151,7 +155,11 @@ void Dog::MoveServos(int time, int servo_target[])
                 servo_[i].SetPosition(servo_target[i]);
             }
         }
-        vTaskDelay(pdMS_TO_TICKS(time));
+        // 分段等待，中止时不必等完整个动作时间
+        for (int waited = 0; waited < time && !stop_requested_; waited += 10)
+        {
+            vTaskDelay(pdMS_TO_TICKS(10));
+        }
     }
 
     // final adjustment to the target.
@@ -266,6 +274,10 @@ void Dog::MoveSingle(int position, int servo_number)
     void Dog::OscillateServos(int amplitude[SERVO_COUNT], int offset[SERVO_COUNT], int period,
                          double phase_diff[SERVO_COUNT], float cycle = 1)
 {
+    if (stop_requested_)
+    {
+        return;
+    }
     for (int i = 0; i < SERVO_COUNT; i++)
     {
         // 设置每个舵机的正弦波参数
@@ -291,7 +303,7 @@ void Dog::MoveSingle(int position, int servo_number)
     // 循环刷新舵机位置
     // 在动作持续期间，不断调用每个舵机的 Refresh()，让它们按照正弦波轨迹运动。
 
-    while (millis() < end_time)
+    while (millis() < end_time && !stop_requested_)
     {
         for (int i = 0; i < SERVO_COUNT; i++)
         {
@@ -363,12 +375,23 @@ void Dog::Home()
         
         MoveServos(3000, homes); // 500ms内复位
         ESP_LOGI(TAG, "Dog is at rest position %d", homes[0]);
-        is_dog_resting_ = true;
+        // 被中止的归位没有到位
+        is_dog_resting_ = !stop_requested_;
     }
 
     vTaskDelay(pdMS_TO_TICKS(100));
 }
 
+void Dog::StopMotion()
+{
+    stop_requested_ = true;
+}
+
+void Dog::ResumeMotion()
+{
+    stop_requested_ = false;
+}
+
 void Dog::ZeroServos()
 {
     ESP_LOGI(TAG, ">>>>>>>>>>>>>>>ZeroServos>>>>>>>>>>>>>>>>>>>>>>>");
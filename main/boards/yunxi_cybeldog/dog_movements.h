@@ -9,6 +9,8 @@
 #include "freertos/task.h"
 #include "oscillator.h"
 
+#include <atomic>
+
 // -- 常量定义（动作参数/方向/幅度等）
 #define FORWARD 1      // 前进
 #define BACKWARD -1    // 后退
@@ -55,6 +57,10 @@ public:
     void OscillateServos(int amplitude[SERVO_COUNT], int offset[SERVO_COUNT], int period,
                          double phase_diff[SERVO_COUNT], float cycle); // 正弦波驱动舵机
 
+    // -- 中止：正在执行的动作尽快结束，之后的移动全部跳过，直到 ResumeMotion()
+    void StopMotion();
+    void ResumeMotion();
+
     // -- 休息/归位
     void Home(); // 所有舵机归位
     bool GetRestState();               // 获取是否处于休息状态
@@ -87,6 +93,7 @@ private:
     float increment_[SERVO_COUNT];  // 每步增量
 
     bool is_dog_resting_;          // 是否处于休息状态，归位状态
+    std::atomic<bool> stop_requested_{false}; // 是否已请求中止
     // bool has_hands_;                // 是否有手部舵机
 
     // -- 动作执行核心（正弦波参数驱动所有舵机）
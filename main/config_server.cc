@@ -6,6 +6,8 @@
 #include "ha_config.h"
 #include "mcp_server.h"
 #include "settings.h"
+#include "memory_budget.h"
+#include "task_profiler.h"
 #include <cJSON.h>
 #include <esp_log.h>
 #include <esp_system.h>
@@ -65,6 +67,8 @@ static const char PAGE_HTML[] =
 "<button class=\"tab active\" onclick=\"showTab('tools',this)\">MCP 工具</button>"
 "<button class=\"tab\" onclick=\"showTab('ha',this)\">HA 配置</button>"
 "<button class=\"tab\" onclick=\"showTab('auth',this)\">修改密码</button>"
+"<button class=\"tab\" onclick=\"showTab('mem',this)\">内存</button>"
+"<button class=\"tab\" onclick=\"showTab('stats',this)\">任务</button>"
 "</div>"
 
 // ── 工具管理面板 ──
@@ -117,6 +121,28 @@ static const char PAGE_HTML[] =
 "<div class=\"bar\"><button class=\"btn btn-primary\" onclick=\"saveAuth()\">保存密码</button></div>"
 "</div></div>"
 
+// ── 内存面板 ──
+"<div id=\"pane-mem\" class=\"pane\">"
+"<div class=\"section\"><h3>堆（按能力）</h3>"
+"<table><thead><tr>"
+"<th>堆</th><th>总量</th><th>空闲</th><th>历史最低空闲</th><th>最大空闲块</th><th>碎片率</th>"
+"</tr></thead><tbody id=\"heap-rows\"></tbody></table></div>"
+"<div class=\"section\"><h3>各子系统占用</h3>"
+"<table><thead><tr>"
+"<th>子系统</th><th>内部 RAM</th><th>PSRAM</th><th>峰值</th><th>块数</th><th>分配失败</th>"
+"</tr></thead><tbody id=\"tag-rows\"></tbody></table>"
+"<p class=\"note-col\" style=\"margin-top:8px\">只统计各子系统的大块缓冲，容器、cJSON、驱动等未记账的分配只体现在堆空闲量中。每 2 秒刷新。</p>"
+"</div></div>"
+
+// ── 任务面板 ──
+"<div id=\"pane-stats\" class=\"pane\">"
+"<div class=\"section\"><h3>CPU 负载 <span id=\"cpu-load\"></span></h3>"
+"<table><thead><tr>"
+"<th>任务</th><th>优先级</th><th>核</th><th>CPU</th><th>平均</th><th>峰值</th><th>最少剩余栈</th>"
+"</tr></thead><tbody id=\"task-rows\"></tbody></table>"
+"<p class=\"note-col\" style=\"margin-top:8px\">CPU 为占整颗芯片的百分比，平均/峰值取最近 1 分钟；剩余栈不足 512 字节标红。每 2 秒刷新。</p>"
+"</div></div>"
+
 "<script>"
 // ── 工具管理员备注（内置工具中文说明）──
 "const TOOL_NOTES={"
@@ -179,11 +205,15 @@ static const char PAGE_HTML[] =
 "const HA_CAM=['ha_cam_url','ha_cam_tok','ha_cam_ent','ha_cam_mot'];"
 
 "let cfg={};"
+"let memTimer=null;"
 "function showTab(id,el){"
 "document.querySelectorAll('.tab').forEach(t=>t.classList.remove('active'));"
 "document.querySelectorAll('.pane').forEach(p=>p.classList.remove('active'));"
 "el.classList.add('active');"
-"document.getElementById('pane-'+id).classList.add('active');}"
+"document.getElementById('pane-'+id).classList.add('active');"
+"clearInterval(memTimer);memTimer=null;"
+"if(id==='mem'){loadMem();memTimer=setInterval(loadMem,2000);}"
+"if(id==='stats'){loadStats();memTimer=setInterval(loadStats,2000);}}"
 
 "function showMsg(id,ok,txt){"
 "const el=document.getElementById('msg-'+id);"
@@ -313,6 +343,29 @@ static const char PAGE_HTML[] =
 "const r=await fetch('/api/auth',{method:'POST',body:JSON.stringify({user,pass})});"
 "showMsg('auth',r.ok,r.ok?'密码已修改，下次登录生效':'保存失败: '+r.status);}"
 
+// 内存统计，只在内存面板可见时轮询
+"function kb(n){return (n/1024).toFixed(1)+' KB';}"
+"async function loadMem(){"
+"try{const r=await fetch('/api/memory');const m=await r.json();"
+"document.getElementById('heap-rows').innerHTML=m.heaps.map(h=>"
+"'<tr><td>'+h.name+'</td><td>'+kb(h.total)+'</td><td>'+kb(h.free)+'</td><td>'+kb(h.min_free)+'</td>'"
+"+'<td>'+kb(h.largest_free_block)+'</td><td>'+h.fragmentation+'%</td></tr>').join('');"
+"document.getElementById('tag-rows').innerHTML=m.tags.map(t=>"
+"'<tr><td>'+t.name+'</td><td>'+kb(t.internal)+'</td><td>'+kb(t.psram)+'</td><td>'+kb(t.peak)+'</td>'"
+"+'<td>'+t.blocks+'</td><td>'+t.failures+'</td></tr>').join('');"
+"}catch(e){}}"
+
+// 任务 CPU/栈统计，同样只在面板可见时轮询
+"async function loadStats(){"
+"try{const r=await fetch('/api/stats');const s=await r.json();"
+"const avg=s.load.length?Math.round(s.load.reduce((a,b)=>a+b,0)/s.load.length):0;"
+"document.getElementById('cpu-load').textContent='（当前 '+(s.load.length?s.load[s.load.length-1]:0)+'%，平均 '+avg+'%）';"
+"document.getElementById('task-rows').innerHTML=s.tasks.map(t=>"
+"'<tr><td>'+escHtml(t.name)+'</td><td>'+t.priority+'</td><td>'+(t.core<0?'-':t.core)+'</td>'"
+"+'<td>'+t.cpu+'%</td><td>'+t.cpu_avg+'%</td><td>'+t.cpu_max+'%</td>'"
+"+'<td'+(t.stack_low?' style=\"color:#cf1322\"':'')+'>'+t.stack_free_min+'</td></tr>').join('');"
+"}catch(e){}}"
+
 // 重启
 "async function reboot(){"
 "if(!confirm('确定要重启设备吗？'))return;"
@@ -509,6 +562,22 @@ esp_err_t ConfigServer::HandleSaveAuth(httpd_req_t* req) {
     return ESP_OK;
 }
 
+esp_err_t ConfigServer::HandleGetMemory(httpd_req_t* req) {
+    if (!CheckAuth(req)) return ESP_OK;
+    std::string json = MemoryBudget::GetInstance().GetJson();
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_send(req, json.c_str(), json.size());
+    return ESP_OK;
+}
+
+esp_err_t ConfigServer::HandleGetStats(httpd_req_t* req) {
+    if (!CheckAuth(req)) return ESP_OK;
+    std::string json = TaskProfiler::GetInstance().GetJson();
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_send(req, json.c_str(), json.size());
+    return ESP_OK;
+}
+
 esp_err_t ConfigServer::HandleReboot(httpd_req_t* req) {
     if (!CheckAuth(req)) return ESP_OK;
     httpd_resp_sendstr(req, "rebooting");
@@ -525,7 +594,7 @@ void ConfigServer::Start() {
 
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
     config.server_port = 80;
-    config.max_uri_handlers = 8;
+    config.max_uri_handlers = 10;
     config.stack_size = 8192;
 
     if (httpd_start(&server_, &config) != ESP_OK) {
@@ -536,6 +605,8 @@ void ConfigServer::Start() {
     static const httpd_uri_t routes[] = {
         { "/",           HTTP_GET,  HandleRoot,       nullptr },
         { "/api/config", HTTP_GET,  HandleGetConfig,  nullptr },
+        { "/api/memory", HTTP_GET,  HandleGetMemory,  nullptr },
+        { "/api/stats",  HTTP_GET,  HandleGetStats,   nullptr },
         { "/api/tools",  HTTP_POST, HandleSaveTools,  nullptr },
         { "/api/ha",     HTTP_POST, HandleSaveHa,     nullptr },
         { "/api/auth",   HTTP_POST, HandleSaveAuth,   nullptr },
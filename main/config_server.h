@@ -26,6 +26,8 @@ private:
     static esp_err_t HandleSaveHa(httpd_req_t* req);     // POST /api/ha
     static esp_err_t HandleSaveAuth(httpd_req_t* req);   // POST /api/auth
     static esp_err_t HandleReboot(httpd_req_t* req);     // POST /api/reboot
+    static esp_err_t HandleGetMemory(httpd_req_t* req);  // GET  /api/memory
+    static esp_err_t HandleGetStats(httpd_req_t* req);   // GET  /api/stats
 
     // HTTP Basic Auth 验证，失败时自动回 401
     static bool CheckAuth(httpd_req_t* req);
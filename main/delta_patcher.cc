@@ -0,0 +1,272 @@
+#include "delta_patcher.h"
+#include "memory_budget.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <miniz.h>
+
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+
+#define TAG "DeltaPatcher"
+
+#define DELTA_OUTPUT_BUFFER_SIZE 4096
+#define DELTA_SCRATCH_BUFFER_SIZE 1024
+
+enum DeltaOpcode {
+    kDeltaOpEnd = 0x00,
+    kDeltaOpCopy = 0x01,
+    kDeltaOpAdd = 0x02,
+    kDeltaOpInsert = 0x03,
+};
+
+static uint16_t ReadLe16(const uint8_t* p) {
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t ReadLe32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Prefer PSRAM for the inflate window, fall back to internal RAM on boards without it
+static void* AllocateBuffer(size_t size) {
+    auto& budget = MemoryBudget::GetInstance();
+    void* ptr = budget.Malloc(kMemoryTagNetwork, size, MALLOC_CAP_SPIRAM);
+    if (ptr == nullptr) {
+        ptr = budget.Malloc(kMemoryTagNetwork, size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    }
+    return ptr;
+}
+
+DeltaPatcher::DeltaPatcher(const DeltaPatchHeader& header, SourceReader reader, TargetWriter writer)
+    : header_(header), reader_(reader), writer_(writer) {
+}
+
+DeltaPatcher::~DeltaPatcher() {
+    auto& budget = MemoryBudget::GetInstance();
+    budget.Free(kMemoryTagNetwork, inflator_);
+    budget.Free(kMemoryTagNetwork, dictionary_);
+    budget.Free(kMemoryTagNetwork, output_);
+    budget.Free(kMemoryTagNetwork, scratch_);
+}
+
+bool DeltaPatcher::ParseHeader(const uint8_t* data, size_t size, DeltaPatchHeader& header) {
+    if (size < DELTA_PATCH_HEADER_SIZE || memcmp(data, DELTA_PATCH_MAGIC, 4) != 0) {
+        ESP_LOGE(TAG, "Invalid patch magic");
+        return false;
+    }
+    header.version = ReadLe16(data + 4);
+    header.flags = ReadLe16(data + 6);
+    header.source_size = ReadLe32(data + 8);
+    header.target_size = ReadLe32(data + 12);
+    memcpy(header.source_sha256, data + 16, 32);
+    memcpy(header.target_sha256, data + 48, 32);
+    if (header.version != DELTA_PATCH_VERSION) {
+        ESP_LOGE(TAG, "Unsupported patch version: %u", header.version);
+        return false;
+    }
+    return true;
+}
+
+bool DeltaPatcher::Initialize() {
+    inflator_ = (tinfl_decompressor*)AllocateBuffer(sizeof(tinfl_decompressor));
+    dictionary_ = (uint8_t*)AllocateBuffer(TINFL_LZ_DICT_SIZE);
+    output_ = (uint8_t*)AllocateBuffer(DELTA_OUTPUT_BUFFER_SIZE);
+    scratch_ = (uint8_t*)AllocateBuffer(DELTA_SCRATCH_BUFFER_SIZE);
+    if (inflator_ == nullptr || dictionary_ == nullptr || output_ == nullptr || scratch_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate patch buffers");
+        return false;
+    }
+    tinfl_init(inflator_);
+    return true;
+}
+
+bool DeltaPatcher::Feed(const uint8_t* data, size_t size) {
+    if (failed_) {
+        return false;
+    }
+    while (!stream_done_) {
+        size_t in_bytes = size;
+        size_t out_bytes = TINFL_LZ_DICT_SIZE - dictionary_offset_;
+        auto status = tinfl_decompress(inflator_, data, &in_bytes, dictionary_, dictionary_ + dictionary_offset_,
+            &out_bytes, TINFL_FLAG_PARSE_ZLIB_HEADER | TINFL_FLAG_COMPUTE_ADLER32 | TINFL_FLAG_HAS_MORE_INPUT);
+        data += in_bytes;
+        size -= in_bytes;
+
+        if (out_bytes > 0) {
+            if (!ProcessCommands(dictionary_ + dictionary_offset_, out_bytes)) {
+                failed_ = true;
+                return false;
+            }
+            dictionary_offset_ = (dictionary_offset_ + out_bytes) & (TINFL_LZ_DICT_SIZE - 1);
+        }
+
+        if (status < TINFL_STATUS_DONE) {
+            ESP_LOGE(TAG, "Inflate failed: %d", status);
+            failed_ = true;
+            return false;
+        }
+        if (status == TINFL_STATUS_DONE) {
+            stream_done_ = true;
+        } else if (status == TINFL_STATUS_NEEDS_MORE_INPUT && size == 0) {
+            break;
+        }
+    }
+    return true;
+}
+
+bool DeltaPatcher::Finish() {
+    if (failed_ || !FlushOutput()) {
+        return false;
+    }
+    if (!stream_done_ || state_ != kStateEnd) {
+        ESP_LOGE(TAG, "Patch stream is truncated");
+        return false;
+    }
+    if (target_written_ != header_.target_size) {
+        ESP_LOGE(TAG, "Target size mismatch: %u != %lu", target_written_, header_.target_size);
+        return false;
+    }
+    return true;
+}
+
+bool DeltaPatcher::ProcessCommands(const uint8_t* data, size_t size) {
+    while (size > 0) {
+        switch (state_) {
+        case kStateOpcode:
+            opcode_ = *data++;
+            size--;
+            arguments_size_ = 0;
+            if (opcode_ == kDeltaOpEnd) {
+                state_ = kStateEnd;
+                break;
+            }
+            if (opcode_ == kDeltaOpCopy || opcode_ == kDeltaOpAdd) {
+                arguments_needed_ = 8;
+            } else if (opcode_ == kDeltaOpInsert) {
+                arguments_needed_ = 4;
+            } else {
+                ESP_LOGE(TAG, "Unknown opcode 0x%02x", opcode_);
+                return false;
+            }
+            state_ = kStateArguments;
+            break;
+        case kStateArguments: {
+            size_t n = std::min(size, arguments_needed_ - arguments_size_);
+            memcpy(arguments_ + arguments_size_, data, n);
+            arguments_size_ += n;
+            data += n;
+            size -= n;
+            if (arguments_size_ == arguments_needed_ && !ExecuteCommand()) {
+                return false;
+            }
+            break;
+        }
+        case kStateAdd: {
+            size_t n = std::min({size, (size_t)remaining_, (size_t)DELTA_SCRATCH_BUFFER_SIZE});
+            if (!reader_(source_offset_, scratch_, n)) {
+                ESP_LOGE(TAG, "Failed to read source at 0x%lx", source_offset_);
+                return false;
+            }
+            for (size_t i = 0; i < n; i++) {
+                scratch_[i] += data[i];
+            }
+            if (!Emit(scratch_, n)) {
+                return false;
+            }
+            source_offset_ += n;
+            remaining_ -= n;
+            data += n;
+            size -= n;
+            if (remaining_ == 0) {
+                state_ = kStateOpcode;
+            }
+            break;
+        }
+        case kStateInsert: {
+            size_t n = std::min(size, (size_t)remaining_);
+            if (!Emit(data, n)) {
+                return false;
+            }
+            remaining_ -= n;
+            data += n;
+            size -= n;
+            if (remaining_ == 0) {
+                state_ = kStateOpcode;
+            }
+            break;
+        }
+        case kStateEnd:
+            ESP_LOGE(TAG, "Trailing data after end of patch");
+            return false;
+        }
+    }
+    return true;
+}
+
+bool DeltaPatcher::ExecuteCommand() {
+    if (opcode_ == kDeltaOpInsert) {
+        remaining_ = ReadLe32(arguments_);
+    } else {
+        source_offset_ = ReadLe32(arguments_);
+        remaining_ = ReadLe32(arguments_ + 4);
+        if (source_offset_ > header_.source_size || remaining_ > header_.source_size - source_offset_) {
+            ESP_LOGE(TAG, "Source range out of bounds: 0x%lx + %lu", source_offset_, remaining_);
+            return false;
+        }
+    }
+    if (remaining_ > header_.target_size - target_written()) {
+        ESP_LOGE(TAG, "Patch overflows the target image");
+        return false;
+    }
+
+    if (opcode_ == kDeltaOpCopy) {
+        // Copy needs no patch data, read the source straight into the output buffer
+        while (remaining_ > 0) {
+            if (output_size_ == DELTA_OUTPUT_BUFFER_SIZE && !FlushOutput()) {
+                return false;
+            }
+            size_t n = std::min((size_t)remaining_, (size_t)DELTA_OUTPUT_BUFFER_SIZE - output_size_);
+            if (!reader_(source_offset_, output_ + output_size_, n)) {
+                ESP_LOGE(TAG, "Failed to read source at 0x%lx", source_offset_);
+                return false;
+            }
+            output_size_ += n;
+            source_offset_ += n;
+            remaining_ -= n;
+        }
+        state_ = kStateOpcode;
+    } else if (remaining_ == 0) {
+        state_ = kStateOpcode;
+    } else {
+        state_ = opcode_ == kDeltaOpAdd ? kStateAdd : kStateInsert;
+    }
+    return true;
+}
+
+bool DeltaPatcher::Emit(const uint8_t* data, size_t size) {
+    while (size > 0) {
+        size_t n = std::min(size, (size_t)DELTA_OUTPUT_BUFFER_SIZE - output_size_);
+        memcpy(output_ + output_size_, data, n);
+        output_size_ += n;
+        data += n;
+        size -= n;
+        if (output_size_ == DELTA_OUTPUT_BUFFER_SIZE && !FlushOutput()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool DeltaPatcher::FlushOutput() {
+    if (output_size_ == 0) {
+        return true;
+    }
+    if (!writer_(output_, output_size_)) {
+        return false;
+    }
+    target_written_ += output_size_;
+    output_size_ = 0;
+    return true;
+}
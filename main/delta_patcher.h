@@ -0,0 +1,96 @@
+#ifndef _DELTA_PATCHER_H
+#define _DELTA_PATCHER_H
+
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * Streaming applier for binary delta firmware updates (see scripts/ota_delta.py).
+ *
+ * Patch layout (little endian):
+ *   header  magic "XZDP" | version u16 | flags u16 | source size u32 | target size u32 |
+ *           source sha256[32] | target sha256[32]
+ *   body    zlib stream of commands:
+ *           0x00 END
+ *           0x01 COPY   src_offset u32, length u32
+ *           0x02 ADD    src_offset u32, length u32, length bytes added (mod 256) to the source
+ *           0x03 INSERT length u32, length literal bytes
+ *
+ * The source image is read back from flash on demand and the target is emitted
+ * in order, so RAM usage is bounded by the inflate window and two small buffers.
+ */
+
+#define DELTA_PATCH_MAGIC "XZDP"
+#define DELTA_PATCH_VERSION 1
+#define DELTA_PATCH_HEADER_SIZE 80
+
+struct DeltaPatchHeader {
+    uint16_t version;
+    uint16_t flags;
+    uint32_t source_size;
+    uint32_t target_size;
+    uint8_t source_sha256[32];
+    uint8_t target_sha256[32];
+};
+
+struct tinfl_decompressor_tag;
+
+class DeltaPatcher {
+public:
+    using SourceReader = std::function<bool(size_t offset, uint8_t* data, size_t size)>;
+    using TargetWriter = std::function<bool(const uint8_t* data, size_t size)>;
+
+    DeltaPatcher(const DeltaPatchHeader& header, SourceReader reader, TargetWriter writer);
+    ~DeltaPatcher();
+
+    static bool ParseHeader(const uint8_t* data, size_t size, DeltaPatchHeader& header);
+
+    // Allocates the inflate state, returns false when out of memory
+    bool Initialize();
+    // Feed the compressed body as it arrives
+    bool Feed(const uint8_t* data, size_t size);
+    // Flush pending output, true if the whole target was produced
+    bool Finish();
+
+    size_t target_written() const { return target_written_ + output_size_; }
+
+private:
+    enum State {
+        kStateOpcode,
+        kStateArguments,
+        kStateAdd,
+        kStateInsert,
+        kStateEnd,
+    };
+
+    DeltaPatchHeader header_;
+    SourceReader reader_;
+    TargetWriter writer_;
+
+    tinfl_decompressor_tag* inflator_ = nullptr;
+    uint8_t* dictionary_ = nullptr;
+    size_t dictionary_offset_ = 0;
+    bool stream_done_ = false;
+
+    uint8_t* output_ = nullptr;
+    size_t output_size_ = 0;
+    uint8_t* scratch_ = nullptr;
+    size_t target_written_ = 0;
+
+    State state_ = kStateOpcode;
+    uint8_t opcode_ = 0;
+    uint8_t arguments_[8];
+    size_t arguments_size_ = 0;
+    size_t arguments_needed_ = 0;
+    uint32_t source_offset_ = 0;
+    uint32_t remaining_ = 0;
+    bool failed_ = false;
+
+    bool ProcessCommands(const uint8_t* data, size_t size);
+    bool ExecuteCommand();
+    bool Emit(const uint8_t* data, size_t size);
+    bool FlushOutput();
+};
+
+#endif // _DELTA_PATCHER_H
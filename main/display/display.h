@@ -39,6 +39,8 @@ public:
     virtual Theme* GetTheme() { return current_theme_; }
     virtual void UpdateStatusBar(bool update_all = false);
     virtual void SetPowerSaveMode(bool on);
+    // True when chat messages are appended to a history instead of replacing each other
+    virtual bool HasChatHistory() const { return false; }
 
     inline int width() const { return width_; }
     inline int height() const { return height_; }
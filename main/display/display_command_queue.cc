@@ -0,0 +1,141 @@
+#include "display_command_queue.h"
+#include "display.h"
+
+#include <esp_log.h>
+
+#include <algorithm>
+#include <vector>
+
+#define TAG "DisplayQueue"
+
+DisplayCommandQueue::~DisplayCommandQueue() {
+    if (task_ != nullptr) {
+        vTaskDelete(task_);
+    }
+}
+
+void DisplayCommandQueue::Start(Display* display) {
+    if (task_ != nullptr) {
+        return;
+    }
+    display_ = display;
+    chat_history_ = display->HasChatHistory();
+    xTaskCreate([](void* arg) {
+        ((DisplayCommandQueue*)arg)->Run();
+        vTaskDelete(nullptr);
+    }, "display_cmd", DISPLAY_QUEUE_TASK_STACK_SIZE, this, 2, &task_);
+    xTaskNotifyGive(task_);
+}
+
+void DisplayCommandQueue::SetStatus(const char* status) {
+    Post(kSlotStatus, status);
+}
+
+void DisplayCommandQueue::SetEmotion(const char* emotion) {
+    Post(kSlotEmotion, emotion);
+}
+
+void DisplayCommandQueue::SetChatMessage(const char* role, const char* content) {
+    Post(kSlotChatMessage, content, role);
+}
+
+void DisplayCommandQueue::ShowNotification(const char* notification, int duration_ms) {
+    Post(kSlotNotification, notification, "", duration_ms);
+}
+
+void DisplayCommandQueue::UpdateStatusBar(bool update_all) {
+    Post(kSlotStatusBar, "", "", update_all);
+}
+
+void DisplayCommandQueue::Post(Slot slot, std::string text, std::string role, int value) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        posted_++;
+        Command command = { slot, ++sequence_, std::move(text), std::move(role), value };
+        if (slot == kSlotChatMessage && chat_history_) {
+            if (chat_messages_.size() >= DISPLAY_QUEUE_MAX_CHAT_MESSAGES) {
+                chat_messages_.pop_front();
+                dropped_++;
+            }
+            chat_messages_.push_back(std::move(command));
+        } else {
+            auto& pending = slots_[slot];
+            if (pending.has_value()) {
+                // A pending full status bar update is not downgraded by a partial one
+                if (slot == kSlotStatusBar) {
+                    command.value |= pending->value;
+                }
+                coalesced_++;
+            }
+            pending = std::move(command);
+        }
+    }
+    // Commands posted before Start() are rendered once the task runs
+    if (task_ != nullptr) {
+        xTaskNotifyGive(task_);
+    }
+}
+
+void DisplayCommandQueue::Run() {
+    std::vector<Command> commands;
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto& slot : slots_) {
+                if (slot.has_value()) {
+                    commands.push_back(std::move(*slot));
+                    slot.reset();
+                }
+            }
+            while (!chat_messages_.empty()) {
+                commands.push_back(std::move(chat_messages_.front()));
+                chat_messages_.pop_front();
+            }
+        }
+
+        std::sort(commands.begin(), commands.end(), [](const Command& a, const Command& b) {
+            return a.sequence < b.sequence;
+        });
+        for (auto& command : commands) {
+            Render(command);
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            rendered_ += commands.size();
+        }
+        commands.clear();
+    }
+}
+
+void DisplayCommandQueue::Render(const Command& command) {
+    switch (command.slot) {
+        case kSlotStatus:
+            display_->SetStatus(command.text.c_str());
+            break;
+        case kSlotEmotion:
+            display_->SetEmotion(command.text.c_str());
+            break;
+        case kSlotChatMessage:
+            display_->SetChatMessage(command.role.c_str(), command.text.c_str());
+            break;
+        case kSlotNotification:
+            display_->ShowNotification(command.text.c_str(), command.value);
+            break;
+        case kSlotStatusBar:
+            display_->UpdateStatusBar(command.value != 0);
+            break;
+        default:
+            break;
+    }
+}
+
+void DisplayCommandQueue::LogStats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (posted_ == 0) {
+        return;
+    }
+    ESP_LOGI(TAG, "Display commands: %lu posted, %lu coalesced, %lu dropped, %lu rendered",
+        (unsigned long)posted_, (unsigned long)coalesced_, (unsigned long)dropped_, (unsigned long)rendered_);
+}
@@ -0,0 +1,90 @@
+#ifndef DISPLAY_COMMAND_QUEUE_H
+#define DISPLAY_COMMAND_QUEUE_H
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <string>
+
+class Display;
+
+// Chat messages kept while the display shows a history, older ones are dropped
+#define DISPLAY_QUEUE_MAX_CHAT_MESSAGES 16
+#define DISPLAY_QUEUE_TASK_STACK_SIZE 4096
+
+/*
+ * Display updates posted from the main loop without waiting for LVGL.
+ *
+ * Every widget has one pending slot: a burst of statuses, emotions,
+ * notifications or status bar refreshes is rendered once, with the last value.
+ * Chat messages are coalesced the same way unless the display keeps a message
+ * history (Display::HasChatHistory), then each of them is rendered in order.
+ * Pending commands are applied in the order they were last posted, so a
+ * status posted after a notification still replaces it.
+ *
+ * The commands are rendered by a low priority task, the display lock is taken
+ * there instead of in the caller.
+ */
+class DisplayCommandQueue {
+public:
+    DisplayCommandQueue() = default;
+    ~DisplayCommandQueue();
+
+    void Start(Display* display);
+
+    void SetStatus(const char* status);
+    void SetEmotion(const char* emotion);
+    void SetChatMessage(const char* role, const char* content);
+    void ShowNotification(const char* notification, int duration_ms = 3000);
+    void UpdateStatusBar(bool update_all = false);
+
+    uint32_t posted() const { return posted_; }
+    uint32_t coalesced() const { return coalesced_; }
+    // Chat messages dropped because the history was full, never rendered at all
+    uint32_t dropped() const { return dropped_; }
+    uint32_t rendered() const { return rendered_; }
+    void LogStats();
+
+private:
+    enum Slot {
+        kSlotStatus,
+        kSlotEmotion,
+        kSlotChatMessage,
+        kSlotNotification,
+        kSlotStatusBar,
+        kSlotCount,
+    };
+
+    struct Command {
+        Slot slot;
+        uint32_t sequence;
+        std::string text;
+        std::string role;
+        int value;
+    };
+
+    Display* display_ = nullptr;
+    TaskHandle_t task_ = nullptr;
+    bool chat_history_ = false;
+
+    std::mutex mutex_;
+    uint32_t sequence_ = 0;
+    std::array<std::optional<Command>, kSlotCount> slots_;
+    std::deque<Command> chat_messages_;
+
+    uint32_t posted_ = 0;
+    uint32_t coalesced_ = 0;
+    uint32_t dropped_ = 0;
+    uint32_t rendered_ = 0;
+
+    void Post(Slot slot, std::string text, std::string role = "", int value = 0);
+    void Run();
+    void Render(const Command& command);
+};
+
+#endif // DISPLAY_COMMAND_QUEUE_H
@@ -47,6 +47,9 @@ public:
     virtual void SetEmotion(const char* emotion) override;
     virtual void SetChatMessage(const char* role, const char* content) override; 
     virtual void SetPreviewImage(std::unique_ptr<LvglImage> image) override;
+#if CONFIG_USE_WECHAT_MESSAGE_STYLE
+    virtual bool HasChatHistory() const override { return true; }
+#endif
 
     // Add theme switching function
     virtual void SetTheme(Theme* theme) override;
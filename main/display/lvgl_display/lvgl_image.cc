@@ -1,4 +1,5 @@
 #include "lvgl_image.h"
+#include "memory_budget.h"
 #include <cbin_font.h>
 
 #include <esp_log.h>
@@ -58,7 +59,8 @@ LvglAllocatedImage::LvglAllocatedImage(void* data, size_t size, int width, int h
 
 LvglAllocatedImage::~LvglAllocatedImage() {
     if (image_dsc_.data) {
-        heap_caps_free((void*)image_dsc_.data);
+        // The buffers handed to this class are tagged display
+        MemoryBudget::GetInstance().Free(kMemoryTagDisplay, (void*)image_dsc_.data);
         image_dsc_.data = nullptr;
     }
 }
\ No newline at end of file
@@ -0,0 +1,195 @@
+#include "event_bus.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#include <cstring>
+
+#define TAG "EventBus"
+
+static_assert((EVENT_BUS_QUEUE_SIZE & (EVENT_BUS_QUEUE_SIZE - 1)) == 0, "EVENT_BUS_QUEUE_SIZE must be a power of two");
+
+static const char* const kTopicNames[] = {
+    "door_opened",
+    "fall_detected",
+    "presence_changed",
+    "station_reply",
+    "reminder_dismissed",
+};
+static_assert(sizeof(kTopicNames) / sizeof(kTopicNames[0]) == kEventTopicCount, "kTopicNames out of date");
+
+// FNV-1a, only compared with the previous event of the same topic
+static uint32_t HashText(const char* text) {
+    uint32_t hash = 2166136261u;
+    for (; *text; text++) {
+        hash = (hash ^ (uint8_t)*text) * 16777619u;
+    }
+    return hash;
+}
+
+// Copies at most size - 1 bytes without splitting a UTF-8 sequence
+static void CopyText(char* dest, size_t size, const char* text) {
+    size_t len = text != nullptr ? strlen(text) : 0;
+    if (len >= size) {
+        len = size - 1;
+        while (len > 0 && ((uint8_t)text[len] & 0xC0) == 0x80) {
+            len--;
+        }
+    }
+    if (len > 0) {
+        memcpy(dest, text, len);
+    }
+    dest[len] = '\0';
+}
+
+EventBus::EventBus() {
+    for (uint32_t i = 0; i < EVENT_BUS_QUEUE_SIZE; i++) {
+        cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+void EventBus::Start() {
+    if (task_.load() != nullptr) {
+        return;
+    }
+    TaskHandle_t task = nullptr;
+    xTaskCreate([](void* arg) {
+        ((EventBus*)arg)->Run();
+        vTaskDelete(nullptr);
+    }, "event_bus", EVENT_BUS_TASK_STACK_SIZE, this, 2, &task);
+    task_.store(task);
+    // Events published before Start() are waiting
+    xTaskNotifyGive(task);
+}
+
+void EventBus::Subscribe(EventTopic topic, std::function<void(const BusEvent&)> callback) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    topics_[topic].subscribers.push_back(std::move(callback));
+}
+
+void EventBus::SetPolicy(EventTopic topic, int min_interval_ms, int dedup_window_ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    topics_[topic].min_interval_us = (int64_t)min_interval_ms * 1000;
+    topics_[topic].dedup_window_us = (int64_t)dedup_window_ms * 1000;
+}
+
+bool EventBus::Publish(EventTopic topic, int32_t value, const char* text) {
+    if (topic >= kEventTopicCount) {
+        return false;
+    }
+    topics_[topic].published.fetch_add(1, std::memory_order_relaxed);
+
+    // Claim a cell: its sequence equals the position when it is free
+    Cell* cell;
+    uint32_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    while (true) {
+        cell = &cells_[pos & (EVENT_BUS_QUEUE_SIZE - 1)];
+        uint32_t sequence = cell->sequence.load(std::memory_order_acquire);
+        int32_t diff = (int32_t)(sequence - pos);
+        if (diff == 0) {
+            if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            overflows_.fetch_add(1, std::memory_order_relaxed);
+            ESP_LOGW(TAG, "Queue full, %s event dropped", kTopicNames[topic]);
+            return false;
+        } else {
+            pos = enqueue_pos_.load(std::memory_order_relaxed);
+        }
+    }
+
+    cell->event.topic = topic;
+    cell->event.value = value;
+    cell->event.timestamp_us = esp_timer_get_time();
+    CopyText(cell->event.text, sizeof(cell->event.text), text);
+    cell->sequence.store(pos + 1, std::memory_order_release);
+
+    TaskHandle_t task = task_.load();
+    if (task != nullptr) {
+        xTaskNotifyGive(task);
+    }
+    return true;
+}
+
+bool EventBus::Pop(BusEvent& event) {
+    Cell* cell = &cells_[dequeue_pos_ & (EVENT_BUS_QUEUE_SIZE - 1)];
+    if (cell->sequence.load(std::memory_order_acquire) != dequeue_pos_ + 1) {
+        return false;
+    }
+    event = cell->event;
+    cell->sequence.store(dequeue_pos_ + EVENT_BUS_QUEUE_SIZE, std::memory_order_release);
+    dequeue_pos_++;
+    return true;
+}
+
+void EventBus::Run() {
+    BusEvent event;
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        while (Pop(event)) {
+            Dispatch(event);
+        }
+    }
+}
+
+void EventBus::Dispatch(const BusEvent& event) {
+    auto& topic = topics_[event.topic];
+    int64_t latency = esp_timer_get_time() - event.timestamp_us;
+    uint32_t text_hash = HashText(event.text);
+
+    std::vector<std::function<void(const BusEvent&)>> subscribers;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (topic.delivered_once) {
+            int64_t elapsed = event.timestamp_us - topic.last_timestamp_us;
+            if (elapsed < topic.min_interval_us) {
+                topic.rate_limited.fetch_add(1, std::memory_order_relaxed);
+                ESP_LOGD(TAG, "%s rate limited", kTopicNames[event.topic]);
+                return;
+            }
+            if (elapsed < topic.dedup_window_us && event.value == topic.last_value && text_hash == topic.last_text_hash) {
+                topic.duplicates.fetch_add(1, std::memory_order_relaxed);
+                ESP_LOGD(TAG, "%s duplicate dropped", kTopicNames[event.topic]);
+                return;
+            }
+        }
+        topic.delivered_once = true;
+        topic.last_timestamp_us = event.timestamp_us;
+        topic.last_value = event.value;
+        topic.last_text_hash = text_hash;
+        subscribers = topic.subscribers;
+    }
+
+    topic.delivered.fetch_add(1, std::memory_order_relaxed);
+    topic.latency_total_us.fetch_add(latency, std::memory_order_relaxed);
+    if (latency > topic.latency_max_us.load(std::memory_order_relaxed)) {
+        topic.latency_max_us.store(latency, std::memory_order_relaxed);
+    }
+    ESP_LOGI(TAG, "%s value=%ld dispatched after %lld us", kTopicNames[event.topic], (long)event.value, latency);
+
+    for (auto& callback : subscribers) {
+        callback(event);
+    }
+}
+
+void EventBus::LogStats() {
+    for (int i = 0; i < kEventTopicCount; i++) {
+        auto& topic = topics_[i];
+        uint32_t published = topic.published.load(std::memory_order_relaxed);
+        if (published == 0) {
+            continue;
+        }
+        uint32_t delivered = topic.delivered.load(std::memory_order_relaxed);
+        int64_t average = delivered > 0 ? topic.latency_total_us.load(std::memory_order_relaxed) / delivered : 0;
+        ESP_LOGI(TAG, "%s: %lu published, %lu delivered, %lu rate limited, %lu duplicates, latency avg %lld us max %lld us",
+            kTopicNames[i], (unsigned long)published, (unsigned long)delivered,
+            (unsigned long)topic.rate_limited.load(std::memory_order_relaxed),
+            (unsigned long)topic.duplicates.load(std::memory_order_relaxed),
+            average, topic.latency_max_us.load(std::memory_order_relaxed));
+    }
+    uint32_t overflows = overflows_.load(std::memory_order_relaxed);
+    if (overflows > 0) {
+        ESP_LOGW(TAG, "%lu events dropped on a full queue", (unsigned long)overflows);
+    }
+}
@@ -0,0 +1,110 @@
+#ifndef EVENT_BUS_H
+#define EVENT_BUS_H
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+// Queue slots, a power of two
+#define EVENT_BUS_QUEUE_SIZE 32
+// Text carried by an event, longer text is cut at a UTF-8 character boundary
+#define EVENT_BUS_TEXT_SIZE 128
+#define EVENT_BUS_TASK_STACK_SIZE 4096
+
+enum EventTopic : uint16_t {
+    kEventDoorOpened,           // Door sensor went from closed to open
+    kEventFallDetected,         // text: the vision analysis
+    kEventPresenceChanged,      // value: 1 sat or lay down, 0 left
+    kEventStationReply,         // text: msg_id of the reply
+    kEventReminderDismissed,    // value: reminder id, the subscriber looks its message up
+    kEventTopicCount,
+};
+
+struct BusEvent {
+    EventTopic topic;
+    int32_t value;
+    int64_t timestamp_us;       // esp_timer_get_time() when published
+    char text[EVENT_BUS_TEXT_SIZE];
+};
+
+/*
+ * Publish/subscribe bus shared by the sensor and monitor producers.
+ *
+ * Publish() copies a fixed size record into a bounded lock-free queue (many
+ * producers, one consumer) and wakes the dispatcher task, it never blocks and
+ * never allocates. A full queue drops the event and counts it.
+ *
+ * The dispatcher applies the topic policy before calling the subscribers:
+ * events closer than min_interval_ms to the last delivered one are dropped
+ * (alert cooldowns), and an event equal to the last delivered one, same value
+ * and text, is dropped within dedup_window_ms. The time from Publish() to the
+ * dispatch is recorded per topic.
+ *
+ * Subscribers run one after the other in the dispatcher task, they should hand
+ * long work to Application::Schedule() or their own task.
+ */
+class EventBus {
+public:
+    static EventBus& GetInstance() {
+        static EventBus instance;
+        return instance;
+    }
+
+    void Start();
+    void Subscribe(EventTopic topic, std::function<void(const BusEvent&)> callback);
+    void SetPolicy(EventTopic topic, int min_interval_ms, int dedup_window_ms);
+
+    // Safe from any task, returns false when the queue is full
+    bool Publish(EventTopic topic, int32_t value = 0, const char* text = nullptr);
+
+    void LogStats();
+
+private:
+    EventBus();
+    EventBus(const EventBus&) = delete;
+    EventBus& operator=(const EventBus&) = delete;
+
+    struct Cell {
+        std::atomic<uint32_t> sequence;
+        BusEvent event;
+    };
+
+    struct TopicState {
+        std::vector<std::function<void(const BusEvent&)>> subscribers;
+        int64_t min_interval_us = 0;
+        int64_t dedup_window_us = 0;
+        // Last delivered event, for the policy
+        int64_t last_timestamp_us = 0;
+        int32_t last_value = 0;
+        uint32_t last_text_hash = 0;
+        bool delivered_once = false;
+        // Statistics
+        std::atomic<uint32_t> published{0};
+        std::atomic<uint32_t> rate_limited{0};
+        std::atomic<uint32_t> duplicates{0};
+        std::atomic<uint32_t> delivered{0};
+        std::atomic<int64_t> latency_total_us{0};
+        std::atomic<int64_t> latency_max_us{0};
+    };
+
+    std::array<Cell, EVENT_BUS_QUEUE_SIZE> cells_;
+    std::atomic<uint32_t> enqueue_pos_{0};
+    uint32_t dequeue_pos_ = 0;
+    std::atomic<uint32_t> overflows_{0};
+
+    std::mutex mutex_;
+    std::array<TopicState, kEventTopicCount> topics_;
+    std::atomic<TaskHandle_t> task_{nullptr};
+
+    bool Pop(BusEvent& event);
+    void Run();
+    void Dispatch(const BusEvent& event);
+};
+
+#endif // EVENT_BUS_H
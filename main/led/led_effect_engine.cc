@@ -0,0 +1,258 @@
+#include "led_effect_engine.h"
+
+#include <esp_log.h>
+
+#include <algorithm>
+#include <cstdlib>
+
+#define TAG "LedEffectEngine"
+
+// Fast attack and a release over a few frames, audio levels only change once per audio frame
+// Wide enough for the 0-32768 average as well as the 0-255 levels
+static uint16_t SmoothLevel(uint16_t current, uint16_t target) {
+    return target >= current ? target : current - (current - target + 3) / 4;
+}
+
+LedEffectEngine::LedEffectEngine(led_strip_handle_t strip, int count, int fps)
+    : strip_(strip), count_(count), frame_interval_us_(1000000 / std::max(fps, 1)),
+      front_(count), back_(count) {
+    esp_timer_create_args_t timer_args = {
+        .callback = [](void* arg) {
+            auto engine = static_cast<LedEffectEngine*>(arg);
+            engine->OnFrame();
+        },
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "led_effect",
+        .skip_unhandled_events = true,
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &timer_));
+}
+
+LedEffectEngine::~LedEffectEngine() {
+    esp_timer_stop(timer_);
+    esp_timer_delete(timer_);
+    if (audio_reactive_) {
+        OutputLevelMeter::GetInstance().Release();
+    }
+}
+
+void LedEffectEngine::SetEffect(std::vector<LedKernel> kernels, bool animated, bool audio_reactive) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    StopTimer();
+    if (audio_reactive != audio_reactive_) {
+        auto& meter = OutputLevelMeter::GetInstance();
+        audio_reactive ? meter.Acquire() : meter.Release();
+        audio_reactive_ = audio_reactive;
+    }
+
+    kernels_ = std::move(kernels);
+    context_ = LedFrameContext();
+    start_time_ = esp_timer_get_time();
+    // The first frame is shown right away rather than one interval later
+    RenderFrame();
+    if (animated && !context_.finished) {
+        ESP_ERROR_CHECK(esp_timer_start_periodic(timer_, frame_interval_us_));
+        timer_running_ = true;
+    }
+}
+
+void LedEffectEngine::SetEffect(LedKernel kernel, bool animated, bool audio_reactive) {
+    SetEffect(std::vector<LedKernel>{std::move(kernel)}, animated, audio_reactive);
+}
+
+void LedEffectEngine::Fill(StripColor color) {
+    SetEffect(led_effects::Fill(color), false);
+}
+
+void LedEffectEngine::SetPixel(int index, StripColor color) {
+    SetEffect(led_effects::Pixel(index, color), false);
+}
+
+void LedEffectEngine::Clear() {
+    Fill(StripColor());
+}
+
+LedEffectEngine::Stats LedEffectEngine::GetStats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats stats;
+    stats.frames = frames_;
+    stats.refreshes = refreshes_;
+    stats.average_us = frames_ > 0 ? (uint32_t)(render_time_us_ / frames_) : 0;
+    stats.max_us = max_render_time_us_;
+    return stats;
+}
+
+void LedEffectEngine::StopTimer() {
+    if (timer_running_) {
+        esp_timer_stop(timer_);
+        timer_running_ = false;
+    }
+}
+
+void LedEffectEngine::OnFrame() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!timer_running_) {
+        return;
+    }
+    RenderFrame();
+    if (context_.finished) {
+        StopTimer();
+    }
+}
+
+void LedEffectEngine::RenderFrame() {
+    int64_t begin = esp_timer_get_time();
+    context_.time_ms = (uint32_t)((begin - start_time_) / 1000);
+    if (audio_reactive_) {
+        auto levels = OutputLevelMeter::GetInstance().GetLevels();
+        context_.audio.rms = SmoothLevel(context_.audio.rms, levels.rms);
+        context_.audio.average = SmoothLevel(context_.audio.average, levels.average);
+        for (int i = 0; i < OUTPUT_LEVEL_BAND_COUNT; i++) {
+            context_.audio.bands[i] = SmoothLevel(context_.audio.bands[i], levels.bands[i]);
+        }
+    }
+
+    std::copy(front_.begin(), front_.end(), back_.begin());
+    for (auto& kernel : kernels_) {
+        kernel(context_, back_.data(), count_);
+    }
+
+    // Only changed pixels are written, and the strip is only refreshed if something changed
+    bool changed = false;
+    for (int i = 0; i < count_; i++) {
+        if (!(back_[i] == front_[i])) {
+            led_strip_set_pixel(strip_, i, back_[i].red, back_[i].green, back_[i].blue);
+            changed = true;
+        }
+    }
+    if (changed) {
+        led_strip_refresh(strip_);
+        std::swap(front_, back_);
+        refreshes_++;
+    }
+    context_.frame++;
+
+    uint32_t elapsed = (uint32_t)(esp_timer_get_time() - begin);
+    frames_++;
+    render_time_us_ += elapsed;
+    max_render_time_us_ = std::max(max_render_time_us_, elapsed);
+}
+
+namespace led_effects {
+
+LedKernel Fill(StripColor color) {
+    return [color](LedFrameContext& context, StripColor* pixels, int count) {
+        std::fill(pixels, pixels + count, color);
+    };
+}
+
+LedKernel Pixel(int index, StripColor color) {
+    return [index, color](LedFrameContext& context, StripColor* pixels, int count) {
+        if (index >= 0 && index < count) {
+            pixels[index] = color;
+        }
+    };
+}
+
+LedKernel Blink(StripColor color, int interval_ms) {
+    interval_ms = std::max(interval_ms, 1);
+    return [color, interval_ms](LedFrameContext& context, StripColor* pixels, int count) {
+        bool on = (context.time_ms / interval_ms) % 2 == 0;
+        std::fill(pixels, pixels + count, on ? color : StripColor());
+    };
+}
+
+LedKernel Breathe(StripColor low, StripColor high, int interval_ms) {
+    interval_ms = std::max(interval_ms, 1);
+    int span = std::max({std::abs(high.red - low.red), std::abs(high.green - low.green),
+        std::abs(high.blue - low.blue)});
+    return [low, high, interval_ms, span](LedFrameContext& context, StripColor* pixels, int count) {
+        if (span == 0) {
+            std::fill(pixels, pixels + count, low);
+            return;
+        }
+        // Triangle wave over 2 * span steps, each channel saturates at its own bound
+        int phase = (context.time_ms / interval_ms) % (2 * span);
+        auto channel = [phase, span](int from, int to) {
+            int distance = std::abs(to - from);
+            int direction = to >= from ? 1 : -1;
+            if (phase <= span) {
+                return (uint8_t)(from + direction * std::min(phase, distance));
+            }
+            return (uint8_t)(to - direction * std::min(phase - span, distance));
+        };
+        StripColor color = {channel(low.red, high.red), channel(low.green, high.green), channel(low.blue, high.blue)};
+        std::fill(pixels, pixels + count, color);
+    };
+}
+
+LedKernel Scroll(StripColor low, StripColor high, int length, int interval_ms) {
+    interval_ms = std::max(interval_ms, 1);
+    return [low, high, length, interval_ms](LedFrameContext& context, StripColor* pixels, int count) {
+        std::fill(pixels, pixels + count, low);
+        int offset = (context.time_ms / interval_ms) % count;
+        for (int j = 0; j < length && j < count; j++) {
+            pixels[(offset + j) % count] = high;
+        }
+    };
+}
+
+LedKernel FadeOut(int interval_ms) {
+    interval_ms = std::max(interval_ms, 1);
+    uint32_t last_step = 0;
+    return [interval_ms, last_step](LedFrameContext& context, StripColor* pixels, int count) mutable {
+        uint32_t step = context.time_ms / interval_ms;
+        bool all_off = true;
+        for (int i = 0; i < count; i++) {
+            // Catch up on missed steps, a shift per step keeps the same curve at any frame rate
+            int shift = std::min<uint32_t>(step - last_step, 8);
+            pixels[i].red >>= shift;
+            pixels[i].green >>= shift;
+            pixels[i].blue >>= shift;
+            if (pixels[i].red != 0 || pixels[i].green != 0 || pixels[i].blue != 0) {
+                all_off = false;
+            }
+        }
+        last_step = step;
+        context.finished = all_off;
+    };
+}
+
+LedKernel Brightness(int percent) {
+    percent = std::min(std::max(percent, 0), 100);
+    return [percent](LedFrameContext& context, StripColor* pixels, int count) {
+        for (int i = 0; i < count; i++) {
+            pixels[i].red = pixels[i].red * percent / 100;
+            pixels[i].green = pixels[i].green * percent / 100;
+            pixels[i].blue = pixels[i].blue * percent / 100;
+        }
+    };
+}
+
+LedKernel AudioMeter(std::vector<StripColor> colors, MeterMode mode, int level_step) {
+    return [colors, mode, level_step](LedFrameContext& context, StripColor* pixels, int count) {
+        int lit = level_step > 0 ? std::min(context.audio.average / level_step, count) : context.audio.rms * count / 255;
+        auto color = [&colors](int i) {
+            return colors.empty() ? StripColor{255, 255, 255} : colors[i % colors.size()];
+        };
+        for (int i = 0; i < count; i++) {
+            bool on;
+            if (mode == kMeterLeftToRight) {
+                on = i < lit;
+            } else if (mode == kMeterCenterOut) {
+                int center = count / 2;
+                int half = lit / 2;
+                on = i >= center - half && (lit % 2 == 0 ? i < center + half : i <= center + half);
+            } else {
+                // Sides in: alternate between the left and the right end
+                int distance = std::min(i, count - 1 - i);
+                int order = 2 * distance + (i > count - 1 - i ? 1 : 0);
+                on = order < lit;
+            }
+            pixels[i] = on ? color(i) : StripColor();
+        }
+    };
+}
+
+} // namespace led_effects
@@ -0,0 +1,117 @@
+#ifndef _LED_EFFECT_ENGINE_H_
+#define _LED_EFFECT_ENGINE_H_
+
+#include <led_strip.h>
+#include <esp_timer.h>
+#include <functional>
+#include <mutex>
+#include <vector>
+#include <cstdint>
+
+#include "output_level_meter.h"
+
+#define LED_EFFECT_DEFAULT_FPS 50
+
+struct StripColor {
+    uint8_t red = 0, green = 0, blue = 0;
+};
+
+inline bool operator==(const StripColor& a, const StripColor& b) {
+    return a.red == b.red && a.green == b.green && a.blue == b.blue;
+}
+
+struct LedFrameContext {
+    uint32_t frame = 0;         // Frames since the effect started
+    uint32_t time_ms = 0;       // Time since the effect started, effects should animate on this
+    OutputLevels audio;         // Smoothed speaker levels, only filled for audio reactive effects
+    bool finished = false;      // Set by a kernel to stop the scheduler after this frame
+};
+
+/*
+ * A kernel renders or modifies the pixels of one frame in place. On entry the
+ * buffer holds the frame currently on the strip, so kernels can draw over it,
+ * fade it or shift it, and several kernels can be stacked into one effect
+ * (for example a pattern followed by a brightness or audio mask).
+ */
+using LedKernel = std::function<void(LedFrameContext& context, StripColor* pixels, int count)>;
+
+/*
+ * Single frame scheduler for an addressable strip.
+ *
+ * One esp_timer renders the active effect at a fixed frame rate into a back
+ * buffer; the strip is only refreshed when the frame differs from the one on
+ * display. Static effects render once and stop the timer. The render time of
+ * every frame is accounted, see GetStats().
+ */
+class LedEffectEngine {
+public:
+    struct Stats {
+        uint32_t frames;
+        uint32_t refreshes;
+        uint32_t average_us;
+        uint32_t max_us;
+    };
+
+    LedEffectEngine(led_strip_handle_t strip, int count, int fps = LED_EFFECT_DEFAULT_FPS);
+    ~LedEffectEngine();
+
+    // Replaces the running effect, the kernels run in order on every frame
+    void SetEffect(std::vector<LedKernel> kernels, bool animated = true, bool audio_reactive = false);
+    void SetEffect(LedKernel kernel, bool animated = true, bool audio_reactive = false);
+    void Fill(StripColor color);
+    void SetPixel(int index, StripColor color);
+    void Clear();
+
+    int count() const { return count_; }
+    Stats GetStats();
+
+private:
+    std::mutex mutex_;
+    led_strip_handle_t strip_;
+    int count_;
+    int64_t frame_interval_us_;
+    esp_timer_handle_t timer_ = nullptr;
+    bool timer_running_ = false;
+
+    std::vector<StripColor> front_;     // Pixels on the strip
+    std::vector<StripColor> back_;      // Pixels being rendered
+    std::vector<LedKernel> kernels_;
+    LedFrameContext context_;
+    int64_t start_time_ = 0;
+    bool audio_reactive_ = false;
+
+    uint32_t frames_ = 0;
+    uint32_t refreshes_ = 0;
+    uint64_t render_time_us_ = 0;
+    uint32_t max_render_time_us_ = 0;
+
+    void OnFrame();
+    void RenderFrame();
+    void StopTimer();
+};
+
+// Stock kernels, colors are final (already scaled to the wanted brightness)
+namespace led_effects {
+    LedKernel Fill(StripColor color);
+    LedKernel Pixel(int index, StripColor color);
+    LedKernel Blink(StripColor color, int interval_ms);
+    // Steps every channel by one per interval from low to high and back
+    LedKernel Breathe(StripColor low, StripColor high, int interval_ms);
+    // length pixels of high moving over low, one pixel per interval
+    LedKernel Scroll(StripColor low, StripColor high, int length, int interval_ms);
+    // Halves the current frame every interval and finishes when dark
+    LedKernel FadeOut(int interval_ms);
+    // Scales the frame by percent (0-100)
+    LedKernel Brightness(int percent);
+
+    enum MeterMode {
+        kMeterLeftToRight = 0,
+        kMeterCenterOut = 1,
+        kMeterSidesIn = 2,
+    };
+    // Lights a share of the pixels proportional to the speaker RMS, pixel i uses colors[i].
+    // With level_step, one pixel per level_step of mean |pcm| instead, not scaled to the strip
+    LedKernel AudioMeter(std::vector<StripColor> colors, MeterMode mode, int level_step = 0);
+}
+
+#endif // _LED_EFFECT_ENGINE_H_
@@ -9,6 +9,8 @@
 #include "esp_websocket_client.h"
 #include "cJSON.h"
 #include "application.h"
+#include "sensor_ingest.h"
+#include "event_bus.h"
 #include "wifi_station.h"
 #include "nvs_flash.h"
 #include "esp_event.h"
@@ -27,6 +29,7 @@ static bool g_is_sitting = false;
 static int64_t g_sit_start_time = 0;
 static bool g_has_alerted = false;
 static esp_websocket_client_handle_t g_ws_client = NULL;
+static SensorIngest g_ws_ingest;
 
 // ===================== 辅助功能 =====================
 
@@ -136,72 +139,52 @@ bool perform_login() {
 
 // ===================== WebSocket 模块 =====================
 
-// ===================== [修正后的消息处理逻辑] =====================
+// ===================== [修正后的消息处理逻辑：流式解析] =====================
 
-// ===================== [修正后的消息处理逻辑：支持 Unicode 转义] =====================
-
-void handle_ws_message(const char *payload) {
+void handle_ws_message(const SensorMessage& message) {
     // 仅打印前80字节，避免 base64 图片数据刷屏
-    ESP_LOGI(TAG, "📩 [消息] %.80s%s", payload, strlen(payload) > 80 ? "..." : "");
+    ESP_LOGI(TAG, "📩 [消息] %s%s (%u 字节, 跳过 %d 个大字段)", message.head.c_str(),
+        message.size > message.head.size() ? "..." : "", (unsigned)message.size, message.skipped_values);
 
     // 1. 处理心跳
-    cJSON *root = cJSON_Parse(payload);
-    if (root) {
-        cJSON *params = cJSON_GetObjectItem(root, "parameters");
-        if (params) {
-            cJSON *info = cJSON_GetObjectItem(params, "info");
-            if (cJSON_IsString(info) && strcmp(info->valuestring, "alive") == 0) {
-                const char *pong_msg = "{\"type\":0,\"info\":\"ok\"}";
-                if (g_ws_client && esp_websocket_client_is_connected(g_ws_client)) {
-                    esp_websocket_client_send_text(g_ws_client, pong_msg, strlen(pong_msg), portMAX_DELAY);
-                    ESP_LOGD(TAG, "❤️ 回复心跳");
-                }
-                cJSON_Delete(root);
-                return;
-            }
+    if (message.info == "alive") {
+        const char *pong_msg = "{\"type\":0,\"info\":\"ok\"}";
+        if (g_ws_client && esp_websocket_client_is_connected(g_ws_client)) {
+            esp_websocket_client_send_text(g_ws_client, pong_msg, strlen(pong_msg), portMAX_DELAY);
+            ESP_LOGD(TAG, "❤️ 回复心跳");
         }
-        cJSON_Delete(root);
+        return;
     }
 
-    // 2. 业务逻辑 - 改用【转义字符匹配法】
-    // 服务器发送的是 Unicode 编码，例如 "\u5728\u5750" 代表 "在坐"
-    // 我们直接匹配这些编码字符串
-    
-    // 关键词："\u5728\u5750" (在坐) 或者 "\u5728\u5367" (在卧)
-    // 注意：在C语言字符串里，反斜杠需要写两次 "\\"
-    bool is_sitting_msg = (strstr(payload, "\\u5728\\u5750") != NULL) || 
-                          (strstr(payload, "\\u5728\\u5367") != NULL);
-
-    // 关键词："\u79bb\u5750" (离坐) 或者 "\u79bb\u5367" (离卧)
-    bool is_leave_msg = (strstr(payload, "\\u79bb\\u5750") != NULL) || 
-                        (strstr(payload, "\\u79bb\\u5367") != NULL);
+    // 2. 业务逻辑：只发布事件，不在 WS 任务里等待和调用 AI
+    // SensorIngest 已在解析时解码并匹配了在坐/在卧、离坐/离卧
+    if (message.presence == kSensorPresenceArrived) {
+        ESP_LOGI(TAG, "🔔 匹配到：在坐/在卧");
+        EventBus::GetInstance().Publish(kEventPresenceChanged, 1);
+    } else if (message.presence == kSensorPresenceLeft) {
+        ESP_LOGI(TAG, "🔔 匹配到：离坐/离卧");
+        EventBus::GetInstance().Publish(kEventPresenceChanged, 0);
+    }
+}
 
+// 坐下/离开的状态机，在事件总线任务中执行
+void handle_presence_event(const BusEvent& event) {
     // --- 场景 A: 坐下 ---
-    if (is_sitting_msg) {
-        ESP_LOGI(TAG, "🔔 匹配到：在坐/在卧 (Unicode)");
-
+    if (event.value == 1) {
         if (!g_is_sitting) {
             g_is_sitting = true;
             g_sit_start_time = get_time_ms();
             g_has_alerted = false;
             ESP_LOGI(TAG, "👇 状态更新：已坐下，触发 AI...");
-
-            // 短暂等待让网络栈处理当前帧，避免瞬间拥堵
-            vTaskDelay(pdMS_TO_TICKS(200));
-
             send_to_ai("系统检测到主人刚刚坐下了。请用热情、温暖的语气问候主人，并询问是否需要打开电视或打开窗帘？");
         }
     }
     // --- 场景 B: 离开 ---
-    else if (is_leave_msg) {
-        ESP_LOGI(TAG, "🔔 匹配到：离坐/离卧 (Unicode)");
-        
-        if (g_is_sitting) {
-            int64_t duration = (get_time_ms() - g_sit_start_time) / 1000;
-            ESP_LOGI(TAG, "👆 状态更新：已离开，共坐了 %lld 秒", duration);
-            g_is_sitting = false;
-            g_has_alerted = false;
-        }
+    else if (g_is_sitting) {
+        int64_t duration = (get_time_ms() - g_sit_start_time) / 1000;
+        ESP_LOGI(TAG, "👆 状态更新：已离开，共坐了 %lld 秒", duration);
+        g_is_sitting = false;
+        g_has_alerted = false;
     }
 }
 
@@ -217,18 +200,13 @@ static void websocket_event_handler(void *handler_args, esp_event_base_t base, i
             }
             break;
         case WEBSOCKET_EVENT_DATA:
-            if (data->op_code == 1 && data->data_len > 0) {
-                char *buf = (char *)malloc(data->data_len + 1);
-                if (buf) {
-                    memcpy(buf, data->data_ptr, data->data_len);
-                    buf[data->data_len] = 0;
-                    handle_ws_message(buf);
-                    free(buf);
-                }
-            }
+            // 大帧会分多次回调，交给 SensorIngest 按 payload_offset 拼接，不再逐段拷贝解析
+            g_ws_ingest.Feed(data->op_code, data->fin, data->data_ptr, data->data_len,
+                data->payload_offset, data->payload_len);
             break;
         case WEBSOCKET_EVENT_DISCONNECTED:
             ESP_LOGW(TAG, "🔌 WS 连接断开");
+            g_ws_ingest.Reset();
             break;
     }
 }
@@ -244,6 +222,10 @@ void sensor_monitor_task(void *pvParameters) {
     }
     ESP_LOGI(TAG, "✅ WiFi 已连接，开始监控...");
 
+    // 服务器会重复推送同一状态，10 秒内相同的状态只处理一次
+    EventBus::GetInstance().SetPolicy(kEventPresenceChanged, 0, 10000);
+    EventBus::GetInstance().Subscribe(kEventPresenceChanged, handle_presence_event);
+
     // 1. 登录循环
     while (1) {
         if (perform_login()) break;
@@ -262,6 +244,7 @@ void sensor_monitor_task(void *pvParameters) {
     ESP_LOGI(TAG, "⏳ 准备连接 WebSocket...");
     g_ws_client = esp_websocket_client_init(&ws_cfg);
     esp_websocket_register_events(g_ws_client, WEBSOCKET_EVENT_ANY, websocket_event_handler, (void *)g_ws_client);
+    g_ws_ingest.OnMessage(handle_ws_message);
     esp_websocket_client_start(g_ws_client);
 
     // 3. 监控久坐
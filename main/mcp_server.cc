@@ -18,6 +18,7 @@
 #include "settings.h"
 #include "lvgl_theme.h"
 #include "lvgl_display.h"
+#include "memory_budget.h"
 
 #define TAG "MCP"
 
@@ -44,7 +45,7 @@ void McpServer::AddCommonTools() {
     // Custom tools must be added in the board's InitializeTools function.
 
     AddTool("self.get_device_status",
-        "Provides the real-time information of the device, including the current status of the audio speaker, screen, battery, network, etc.\n"
+        "Provides the real-time information of the device, including the current status of the audio speaker, screen, battery, network, free memory, etc.\n"
         "Use this tool for: \n"
         "1. Answering questions about current condition (e.g. what is the current volume of the audio speaker?)\n"
         "2. As the first step to control the device (e.g. turn up / down the volume of the audio speaker, etc.)",
@@ -261,7 +262,8 @@ void McpServer::AddUserOnlyTools() {
                 }
 
                 size_t content_length = http->GetBodyLength();
-                char* data = (char*)heap_caps_malloc(content_length, MALLOC_CAP_8BIT);
+                auto& budget = MemoryBudget::GetInstance();
+                char* data = (char*)budget.Malloc(kMemoryTagMcp, content_length, MALLOC_CAP_8BIT);
                 if (data == nullptr) {
                     throw std::runtime_error("Failed to allocate memory for image: " + url);
                 }
@@ -269,7 +271,7 @@ void McpServer::AddUserOnlyTools() {
                 while (total_read < content_length) {
                     int ret = http->Read(data + total_read, content_length - total_read);
                     if (ret < 0) {
-                        heap_caps_free(data);
+                        budget.Free(kMemoryTagMcp, data);
                         throw std::runtime_error("Failed to download image: " + url);
                     }
                     if (ret == 0) {
@@ -280,6 +282,8 @@ void McpServer::AddUserOnlyTools() {
                 http->Close();
 
                 auto image = std::make_unique<LvglAllocatedImage>(data, content_length);
+                // The image owns the buffer from now on
+                budget.Retag(kMemoryTagMcp, kMemoryTagDisplay, data);
                 display->SetPreviewImage(std::move(image));
                 return true;
             });
@@ -304,14 +308,21 @@ void McpServer::AddUserOnlyTools() {
 }
 
 void McpServer::AddTool(McpTool* tool) {
+    std::lock_guard<std::mutex> lock(tools_mutex_);
     // Prevent adding duplicate tools
-    if (std::find_if(tools_.begin(), tools_.end(), [tool](const McpTool* t) { return t->name() == tool->name(); }) != tools_.end()) {
+    auto existing = tool_index_.find(tool->name());
+    if (existing != tool_index_.end() && existing->second->name() == tool->name()) {
         ESP_LOGW(TAG, "Tool %s already added", tool->name().c_str());
         return;
     }
 
     ESP_LOGI(TAG, "Add tool: %s%s", tool->name().c_str(), tool->user_only() ? " [user]" : "");
     tools_.push_back(tool);
+    // An alias pointing at this name keeps precedence over the plain name
+    tool_index_.emplace(tool->name(), tool);
+    for (auto& cache : tools_list_cache_) {
+        cache.clear();
+    }
 }
 
 void McpServer::AddTool(const std::string& name, const std::string& description, const PropertyList& properties, std::function<ReturnValue(const PropertyList&)> callback) {
@@ -460,6 +471,7 @@ void McpServer::ReplyError(int id, const std::string& message) {
 
 void McpServer::ApplyConfig() {
     auto& cfg = McpConfig::GetInstance();
+    std::lock_guard<std::mutex> lock(tools_mutex_);
     overrides_.clear();
     alias_map_.clear();
     for (auto* tool : tools_) {
@@ -469,9 +481,33 @@ void McpServer::ApplyConfig() {
             alias_map_[ov.alias] = tool->name();
         }
     }
+    RebuildToolIndex();
     ESP_LOGI(TAG, "ApplyConfig: %u tools, %u aliases", (unsigned)tools_.size(), (unsigned)alias_map_.size());
 }
 
+void McpServer::RebuildToolIndex() {
+    tool_index_.clear();
+    tool_index_.reserve(tools_.size() + alias_map_.size());
+    for (auto* tool : tools_) {
+        tool_index_.emplace(tool->name(), tool);
+    }
+    for (const auto& [alias, name] : alias_map_) {
+        auto it = std::find_if(tools_.begin(), tools_.end(), [&name](const McpTool* t) { return t->name() == name; });
+        if (it != tools_.end()) {
+            tool_index_[alias] = *it;
+        }
+    }
+    for (auto& cache : tools_list_cache_) {
+        cache.clear();
+    }
+}
+
+McpTool* McpServer::FindTool(const std::string& name) {
+    std::lock_guard<std::mutex> lock(tools_mutex_);
+    auto it = tool_index_.find(name);
+    return it != tool_index_.end() ? it->second : nullptr;
+}
+
 std::string McpServer::GetAllToolsInfoJson() {
     cJSON* arr = cJSON_CreateArray();
     for (auto* tool : tools_) {
@@ -488,56 +524,55 @@ std::string McpServer::GetAllToolsInfoJson() {
 }
 
 void McpServer::GetToolsList(int id, const std::string& cursor, bool list_user_only_tools) {
+    ToolsListPage page;
+    {
+        std::lock_guard<std::mutex> lock(tools_mutex_);
+        auto& cache = tools_list_cache_[list_user_only_tools ? 1 : 0];
+        auto it = cache.find(cursor);
+        if (it != cache.end()) {
+            page = it->second;
+        } else {
+            page = BuildToolsListPage(cursor, list_user_only_tools);
+            // Only cursors we can hand out are cached, so unknown cursors cannot grow the cache
+            if (cursor.empty() || tool_index_.find(cursor) != tool_index_.end()) {
+                cache.emplace(cursor, page);
+            }
+        }
+    }
+
+    if (page.error) {
+        ESP_LOGE(TAG, "tools/list: %s", page.payload.c_str());
+        ReplyError(id, page.payload);
+        return;
+    }
+    ReplyResult(id, page.payload);
+}
+
+McpServer::ToolsListPage McpServer::BuildToolsListPage(const std::string& cursor, bool list_user_only_tools) {
     const int max_payload_size = 8000;
     std::string json = "{\"tools\":[";
-
-    bool found_cursor = cursor.empty();
-    auto it = tools_.begin();
     std::string next_cursor = "";
 
-    while (it != tools_.end()) {
-        // 如果我们还没有找到起始位置，继续搜索
-        if (!found_cursor) {
-            if ((*it)->name() == cursor) {
-                found_cursor = true;
-            } else {
-                ++it;
-                continue;
-            }
-        }
+    auto it = tools_.begin();
+    if (!cursor.empty()) {
+        it = std::find_if(tools_.begin(), tools_.end(), [&cursor](const McpTool* t) { return t->name() == cursor; });
+    }
 
+    for (; it != tools_.end(); ++it) {
         if (!list_user_only_tools && (*it)->user_only()) {
-            ++it;
             continue;
         }
 
         // 检查是否被禁用
         auto ov_it = overrides_.find((*it)->name());
         if (ov_it != overrides_.end() && !ov_it->second.enabled) {
-            ++it;
             continue;
         }
 
         // 生成工具 JSON，若有别名/描述覆盖则修改
         std::string tool_json_str;
-        bool has_override = (ov_it != overrides_.end()) &&
-                            (!ov_it->second.alias.empty() || !ov_it->second.description.empty());
-        if (has_override) {
-            cJSON* item = cJSON_Parse((*it)->to_json().c_str());
-            if (item) {
-                if (!ov_it->second.alias.empty()) {
-                    cJSON_ReplaceItemInObject(item, "name",
-                        cJSON_CreateString(ov_it->second.alias.c_str()));
-                }
-                if (!ov_it->second.description.empty()) {
-                    cJSON_ReplaceItemInObject(item, "description",
-                        cJSON_CreateString(ov_it->second.description.c_str()));
-                }
-                char* str = cJSON_PrintUnformatted(item);
-                tool_json_str = std::string(str) + ",";
-                cJSON_free(str);
-                cJSON_Delete(item);
-            }
+        if (ov_it != overrides_.end()) {
+            tool_json_str = (*it)->to_json(ov_it->second.alias, ov_it->second.description) + ",";
         } else {
             tool_json_str = (*it)->to_json() + ",";
         }
@@ -550,7 +585,6 @@ void McpServer::GetToolsList(int id, const std::string& cursor, bool list_user_o
         }
 
         json += tool_json_str;
-        ++it;
     }
 
     if (json.back() == ',') {
@@ -559,9 +593,7 @@ void McpServer::GetToolsList(int id, const std::string& cursor, bool list_user_o
 
     if (json.back() == '[' && !tools_.empty()) {
         // 如果没有添加任何tool，返回错误
-        ESP_LOGE(TAG, "tools/list: Failed to add tool %s because of payload size limit", next_cursor.c_str());
-        ReplyError(id, "Failed to add tool " + next_cursor + " because of payload size limit");
-        return;
+        return ToolsListPage{true, "Failed to add tool " + next_cursor + " because of payload size limit"};
     }
 
     if (next_cursor.empty()) {
@@ -569,30 +601,19 @@ void McpServer::GetToolsList(int id, const std::string& cursor, bool list_user_o
     } else {
         json += "],\"nextCursor\":\"" + next_cursor + "\"}";
     }
-
-    ReplyResult(id, json);
+    return ToolsListPage{false, json};
 }
 
 void McpServer::DoToolCall(int id, const std::string& tool_name, const cJSON* tool_arguments) {
-    // 若 AI 使用别名调用，先反向解析到原始名
-    std::string resolved_name = tool_name;
-    auto alias_it = alias_map_.find(tool_name);
-    if (alias_it != alias_map_.end()) {
-        resolved_name = alias_it->second;
-    }
-
-    auto tool_iter = std::find_if(tools_.begin(), tools_.end(),
-                                 [&resolved_name](const McpTool* tool) {
-                                     return tool->name() == resolved_name;
-                                 });
-    
-    if (tool_iter == tools_.end()) {
-        ESP_LOGE(TAG, "tools/call: Unknown tool: %s", resolved_name.c_str());
-        ReplyError(id, "Unknown tool: " + resolved_name);
+    // 若 AI 使用别名调用，索引中别名直接指向原始工具
+    auto tool = FindTool(tool_name);
+    if (tool == nullptr) {
+        ESP_LOGE(TAG, "tools/call: Unknown tool: %s", tool_name.c_str());
+        ReplyError(id, "Unknown tool: " + tool_name);
         return;
     }
 
-    PropertyList arguments = (*tool_iter)->properties();
+    PropertyList arguments = tool->properties();
     try {
         for (auto& argument : arguments) {
             bool found = false;
@@ -624,9 +645,9 @@ void McpServer::DoToolCall(int id, const std::string& tool_name, const cJSON* to
 
     // Use main thread to call the tool
     auto& app = Application::GetInstance();
-    app.Schedule([this, id, tool_iter, arguments = std::move(arguments)]() {
+    app.Schedule([this, id, tool, arguments = std::move(arguments)]() {
         try {
-            ReplyResult(id, (*tool_iter)->Call(arguments));
+            ReplyResult(id, tool->Call(arguments));
         } catch (const std::exception& e) {
             ESP_LOGE(TAG, "tools/call: %s", e.what());
             ReplyError(id, e.what());
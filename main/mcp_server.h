@@ -4,6 +4,8 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
+#include <mutex>
 #include <functional>
 #include <variant>
 #include <optional>
@@ -121,7 +123,8 @@ public:
         value_ = value;
     }
 
-    std::string to_json() const {
+    // Build the schema object directly, callers attach it without a print / parse round trip
+    cJSON* to_cjson() const {
         cJSON *json = cJSON_CreateObject();
         
         if (type_ == kPropertyTypeBoolean) {
@@ -146,7 +149,11 @@ public:
                 cJSON_AddStringToObject(json, "default", value<std::string>().c_str());
             }
         }
-        
+        return json;
+    }
+
+    std::string to_json() const {
+        cJSON *json = to_cjson();
         char *json_str = cJSON_PrintUnformatted(json);
         std::string result(json_str);
         cJSON_free(json_str);
@@ -189,14 +196,16 @@ public:
         return required;
     }
 
-    std::string to_json() const {
+    cJSON* to_cjson() const {
         cJSON *json = cJSON_CreateObject();
-        
         for (const auto& property : properties_) {
-            cJSON *prop_json = cJSON_Parse(property.to_json().c_str());
-            cJSON_AddItemToObject(json, property.name().c_str(), prop_json);
+            cJSON_AddItemToObject(json, property.name().c_str(), property.to_cjson());
         }
-        
+        return json;
+    }
+
+    std::string to_json() const {
+        cJSON *json = to_cjson();
         char *json_str = cJSON_PrintUnformatted(json);
         std::string result(json_str);
         cJSON_free(json_str);
@@ -230,18 +239,17 @@ public:
     inline const PropertyList& properties() const { return properties_; }
     inline bool user_only() const { return user_only_; }
 
-    std::string to_json() const {
+    // Name and description can be replaced by the values configured in McpConfig
+    cJSON* to_cjson(const std::string& name_override = "", const std::string& description_override = "") const {
         std::vector<std::string> required = properties_.GetRequired();
         
         cJSON *json = cJSON_CreateObject();
-        cJSON_AddStringToObject(json, "name", name_.c_str());
-        cJSON_AddStringToObject(json, "description", description_.c_str());
+        cJSON_AddStringToObject(json, "name", name_override.empty() ? name_.c_str() : name_override.c_str());
+        cJSON_AddStringToObject(json, "description", description_override.empty() ? description_.c_str() : description_override.c_str());
         
         cJSON *input_schema = cJSON_CreateObject();
         cJSON_AddStringToObject(input_schema, "type", "object");
-        
-        cJSON *properties = cJSON_Parse(properties_.to_json().c_str());
-        cJSON_AddItemToObject(input_schema, "properties", properties);
+        cJSON_AddItemToObject(input_schema, "properties", properties_.to_cjson());
         
         if (!required.empty()) {
             cJSON *required_array = cJSON_CreateArray();
@@ -261,7 +269,11 @@ public:
             cJSON_AddItemToObject(annotations, "audience", audience);
             cJSON_AddItemToObject(json, "annotations", annotations);
         }
-        
+        return json;
+    }
+
+    std::string to_json(const std::string& name_override = "", const std::string& description_override = "") const {
+        cJSON *json = to_cjson(name_override, description_override);
         char *json_str = cJSON_PrintUnformatted(json);
         std::string result(json_str);
         cJSON_free(json_str);
@@ -350,7 +362,15 @@ private:
     void ReplyResult(int id, const std::string& result);
     void ReplyError(int id, const std::string& message);
 
+    struct ToolsListPage {
+        bool error = false;
+        std::string payload;    // Result JSON, or the error message when error is set
+    };
+
     void GetToolsList(int id, const std::string& cursor, bool list_user_only_tools);
+    ToolsListPage BuildToolsListPage(const std::string& cursor, bool list_user_only_tools);
+    void RebuildToolIndex();
+    McpTool* FindTool(const std::string& name);
     void DoToolCall(int id, const std::string& tool_name, const cJSON* tool_arguments);
 
     std::vector<McpTool*> tools_;
@@ -358,6 +378,13 @@ private:
     // 运行时覆盖（ApplyConfig 后填充）
     std::map<std::string, ToolOverride> overrides_;
     std::map<std::string, std::string>  alias_map_;   // 别名 → 原始名
+
+    // Name and alias lookup for tools/call, aliases take precedence like alias_map_
+    std::mutex tools_mutex_;
+    std::unordered_map<std::string, McpTool*> tool_index_;
+    // Serialized tools/list pages keyed by cursor, [0] without and [1] with user only tools.
+    // Cleared by AddTool and ApplyConfig.
+    std::unordered_map<std::string, ToolsListPage> tools_list_cache_[2];
 };
 
 #endif // MCP_SERVER_H
@@ -0,0 +1,186 @@
+#include "memory_budget.h"
+
+#include <esp_log.h>
+#include <esp_memory_utils.h>
+
+#define TAG "MemoryBudget"
+
+static const char* const kTagNames[] = {
+    "audio",
+    "display",
+    "camera",
+    "network",
+    "mcp",
+    "home_device",
+};
+static_assert(sizeof(kTagNames) / sizeof(kTagNames[0]) == kMemoryTagCount, "kTagNames out of date");
+
+struct HeapEntry {
+    const char* name;
+    uint32_t caps;
+};
+
+static const HeapEntry kHeaps[] = {
+    { "internal", MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT },
+    { "dma", MALLOC_CAP_DMA },
+    { "psram", MALLOC_CAP_SPIRAM },
+};
+
+// 0 when the free memory is one block, close to 100 when it is scattered in small pieces
+static int Fragmentation(const multi_heap_info_t& info) {
+    if (info.total_free_bytes == 0) {
+        return 0;
+    }
+    return 100 - (int)((uint64_t)info.largest_free_block * 100 / info.total_free_bytes);
+}
+
+void* MemoryBudget::Malloc(MemoryTag tag, size_t size, uint32_t caps) {
+    void* ptr = heap_caps_malloc(size, caps);
+    Account(tag, ptr);
+    return ptr;
+}
+
+void* MemoryBudget::AlignedMalloc(MemoryTag tag, size_t alignment, size_t size, uint32_t caps) {
+    void* ptr = heap_caps_aligned_alloc(alignment, size, caps);
+    Account(tag, ptr);
+    return ptr;
+}
+
+void MemoryBudget::Free(MemoryTag tag, void* ptr) {
+    if (ptr == nullptr) {
+        return;
+    }
+    Release(tag, ptr);
+    heap_caps_free(ptr);
+}
+
+void MemoryBudget::Retag(MemoryTag from, MemoryTag to, void* ptr) {
+    if (ptr == nullptr || from == to) {
+        return;
+    }
+    Release(from, ptr);
+    Account(to, ptr);
+}
+
+void MemoryBudget::Account(MemoryTag tag, void* ptr) {
+    auto& stats = tags_[tag];
+    if (ptr == nullptr) {
+        stats.failures.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    size_t size = heap_caps_get_allocated_size(ptr);
+    size_t total;
+    if (esp_ptr_external_ram(ptr)) {
+        total = stats.psram_bytes.fetch_add(size, std::memory_order_relaxed) + size +
+            stats.internal_bytes.load(std::memory_order_relaxed);
+    } else {
+        total = stats.internal_bytes.fetch_add(size, std::memory_order_relaxed) + size +
+            stats.psram_bytes.load(std::memory_order_relaxed);
+    }
+    stats.blocks.fetch_add(1, std::memory_order_relaxed);
+
+    size_t peak = stats.peak_bytes.load(std::memory_order_relaxed);
+    while (total > peak && !stats.peak_bytes.compare_exchange_weak(peak, total, std::memory_order_relaxed)) {
+    }
+}
+
+void MemoryBudget::Release(MemoryTag tag, void* ptr) {
+    auto& stats = tags_[tag];
+    size_t size = heap_caps_get_allocated_size(ptr);
+    if (esp_ptr_external_ram(ptr)) {
+        stats.psram_bytes.fetch_sub(size, std::memory_order_relaxed);
+    } else {
+        stats.internal_bytes.fetch_sub(size, std::memory_order_relaxed);
+    }
+    stats.blocks.fetch_sub(1, std::memory_order_relaxed);
+}
+
+std::string MemoryBudget::GetJson() {
+    /*
+     * {
+     *     "heaps": [{ "name": "internal", "total": 0, "free": 0, "min_free": 0, "largest_free_block": 0, "fragmentation": 0 }],
+     *     "tags": [{ "name": "camera", "internal": 0, "psram": 0, "peak": 0, "blocks": 0, "failures": 0 }]
+     * }
+     */
+    auto root = cJSON_CreateObject();
+
+    auto heaps = cJSON_CreateArray();
+    for (const auto& entry : kHeaps) {
+        size_t total = heap_caps_get_total_size(entry.caps);
+        if (total == 0) {
+            continue;
+        }
+        multi_heap_info_t info = {};
+        heap_caps_get_info(&info, entry.caps);
+        auto heap = cJSON_CreateObject();
+        cJSON_AddStringToObject(heap, "name", entry.name);
+        cJSON_AddNumberToObject(heap, "total", total);
+        cJSON_AddNumberToObject(heap, "free", info.total_free_bytes);
+        cJSON_AddNumberToObject(heap, "min_free", info.minimum_free_bytes);
+        cJSON_AddNumberToObject(heap, "largest_free_block", info.largest_free_block);
+        cJSON_AddNumberToObject(heap, "fragmentation", Fragmentation(info));
+        cJSON_AddItemToArray(heaps, heap);
+    }
+    cJSON_AddItemToObject(root, "heaps", heaps);
+
+    auto tags = cJSON_CreateArray();
+    for (int i = 0; i < kMemoryTagCount; i++) {
+        auto& stats = tags_[i];
+        auto tag = cJSON_CreateObject();
+        cJSON_AddStringToObject(tag, "name", kTagNames[i]);
+        cJSON_AddNumberToObject(tag, "internal", stats.internal_bytes.load(std::memory_order_relaxed));
+        cJSON_AddNumberToObject(tag, "psram", stats.psram_bytes.load(std::memory_order_relaxed));
+        cJSON_AddNumberToObject(tag, "peak", stats.peak_bytes.load(std::memory_order_relaxed));
+        cJSON_AddNumberToObject(tag, "blocks", stats.blocks.load(std::memory_order_relaxed));
+        cJSON_AddNumberToObject(tag, "failures", stats.failures.load(std::memory_order_relaxed));
+        cJSON_AddItemToArray(tags, tag);
+    }
+    cJSON_AddItemToObject(root, "tags", tags);
+
+    auto json_str = cJSON_PrintUnformatted(root);
+    std::string json(json_str);
+    cJSON_free(json_str);
+    cJSON_Delete(root);
+    return json;
+}
+
+void MemoryBudget::AddStatusJson(cJSON* root) {
+    auto memory = cJSON_CreateObject();
+    for (const auto& entry : kHeaps) {
+        if (entry.caps == MALLOC_CAP_DMA || heap_caps_get_total_size(entry.caps) == 0) {
+            continue;
+        }
+        multi_heap_info_t info = {};
+        heap_caps_get_info(&info, entry.caps);
+        auto heap = cJSON_CreateObject();
+        cJSON_AddNumberToObject(heap, "free_kb", info.total_free_bytes / 1024);
+        cJSON_AddNumberToObject(heap, "largest_free_block_kb", info.largest_free_block / 1024);
+        cJSON_AddItemToObject(memory, entry.name, heap);
+    }
+    cJSON_AddItemToObject(root, "memory", memory);
+}
+
+void MemoryBudget::LogStats() {
+    for (const auto& entry : kHeaps) {
+        if (heap_caps_get_total_size(entry.caps) == 0) {
+            continue;
+        }
+        multi_heap_info_t info = {};
+        heap_caps_get_info(&info, entry.caps);
+        ESP_LOGI(TAG, "%s: free %u, min free %u, largest block %u, fragmentation %d%%", entry.name,
+            (unsigned)info.total_free_bytes, (unsigned)info.minimum_free_bytes,
+            (unsigned)info.largest_free_block, Fragmentation(info));
+    }
+    for (int i = 0; i < kMemoryTagCount; i++) {
+        auto& stats = tags_[i];
+        size_t peak = stats.peak_bytes.load(std::memory_order_relaxed);
+        if (peak == 0 && stats.failures.load(std::memory_order_relaxed) == 0) {
+            continue;
+        }
+        ESP_LOGI(TAG, "%s: internal %u, psram %u, peak %u, %lu blocks, %lu failures", kTagNames[i],
+            (unsigned)stats.internal_bytes.load(std::memory_order_relaxed),
+            (unsigned)stats.psram_bytes.load(std::memory_order_relaxed), (unsigned)peak,
+            (unsigned long)stats.blocks.load(std::memory_order_relaxed),
+            (unsigned long)stats.failures.load(std::memory_order_relaxed));
+    }
+}
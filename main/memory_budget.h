@@ -0,0 +1,77 @@
+#ifndef MEMORY_BUDGET_H
+#define MEMORY_BUDGET_H
+
+#include <cJSON.h>
+#include <esp_heap_caps.h>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+enum MemoryTag {
+    kMemoryTagAudio,
+    kMemoryTagDisplay,
+    kMemoryTagCamera,
+    kMemoryTagNetwork,
+    kMemoryTagMcp,
+    kMemoryTagHomeDevice,
+    kMemoryTagCount,
+};
+
+/*
+ * Heap accounting per subsystem.
+ *
+ * The large buffers (frames, images, stacks, download chunks) are allocated
+ * through Malloc()/AlignedMalloc() with the tag of their owner and released
+ * with Free() and the same tag; the block size reported by the heap is added
+ * to the internal RAM or the PSRAM total of the tag, with a high-water mark.
+ * A buffer handed to another subsystem is moved with Retag(). Failed requests
+ * are counted per tag, including PSRAM attempts that fall back to internal RAM.
+ *
+ * Allocations made elsewhere (std containers, cJSON, the drivers) are not
+ * tagged, they show up in the difference between the heap totals and the sum
+ * of the tags. The heap side reports free, minimum free and largest free
+ * block per capability, the largest block tells whether a big buffer can
+ * still be allocated when the free total looks fine.
+ */
+class MemoryBudget {
+public:
+    static MemoryBudget& GetInstance() {
+        static MemoryBudget instance;
+        return instance;
+    }
+
+    void* Malloc(MemoryTag tag, size_t size, uint32_t caps);
+    void* AlignedMalloc(MemoryTag tag, size_t alignment, size_t size, uint32_t caps);
+    // Accepts nullptr
+    void Free(MemoryTag tag, void* ptr);
+    void Retag(MemoryTag from, MemoryTag to, void* ptr);
+
+    // Heaps and tags, for the config server
+    std::string GetJson();
+    // Short summary added to the device status given to the AI
+    void AddStatusJson(cJSON* root);
+    void LogStats();
+
+private:
+    MemoryBudget() = default;
+    MemoryBudget(const MemoryBudget&) = delete;
+    MemoryBudget& operator=(const MemoryBudget&) = delete;
+
+    struct TagStats {
+        std::atomic<size_t> internal_bytes{0};
+        std::atomic<size_t> psram_bytes{0};
+        std::atomic<size_t> peak_bytes{0};
+        std::atomic<uint32_t> blocks{0};
+        std::atomic<uint32_t> failures{0};
+    };
+
+    std::array<TagStats, kMemoryTagCount> tags_;
+
+    void Account(MemoryTag tag, void* ptr);
+    void Release(MemoryTag tag, void* ptr);
+};
+
+#endif // MEMORY_BUDGET_H
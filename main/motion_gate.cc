@@ -0,0 +1,188 @@
+#include "motion_gate.h"
+#include "memory_budget.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <esp_jpeg_dec.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#define TAG "MotionGate"
+
+static int MeanLuma(const uint8_t* cells, size_t count) {
+    uint32_t sum = 0;
+    for (size_t i = 0; i < count; i++) {
+        sum += cells[i];
+    }
+    return (int)(sum / count);
+}
+
+// The decoder divides both sides by 2, 4 or 8 to sizes that are multiples of 8. Picks the
+// largest division that still covers the grid, 0 when the frame has to be decoded in full
+static int ScaleShift(int width, int height) {
+    for (int shift = 3; shift > 0; shift--) {
+        int scaled_width = width >> shift;
+        int scaled_height = height >> shift;
+        if ((scaled_width << shift) == width && (scaled_height << shift) == height &&
+            scaled_width % 8 == 0 && scaled_height % 8 == 0 &&
+            scaled_width >= MOTION_GATE_GRID_WIDTH && scaled_height >= MOTION_GATE_GRID_HEIGHT) {
+            return shift;
+        }
+    }
+    return 0;
+}
+
+static jpeg_dec_handle_t OpenDecoder(const std::string& jpeg_data, int scaled_width, int scaled_height,
+    jpeg_dec_io_t& io, jpeg_dec_header_info_t& header) {
+    jpeg_dec_config_t dec_cfg = {};
+    dec_cfg.output_type = JPEG_PIXEL_FORMAT_GRAY;
+    dec_cfg.rotate = JPEG_ROTATE_0D;
+    dec_cfg.scale.width = scaled_width;
+    dec_cfg.scale.height = scaled_height;
+    jpeg_dec_handle_t dec = nullptr;
+    if (jpeg_dec_open(&dec_cfg, &dec) != JPEG_ERR_OK) {
+        ESP_LOGE(TAG, "jpeg_dec_open failed");
+        return nullptr;
+    }
+    io = {};
+    io.inbuf = (uint8_t*)jpeg_data.data();
+    io.inbuf_len = jpeg_data.size();
+    header = {};
+    if (jpeg_dec_parse_header(dec, &io, &header) != JPEG_ERR_OK) {
+        ESP_LOGE(TAG, "Invalid JPEG header");
+        jpeg_dec_close(dec);
+        return nullptr;
+    }
+    return dec;
+}
+
+bool MotionGate::DecodeThumbnail(const std::string& jpeg_data) {
+    // The scale is part of the decoder configuration, the size comes from the header
+    jpeg_dec_io_t io;
+    jpeg_dec_header_info_t header;
+    auto dec = OpenDecoder(jpeg_data, 0, 0, io, header);
+    if (dec == nullptr) {
+        return false;
+    }
+    if (header.width < MOTION_GATE_GRID_WIDTH || header.height < MOTION_GATE_GRID_HEIGHT) {
+        ESP_LOGE(TAG, "Frame of %dx%d is smaller than the grid", header.width, header.height);
+        jpeg_dec_close(dec);
+        return false;
+    }
+    int shift = ScaleShift(header.width, header.height);
+    int width = header.width >> shift;
+    int height = header.height >> shift;
+    if (shift > 0) {
+        jpeg_dec_close(dec);
+        dec = OpenDecoder(jpeg_data, width, height, io, header);
+        if (dec == nullptr) {
+            return false;
+        }
+    }
+
+    // Luma only, at most 1/64 of the pixels; the decoder requires a 16 byte aligned output buffer
+    size_t gray_size = (size_t)width * height;
+    auto gray = (uint8_t*)MemoryBudget::GetInstance().AlignedMalloc(kMemoryTagHomeDevice, 16, gray_size,
+        MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (gray == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate %u bytes for a %dx%d frame", (unsigned)gray_size, width, height);
+        jpeg_dec_close(dec);
+        return false;
+    }
+    io.outbuf = gray;
+    io.out_size = gray_size;
+    bool ok = jpeg_dec_process(dec, &io) == JPEG_ERR_OK;
+    jpeg_dec_close(dec);
+    if (!ok) {
+        ESP_LOGE(TAG, "jpeg_dec_process failed");
+        MemoryBudget::GetInstance().Free(kMemoryTagHomeDevice, gray);
+        return false;
+    }
+
+    // Box filter down to the grid
+    std::vector<uint32_t> sums(kCells, 0);
+    std::vector<uint32_t> counts(kCells, 0);
+    for (int y = 0; y < height; y++) {
+        const uint8_t* row = gray + (size_t)y * width;
+        uint32_t* row_sums = sums.data() + (y * MOTION_GATE_GRID_HEIGHT / height) * MOTION_GATE_GRID_WIDTH;
+        uint32_t* row_counts = counts.data() + (y * MOTION_GATE_GRID_HEIGHT / height) * MOTION_GATE_GRID_WIDTH;
+        for (int x = 0; x < width; x++) {
+            int cell = x * MOTION_GATE_GRID_WIDTH / width;
+            row_sums[cell] += row[x];
+            row_counts[cell]++;
+        }
+    }
+    MemoryBudget::GetInstance().Free(kMemoryTagHomeDevice, gray);
+
+    for (size_t i = 0; i < kCells; i++) {
+        thumbnail_[i] = (uint8_t)(sums[i] / counts[i]);
+    }
+    return true;
+}
+
+bool MotionGate::ShouldAnalyze(const std::string& jpeg_data, int64_t now_ms) {
+    if (!DecodeThumbnail(jpeg_data)) {
+        // Not knowing what is in the frame is no reason to skip it, the references stay as they are
+        forwarded_frames_++;
+        return true;
+    }
+    return ShouldAnalyze(thumbnail_, now_ms);
+}
+
+bool MotionGate::ShouldAnalyze(const uint8_t* thumbnail, int64_t now_ms) {
+    if (thumbnail != thumbnail_) {
+        memcpy(thumbnail_, thumbnail, kCells);
+    }
+
+    if (!has_reference_) {
+        for (size_t i = 0; i < kCells; i++) {
+            background_[i] = thumbnail_[i] << MOTION_GATE_BACKGROUND_SHIFT;
+        }
+        memcpy(reference_, thumbnail_, kCells);
+        has_reference_ = true;
+        last_forward_ms_ = now_ms;
+        motion_energy_ = 0;
+        changed_percent_ = 100;
+        forwarded_frames_++;
+        return true;
+    }
+
+    int mean = MeanLuma(thumbnail_, kCells);
+    int reference_mean = MeanLuma(reference_, kCells);
+    uint32_t background_sum = 0;
+    for (size_t i = 0; i < kCells; i++) {
+        background_sum += background_[i] >> MOTION_GATE_BACKGROUND_SHIFT;
+    }
+    int background_mean = (int)(background_sum / kCells);
+
+    uint32_t energy = 0;
+    size_t changed = 0;
+    for (size_t i = 0; i < kCells; i++) {
+        int luma = thumbnail_[i] - mean;
+        energy += abs(luma - ((background_[i] >> MOTION_GATE_BACKGROUND_SHIFT) - background_mean));
+        if (abs(luma - (reference_[i] - reference_mean)) > MOTION_GATE_CELL_THRESHOLD) {
+            changed++;
+        }
+        background_[i] = background_[i] - (background_[i] >> MOTION_GATE_BACKGROUND_SHIFT) + thumbnail_[i];
+    }
+    motion_energy_ = (int)(energy / kCells);
+    changed_percent_ = (int)(changed * 100 / kCells);
+
+    bool forward = changed_percent_ >= MOTION_GATE_CHANGED_PERCENT ||
+        now_ms - last_forward_ms_ >= MOTION_GATE_FORCE_INTERVAL_MS;
+    if (forward) {
+        memcpy(reference_, thumbnail_, kCells);
+        last_forward_ms_ = now_ms;
+        forwarded_frames_++;
+    } else {
+        skipped_frames_++;
+    }
+    ESP_LOGD(TAG, "energy=%d changed=%d%% %s", motion_energy_, changed_percent_, forward ? "forward" : "skip");
+    return forward;
+}
+
+void MotionGate::Reset() {
+    has_reference_ = false;
+}
@@ -0,0 +1,68 @@
+#ifndef MOTION_GATE_H
+#define MOTION_GATE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+// Luma thumbnail the frames are reduced to before they are compared
+#define MOTION_GATE_GRID_WIDTH 32
+#define MOTION_GATE_GRID_HEIGHT 24
+// Background model update rate, 1/8 of the new frame per call
+#define MOTION_GATE_BACKGROUND_SHIFT 3
+// Luma difference at which a thumbnail cell counts as changed
+#define MOTION_GATE_CELL_THRESHOLD 16
+// Share of changed cells, in percent, that makes a frame worth analyzing
+#define MOTION_GATE_CHANGED_PERCENT 3
+// A frame is forwarded at least this often, even if nothing moved
+#define MOTION_GATE_FORCE_INTERVAL_MS (5 * 60 * 1000)
+
+/*
+ * Decides on the device which camera frames are worth a cloud vision request.
+ *
+ * Each JPEG is decoded to grayscale, scaled down by the decoder where the
+ * frame size allows it, and averaged down to a MOTION_GATE_GRID_WIDTH x
+ * MOTION_GATE_GRID_HEIGHT luma thumbnail. Two references are kept: a slow
+ * moving background, whose mean difference is reported as the motion energy,
+ * and the thumbnail of the last forwarded frame. A frame is forwarded when
+ * enough cells differ from the last forwarded one, so a person who moved and
+ * then stays still (lying on the floor) is analyzed once, not on every poll.
+ * The average brightness is taken out of both comparisons, an IR switch or a
+ * cloud does not count as a change.
+ */
+class MotionGate {
+public:
+    // Returns true when the frame should be sent for analysis, false when it is
+    // close to the last forwarded one. A frame that cannot be decoded is sent
+    bool ShouldAnalyze(const std::string& jpeg_data, int64_t now_ms);
+    // Same decision for a thumbnail that is already MOTION_GATE_GRID_WIDTH x MOTION_GATE_GRID_HEIGHT
+    bool ShouldAnalyze(const uint8_t* thumbnail, int64_t now_ms);
+    // Forgets both references, the next frame is forwarded
+    void Reset();
+
+    // Mean luma difference to the background of the last frame
+    int motion_energy() const { return motion_energy_; }
+    // Changed cells of the last frame, in percent
+    int changed_percent() const { return changed_percent_; }
+    uint32_t forwarded_frames() const { return forwarded_frames_; }
+    uint32_t skipped_frames() const { return skipped_frames_; }
+
+private:
+    static constexpr size_t kCells = MOTION_GATE_GRID_WIDTH * MOTION_GATE_GRID_HEIGHT;
+
+    uint8_t thumbnail_[kCells];
+    uint8_t reference_[kCells];
+    // Fixed point, MOTION_GATE_BACKGROUND_SHIFT fractional bits
+    uint16_t background_[kCells];
+    bool has_reference_ = false;
+    int64_t last_forward_ms_ = 0;
+
+    int motion_energy_ = 0;
+    int changed_percent_ = 0;
+    uint32_t forwarded_frames_ = 0;
+    uint32_t skipped_frames_ = 0;
+
+    bool DecodeThumbnail(const std::string& jpeg_data);
+};
+
+#endif // MOTION_GATE_H
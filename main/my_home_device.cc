@@ -6,8 +6,11 @@
 #include <cJSON.h>
 #include <esp_log.h>
 #include <string.h>
+#include <stdio.h>
+#include <time.h>
 #include <atomic>
 #include <deque>
+#include <map>
 #include <mutex>
 #include <algorithm>
 #include <freertos/FreeRTOS.h>
@@ -20,6 +23,10 @@
 #include <esp_heap_caps.h>
 #include <esp_jpeg_dec.h>
 #include "application.h"
+#include "motion_gate.h"
+#include "reminder_scheduler.h"
+#include "event_bus.h"
+#include "memory_budget.h"
 #include "display/lvgl_display/lvgl_display.h"
 #include "display/lvgl_display/lvgl_image.h"
 #include "assets/lang_config.h"
@@ -211,20 +218,19 @@ struct ScReply { std::string msg_id; std::string url; };
 static std::mutex            s_sc_reply_mutex;
 static std::deque<ScReply>   s_sc_replies;    // 待播放的回复（msg_id + url），deque保证O(1)头删
 
-// 更新屏幕上的留言计数（必须在主线程 / Schedule 内调用）
+// 更新屏幕上的留言计数（经显示队列渲染，不直接操作 LVGL）
 static void ScUpdateReplyBadge() {
-    auto* display = Board::GetInstance().GetDisplay();
-    if (!display) return;
+    auto& display = Application::GetInstance().GetDisplayQueue();
     size_t unread;
     {
         std::lock_guard<std::mutex> lk(s_sc_reply_mutex);
         unread = s_sc_replies.size();
     }
     if (unread == 0) {
-        display->SetChatMessage("system", "📞 总台通话就绪\n按住按键说话，松开发送");
+        display.SetChatMessage("system", "📞 总台通话就绪\n按住按键说话，松开发送");
     } else {
         std::string msg = "📩 收到总台 " + std::to_string(unread) + " 条留言\n说「播放留言」收听";
-        display->SetChatMessage("system", msg.c_str());
+        display.SetChatMessage("system", msg.c_str());
     }
 }
 
@@ -557,16 +563,8 @@ static void ScWsEventHandler(void*, esp_event_base_t, int32_t event_id, void* ev
                         s_sc_replies.push_back({msg_id, url});
                     }
                 }
-                // 震动音 + 持久屏幕提示（不自动消失）
-                Application::GetInstance().Schedule([]() {
-                    auto& audio = Application::GetInstance().GetAudioService();
-                    audio.PlaySound(Lang::Sounds::OGG_VIBRATION);
-                    auto* display = Board::GetInstance().GetDisplay();
-                    if (display) {
-                        display->SetEmotion("happy");
-                        ScUpdateReplyBadge();
-                    }
-                });
+                // 震动音 + 持久屏幕提示由事件总线订阅者处理，同一 msg_id 重发只提示一次
+                EventBus::GetInstance().Publish(kEventStationReply, 0, msg_id.c_str());
                 s_sc_state = StationCallState::kReady;
             }
         }
@@ -598,12 +596,10 @@ void StationCallConnect() {
 
     // 屏幕反馈，通过 Schedule 投递到主线程
     Application::GetInstance().Schedule([]() {
-        auto* display = Board::GetInstance().GetDisplay();
-        if (display) {
-            display->SetEmotion("thinking");
-            display->SetStatus("总台通话");
-            display->SetChatMessage("system", "📞 正在连接总台...\n连接后按住按键说话");
-        }
+        auto& display = Application::GetInstance().GetDisplayQueue();
+        display.SetEmotion("thinking");
+        display.SetStatus("总台通话");
+        display.SetChatMessage("system", "📞 正在连接总台...\n连接后按住按键说话");
     });
 }
 
@@ -620,7 +616,7 @@ void StationCallDisconnect() {
         vTaskDelay(pdMS_TO_TICKS(10));
     }
     if (s_sc_send_stack) {
-        heap_caps_free(s_sc_send_stack);
+        MemoryBudget::GetInstance().Free(kMemoryTagHomeDevice, s_sc_send_stack);
         s_sc_send_stack = nullptr;
     }
     {
@@ -628,12 +624,10 @@ void StationCallDisconnect() {
         s_sc_replies.clear();
     }
     Application::GetInstance().Schedule([]() {
-        auto* display = Board::GetInstance().GetDisplay();
-        if (display) {
-            display->SetStatus("待机");
-            display->SetEmotion("neutral");
-            display->SetChatMessage("system", "");
-        }
+        auto& display = Application::GetInstance().GetDisplayQueue();
+        display.SetStatus("待机");
+        display.SetEmotion("neutral");
+        display.SetChatMessage("system", "");
     });
 }
 
@@ -660,11 +654,9 @@ void StationCallStartRecord() {
         if (app.GetDeviceState() == kDeviceStateListening) {
             app.StopListening();
         }
-        auto* display = Board::GetInstance().GetDisplay();
-        if (display) {
-            display->SetEmotion("thinking");  // 使用存在的表情，"listening" 不在表情库中
-            display->ShowNotification("🔴 录音中...", 60000);
-        }
+        auto& display = app.GetDisplayQueue();
+        display.SetEmotion("thinking");  // 使用存在的表情，"listening" 不在表情库中
+        display.ShowNotification("🔴 录音中...", 60000);
     });
     s_sc_record_start_us = esp_timer_get_time();
     xTaskCreate(ScRecordTask, "sc_record", 4096, nullptr, 5, &s_sc_record_task);
@@ -681,15 +673,14 @@ void StationCallStopRecord() {
     }
     s_sc_state = StationCallState::kSending;
     Application::GetInstance().Schedule([]() {
-        auto* display = Board::GetInstance().GetDisplay();
-        if (display) display->SetEmotion("neutral");
+        Application::GetInstance().GetDisplayQueue().SetEmotion("neutral");
     });
 
     // 首次使用时从 PSRAM 分配 32KB 栈（CONFIG_SPIRAM_ALLOW_STACK_EXTERNAL_MEMORY=y）
     // 避免从碎片化内部 SRAM 中申请大连续块失败
     if (!s_sc_send_stack) {
-        s_sc_send_stack = (StackType_t*)heap_caps_malloc(
-            32768, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        s_sc_send_stack = (StackType_t*)MemoryBudget::GetInstance().Malloc(
+            kMemoryTagHomeDevice, 32768, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
     }
     if (!s_sc_send_stack) {
         ESP_LOGE(TAG, "ScSendTask: PSRAM alloc failed");
@@ -710,112 +701,171 @@ void StationCallStopRecord() {
 // =================================================================================
 // =================================================================================
 
-struct Reminder {
-    int     id;           // 唯一编号，自增
-    int64_t trigger_us;   // esp_timer_get_time() 到期时间（微秒）
-    std::string message;
-    bool fired;
-};
-
-static std::mutex          s_reminder_mutex;
-static std::vector<Reminder> s_reminders;
-static int s_reminder_id_counter = 0;
 static std::atomic<bool> s_alarm_active{false};  // 当前是否有闹钟正在响
 
+// 已关闭、等待 AI 播报的提醒内容，按提醒 id 查找（事件总线只传 id，不拷贝内容）
+static std::mutex                 s_dismissed_mutex;
+static std::map<int, std::string> s_dismissed_reminders;
+
 bool IsAlarmRinging() { return s_alarm_active.load(); }
 void DismissAlarm()   { s_alarm_active = false; }
 
-static void ReminderTask(void*) {
-    while (true) {
-        // 方案四：自适应轮询间隔
-        // - 无提醒：30 秒轮询一次（节省 CPU）
-        // - 最近提醒在 60 秒内：1 秒轮询（高精度触发）
-        // - 其他：5 秒轮询
-        int32_t next_check_ms = 30000;
-        {
-            std::lock_guard<std::mutex> lock(s_reminder_mutex);
-            if (!s_reminders.empty()) {
-                int64_t now_us = esp_timer_get_time();
-                int64_t min_remaining_ms = INT64_MAX;
-                for (auto& r : s_reminders) {
-                    int64_t rem_ms = (r.trigger_us - now_us) / 1000LL;
-                    if (rem_ms < min_remaining_ms) min_remaining_ms = rem_ms;
-                }
-                if (min_remaining_ms < 60000LL) next_check_ms = 1000;
-                else next_check_ms = 5000;
-            }
+// 提醒到期回调，在 ReminderScheduler 的任务中执行，响铃直到用户按键关闭
+static void RingReminder(const Reminder& reminder) {
+    s_alarm_active = true;
+    std::string fire_msg = reminder.message;
+
+    // ① 屏幕显示闹钟界面：scare 表情 + 提醒内容 + 操作提示
+    Application::GetInstance().Schedule([fire_msg]() {
+        Application::GetInstance().Alert(
+            "⏰ 提醒时间到！",
+            ("🔔 " + fire_msg + "\n\n按键关闭").c_str(),
+            "scare"
+        );
+    });
+
+    // ② 重复响铃循环：每次响一声，每 500ms 检查一次，5 秒后再响
+    auto& audio = Application::GetInstance().GetAudioService();
+    while (s_alarm_active) {
+        audio.PlaySound(Lang::Sounds::OGG_XIAOZHI_MORNING_ALARM);
+        for (int i = 0; i < 10 && s_alarm_active; i++) {
+            vTaskDelay(pdMS_TO_TICKS(500));
         }
-        vTaskDelay(pdMS_TO_TICKS(next_check_ms));
+    }
 
-        int64_t now_us = esp_timer_get_time();
-        std::vector<std::string> to_fire;
+    // ③ 用户按键关闭 — 显示确认界面
+    Application::GetInstance().Schedule([]() {
+        auto& display = Application::GetInstance().GetDisplayQueue();
+        display.SetStatus("✅ 好的~");
+        display.SetEmotion("happy");
+        display.SetChatMessage("system", "提醒已关闭 😊");
+    });
+    vTaskDelay(pdMS_TO_TICKS(1500));
 
-        {
-            std::lock_guard<std::mutex> lock(s_reminder_mutex);
-            for (auto& r : s_reminders) {
-                if (!r.fired && now_us >= r.trigger_us) {
-                    r.fired = true;
-                    to_fire.push_back(r.message);
-                }
-            }
-            s_reminders.erase(
-                std::remove_if(s_reminders.begin(), s_reminders.end(),
-                    [](const Reminder& r) { return r.fired; }),
-                s_reminders.end()
-            );
+    // ④ 恢复待机界面 + 通知 AI 语音播报（事件总线订阅者按 id 取回内容）
+    {
+        std::lock_guard<std::mutex> lk(s_dismissed_mutex);
+        s_dismissed_reminders[reminder.id] = fire_msg;
+    }
+    if (!EventBus::GetInstance().Publish(kEventReminderDismissed, reminder.id)) {
+        std::lock_guard<std::mutex> lk(s_dismissed_mutex);
+        s_dismissed_reminders.erase(reminder.id);
+    }
+}
+
+// 生成人性化时间描述，如"1小时30分钟"
+static std::string DescribeDuration(int64_t seconds) {
+    int h = (int)(seconds / 3600);
+    int m = (int)((seconds % 3600) / 60);
+    int s = (int)(seconds % 60);
+    std::string when;
+    if (h > 0) when += std::to_string(h) + "小时";
+    if (m > 0) when += std::to_string(m) + "分钟";
+    if (s > 0 && h == 0) when += std::to_string(s) + "秒";
+    return when;
+}
+
+static std::string DescribeRepeat(const Reminder& r) {
+    switch (r.repeat) {
+        case kReminderRepeatDaily:    return "每天";
+        case kReminderRepeatWeekdays: return "工作日";
+        case kReminderRepeatWeekly:   return "每周";
+        case kReminderRepeatInterval: return "每" + DescribeDuration(r.interval_sec);
+        default:                      return "";
+    }
+}
+
+// 报警提示音（门磁、跌倒）：连响三次，间隔 600ms（原1200ms，缩短为600ms更及时）
+// 每一声都通过 Schedule 在主线程播放，间隔由单次定时器计时，事件总线任务和主线程都不等待
+#define ALERT_SOUND_COUNT 3
+#define ALERT_SOUND_INTERVAL_MS 600
+static esp_timer_handle_t s_alert_timer = nullptr;
+static std::atomic<int>   s_alert_left{0};
+
+static void PlayAlertBeep() {
+    Application::GetInstance().Schedule([]() {
+        Application::GetInstance().GetAudioService().PlaySound(Lang::Sounds::OGG_VIBRATION);
+        if (s_alert_left.fetch_sub(1) > 1) {
+            esp_timer_start_once(s_alert_timer, ALERT_SOUND_INTERVAL_MS * 1000);
         }
+    });
+}
 
-        for (auto& msg : to_fire) {
-            ESP_LOGI(TAG, "Reminder fired: %s", msg.c_str());
-            s_alarm_active = true;
-            std::string fire_msg = msg;
-
-            // ① 屏幕显示闹钟界面：scare 表情 + 提醒内容 + 操作提示
-            Application::GetInstance().Schedule([fire_msg]() {
-                Application::GetInstance().Alert(
-                    "⏰ 提醒时间到！",
-                    ("🔔 " + fire_msg + "\n\n按键关闭").c_str(),
-                    "scare"
-                );
-            });
+static void PlayAlertSound() {
+    if (s_alert_timer == nullptr) {
+        esp_timer_create_args_t alert_timer_args = {
+            .callback = [](void*) { PlayAlertBeep(); },
+            .arg = nullptr,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name = "alert_sound",
+            .skip_unhandled_events = true
+        };
+        esp_timer_create(&alert_timer_args, &s_alert_timer);
+    }
+    // 上一轮还没响完时只重新计数，不叠加第二轮
+    if (s_alert_left.exchange(ALERT_SOUND_COUNT) == 0) {
+        PlayAlertBeep();
+    }
+}
+
+// 传感器/监控事件的订阅者，生产者只管 Publish，不再各自 Schedule 和做冷却
+static void RegisterEventHandlers() {
+    auto& bus = EventBus::GetInstance();
+
+    // 门磁：报警后 30 秒内不重复提醒
+    bus.SetPolicy(kEventDoorOpened, 30000, 0);
+    bus.Subscribe(kEventDoorOpened, [](const BusEvent&) {
+        ESP_LOGI(TAG, "Door opened! Playing alert sound.");
+        PlayAlertSound();
+    });
 
-            // ② 重复响铃循环：每次响一声，每 500ms 检查一次，5 秒后再响
+    // 跌倒：报警后冷却 FALL_DETECT_COOLDOWN_SEC 再重新报警
+    bus.SetPolicy(kEventFallDetected, FALL_DETECT_COOLDOWN_SEC * 1000, 0);
+    bus.Subscribe(kEventFallDetected, [](const BusEvent& event) {
+        ESP_LOGW(TAG, "FallDetect: FALL DETECTED! %s", event.text);
+        PlayAlertSound();
+    });
+
+    // 总台回复：同一条留言 60 秒内重发只提示一次
+    bus.SetPolicy(kEventStationReply, 0, 60000);
+    bus.Subscribe(kEventStationReply, [](const BusEvent&) {
+        Application::GetInstance().Schedule([]() {
             auto& audio = Application::GetInstance().GetAudioService();
-            while (s_alarm_active) {
-                audio.PlaySound(Lang::Sounds::OGG_XIAOZHI_MORNING_ALARM);
-                for (int i = 0; i < 10 && s_alarm_active; i++) {
-                    vTaskDelay(pdMS_TO_TICKS(500));
-                }
-            }
+            audio.PlaySound(Lang::Sounds::OGG_VIBRATION);
+            Application::GetInstance().GetDisplayQueue().SetEmotion("happy");
+            ScUpdateReplyBadge();
+        });
+    });
 
-            // ③ 用户按键关闭 — 显示确认界面
-            Application::GetInstance().Schedule([]() {
-                auto display = Board::GetInstance().GetDisplay();
-                display->SetStatus("✅ 好的~");
-                display->SetEmotion("happy");
-                display->SetChatMessage("system", "提醒已关闭 😊");
-            });
-            vTaskDelay(pdMS_TO_TICKS(1500));
-
-            // ④ 恢复待机界面 + 通知 AI 语音播报
-            Application::GetInstance().Schedule([fire_msg]() {
-                auto display = Board::GetInstance().GetDisplay();
-                display->SetStatus(Lang::Strings::STANDBY);
-                display->SetEmotion("neutral");
-                display->SetChatMessage("system", "");
-                auto* proto = Application::GetInstance().GetProtocol();
-                if (proto) {
-                    proto->SendSensorEvent("提醒时间到了：" + fire_msg + "。请用语音告知用户。");
-                }
-            });
+    // 提醒关闭：恢复待机界面 + 通知 AI 语音播报
+    bus.Subscribe(kEventReminderDismissed, [](const BusEvent& event) {
+        std::string fire_msg;
+        {
+            std::lock_guard<std::mutex> lk(s_dismissed_mutex);
+            auto it = s_dismissed_reminders.find(event.value);
+            if (it == s_dismissed_reminders.end()) {
+                return;
+            }
+            fire_msg = std::move(it->second);
+            s_dismissed_reminders.erase(it);
         }
-    }
-    vTaskDelete(nullptr);
+        Application::GetInstance().Schedule([fire_msg = std::move(fire_msg)]() {
+            auto& display = Application::GetInstance().GetDisplayQueue();
+            display.SetStatus(Lang::Strings::STANDBY);
+            display.SetEmotion("neutral");
+            display.SetChatMessage("system", "");
+            auto* proto = Application::GetInstance().GetProtocol();
+            if (proto) {
+                proto->SendSensorEvent("提醒时间到了：" + fire_msg + "。请用语音告知用户。");
+            }
+        });
+    });
 }
 
 static void StartReminderTask() {
-    xTaskCreate(ReminderTask, "reminder", 4096, nullptr, 1, nullptr);
-    ESP_LOGI(TAG, "ReminderTask started");
+    // 最小堆 + 单个 esp_timer 定时，不再轮询；提醒保存在 NVS，重启后恢复
+    ReminderScheduler::GetInstance().Start(RingReminder);
+    ESP_LOGI(TAG, "ReminderScheduler started");
 }
 
 // =================================================================================
@@ -1444,41 +1494,79 @@ void MyHomeDevice::RegisterHomeDeviceTools() {
     server.AddTool(
         "set_reminder",
         "【必须调用此工具】设置提醒/闹钟，不可直接承诺而不调用。"
-        "当用户说'X分钟后提醒我...'、'X小时后提醒我...'、'X点提醒我...'等时调用。"
-        "AI需将时间转换为秒数（10分钟=600，1小时=3600，下午8点距现在的秒数）。"
-        "message: 提醒内容（如'吃药'、'出门'）。delay_seconds: 从现在起多少秒后提醒。",
+        "当用户说'X分钟后提醒我...'、'X小时后提醒我...'、'X点提醒我...'、'每天X点提醒我...'等时调用。"
+        "message: 提醒内容（如'吃药'、'出门'）。"
+        "delay_seconds: 从现在起多少秒后提醒（10分钟=600，1小时=3600）。"
+        "time: 指定时刻，24小时制'HH:MM'（如'20:00'），给出时忽略 delay_seconds。"
+        "repeat: 'none'(默认) | 'daily'(每天) | 'weekdays'(工作日) | 'weekly'(每周) | 秒数(按间隔重复，至少60)。",
         PropertyList({
             Property("message",       kPropertyTypeString),
-            Property("delay_seconds", kPropertyTypeString),
+            Property("delay_seconds", kPropertyTypeString, std::string("0")),
+            Property("time",          kPropertyTypeString, std::string("")),
+            Property("repeat",        kPropertyTypeString, std::string("none")),
         }),
         [](const PropertyList& props) -> ReturnValue {
             try {
                 std::string message  = props["message"].value<std::string>();
                 std::string delay_s  = props["delay_seconds"].value<std::string>();
-                int delay_sec = atoi(delay_s.c_str());
+                std::string at       = props["time"].value<std::string>();
+                std::string repeat_s = props["repeat"].value<std::string>();
 
                 if (message.empty()) return std::string("提醒内容不能为空");
-                if (delay_sec <= 0)  return std::string("延迟时间必须大于0秒");
 
-                int64_t trigger_us = esp_timer_get_time() + (int64_t)delay_sec * 1000000LL;
-                int reminder_id = 0;
-                {
-                    std::lock_guard<std::mutex> lock(s_reminder_mutex);
-                    reminder_id = ++s_reminder_id_counter;
-                    s_reminders.push_back({reminder_id, trigger_us, message, false});
+                ReminderRepeat repeat = kReminderRepeatNone;
+                int32_t interval_sec = 0;
+                if (repeat_s == "daily") {
+                    repeat = kReminderRepeatDaily;
+                } else if (repeat_s == "weekdays") {
+                    repeat = kReminderRepeatWeekdays;
+                } else if (repeat_s == "weekly") {
+                    repeat = kReminderRepeatWeekly;
+                } else if (!repeat_s.empty() && repeat_s != "none") {
+                    interval_sec = atoi(repeat_s.c_str());
+                    if (interval_sec < 60) return std::string("重复间隔至少60秒");
+                    repeat = kReminderRepeatInterval;
                 }
 
-                // 生成人性化时间描述
-                int h   = delay_sec / 3600;
-                int m   = (delay_sec % 3600) / 60;
-                int s   = delay_sec % 60;
+                int64_t now = ReminderScheduler::Now();
+                int64_t trigger = 0;
                 std::string when;
-                if (h > 0) when += std::to_string(h) + "小时";
-                if (m > 0) when += std::to_string(m) + "分钟";
-                if (s > 0 && h == 0) when += std::to_string(s) + "秒";
+                if (!at.empty()) {
+                    int hour = -1, minute = -1;
+                    if (sscanf(at.c_str(), "%d:%d", &hour, &minute) != 2 ||
+                        hour < 0 || hour > 23 || minute < 0 || minute > 59) {
+                        return std::string("时间格式应为 HH:MM，如 20:00");
+                    }
+                    if (!ReminderScheduler::IsClockValid()) {
+                        return std::string("设备时间尚未同步，请改用 delay_seconds 设置提醒");
+                    }
+                    time_t t = (time_t)now;
+                    struct tm tm;
+                    localtime_r(&t, &tm);
+                    tm.tm_hour = hour;
+                    tm.tm_min  = minute;
+                    tm.tm_sec  = 0;
+                    trigger = (int64_t)mktime(&tm);
+                    if (trigger <= now) trigger += 24 * 3600;
+                    char buf[8];
+                    snprintf(buf, sizeof(buf), "%02d:%02d", hour, minute);
+                    when = buf;
+                } else {
+                    int delay_sec = atoi(delay_s.c_str());
+                    if (delay_sec <= 0) return std::string("延迟时间必须大于0秒");
+                    trigger = now + delay_sec;
+                    when = DescribeDuration(delay_sec) + "后";
+                }
+
+                int reminder_id = ReminderScheduler::GetInstance().Add(trigger, message, repeat, interval_sec);
+                if (reminder_id < 0) return std::string("提醒数量已达上限，请先取消一些提醒");
 
-                ESP_LOGI(TAG, "Reminder set: id=%d in %ds → %s", reminder_id, delay_sec, message.c_str());
-                return "好的，" + when + "后我会提醒你：" + message + "（编号：" + std::to_string(reminder_id) + "）";
+                ESP_LOGI(TAG, "Reminder set: id=%d at %lld repeat=%d → %s",
+                         reminder_id, (long long)trigger, (int)repeat, message.c_str());
+                std::string repeat_desc = DescribeRepeat({reminder_id, trigger, message, repeat, interval_sec, false});
+                return "好的，" + when + "我会提醒你：" + message
+                       + (repeat_desc.empty() ? "" : "，" + repeat_desc + "重复")
+                       + "（编号：" + std::to_string(reminder_id) + "）";
             } catch (...) {
                 return std::string("设置提醒失败，请检查参数");
             }
@@ -1491,25 +1579,21 @@ void MyHomeDevice::RegisterHomeDeviceTools() {
         "当用户问'我有什么提醒'、'我设了什么闹钟'、'有几个提醒'时调用。",
         PropertyList(std::vector<Property>()),
         [](const PropertyList&) -> ReturnValue {
-            std::lock_guard<std::mutex> lock(s_reminder_mutex);
-            if (s_reminders.empty()) {
+            auto reminders = ReminderScheduler::GetInstance().List();
+            if (reminders.empty()) {
                 return std::string("当前没有待触发的提醒");
             }
-            int64_t now_us = esp_timer_get_time();
-            std::string result = "当前有" + std::to_string(s_reminders.size()) + "个提醒：";
+            int64_t now = ReminderScheduler::Now();
+            std::string result = "当前有" + std::to_string(reminders.size()) + "个提醒：";
             int idx = 1;
-            for (auto& r : s_reminders) {
-                int64_t rem_sec = (r.trigger_us - now_us) / 1000000LL;
+            for (auto& r : reminders) {
+                int64_t rem_sec = r.trigger - now;
                 if (rem_sec < 0) rem_sec = 0;
-                int h = (int)(rem_sec / 3600);
-                int m = (int)((rem_sec % 3600) / 60);
-                int s = (int)(rem_sec % 60);
-                std::string when;
-                if (h > 0) when += std::to_string(h) + "小时";
-                if (m > 0) when += std::to_string(m) + "分钟";
-                if (s > 0 && h == 0) when += std::to_string(s) + "秒";
+                std::string when = DescribeDuration(rem_sec);
                 if (when.empty()) when = "即将触发";
-                result += std::to_string(idx++) + ". " + when + "后：" + r.message
+                std::string repeat_desc = DescribeRepeat(r);
+                result += std::to_string(idx++) + ". " + when + "后"
+                        + (repeat_desc.empty() ? "" : "（" + repeat_desc + "）") + "：" + r.message
                         + "（编号：" + std::to_string(r.id) + "）；";
             }
             return result;
@@ -1536,26 +1620,14 @@ void MyHomeDevice::RegisterHomeDeviceTools() {
                 }
                 int target_id = by_id ? atoi(keyword.c_str()) : 0;
 
-                std::vector<std::string> cancelled;
-                {
-                    std::lock_guard<std::mutex> lock(s_reminder_mutex);
-                    auto it = s_reminders.begin();
-                    while (it != s_reminders.end()) {
-                        bool match = by_id
-                            ? (it->id == target_id)
-                            : (it->message.find(keyword) != std::string::npos);
-                        if (match) {
-                            cancelled.push_back(it->message);
-                            it = s_reminders.erase(it);
-                        } else {
-                            ++it;
-                        }
-                    }
-                }
+                auto cancelled = ReminderScheduler::GetInstance().Cancel([&](const Reminder& r) {
+                    return by_id ? (r.id == target_id)
+                                 : (r.message.find(keyword) != std::string::npos);
+                });
 
                 if (cancelled.empty()) return std::string("未找到匹配的提醒：") + keyword;
                 std::string result = "已取消" + std::to_string(cancelled.size()) + "个提醒：";
-                for (auto& msg : cancelled) result += msg + " ";
+                for (auto& r : cancelled) result += r.message + " ";
                 return result;
             } catch (...) {
                 return std::string("取消提醒失败，请检查参数");
@@ -1715,6 +1787,7 @@ void MyHomeDevice::RegisterHomeDeviceTools() {
     }
 
     // 启动后台监控任务（跌倒检测和门磁监控暂时禁用）
+    RegisterEventHandlers();
     // StartFallDetectionMonitor();
     StartReminderTask();
     // StartDoorMonitor();
@@ -1815,7 +1888,9 @@ static void ShowJpegOnDisplay(const std::string& jpeg_data) {
     int w = hdr.width, h = hdr.height;
     size_t rgb_size = (size_t)w * h * 2;
     // outbuf 必须 16 字节对齐（esp_jpeg_dec 要求）
-    uint8_t* rgb = (uint8_t*)heap_caps_aligned_alloc(16, rgb_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    // 交给 LvglAllocatedImage 显示，按 display 记账
+    uint8_t* rgb = (uint8_t*)MemoryBudget::GetInstance().AlignedMalloc(
+        kMemoryTagDisplay, 16, rgb_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
     if (!rgb) {
         ESP_LOGE(TAG, "OOM for RGB565 buf (%d bytes), need PSRAM", (int)rgb_size);
         jpeg_dec_close(dec);
@@ -1826,7 +1901,7 @@ static void ShowJpegOnDisplay(const std::string& jpeg_data) {
     io.out_size = rgb_size;
     if (jpeg_dec_process(dec, &io) != JPEG_ERR_OK) {
         ESP_LOGE(TAG, "jpeg_dec_process failed");
-        heap_caps_free(rgb);
+        MemoryBudget::GetInstance().Free(kMemoryTagDisplay, rgb);
         jpeg_dec_close(dec);
         return;
     }
@@ -1838,7 +1913,7 @@ static void ShowJpegOnDisplay(const std::string& jpeg_data) {
         auto img = std::make_unique<LvglAllocatedImage>(rgb, rgb_size, w, h, w * 2, LV_COLOR_FORMAT_RGB565);
         display->SetPreviewImage(std::move(img));
     } catch (...) {
-        heap_caps_free(rgb);
+        MemoryBudget::GetInstance().Free(kMemoryTagDisplay, rgb);
     }
 }
 
@@ -1848,10 +1923,9 @@ static void ShowJpegOnDisplay(const std::string& jpeg_data) {
 /*
 static void FallDetectionMonitorTask(void*) {
     static const int POLL_MS     = FALL_DETECT_POLL_SEC     * 1000;
-    static const int COOLDOWN_MS = FALL_DETECT_COOLDOWN_SEC * 1000;
 
-    // last_alert_ms：上次报警时间（报警后冷却 120s 才再次报警）
-    int64_t last_alert_ms = -(int64_t)COOLDOWN_MS;
+    // 只把有明显变化的画面送去 AI 分析
+    static MotionGate motion_gate;  // 约 3KB，不放在任务栈上
 
     ESP_LOGI(TAG, "FallDetectionMonitor started, poll=%ds alert_cooldown=%ds",
              FALL_DETECT_POLL_SEC, FALL_DETECT_COOLDOWN_SEC);
@@ -1899,14 +1973,27 @@ static void FallDetectionMonitorTask(void*) {
         std::string jpeg_data;
         if (!DownloadJpegFromHA(jpeg_data, HA_CAMERA_PROXY_SMALL_URL)) continue;
 
-        // 4. AI 分析是否有人跌倒
+        // 4. 本地运动门限：画面与上次上传的相比变化不大就不上传
+        if (!motion_gate.ShouldAnalyze(jpeg_data, esp_timer_get_time() / 1000)) {
+            ESP_LOGI(TAG, "FallDetect: scene unchanged (energy=%d changed=%d%%), skip, uploads avoided %lu/%lu",
+                     motion_gate.motion_energy(), motion_gate.changed_percent(),
+                     (unsigned long)motion_gate.skipped_frames(),
+                     (unsigned long)(motion_gate.skipped_frames() + motion_gate.forwarded_frames()));
+            continue;
+        }
+
+        // 5. AI 分析是否有人跌倒
         std::string analysis;
         std::string question = "请仔细分析画面，判断是否有人跌倒、摔倒、倒地或出现异常姿态。"
                                "如果发现有人跌倒，请以'【跌倒警报】'开头详细描述情况；"
                                "如果画面正常，只需回复'正常'两字。";
-        if (!AnalyzeJpeg(jpeg_data, question, analysis)) continue;
+        if (!AnalyzeJpeg(jpeg_data, question, analysis)) {
+            // 没分析成功，下一帧无论变化大小都要上传
+            motion_gate.Reset();
+            continue;
+        }
 
-        // 5. 判断是否触发跌倒警报
+        // 6. 判断是否触发跌倒警报
         bool fall = analysis.find("跌倒警报") != std::string::npos ||
                     analysis.find("跌倒")     != std::string::npos ||
                     analysis.find("摔倒")     != std::string::npos ||
@@ -1918,24 +2005,8 @@ static void FallDetectionMonitorTask(void*) {
             continue;
         }
 
-        ESP_LOGW(TAG, "FallDetect: FALL DETECTED! %s", analysis.c_str());
-
-        // 6. 报警冷却：120s 内不重复报警
-        int64_t now_ms = esp_timer_get_time() / 1000;
-        if (now_ms - last_alert_ms < COOLDOWN_MS) {
-            ESP_LOGW(TAG, "FallDetect: alert cooldown, skip");
-            continue;
-        }
-        last_alert_ms = now_ms;
-
-        // 7. 连续播放提示音三次
-        {
-            auto& audio = Application::GetInstance().GetAudioService();
-            for (int i = 0; i < 3; i++) {
-                audio.PlaySound(Lang::Sounds::OGG_VIBRATION);
-                vTaskDelay(pdMS_TO_TICKS(600));  // 原1200ms，缩短为600ms更及时
-            }
-        }
+        // 7. 报警交给事件总线：冷却（FALL_DETECT_COOLDOWN_SEC）和提示音都在订阅者那边
+        EventBus::GetInstance().Publish(kEventFallDetected, 0, analysis.c_str());
     }
     vTaskDelete(nullptr);
 }
@@ -1951,11 +2022,9 @@ void StartFallDetectionMonitor() {
 /*
 static void DoorMonitorTask(void*) {
     static const int POLL_MS     = 2000;   // 每 2 秒轮询一次（原3秒，提高响应速度）
-    static const int COOLDOWN_MS = 30000;  // 报警后 30 秒内不重复提醒
 
     bool last_open = false;              // 上次检测到的状态（false=关, true=开）
     bool initialized = false;           // 第一次采样只记录状态，不报警
-    int64_t last_alert_ms = -(int64_t)COOLDOWN_MS;
 
     ESP_LOGI(TAG, "DoorMonitor started, poll=2s cooldown=30s");
 
@@ -1977,18 +2046,9 @@ static void DoorMonitorTask(void*) {
             continue;
         }
 
-        // 门从关→开，且已过冷却时间，才报警
+        // 门从关→开才报警，30 秒冷却由事件总线处理
         if (door_open && !last_open) {
-            int64_t now_ms = (int64_t)(esp_timer_get_time() / 1000);
-            if (now_ms - last_alert_ms >= COOLDOWN_MS) {
-                last_alert_ms = now_ms;
-                ESP_LOGI(TAG, "Door opened! Playing alert sound.");
-                auto& audio = Application::GetInstance().GetAudioService();
-                for (int i = 0; i < 3; i++) {
-                    audio.PlaySound(Lang::Sounds::OGG_VIBRATION);
-                    vTaskDelay(pdMS_TO_TICKS(600));  // 原1200ms，缩短为600ms更及时
-                }
-            }
+            EventBus::GetInstance().Publish(kEventDoorOpened);
         }
 
         last_open = door_open;
@@ -2,6 +2,8 @@
 #include "system_info.h"
 #include "settings.h"
 #include "assets/lang_config.h"
+#include "delta_patcher.h"
+#include "memory_budget.h"
 
 #include <cJSON.h>
 #include <esp_log.h>
@@ -10,6 +12,11 @@
 #include <esp_app_format.h>
 #include <esp_efuse.h>
 #include <esp_efuse_table.h>
+#include <esp_heap_caps.h>
+#include <mbedtls/sha256.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
 #ifdef SOC_HMAC_SUPPORTED
 #include <esp_hmac.h>
 #endif
@@ -18,9 +25,17 @@
 #include <vector>
 #include <sstream>
 #include <algorithm>
+#include <array>
 
 #define TAG "Ota"
 
+// Firmware is downloaded into a small pool of chunks so that network reads and flash writes overlap
+#define OTA_CHUNK_COUNT 2
+#define OTA_CHUNK_SIZE_PSRAM (16 * 1024)
+#define OTA_CHUNK_SIZE_INTERNAL (4 * 1024)
+#define OTA_MAX_RESUME_RETRIES 5
+#define OTA_DELTA_BUFFER_SIZE 4096
+
 
 Ota::Ota() {
 #ifdef ESP_EFUSE_BLOCK_USR_DATA
@@ -217,6 +232,23 @@ bool Ota::CheckVersion() {
         if (cJSON_IsString(url)) {
             firmware_url_ = url->valuestring;
         }
+        // Optional, hex encoded SHA-256 of the whole image, verified while downloading
+        firmware_sha256_.clear();
+        cJSON *sha256 = cJSON_GetObjectItem(firmware, "sha256");
+        if (cJSON_IsString(sha256) && strlen(sha256->valuestring) == 64) {
+            firmware_sha256_ = sha256->valuestring;
+            std::transform(firmware_sha256_.begin(), firmware_sha256_.end(), firmware_sha256_.begin(), ::tolower);
+        }
+        // Optional delta patch, only usable when it was built against the running version
+        delta_url_.clear();
+        cJSON *delta = cJSON_GetObjectItem(firmware, "delta");
+        if (cJSON_IsObject(delta)) {
+            cJSON *delta_url = cJSON_GetObjectItem(delta, "url");
+            cJSON *delta_from = cJSON_GetObjectItem(delta, "from");
+            if (cJSON_IsString(delta_url) && cJSON_IsString(delta_from) && current_version_ == delta_from->valuestring) {
+                delta_url_ = delta_url->valuestring;
+            }
+        }
 
         if (cJSON_IsString(version) && cJSON_IsString(url)) {
             // Check if the version is newer, for example, 0.1.0 is newer than 0.0.1
@@ -260,51 +292,241 @@ void Ota::MarkCurrentVersionValid() {
     }
 }
 
-bool Ota::Upgrade(const std::string& firmware_url) {
-    ESP_LOGI(TAG, "Upgrading firmware from %s", firmware_url.c_str());
+namespace {
+
+struct OtaChunk {
+    uint8_t* data = nullptr;
+    size_t size = 0;
+};
+
+struct OtaWriterContext {
     esp_ota_handle_t update_handle = 0;
-    auto update_partition = esp_ota_get_next_update_partition(NULL);
-    if (update_partition == NULL) {
-        ESP_LOGE(TAG, "Failed to get update partition");
-        return false;
+    QueueHandle_t free_queue = nullptr;
+    QueueHandle_t filled_queue = nullptr;
+    SemaphoreHandle_t done = nullptr;
+    mbedtls_sha256_context sha256;
+    volatile esp_err_t error = ESP_OK;
+    int64_t flash_time_us = 0;
+};
+
+// Drains filled chunks into flash and the running SHA-256, a null chunk stops the task
+void OtaWriterTask(void* arg) {
+    auto ctx = static_cast<OtaWriterContext*>(arg);
+    while (true) {
+        OtaChunk* chunk = nullptr;
+        xQueueReceive(ctx->filled_queue, &chunk, portMAX_DELAY);
+        if (chunk == nullptr) {
+            break;
+        }
+        if (ctx->error == ESP_OK) {
+            auto start_time = esp_timer_get_time();
+            esp_err_t err = esp_ota_write(ctx->update_handle, chunk->data, chunk->size);
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to write OTA data: %s", esp_err_to_name(err));
+                ctx->error = err;
+            } else {
+                mbedtls_sha256_update(&ctx->sha256, chunk->data, chunk->size);
+            }
+            ctx->flash_time_us += esp_timer_get_time() - start_time;
+        }
+        xQueueSend(ctx->free_queue, &chunk, portMAX_DELAY);
     }
+    xSemaphoreGive(ctx->done);
+    vTaskDelete(NULL);
+}
 
-    ESP_LOGI(TAG, "Writing to partition %s at offset 0x%lx", update_partition->label, update_partition->address);
-    bool image_header_checked = false;
-    std::string image_header;
+std::string Sha256ToHex(const uint8_t* digest) {
+    char hex[65];
+    for (size_t i = 0; i < 32; i++) {
+        snprintf(hex + i * 2, 3, "%02x", digest[i]);
+    }
+    return std::string(hex);
+}
 
+} // namespace
+
+std::unique_ptr<Http> Ota::OpenFirmwareStream(const std::string& firmware_url, size_t offset, size_t& body_length) {
     auto network = Board::GetInstance().GetNetwork();
     auto http = network->CreateHttp(0);
+    if (offset > 0) {
+        http->SetHeader("Range", "bytes=" + std::to_string(offset) + "-");
+    }
     if (!http->Open("GET", firmware_url)) {
         ESP_LOGE(TAG, "Failed to open HTTP connection");
-        return false;
+        return nullptr;
+    }
+
+    int expected_status = offset > 0 ? 206 : 200;
+    if (http->GetStatusCode() != expected_status) {
+        ESP_LOGE(TAG, "Failed to get firmware at offset %u, status code: %d", offset, http->GetStatusCode());
+        return nullptr;
     }
 
-    if (http->GetStatusCode() != 200) {
-        ESP_LOGE(TAG, "Failed to get firmware, status code: %d", http->GetStatusCode());
+    body_length = http->GetBodyLength();
+    return http;
+}
+
+bool Ota::Upgrade(const std::string& firmware_url, const std::string& expected_sha256) {
+    ESP_LOGI(TAG, "Upgrading firmware from %s", firmware_url.c_str());
+    auto update_partition = esp_ota_get_next_update_partition(NULL);
+    if (update_partition == NULL) {
+        ESP_LOGE(TAG, "Failed to get update partition");
         return false;
     }
 
-    size_t content_length = http->GetBodyLength();
+    ESP_LOGI(TAG, "Writing to partition %s at offset 0x%lx", update_partition->label, update_partition->address);
+
+    size_t content_length = 0;
+    auto http = OpenFirmwareStream(firmware_url, 0, content_length);
+    if (!http) {
+        return false;
+    }
     if (content_length == 0) {
         ESP_LOGE(TAG, "Failed to get content length");
         return false;
     }
+    if (content_length > update_partition->size) {
+        ESP_LOGE(TAG, "Firmware size %u exceeds partition size %lu", content_length, update_partition->size);
+        return false;
+    }
+
+    // Prefer large chunks in PSRAM, fall back to smaller internal ones
+    size_t chunk_capacity = OTA_CHUNK_SIZE_PSRAM;
+    std::array<OtaChunk, OTA_CHUNK_COUNT> chunks;
+    auto& budget = MemoryBudget::GetInstance();
+    for (auto& chunk : chunks) {
+        chunk.data = (uint8_t*)budget.Malloc(kMemoryTagNetwork, OTA_CHUNK_SIZE_PSRAM, MALLOC_CAP_SPIRAM);
+        if (chunk.data == nullptr) {
+            chunk_capacity = OTA_CHUNK_SIZE_INTERNAL;
+            break;
+        }
+    }
+    if (chunk_capacity == OTA_CHUNK_SIZE_INTERNAL) {
+        for (auto& chunk : chunks) {
+            budget.Free(kMemoryTagNetwork, chunk.data);
+            chunk.data = (uint8_t*)budget.Malloc(kMemoryTagNetwork, OTA_CHUNK_SIZE_INTERNAL, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        }
+    }
+
+    OtaWriterContext ctx;
+    ctx.free_queue = xQueueCreate(OTA_CHUNK_COUNT, sizeof(OtaChunk*));
+    ctx.filled_queue = xQueueCreate(OTA_CHUNK_COUNT + 1, sizeof(OtaChunk*));
+    ctx.done = xSemaphoreCreateBinary();
+    mbedtls_sha256_init(&ctx.sha256);
+    mbedtls_sha256_starts(&ctx.sha256, 0);
+
+    bool resources_ok = ctx.free_queue != nullptr && ctx.filled_queue != nullptr && ctx.done != nullptr;
+    for (auto& chunk : chunks) {
+        resources_ok = resources_ok && chunk.data != nullptr;
+        if (resources_ok) {
+            OtaChunk* ptr = &chunk;
+            xQueueSend(ctx.free_queue, &ptr, 0);
+        }
+    }
+
+    bool ota_begun = false;
+    bool writer_started = false;
+    auto cleanup = [&](bool success) {
+        if (writer_started) {
+            OtaChunk* stop = nullptr;
+            xQueueSend(ctx.filled_queue, &stop, portMAX_DELAY);
+            xSemaphoreTake(ctx.done, portMAX_DELAY);
+        }
+        if (ota_begun && !success) {
+            esp_ota_abort(ctx.update_handle);
+        }
+        mbedtls_sha256_free(&ctx.sha256);
+        for (auto& chunk : chunks) {
+            budget.Free(kMemoryTagNetwork, chunk.data);
+        }
+        if (ctx.free_queue) vQueueDelete(ctx.free_queue);
+        if (ctx.filled_queue) vQueueDelete(ctx.filled_queue);
+        if (ctx.done) vSemaphoreDelete(ctx.done);
+    };
+
+    if (!resources_ok) {
+        ESP_LOGE(TAG, "Failed to allocate OTA buffers");
+        cleanup(false);
+        return false;
+    }
+    ESP_LOGI(TAG, "OTA pipeline: %d x %u bytes chunks", OTA_CHUNK_COUNT, chunk_capacity);
 
-    char buffer[512];
     size_t total_read = 0, recent_read = 0;
-    auto last_calc_time = esp_timer_get_time();
-    while (true) {
-        int ret = http->Read(buffer, sizeof(buffer));
-        if (ret < 0) {
-            ESP_LOGE(TAG, "Failed to read HTTP data: %s", esp_err_to_name(ret));
+    int resume_retries = 0;
+    int64_t reader_wait_us = 0;
+    const size_t header_size = sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t) + sizeof(esp_app_desc_t);
+    auto start_time = esp_timer_get_time();
+    auto last_calc_time = start_time;
+    // Kept across a resume until it holds the image header
+    OtaChunk* chunk = nullptr;
+    while (total_read < content_length) {
+        if (chunk == nullptr) {
+            auto wait_start = esp_timer_get_time();
+            xQueueReceive(ctx.free_queue, &chunk, portMAX_DELAY);
+            reader_wait_us += esp_timer_get_time() - wait_start;
+            if (ctx.error != ESP_OK) {
+                cleanup(false);
+                return false;
+            }
+            chunk->size = 0;
+        }
+
+        // Fill the whole chunk so each flash write is large
+        bool stream_broken = false;
+        while (chunk->size < chunk_capacity && total_read + chunk->size < content_length) {
+            size_t to_read = std::min(chunk_capacity - chunk->size, content_length - total_read - chunk->size);
+            int ret = http->Read((char*)chunk->data + chunk->size, to_read);
+            if (ret <= 0) {
+                ESP_LOGW(TAG, "HTTP read interrupted at %u/%u: %d", total_read + chunk->size, content_length, ret);
+                stream_broken = true;
+                break;
+            }
+            chunk->size += ret;
+        }
+
+        // Until the header is complete the chunk is held back and the download resumed into it
+        bool header_pending = !ota_begun && chunk->size < header_size;
+        if (header_pending && !stream_broken) {
+            ESP_LOGE(TAG, "Image header is truncated");
+            xQueueSend(ctx.free_queue, &chunk, 0);
+            cleanup(false);
             return false;
         }
+        if (!header_pending && !ota_begun) {
+            esp_app_desc_t new_app_info;
+            memcpy(&new_app_info, chunk->data + sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t), sizeof(esp_app_desc_t));
+            ESP_LOGI(TAG, "Current version: %s, New version: %s", esp_app_get_description()->version, new_app_info.version);
+
+            if (esp_ota_begin(update_partition, OTA_WITH_SEQUENTIAL_WRITES, &ctx.update_handle) != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to begin OTA");
+                xQueueSend(ctx.free_queue, &chunk, 0);
+                cleanup(false);
+                return false;
+            }
+            ota_begun = true;
+
+            if (xTaskCreate(OtaWriterTask, "ota_writer", 4096, &ctx, uxTaskPriorityGet(NULL), NULL) != pdPASS) {
+                ESP_LOGE(TAG, "Failed to create OTA writer task");
+                xQueueSend(ctx.free_queue, &chunk, 0);
+                cleanup(false);
+                return false;
+            }
+            writer_started = true;
+        }
+
+        if (!header_pending) {
+            if (chunk->size > 0) {
+                total_read += chunk->size;
+                recent_read += chunk->size;
+                xQueueSend(ctx.filled_queue, &chunk, portMAX_DELAY);
+            } else {
+                xQueueSend(ctx.free_queue, &chunk, 0);
+            }
+            chunk = nullptr;
+        }
 
         // Calculate speed and progress every second
-        recent_read += ret;
-        total_read += ret;
-        if (esp_timer_get_time() - last_calc_time >= 1000000 || ret == 0) {
+        if (esp_timer_get_time() - last_calc_time >= 1000000 || total_read == content_length) {
             size_t progress = total_read * 100 / content_length;
             ESP_LOGI(TAG, "Progress: %u%% (%u/%u), Speed: %uB/s", progress, total_read, content_length, recent_read);
             if (upgrade_callback_) {
@@ -314,39 +536,61 @@ bool Ota::Upgrade(const std::string& firmware_url) {
             recent_read = 0;
         }
 
-        if (ret == 0) {
-            break;
-        }
-
-        if (!image_header_checked) {
-            image_header.append(buffer, ret);
-            if (image_header.size() >= sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t) + sizeof(esp_app_desc_t)) {
-                esp_app_desc_t new_app_info;
-                memcpy(&new_app_info, image_header.data() + sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t), sizeof(esp_app_desc_t));
-                
-                auto current_version = esp_app_get_description()->version;
-                ESP_LOGI(TAG, "Current version: %s, New version: %s", current_version, new_app_info.version);
-
-                if (esp_ota_begin(update_partition, OTA_WITH_SEQUENTIAL_WRITES, &update_handle)) {
-                    esp_ota_abort(update_handle);
-                    ESP_LOGE(TAG, "Failed to begin OTA");
-                    return false;
+        size_t received = total_read + (chunk != nullptr ? chunk->size : 0);
+        if (stream_broken && received < content_length) {
+            // Resume from where the connection dropped with an HTTP range request
+            http.reset();
+            size_t remaining = 0;
+            while (!http && resume_retries < OTA_MAX_RESUME_RETRIES) {
+                resume_retries++;
+                vTaskDelay(pdMS_TO_TICKS(1000 * resume_retries));
+                ESP_LOGI(TAG, "Resuming download at %u (%d/%d)", received, resume_retries, OTA_MAX_RESUME_RETRIES);
+                http = OpenFirmwareStream(firmware_url, received, remaining);
+                if (http && remaining != content_length - received) {
+                    ESP_LOGE(TAG, "Unexpected range length %u, expected %u", remaining, content_length - received);
+                    http.reset();
                 }
-
-                image_header_checked = true;
-                std::string().swap(image_header);
             }
-        }
-        auto err = esp_ota_write(update_handle, buffer, ret);
-        if (err != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to write OTA data: %s", esp_err_to_name(err));
-            esp_ota_abort(update_handle);
-            return false;
+            if (!http) {
+                ESP_LOGE(TAG, "Failed to resume download");
+                if (chunk != nullptr) {
+                    xQueueSend(ctx.free_queue, &chunk, 0);
+                }
+                cleanup(false);
+                return false;
+            }
         }
     }
     http->Close();
 
-    esp_err_t err = esp_ota_end(update_handle);
+    // Wait for the writer to drain the last chunks
+    OtaChunk* stop = nullptr;
+    xQueueSend(ctx.filled_queue, &stop, portMAX_DELAY);
+    xSemaphoreTake(ctx.done, portMAX_DELAY);
+    writer_started = false;
+    if (ctx.error != ESP_OK) {
+        cleanup(false);
+        return false;
+    }
+
+    uint8_t digest[32];
+    mbedtls_sha256_finish(&ctx.sha256, digest);
+    auto digest_hex = Sha256ToHex(digest);
+    if (!expected_sha256.empty() && expected_sha256 != digest_hex) {
+        ESP_LOGE(TAG, "SHA-256 mismatch, expected %s, got %s", expected_sha256.c_str(), digest_hex.c_str());
+        cleanup(false);
+        return false;
+    }
+
+    auto elapsed_ms = (esp_timer_get_time() - start_time) / 1000;
+    ESP_LOGI(TAG, "Downloaded %u bytes in %lld ms (%lld KB/s), flash %lld ms, reader waited %lld ms, resumes %d, sha256 %s%s",
+        total_read, elapsed_ms, elapsed_ms > 0 ? (int64_t)total_read / elapsed_ms : 0LL,
+        ctx.flash_time_us / 1000, reader_wait_us / 1000, resume_retries, digest_hex.c_str(),
+        expected_sha256.empty() ? " (not verified)" : " (verified)");
+
+    esp_err_t err = esp_ota_end(ctx.update_handle);
+    ota_begun = false;
+    cleanup(true);
     if (err != ESP_OK) {
         if (err == ESP_ERR_OTA_VALIDATE_FAILED) {
             ESP_LOGE(TAG, "Image validation failed, image is corrupted");
@@ -366,14 +610,173 @@ bool Ota::Upgrade(const std::string& firmware_url) {
     return true;
 }
 
+bool Ota::UpgradeFromDelta(const std::string& patch_url, const std::string& expected_sha256) {
+    ESP_LOGI(TAG, "Upgrading firmware with delta patch from %s", patch_url.c_str());
+    auto running_partition = esp_ota_get_running_partition();
+    auto update_partition = esp_ota_get_next_update_partition(NULL);
+    if (running_partition == NULL || update_partition == NULL) {
+        ESP_LOGE(TAG, "Failed to get OTA partitions");
+        return false;
+    }
+
+    size_t patch_length = 0;
+    auto http = OpenFirmwareStream(patch_url, 0, patch_length);
+    if (!http) {
+        return false;
+    }
+
+    auto free_buffer = [](uint8_t* ptr) { MemoryBudget::GetInstance().Free(kMemoryTagNetwork, ptr); };
+    std::unique_ptr<uint8_t, decltype(free_buffer)> buffer(
+        (uint8_t*)MemoryBudget::GetInstance().Malloc(kMemoryTagNetwork, OTA_DELTA_BUFFER_SIZE,
+            MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT), free_buffer);
+    if (!buffer) {
+        ESP_LOGE(TAG, "Failed to allocate delta buffer");
+        return false;
+    }
+
+    size_t header_size = 0;
+    while (header_size < DELTA_PATCH_HEADER_SIZE) {
+        int ret = http->Read((char*)buffer.get() + header_size, DELTA_PATCH_HEADER_SIZE - header_size);
+        if (ret <= 0) {
+            ESP_LOGE(TAG, "Failed to read patch header");
+            return false;
+        }
+        header_size += ret;
+    }
+    DeltaPatchHeader header;
+    if (!DeltaPatcher::ParseHeader(buffer.get(), header_size, header)) {
+        return false;
+    }
+    if (header.source_size > running_partition->size || header.target_size > update_partition->size) {
+        ESP_LOGE(TAG, "Patch sizes do not fit the partitions");
+        return false;
+    }
+    if (!expected_sha256.empty() && expected_sha256 != Sha256ToHex(header.target_sha256)) {
+        ESP_LOGE(TAG, "Patch target does not match the firmware in the manifest");
+        return false;
+    }
+
+    // The patch is only valid against the exact image that is running now
+    mbedtls_sha256_context sha256;
+    mbedtls_sha256_init(&sha256);
+    mbedtls_sha256_starts(&sha256, 0);
+    bool source_ok = true;
+    for (size_t offset = 0; offset < header.source_size; offset += OTA_DELTA_BUFFER_SIZE) {
+        size_t n = std::min((size_t)OTA_DELTA_BUFFER_SIZE, (size_t)header.source_size - offset);
+        if (esp_partition_read(running_partition, offset, buffer.get(), n) != ESP_OK) {
+            source_ok = false;
+            break;
+        }
+        mbedtls_sha256_update(&sha256, buffer.get(), n);
+    }
+    uint8_t digest[32];
+    mbedtls_sha256_finish(&sha256, digest);
+    mbedtls_sha256_free(&sha256);
+    if (!source_ok || memcmp(digest, header.source_sha256, sizeof(digest)) != 0) {
+        ESP_LOGE(TAG, "Running image does not match the patch source");
+        return false;
+    }
+
+    esp_ota_handle_t update_handle = 0;
+    if (esp_ota_begin(update_partition, OTA_WITH_SEQUENTIAL_WRITES, &update_handle) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to begin OTA");
+        return false;
+    }
+
+    mbedtls_sha256_init(&sha256);
+    mbedtls_sha256_starts(&sha256, 0);
+    DeltaPatcher patcher(header,
+        [running_partition](size_t offset, uint8_t* data, size_t size) {
+            return esp_partition_read(running_partition, offset, data, size) == ESP_OK;
+        },
+        [update_handle, &sha256](const uint8_t* data, size_t size) {
+            esp_err_t err = esp_ota_write(update_handle, data, size);
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to write OTA data: %s", esp_err_to_name(err));
+                return false;
+            }
+            mbedtls_sha256_update(&sha256, data, size);
+            return true;
+        });
+
+    bool success = patcher.Initialize();
+    size_t total_read = header_size, recent_read = 0;
+    auto start_time = esp_timer_get_time();
+    auto last_calc_time = start_time;
+    while (success) {
+        int ret = http->Read((char*)buffer.get(), OTA_DELTA_BUFFER_SIZE);
+        if (ret < 0) {
+            ESP_LOGE(TAG, "Failed to read patch data: %d", ret);
+            success = false;
+            break;
+        }
+        if (ret == 0) {
+            break;
+        }
+        total_read += ret;
+        recent_read += ret;
+        success = patcher.Feed(buffer.get(), ret);
+
+        if (esp_timer_get_time() - last_calc_time >= 1000000) {
+            size_t progress = patcher.target_written() * 100 / header.target_size;
+            ESP_LOGI(TAG, "Progress: %u%% (%u/%lu), Speed: %uB/s", progress, patcher.target_written(), header.target_size, recent_read);
+            if (upgrade_callback_) {
+                upgrade_callback_(progress, recent_read);
+            }
+            last_calc_time = esp_timer_get_time();
+            recent_read = 0;
+        }
+    }
+    http->Close();
+
+    success = success && patcher.Finish();
+    mbedtls_sha256_finish(&sha256, digest);
+    mbedtls_sha256_free(&sha256);
+    if (success && memcmp(digest, header.target_sha256, sizeof(digest)) != 0) {
+        ESP_LOGE(TAG, "Patched image SHA-256 mismatch");
+        success = false;
+    }
+    if (!success) {
+        esp_ota_abort(update_handle);
+        return false;
+    }
+
+    ESP_LOGI(TAG, "Patched %lu bytes image from %u bytes of patch data in %lld ms",
+        header.target_size, total_read, (esp_timer_get_time() - start_time) / 1000);
+    if (upgrade_callback_) {
+        upgrade_callback_(100, recent_read);
+    }
+
+    esp_err_t err = esp_ota_end(update_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to end OTA: %s", esp_err_to_name(err));
+        return false;
+    }
+    err = esp_ota_set_boot_partition(update_partition);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to set boot partition: %s", esp_err_to_name(err));
+        return false;
+    }
+
+    ESP_LOGI(TAG, "Firmware upgrade successful");
+    return true;
+}
+
 bool Ota::StartUpgrade(std::function<void(int progress, size_t speed)> callback) {
     upgrade_callback_ = callback;
-    return Upgrade(firmware_url_);
+    if (!delta_url_.empty()) {
+        if (UpgradeFromDelta(delta_url_, firmware_sha256_)) {
+            return true;
+        }
+        ESP_LOGW(TAG, "Delta upgrade failed, falling back to the full image");
+    }
+    return Upgrade(firmware_url_, firmware_sha256_);
 }
 
 bool Ota::StartUpgradeFromUrl(const std::string& url, std::function<void(int progress, size_t speed)> callback) {
     upgrade_callback_ = callback;
-    return Upgrade(url);
+    // The manifest hash only applies to the URL it was published with
+    return Upgrade(url, url == firmware_url_ ? firmware_sha256_ : "");
 }
 
 std::vector<int> Ota::ParseVersion(const std::string& version) {
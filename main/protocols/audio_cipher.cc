@@ -0,0 +1,88 @@
+#include "audio_cipher.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#include <algorithm>
+#include <cstring>
+
+#define TAG "AudioCipher"
+
+AudioCipher::AudioCipher() {
+#if AUDIO_CIPHER_HARDWARE
+    esp_aes_init(&ctx_);
+#else
+    mbedtls_aes_init(&ctx_);
+#endif
+}
+
+AudioCipher::~AudioCipher() {
+#if AUDIO_CIPHER_HARDWARE
+    esp_aes_free(&ctx_);
+#else
+    mbedtls_aes_free(&ctx_);
+#endif
+}
+
+bool AudioCipher::SetKey(const uint8_t* key, size_t key_size) {
+    if (key_size != 16) {
+        ESP_LOGE(TAG, "Invalid key size: %u", (unsigned)key_size);
+        has_key_ = false;
+        return false;
+    }
+#if AUDIO_CIPHER_HARDWARE
+    int ret = esp_aes_setkey(&ctx_, key, 128);
+#else
+    int ret = mbedtls_aes_setkey_enc(&ctx_, key, 128);
+#endif
+    has_key_ = ret == 0;
+    if (!has_key_) {
+        ESP_LOGE(TAG, "Failed to set key, ret: %d", ret);
+    }
+    return has_key_;
+}
+
+bool AudioCipher::Crypt(const uint8_t* header, const uint8_t* input, uint8_t* output, size_t size) {
+    if (!has_key_) {
+        return false;
+    }
+
+    int64_t start = esp_timer_get_time();
+    // CTR advances the counter block, so it must not be the packet header itself
+    uint8_t counter[AUDIO_CIPHER_HEADER_SIZE];
+    uint8_t stream_block[AUDIO_CIPHER_HEADER_SIZE];
+    size_t nc_off = 0;
+    memcpy(counter, header, sizeof(counter));
+#if AUDIO_CIPHER_HARDWARE
+    int ret = esp_aes_crypt_ctr(&ctx_, size, &nc_off, counter, stream_block, input, output);
+#else
+    int ret = mbedtls_aes_crypt_ctr(&ctx_, size, &nc_off, counter, stream_block, input, output);
+#endif
+    if (ret != 0) {
+        ESP_LOGE(TAG, "AES-CTR failed, ret: %d", ret);
+        return false;
+    }
+
+    uint32_t elapsed = (uint32_t)(esp_timer_get_time() - start);
+    packets_++;
+    bytes_ += size;
+    total_us_ += elapsed;
+    max_us_ = std::max(max_us_, elapsed);
+    return true;
+}
+
+void AudioCipher::LogStats(const char* name) {
+    if (packets_ == 0) {
+        return;
+    }
+    ESP_LOGI(TAG, "%s: %lu packets, %lu bytes avg, %lu us avg, %lu us max (%s)", name,
+        (unsigned long)packets_, (unsigned long)(bytes_ / packets_), (unsigned long)(total_us_ / packets_),
+        (unsigned long)max_us_, AUDIO_CIPHER_HARDWARE ? "hardware" : "software");
+}
+
+void AudioCipher::ResetStats() {
+    packets_ = 0;
+    bytes_ = 0;
+    total_us_ = 0;
+    max_us_ = 0;
+}
@@ -0,0 +1,55 @@
+#ifndef AUDIO_CIPHER_H
+#define AUDIO_CIPHER_H
+
+#include <cstdint>
+#include <cstddef>
+
+#if CONFIG_MBEDTLS_HARDWARE_AES && !CONFIG_IDF_TARGET_LINUX
+#include <aes/esp_aes.h>
+#define AUDIO_CIPHER_HARDWARE 1
+#else
+#include <mbedtls/aes.h>
+#define AUDIO_CIPHER_HARDWARE 0
+#endif
+
+// The packet header doubles as the initial AES-CTR counter block
+#define AUDIO_CIPHER_HEADER_SIZE 16
+
+/*
+ * AES-128-CTR for the UDP audio channel.
+ *
+ * On chips with the AES accelerator the esp_aes driver is called directly,
+ * elsewhere (the Linux target, or with the accelerator disabled) mbedtls does
+ * it in software. Input and output may be the same buffer, so packets can be
+ * processed in place. Every call is timed, LogStats() prints the average and
+ * worst case per packet.
+ *
+ * The context is not shared: use one instance per direction.
+ */
+class AudioCipher {
+public:
+    AudioCipher();
+    ~AudioCipher();
+
+    bool SetKey(const uint8_t* key, size_t key_size);
+    // Encrypts or decrypts size bytes under the 16 byte header, the header is left untouched
+    bool Crypt(const uint8_t* header, const uint8_t* input, uint8_t* output, size_t size);
+
+    void LogStats(const char* name);
+    void ResetStats();
+
+private:
+#if AUDIO_CIPHER_HARDWARE
+    esp_aes_context ctx_;
+#else
+    mbedtls_aes_context ctx_;
+#endif
+    bool has_key_ = false;
+
+    uint32_t packets_ = 0;
+    uint64_t bytes_ = 0;
+    uint64_t total_us_ = 0;
+    uint32_t max_us_ = 0;
+};
+
+#endif // AUDIO_CIPHER_H
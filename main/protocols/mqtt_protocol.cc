@@ -91,32 +91,31 @@ bool MqttProtocol::StartMqttClient(bool report_error) {
     });
 
     mqtt_->OnMessage([this](const std::string& topic, const std::string& payload) {
-        cJSON* root = cJSON_Parse(payload.c_str());
-        if (root == nullptr) {
+        ServerMessage message;
+        if (!ParseServerMessage(payload.data(), payload.size(), message)) {
             ESP_LOGE(TAG, "Failed to parse json message %s", payload.c_str());
             return;
         }
-        cJSON* type = cJSON_GetObjectItem(root, "type");
-        if (!cJSON_IsString(type)) {
-            ESP_LOGE(TAG, "Message type is invalid");
-            cJSON_Delete(root);
-            return;
-        }
 
-        if (strcmp(type->valuestring, "hello") == 0) {
+        if (message.type == kServerMessageHello) {
+            cJSON* root = cJSON_ParseWithLength(payload.data(), payload.size());
+            if (root == nullptr) {
+                ESP_LOGE(TAG, "Failed to parse hello message %s", payload.c_str());
+                return;
+            }
             ParseServerHello(root);
-        } else if (strcmp(type->valuestring, "goodbye") == 0) {
-            auto session_id = cJSON_GetObjectItem(root, "session_id");
-            ESP_LOGI(TAG, "Received goodbye message, session_id: %s", session_id ? session_id->valuestring : "null");
-            if (session_id == nullptr || session_id_ == session_id->valuestring) {
+            cJSON_Delete(root);
+        } else if (message.type == kServerMessageGoodbye) {
+            ESP_LOGI(TAG, "Received goodbye message, session_id: %.*s",
+                (int)message.session_id.size(), message.session_id.data());
+            if (message.session_id.empty() || session_id_ == message.session_id) {
                 Application::GetInstance().Schedule([this]() {
                     CloseAudioChannel();
                 });
             }
-        } else if (on_incoming_json_ != nullptr) {
-            on_incoming_json_(root);
+        } else {
+            DispatchIncomingMessage(payload.data(), payload.size(), message);
         }
-        cJSON_Delete(root);
         last_incoming_time_ = std::chrono::steady_clock::now();
     });
 
@@ -157,32 +156,46 @@ bool MqttProtocol::SendAudio(std::unique_ptr<AudioStreamPacket> packet) {
     if (udp_ == nullptr) {
         return false;
     }
+    return SendAudioLocked(*packet);
+}
 
-    std::string nonce(aes_nonce_);
-    *(uint16_t*)&nonce[2] = htons(packet->payload.size());
-    *(uint32_t*)&nonce[8] = htonl(packet->timestamp);
-    *(uint32_t*)&nonce[12] = htonl(++local_sequence_);
-
-    std::string encrypted;
-    encrypted.resize(aes_nonce_.size() + packet->payload.size());
-    memcpy(encrypted.data(), nonce.data(), nonce.size());
+bool MqttProtocol::SendAudioBatch(std::vector<std::unique_ptr<AudioStreamPacket>>& packets) {
+    // One lock and one datagram buffer for the whole batch, the datagrams still go out one by one
+    std::lock_guard<std::mutex> lock(channel_mutex_);
+    bool success = udp_ != nullptr;
+    for (size_t i = 0; success && i < packets.size(); i++) {
+        success = SendAudioLocked(*packets[i]);
+    }
+    packets.clear();
+    return success;
+}
 
-    size_t nc_off = 0;
-    uint8_t stream_block[16] = {0};
-    if (mbedtls_aes_crypt_ctr(&aes_ctx_, packet->payload.size(), &nc_off, (uint8_t*)nonce.c_str(), stream_block,
-        (uint8_t*)packet->payload.data(), (uint8_t*)&encrypted[nonce.size()]) != 0) {
+// channel_mutex_ must be held and udp_ valid
+bool MqttProtocol::SendAudioLocked(const AudioStreamPacket& packet) {
+    // The header is the nonce of this packet, it is built in place and the payload is
+    // encrypted straight behind it, the buffer capacity is kept between packets
+    send_buffer_.resize(AUDIO_CIPHER_HEADER_SIZE + packet.payload.size());
+    auto header = (uint8_t*)send_buffer_.data();
+    memcpy(header, aes_nonce_.data(), AUDIO_CIPHER_HEADER_SIZE);
+    *(uint16_t*)&header[2] = htons(packet.payload.size());
+    *(uint32_t*)&header[8] = htonl(packet.timestamp);
+    *(uint32_t*)&header[12] = htonl(++local_sequence_);
+
+    if (!tx_cipher_.Crypt(header, packet.payload.data(), header + AUDIO_CIPHER_HEADER_SIZE, packet.payload.size())) {
         ESP_LOGE(TAG, "Failed to encrypt audio data");
         return false;
     }
 
-    return udp_->Send(encrypted) > 0;
+    return udp_->Send(send_buffer_) > 0;
 }
 
 void MqttProtocol::CloseAudioChannel() {
     {
         std::lock_guard<std::mutex> lock(channel_mutex_);
         udp_.reset();
+        tx_cipher_.LogStats("Encrypt");
     }
+    rx_cipher_.LogStats("Decrypt");
 
     std::string message = "{";
     message += "\"session_id\":\"" + session_id_ + "\",";
@@ -221,6 +234,9 @@ bool MqttProtocol::OpenAudioChannel() {
     }
 
     std::lock_guard<std::mutex> lock(channel_mutex_);
+    send_buffer_.reserve(AUDIO_CIPHER_HEADER_SIZE + MQTT_UDP_MAX_AUDIO_PAYLOAD);
+    tx_cipher_.ResetStats();
+    rx_cipher_.ResetStats();
     auto network = Board::GetInstance().GetNetwork();
     udp_ = network->CreateUdp(2);
     udp_->OnMessage([this](const std::string& data) {
@@ -229,7 +245,7 @@ bool MqttProtocol::OpenAudioChannel() {
          * |type 1u|flags 1u|payload_len 2u|ssrc 4u|timestamp 4u|sequence 4u|
          * |payload payload_len|
          */
-        if (data.size() < sizeof(aes_nonce_)) {
+        if (data.size() < AUDIO_CIPHER_HEADER_SIZE) {
             ESP_LOGE(TAG, "Invalid audio packet size: %u", data.size());
             return;
         }
@@ -247,19 +263,16 @@ bool MqttProtocol::OpenAudioChannel() {
             ESP_LOGW(TAG, "Received audio packet with wrong sequence: %lu, expected: %lu", sequence, remote_sequence_ + 1);
         }
 
-        size_t decrypted_size = data.size() - aes_nonce_.size();
-        size_t nc_off = 0;
-        uint8_t stream_block[16] = {0};
-        auto nonce = (uint8_t*)data.data();
-        auto encrypted = (uint8_t*)data.data() + aes_nonce_.size();
+        size_t decrypted_size = data.size() - AUDIO_CIPHER_HEADER_SIZE;
+        auto header = (const uint8_t*)data.data();
         auto packet = std::make_unique<AudioStreamPacket>();
         packet->sample_rate = server_sample_rate_;
         packet->frame_duration = server_frame_duration_;
         packet->timestamp = timestamp;
         packet->payload.resize(decrypted_size);
-        int ret = mbedtls_aes_crypt_ctr(&aes_ctx_, decrypted_size, &nc_off, nonce, stream_block, encrypted, (uint8_t*)packet->payload.data());
-        if (ret != 0) {
-            ESP_LOGE(TAG, "Failed to decrypt audio data, ret: %d", ret);
+        // Decrypted straight into the payload, the datagram itself is not copied
+        if (!rx_cipher_.Crypt(header, header + AUDIO_CIPHER_HEADER_SIZE, packet->payload.data(), decrypted_size)) {
+            ESP_LOGE(TAG, "Failed to decrypt audio data");
             return;
         }
         if (on_incoming_audio_ != nullptr) {
@@ -286,6 +299,9 @@ std::string MqttProtocol::GetHelloMessage() {
     cJSON* features = cJSON_CreateObject();
 #if CONFIG_USE_SERVER_AEC
     cJSON_AddBoolToObject(features, "aec", true);
+#endif
+#if CONFIG_USE_UPLINK_SILENCE_SUPPRESSION
+    cJSON_AddBoolToObject(features, "dtx", true);
 #endif
     cJSON_AddBoolToObject(features, "mcp", true);
     cJSON_AddItemToObject(root, "features", features);
@@ -294,6 +310,9 @@ std::string MqttProtocol::GetHelloMessage() {
     cJSON_AddNumberToObject(audio_params, "sample_rate", 16000);
     cJSON_AddNumberToObject(audio_params, "channels", 1);
     cJSON_AddNumberToObject(audio_params, "frame_duration", OPUS_FRAME_DURATION_MS);
+    // Uplink frame durations the server may pick from with uplink_frame_duration
+    static const int uplink_frame_durations[] = {20, 40, 60};
+    cJSON_AddItemToObject(audio_params, "uplink_frame_durations", cJSON_CreateIntArray(uplink_frame_durations, 3));
     cJSON_AddItemToObject(root, "audio_params", audio_params);
     auto json_str = cJSON_PrintUnformatted(root);
     std::string message(json_str);
@@ -315,6 +334,10 @@ void MqttProtocol::ParseServerHello(const cJSON* root) {
         ESP_LOGI(TAG, "Session ID: %s", session_id_.c_str());
     }
 
+    auto features = cJSON_GetObjectItem(root, "features");
+    server_dtx_ = cJSON_IsObject(features) && cJSON_IsTrue(cJSON_GetObjectItem(features, "dtx"));
+    server_uplink_frame_duration_ = 0;
+
     // Get sample rate from hello message
     auto audio_params = cJSON_GetObjectItem(root, "audio_params");
     if (cJSON_IsObject(audio_params)) {
@@ -326,6 +349,10 @@ void MqttProtocol::ParseServerHello(const cJSON* root) {
         if (cJSON_IsNumber(frame_duration)) {
             server_frame_duration_ = frame_duration->valueint;
         }
+        auto uplink_frame_duration = cJSON_GetObjectItem(audio_params, "uplink_frame_duration");
+        if (cJSON_IsNumber(uplink_frame_duration)) {
+            server_uplink_frame_duration_ = uplink_frame_duration->valueint;
+        }
     }
 
     auto udp = cJSON_GetObjectItem(root, "udp");
@@ -341,8 +368,15 @@ void MqttProtocol::ParseServerHello(const cJSON* root) {
     // auto encryption = cJSON_GetObjectItem(udp, "encryption")->valuestring;
     // ESP_LOGI(TAG, "UDP server: %s, port: %d, encryption: %s", udp_server_.c_str(), udp_port_, encryption);
     aes_nonce_ = DecodeHexString(nonce);
-    mbedtls_aes_init(&aes_ctx_);
-    mbedtls_aes_setkey_enc(&aes_ctx_, (const unsigned char*)DecodeHexString(key).c_str(), 128);
+    if (aes_nonce_.size() != AUDIO_CIPHER_HEADER_SIZE) {
+        ESP_LOGE(TAG, "Invalid nonce size: %u", (unsigned)aes_nonce_.size());
+        return;
+    }
+    auto aes_key = DecodeHexString(key);
+    if (!tx_cipher_.SetKey((const uint8_t*)aes_key.data(), aes_key.size()) ||
+        !rx_cipher_.SetKey((const uint8_t*)aes_key.data(), aes_key.size())) {
+        return;
+    }
     local_sequence_ = 0;
     remote_sequence_ = 0;
     xEventGroupSetBits(event_group_handle_, MQTT_PROTOCOL_SERVER_HELLO_EVENT);
@@ -3,10 +3,10 @@
 
 
 #include "protocol.h"
+#include "audio_cipher.h"
 #include <mqtt.h>
 #include <udp.h>
 #include <cJSON.h>
-#include <mbedtls/aes.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/event_groups.h>
 #include <esp_timer.h>
@@ -21,6 +21,9 @@
 
 #define MQTT_PROTOCOL_SERVER_HELLO_EVENT (1 << 0)
 
+// Largest Opus payload the reused datagram buffer is sized for
+#define MQTT_UDP_MAX_AUDIO_PAYLOAD 1500
+
 class MqttProtocol : public Protocol {
 public:
     MqttProtocol();
@@ -28,6 +31,7 @@ public:
 
     bool Start() override;
     bool SendAudio(std::unique_ptr<AudioStreamPacket> packet) override;
+    bool SendAudioBatch(std::vector<std::unique_ptr<AudioStreamPacket>>& packets) override;
     bool OpenAudioChannel() override;
     void CloseAudioChannel() override;
     bool IsAudioChannelOpened() const override;
@@ -40,15 +44,19 @@ private:
     std::mutex channel_mutex_;
     std::unique_ptr<Mqtt> mqtt_;
     std::unique_ptr<Udp> udp_;
-    mbedtls_aes_context aes_ctx_;
+    AudioCipher tx_cipher_;
+    AudioCipher rx_cipher_;
     std::string aes_nonce_;
     std::string udp_server_;
     int udp_port_;
     uint32_t local_sequence_;
     uint32_t remote_sequence_;
+    // Encrypted datagram, reused for every send
+    std::string send_buffer_;
     esp_timer_handle_t reconnect_timer_;
 
     bool StartMqttClient(bool report_error=false);
+    bool SendAudioLocked(const AudioStreamPacket& packet);
     void ParseServerHello(const cJSON* root);
     std::string DecodeHexString(const std::string& hex_string);
 
@@ -8,6 +8,10 @@ void Protocol::OnIncomingJson(std::function<void(const cJSON* root)> callback) {
     on_incoming_json_ = callback;
 }
 
+void Protocol::OnIncomingMessage(std::function<void(const ServerMessage& message)> callback) {
+    on_incoming_message_ = callback;
+}
+
 void Protocol::OnIncomingAudio(std::function<void(std::unique_ptr<AudioStreamPacket> packet)> callback) {
     on_incoming_audio_ = callback;
 }
@@ -32,6 +36,18 @@ void Protocol::OnDisconnected(std::function<void()> callback) {
     on_disconnected_ = callback;
 }
 
+bool Protocol::SendAudioBatch(std::vector<std::unique_ptr<AudioStreamPacket>>& packets) {
+    bool success = true;
+    for (auto& packet : packets) {
+        if (!SendAudio(std::move(packet))) {
+            success = false;
+            break;
+        }
+    }
+    packets.clear();
+    return success;
+}
+
 void Protocol::SetError(const std::string& message) {
     error_occurred_ = true;
     if (on_network_error_ != nullptr) {
@@ -39,6 +55,25 @@ void Protocol::SetError(const std::string& message) {
     }
 }
 
+// Flat messages go through the fast path, the rest are parsed into a cJSON DOM
+void Protocol::DispatchIncomingMessage(const char* data, size_t len, const ServerMessage& message) {
+    if (!message.needs_dom() && on_incoming_message_ != nullptr) {
+        on_incoming_message_(message);
+        return;
+    }
+    if (on_incoming_json_ == nullptr) {
+        return;
+    }
+
+    cJSON* root = cJSON_ParseWithLength(data, len);
+    if (root == nullptr) {
+        ESP_LOGE(TAG, "Failed to parse json message, type: %.*s", (int)message.type_name.size(), message.type_name.data());
+        return;
+    }
+    on_incoming_json_(root);
+    cJSON_Delete(root);
+}
+
 void Protocol::SendAbortSpeaking(AbortReason reason) {
     std::string message = "{\"session_id\":\"" + session_id_ + "\",\"type\":\"abort\"";
     if (reason == kAbortReasonWakeWordDetected) {
@@ -8,6 +8,8 @@
 #include <vector>
 #include <memory>
 
+#include "server_message.h"
+
 // ================== 补充缺失的结构体定义 ==================
 
 struct AudioStreamPacket {
@@ -36,6 +38,9 @@ struct BinaryProtocol3 {
 
 // ========================================================
 
+// Upper bound of packets handed to SendAudioBatch at once
+#define MAX_AUDIO_PACKETS_PER_SEND 8
+
 enum AbortReason {
     kAbortReasonNone,
     kAbortReasonWakeWordDetected,
@@ -54,10 +59,15 @@ public:
 
     inline int server_sample_rate() const { return server_sample_rate_; }
     inline int server_frame_duration() const { return server_frame_duration_; }
+    // Uplink frame duration requested by the server hello, 0 if it did not ask for one
+    inline int server_uplink_frame_duration() const { return server_uplink_frame_duration_; }
     inline const std::string& session_id() const { return session_id_; }
+    // The server accepts an uplink with silent frames left out
+    inline bool server_dtx() const { return server_dtx_; }
 
     void OnIncomingAudio(std::function<void(std::unique_ptr<AudioStreamPacket> packet)> callback);
     void OnIncomingJson(std::function<void(const cJSON* root)> callback);
+    void OnIncomingMessage(std::function<void(const ServerMessage& message)> callback);
     void OnAudioChannelOpened(std::function<void()> callback);
     void OnAudioChannelClosed(std::function<void()> callback);
     void OnNetworkError(std::function<void(const std::string& message)> callback);
@@ -69,6 +79,8 @@ public:
     virtual void CloseAudioChannel() = 0;
     virtual bool IsAudioChannelOpened() const = 0;
     virtual bool SendAudio(std::unique_ptr<AudioStreamPacket> packet) = 0;
+    // Sends the packets in order and clears the vector, transports override it to share the per packet work
+    virtual bool SendAudioBatch(std::vector<std::unique_ptr<AudioStreamPacket>>& packets);
     virtual void SendWakeWordDetected(const std::string& wake_word);
     virtual void SendStartListening(ListeningMode mode);
     virtual void SendStopListening();
@@ -81,6 +93,7 @@ public:
 
 protected:
     std::function<void(const cJSON* root)> on_incoming_json_;
+    std::function<void(const ServerMessage& message)> on_incoming_message_;
     std::function<void(std::unique_ptr<AudioStreamPacket> packet)> on_incoming_audio_;
     std::function<void()> on_audio_channel_opened_;
     std::function<void()> on_audio_channel_closed_;
@@ -90,11 +103,14 @@ protected:
 
     int server_sample_rate_ = 24000;
     int server_frame_duration_ = 60;
+    bool server_dtx_ = false;
+    int server_uplink_frame_duration_ = 0;
     bool error_occurred_ = false;
     std::string session_id_;
     std::chrono::time_point<std::chrono::steady_clock> last_incoming_time_;
 
     virtual void SetError(const std::string& message);
+    void DispatchIncomingMessage(const char* data, size_t len, const ServerMessage& message);
     virtual bool IsTimeout() const;
 };
 
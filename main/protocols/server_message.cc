@@ -0,0 +1,274 @@
+#include "server_message.h"
+
+#include <cstdint>
+
+namespace {
+
+struct FieldEntry {
+    std::string_view key;
+    std::string_view ServerMessage::* field;
+};
+
+// Top level string fields picked up by the tokenizer, everything else is skipped
+constexpr FieldEntry kFields[] = {
+    {"type", &ServerMessage::type_name},
+    {"session_id", &ServerMessage::session_id},
+    {"state", &ServerMessage::state},
+    {"text", &ServerMessage::text},
+    {"emotion", &ServerMessage::emotion},
+    {"command", &ServerMessage::command},
+    {"status", &ServerMessage::status},
+    {"message", &ServerMessage::message},
+};
+constexpr size_t kFieldCount = sizeof(kFields) / sizeof(kFields[0]);
+
+struct TypeEntry {
+    std::string_view name;
+    ServerMessageType type;
+};
+
+constexpr TypeEntry kTypes[] = {
+    {"tts", kServerMessageTts},
+    {"llm", kServerMessageLlm},
+    {"stt", kServerMessageStt},
+    {"mcp", kServerMessageMcp},
+    {"hello", kServerMessageHello},
+    {"goodbye", kServerMessageGoodbye},
+    {"system", kServerMessageSystem},
+    {"alert", kServerMessageAlert},
+    {"custom", kServerMessageCustom},
+};
+
+class Scanner {
+public:
+    Scanner(const char* data, size_t len) : p_(data), end_(data + len) {}
+
+    void SkipSpace() {
+        while (p_ < end_ && (*p_ == ' ' || *p_ == '\t' || *p_ == '\n' || *p_ == '\r')) {
+            p_++;
+        }
+    }
+
+    bool Consume(char c) {
+        SkipSpace();
+        if (p_ < end_ && *p_ == c) {
+            p_++;
+            return true;
+        }
+        return false;
+    }
+
+    bool Peek(char c) {
+        SkipSpace();
+        return p_ < end_ && *p_ == c;
+    }
+
+    // Read a string token, the view excludes the quotes and keeps escapes as is
+    bool ReadString(std::string_view& out) {
+        if (!Consume('"')) {
+            return false;
+        }
+        const char* start = p_;
+        while (p_ < end_) {
+            if (*p_ == '\\') {
+                p_ += 2;
+                continue;
+            }
+            if (*p_ == '"') {
+                out = std::string_view(start, p_ - start);
+                p_++;
+                return true;
+            }
+            p_++;
+        }
+        return false;
+    }
+
+    bool SkipValue() {
+        SkipSpace();
+        if (p_ >= end_) {
+            return false;
+        }
+        if (*p_ == '"') {
+            std::string_view ignored;
+            return ReadString(ignored);
+        }
+        if (*p_ == '{' || *p_ == '[') {
+            int depth = 0;
+            while (p_ < end_) {
+                char c = *p_;
+                if (c == '"') {
+                    std::string_view ignored;
+                    if (!ReadString(ignored)) {
+                        return false;
+                    }
+                    continue;
+                }
+                p_++;
+                if (c == '{' || c == '[') {
+                    depth++;
+                } else if (c == '}' || c == ']') {
+                    if (--depth == 0) {
+                        return true;
+                    }
+                }
+            }
+            return false;
+        }
+        // Number, true, false or null
+        const char* start = p_;
+        while (p_ < end_ && *p_ != ',' && *p_ != '}' && *p_ != ']' &&
+            *p_ != ' ' && *p_ != '\t' && *p_ != '\n' && *p_ != '\r') {
+            p_++;
+        }
+        return p_ > start;
+    }
+
+private:
+    const char* p_;
+    const char* end_;
+};
+
+void AppendUtf8(std::string& out, uint32_t cp) {
+    if (cp < 0x80) {
+        out.push_back(static_cast<char>(cp));
+    } else if (cp < 0x800) {
+        out.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        out.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else {
+        out.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    }
+}
+
+bool ParseHex4(std::string_view raw, size_t pos, uint32_t& value) {
+    if (pos + 4 > raw.size()) {
+        return false;
+    }
+    value = 0;
+    for (size_t i = pos; i < pos + 4; i++) {
+        char c = raw[i];
+        value <<= 4;
+        if (c >= '0' && c <= '9') value |= c - '0';
+        else if (c >= 'a' && c <= 'f') value |= c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') value |= c - 'A' + 10;
+        else return false;
+    }
+    return true;
+}
+
+} // namespace
+
+bool ParseServerMessage(const char* data, size_t len, ServerMessage& message) {
+    message = ServerMessage();
+    if (data == nullptr) {
+        return false;
+    }
+
+    Scanner scanner(data, len);
+    if (!scanner.Consume('{')) {
+        return false;
+    }
+
+    uint32_t seen = 0;
+    if (!scanner.Consume('}')) {
+        do {
+            std::string_view key;
+            if (!scanner.ReadString(key) || !scanner.Consume(':')) {
+                return false;
+            }
+
+            size_t index = kFieldCount;
+            if (scanner.Peek('"')) {
+                for (size_t i = 0; i < kFieldCount; i++) {
+                    if (kFields[i].key == key) {
+                        index = i;
+                        break;
+                    }
+                }
+            }
+
+            if (index < kFieldCount) {
+                std::string_view value;
+                if (!scanner.ReadString(value)) {
+                    return false;
+                }
+                // Keep the first occurrence, the same as cJSON_GetObjectItem
+                if (!(seen & (1u << index))) {
+                    seen |= 1u << index;
+                    message.*(kFields[index].field) = value;
+                }
+            } else if (!scanner.SkipValue()) {
+                return false;
+            }
+        } while (scanner.Consume(','));
+
+        if (!scanner.Consume('}')) {
+            return false;
+        }
+    }
+
+    if (!(seen & 1u)) {
+        return false;
+    }
+    for (const auto& entry : kTypes) {
+        if (entry.name == message.type_name) {
+            message.type = entry.type;
+            break;
+        }
+    }
+    return true;
+}
+
+std::string UnescapeJsonString(std::string_view raw) {
+    std::string out;
+    out.reserve(raw.size());
+    for (size_t i = 0; i < raw.size(); i++) {
+        char c = raw[i];
+        if (c != '\\' || i + 1 >= raw.size()) {
+            out.push_back(c);
+            continue;
+        }
+        char e = raw[++i];
+        switch (e) {
+            case 'b': out.push_back('\b'); break;
+            case 'f': out.push_back('\f'); break;
+            case 'n': out.push_back('\n'); break;
+            case 'r': out.push_back('\r'); break;
+            case 't': out.push_back('\t'); break;
+            case 'u': {
+                uint32_t cp;
+                if (!ParseHex4(raw, i + 1, cp)) {
+                    out.push_back(e);
+                    break;
+                }
+                i += 4;
+                if (cp >= 0xD800 && cp <= 0xDBFF) {
+                    uint32_t low;
+                    if (i + 2 < raw.size() && raw[i + 1] == '\\' && raw[i + 2] == 'u' &&
+                        ParseHex4(raw, i + 3, low) && low >= 0xDC00 && low <= 0xDFFF) {
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                        i += 6;
+                    } else {
+                        cp = 0xFFFD;
+                    }
+                } else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+                    cp = 0xFFFD;
+                }
+                AppendUtf8(out, cp);
+                break;
+            }
+            default:
+                // \" \\ \/ and anything unknown map to the character itself
+                out.push_back(e);
+                break;
+        }
+    }
+    return out;
+}
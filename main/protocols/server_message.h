@@ -0,0 +1,59 @@
+#ifndef SERVER_MESSAGE_H
+#define SERVER_MESSAGE_H
+
+#include <string>
+#include <string_view>
+#include <cstddef>
+
+/*
+ * Lightweight view of a server text frame.
+ *
+ * Most frames received during a conversation (tts / stt / llm) only carry a
+ * handful of flat string fields, so instead of building a cJSON DOM for each of
+ * them we scan the top level object once and keep string_views into the
+ * original buffer. Views hold the raw (still escaped) JSON string contents, use
+ * UnescapeJsonString() when a decoded copy is needed. Fields missing from the
+ * message are left default constructed (data() == nullptr).
+ *
+ * Messages that carry nested payloads (mcp, custom, hello...) report
+ * needs_dom() so the caller can fall back to cJSON for those.
+ */
+
+enum ServerMessageType {
+    kServerMessageUnknown,
+    kServerMessageHello,
+    kServerMessageGoodbye,
+    kServerMessageTts,
+    kServerMessageStt,
+    kServerMessageLlm,
+    kServerMessageMcp,
+    kServerMessageSystem,
+    kServerMessageAlert,
+    kServerMessageCustom,
+};
+
+struct ServerMessage {
+    ServerMessageType type = kServerMessageUnknown;
+    std::string_view type_name;
+    std::string_view session_id;
+    std::string_view state;
+    std::string_view text;
+    std::string_view emotion;
+    std::string_view command;
+    std::string_view status;
+    std::string_view message;
+
+    // Hello, mcp, custom and unknown messages need the full DOM
+    bool needs_dom() const {
+        return type == kServerMessageUnknown || type == kServerMessageHello ||
+            type == kServerMessageMcp || type == kServerMessageCustom;
+    }
+};
+
+// Returns false if the data is not a JSON object or has no string "type" field
+bool ParseServerMessage(const char* data, size_t len, ServerMessage& message);
+
+// Decode JSON escapes (including \uXXXX surrogate pairs) into UTF-8
+std::string UnescapeJsonString(std::string_view raw);
+
+#endif // SERVER_MESSAGE_H
@@ -25,36 +25,64 @@ bool WebsocketProtocol::Start() {
     return true;
 }
 
-bool WebsocketProtocol::SendAudio(std::unique_ptr<AudioStreamPacket> packet) {
-    if (websocket_ == nullptr || !websocket_->IsConnected()) {
-        return false;
-    }
-
+void WebsocketProtocol::AppendAudioRecord(const AudioStreamPacket& packet) {
+    size_t offset = send_buffer_.size();
     if (version_ == 2) {
-        std::string serialized;
-        serialized.resize(sizeof(BinaryProtocol2) + packet->payload.size());
-        auto bp2 = (BinaryProtocol2*)serialized.data();
+        send_buffer_.resize(offset + sizeof(BinaryProtocol2) + packet.payload.size());
+        auto bp2 = (BinaryProtocol2*)&send_buffer_[offset];
         bp2->version = htons(version_);
         bp2->type = 0;
         bp2->reserved = 0;
-        bp2->timestamp = htonl(packet->timestamp);
-        bp2->payload_size = htonl(packet->payload.size());
-        memcpy(bp2->payload, packet->payload.data(), packet->payload.size());
-
-        return websocket_->Send(serialized.data(), serialized.size(), true);
+        bp2->timestamp = htonl(packet.timestamp);
+        bp2->payload_size = htonl(packet.payload.size());
+        memcpy(bp2->payload, packet.payload.data(), packet.payload.size());
     } else if (version_ == 3) {
-        std::string serialized;
-        serialized.resize(sizeof(BinaryProtocol3) + packet->payload.size());
-        auto bp3 = (BinaryProtocol3*)serialized.data();
+        send_buffer_.resize(offset + sizeof(BinaryProtocol3) + packet.payload.size());
+        auto bp3 = (BinaryProtocol3*)&send_buffer_[offset];
         bp3->type = 0;
         bp3->reserved = 0;
-        bp3->payload_size = htons(packet->payload.size());
-        memcpy(bp3->payload, packet->payload.data(), packet->payload.size());
-
-        return websocket_->Send(serialized.data(), serialized.size(), true);
+        bp3->payload_size = htons(packet.payload.size());
+        memcpy(bp3->payload, packet.payload.data(), packet.payload.size());
     } else {
-        return websocket_->Send(packet->payload.data(), packet->payload.size(), true);
+        send_buffer_.append((const char*)packet.payload.data(), packet.payload.size());
+    }
+}
+
+bool WebsocketProtocol::SendAudio(std::unique_ptr<AudioStreamPacket> packet) {
+    if (websocket_ == nullptr || !websocket_->IsConnected()) {
+        return false;
+    }
+
+    send_buffer_.clear();
+    AppendAudioRecord(*packet);
+    return websocket_->Send(send_buffer_.data(), send_buffer_.size(), true);
+}
+
+bool WebsocketProtocol::SendAudioBatch(std::vector<std::unique_ptr<AudioStreamPacket>>& packets) {
+    if (websocket_ == nullptr || !websocket_->IsConnected()) {
+        packets.clear();
+        return false;
+    }
+
+    // Version 1 frames carry no length, so every packet needs a frame of its own
+    bool one_frame = server_audio_batch_ && version_ != 1;
+    bool success = true;
+    send_buffer_.clear();
+    for (auto& packet : packets) {
+        AppendAudioRecord(*packet);
+        if (!one_frame) {
+            success = websocket_->Send(send_buffer_.data(), send_buffer_.size(), true);
+            send_buffer_.clear();
+            if (!success) {
+                break;
+            }
+        }
     }
+    if (one_frame && !send_buffer_.empty()) {
+        success = websocket_->Send(send_buffer_.data(), send_buffer_.size(), true);
+    }
+    packets.clear();
+    return success;
 }
 
 bool WebsocketProtocol::SendText(const std::string& text) {
@@ -145,21 +173,30 @@ bool WebsocketProtocol::OpenAudioChannel() {
                 }
             }
         } else {
-            // Parse JSON data
-            auto root = cJSON_Parse(data);
-            auto type = cJSON_GetObjectItem(root, "type");
-            if (cJSON_IsString(type)) {
-                if (strcmp(type->valuestring, "hello") == 0) {
+            ServerMessage message;
+            if (!ParseServerMessage(data, len, message)) {
+                ESP_LOGE(TAG, "Missing message type, data: %.*s", (int)len, data);
+            } else if (message.type == kServerMessageHello) {
+                auto root = cJSON_ParseWithLength(data, len);
+                if (root != nullptr) {
                     ParseServerHello(root);
-                } else {
-                    if (on_incoming_json_ != nullptr) {
-                        on_incoming_json_(root);
-                    }
+                    cJSON_Delete(root);
+                }
+            } else if (message.type == kServerMessageGoodbye) {
+                ESP_LOGI(TAG, "Received goodbye message, session_id: %.*s",
+                    (int)message.session_id.size(), message.session_id.data());
+                if (message.session_id.empty() || session_id_ == message.session_id) {
+                    // Not from inside the websocket callback, it owns the connection
+                    Application::GetInstance().Schedule([this]() {
+                        CloseAudioChannel();
+                        if (on_audio_channel_closed_ != nullptr) {
+                            on_audio_channel_closed_();
+                        }
+                    });
                 }
             } else {
-                ESP_LOGE(TAG, "Missing message type, data: %s", data);
+                DispatchIncomingMessage(data, len, message);
             }
-            cJSON_Delete(root);
         }
         last_incoming_time_ = std::chrono::steady_clock::now();
     });
@@ -208,6 +245,12 @@ std::string WebsocketProtocol::GetHelloMessage() {
 #if CONFIG_USE_SERVER_AEC
     cJSON_AddBoolToObject(features, "aec", true);
 #endif
+#if CONFIG_USE_UPLINK_SILENCE_SUPPRESSION
+    cJSON_AddBoolToObject(features, "dtx", true);
+#endif
+    if (version_ != 1) {
+        cJSON_AddBoolToObject(features, "audio_batch", true);
+    }
     cJSON_AddBoolToObject(features, "mcp", true);
     cJSON_AddItemToObject(root, "features", features);
     cJSON_AddStringToObject(root, "transport", "websocket");
@@ -216,6 +259,9 @@ std::string WebsocketProtocol::GetHelloMessage() {
     cJSON_AddNumberToObject(audio_params, "sample_rate", 16000);
     cJSON_AddNumberToObject(audio_params, "channels", 1);
     cJSON_AddNumberToObject(audio_params, "frame_duration", OPUS_FRAME_DURATION_MS);
+    // Uplink frame durations the server may pick from with uplink_frame_duration
+    static const int uplink_frame_durations[] = {20, 40, 60};
+    cJSON_AddItemToObject(audio_params, "uplink_frame_durations", cJSON_CreateIntArray(uplink_frame_durations, 3));
     cJSON_AddItemToObject(root, "audio_params", audio_params);
     auto json_str = cJSON_PrintUnformatted(root);
     std::string message(json_str);
@@ -237,6 +283,11 @@ void WebsocketProtocol::ParseServerHello(const cJSON* root) {
         ESP_LOGI(TAG, "Session ID: %s", session_id_.c_str());
     }
 
+    auto features = cJSON_GetObjectItem(root, "features");
+    server_dtx_ = cJSON_IsObject(features) && cJSON_IsTrue(cJSON_GetObjectItem(features, "dtx"));
+    server_audio_batch_ = cJSON_IsObject(features) && cJSON_IsTrue(cJSON_GetObjectItem(features, "audio_batch"));
+    server_uplink_frame_duration_ = 0;
+
     auto audio_params = cJSON_GetObjectItem(root, "audio_params");
     if (cJSON_IsObject(audio_params)) {
         auto sample_rate = cJSON_GetObjectItem(audio_params, "sample_rate");
@@ -247,6 +298,10 @@ void WebsocketProtocol::ParseServerHello(const cJSON* root) {
         if (cJSON_IsNumber(frame_duration)) {
             server_frame_duration_ = frame_duration->valueint;
         }
+        auto uplink_frame_duration = cJSON_GetObjectItem(audio_params, "uplink_frame_duration");
+        if (cJSON_IsNumber(uplink_frame_duration)) {
+            server_uplink_frame_duration_ = uplink_frame_duration->valueint;
+        }
     }
 
     xEventGroupSetBits(event_group_handle_, WEBSOCKET_PROTOCOL_SERVER_HELLO_EVENT);
@@ -17,6 +17,7 @@ public:
 
     bool Start() override;
     bool SendAudio(std::unique_ptr<AudioStreamPacket> packet) override;
+    bool SendAudioBatch(std::vector<std::unique_ptr<AudioStreamPacket>>& packets) override;
     bool OpenAudioChannel() override;
     void CloseAudioChannel() override;
     bool IsAudioChannelOpened() const override;
@@ -25,7 +26,12 @@ private:
     EventGroupHandle_t event_group_handle_;
     std::unique_ptr<WebSocket> websocket_;
     int version_ = 1;
+    // Server accepts several binary protocol records in one websocket frame
+    bool server_audio_batch_ = false;
+    // Serialized audio, reused for every send
+    std::string send_buffer_;
 
+    void AppendAudioRecord(const AudioStreamPacket& packet);
     void ParseServerHello(const cJSON* root);
     bool SendText(const std::string& text) override;
     std::string GetHelloMessage();
@@ -0,0 +1,321 @@
+#include "reminder_scheduler.h"
+#include "settings.h"
+
+#include <esp_log.h>
+#include <cJSON.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
+
+#define TAG "ReminderScheduler"
+
+#define REMINDER_EVENT_DUE (1 << 0)
+#define REMINDER_EVENT_SAVE (1 << 1)
+// A clock change larger than this is taken as the first synchronization
+#define REMINDER_CLOCK_JUMP_SEC 60
+#define SECONDS_PER_DAY (24 * 3600LL)
+
+// std::*_heap build a max-heap, inverting the order puts the earliest trigger in front
+static bool TriggersLater(const Reminder& a, const Reminder& b) {
+    return a.trigger > b.trigger;
+}
+
+static bool IsWeekend(int64_t when) {
+    time_t t = (time_t)when;
+    struct tm tm;
+    localtime_r(&t, &tm);
+    return tm.tm_wday == 0 || tm.tm_wday == 6;
+}
+
+bool ReminderScheduler::IsClockValid() {
+    return Now() >= REMINDER_MIN_VALID_TIME;
+}
+
+int64_t ReminderScheduler::Now() {
+    return (int64_t)time(nullptr);
+}
+
+int64_t ReminderScheduler::NextTrigger(const Reminder& reminder, int64_t after) {
+    int64_t step;
+    switch (reminder.repeat) {
+        case kReminderRepeatDaily:
+        case kReminderRepeatWeekdays:
+            step = SECONDS_PER_DAY;
+            break;
+        case kReminderRepeatWeekly:
+            step = 7 * SECONDS_PER_DAY;
+            break;
+        case kReminderRepeatInterval:
+            step = std::max<int64_t>(reminder.interval_sec, 60);
+            break;
+        default:
+            return 0;
+    }
+
+    int64_t next = reminder.trigger;
+    if (next <= after) {
+        // Occurrences missed while the device was off are skipped, not replayed
+        next += ((after - next) / step + 1) * step;
+    }
+    if (reminder.repeat == kReminderRepeatWeekdays) {
+        while (IsWeekend(next)) {
+            next += SECONDS_PER_DAY;
+        }
+    }
+    return next;
+}
+
+void ReminderScheduler::Start(std::function<void(const Reminder&)> on_fire) {
+    if (event_group_ != nullptr) {
+        return;
+    }
+    on_fire_ = std::move(on_fire);
+    event_group_ = xEventGroupCreate();
+
+    esp_timer_create_args_t due_timer_args = {
+        .callback = [](void* arg) {
+            auto scheduler = (ReminderScheduler*)arg;
+            xEventGroupSetBits(scheduler->event_group_, REMINDER_EVENT_DUE);
+        },
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "reminder_due",
+        .skip_unhandled_events = true
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&due_timer_args, &due_timer_));
+
+    esp_timer_create_args_t save_timer_args = {
+        .callback = [](void* arg) {
+            auto scheduler = (ReminderScheduler*)arg;
+            xEventGroupSetBits(scheduler->event_group_, REMINDER_EVENT_SAVE);
+        },
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "reminder_save",
+        .skip_unhandled_events = true
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&save_timer_args, &save_timer_));
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Load();
+        CheckClock();
+        Arm();
+    }
+
+    xTaskCreate([](void* arg) {
+        ((ReminderScheduler*)arg)->Run();
+        vTaskDelete(nullptr);
+    }, "reminder", REMINDER_TASK_STACK_SIZE, this, 1, nullptr);
+}
+
+void ReminderScheduler::Run() {
+    while (true) {
+        EventBits_t bits = xEventGroupWaitBits(event_group_, REMINDER_EVENT_DUE | REMINDER_EVENT_SAVE,
+            pdTRUE, pdFALSE, portMAX_DELAY);
+
+        std::vector<Reminder> fired;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            CheckClock();
+            int64_t now = Now();
+            while (!heap_.empty() && heap_.front().trigger <= now) {
+                Reminder reminder = Pop();
+                fired.push_back(reminder);
+                int64_t next = NextTrigger(reminder, now);
+                if (next > 0) {
+                    reminder.trigger = next;
+                    Push(std::move(reminder));
+                }
+                dirty_ = true;
+            }
+            Arm();
+
+            // A fired reminder is saved before the callback, it may block for a long time
+            if (dirty_ && (!fired.empty() || (bits & REMINDER_EVENT_SAVE))) {
+                esp_timer_stop(save_timer_);
+                Save();
+            }
+        }
+
+        for (auto& reminder : fired) {
+            ESP_LOGI(TAG, "Reminder %d fired: %s", reminder.id, reminder.message.c_str());
+            on_fire_(reminder);
+        }
+    }
+}
+
+int ReminderScheduler::Add(int64_t trigger, const std::string& message, ReminderRepeat repeat, int32_t interval_sec) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (heap_.size() >= REMINDER_MAX_COUNT) {
+        ESP_LOGW(TAG, "Too many reminders, %u pending", (unsigned)heap_.size());
+        return -1;
+    }
+    CheckClock();
+
+    Reminder reminder = { next_id_++, trigger, message, repeat, interval_sec, !IsClockValid() };
+    if (repeat == kReminderRepeatWeekdays && IsWeekend(reminder.trigger)) {
+        reminder.trigger = NextTrigger(reminder, reminder.trigger);
+    }
+    int id = reminder.id;
+    Push(std::move(reminder));
+    MarkDirty();
+    Arm();
+    return id;
+}
+
+std::vector<Reminder> ReminderScheduler::Cancel(const std::function<bool(const Reminder&)>& match) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<Reminder> cancelled;
+    auto it = std::remove_if(heap_.begin(), heap_.end(), [&](const Reminder& reminder) {
+        if (match(reminder)) {
+            cancelled.push_back(reminder);
+            return true;
+        }
+        return false;
+    });
+    if (cancelled.empty()) {
+        return cancelled;
+    }
+    heap_.erase(it, heap_.end());
+    std::make_heap(heap_.begin(), heap_.end(), TriggersLater);
+    MarkDirty();
+    Arm();
+    return cancelled;
+}
+
+std::vector<Reminder> ReminderScheduler::List() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    CheckClock();
+    std::vector<Reminder> reminders = heap_;
+    std::sort(reminders.begin(), reminders.end(), [](const Reminder& a, const Reminder& b) {
+        return a.trigger < b.trigger;
+    });
+    return reminders;
+}
+
+void ReminderScheduler::Push(Reminder reminder) {
+    heap_.push_back(std::move(reminder));
+    std::push_heap(heap_.begin(), heap_.end(), TriggersLater);
+}
+
+Reminder ReminderScheduler::Pop() {
+    std::pop_heap(heap_.begin(), heap_.end(), TriggersLater);
+    Reminder reminder = std::move(heap_.back());
+    heap_.pop_back();
+    return reminder;
+}
+
+void ReminderScheduler::CheckClock() {
+    int64_t wall = Now();
+    int64_t uptime = esp_timer_get_time() / 1000000;
+    if (last_uptime_ >= 0 && last_wall_ < REMINDER_MIN_VALID_TIME && wall >= REMINDER_MIN_VALID_TIME) {
+        int64_t jump = wall - (last_wall_ + uptime - last_uptime_);
+        if (llabs(jump) > REMINDER_CLOCK_JUMP_SEC) {
+            int moved = 0;
+            for (auto& reminder : heap_) {
+                if (reminder.provisional) {
+                    reminder.trigger += jump;
+                    reminder.provisional = false;
+                    moved++;
+                }
+            }
+            if (moved > 0) {
+                std::make_heap(heap_.begin(), heap_.end(), TriggersLater);
+                MarkDirty();
+                ESP_LOGI(TAG, "Clock synchronized, moved %d reminders by %lld s", moved, (long long)jump);
+            }
+        }
+    }
+    last_wall_ = wall;
+    last_uptime_ = uptime;
+}
+
+void ReminderScheduler::Arm() {
+    if (due_timer_ == nullptr) {
+        return;
+    }
+    esp_timer_stop(due_timer_);
+    if (heap_.empty()) {
+        return;
+    }
+
+    int64_t wait = std::clamp<int64_t>(heap_.front().trigger - Now(), 0, REMINDER_MAX_TIMER_SEC);
+    // Saved reminders cannot be placed until the clock is set, check back soon
+    if (!IsClockValid() && std::any_of(heap_.begin(), heap_.end(), [](const Reminder& r) { return !r.provisional; })) {
+        wait = std::min<int64_t>(wait, REMINDER_UNSYNCED_TIMER_SEC);
+    }
+    esp_timer_start_once(due_timer_, std::max<int64_t>(wait * 1000000, 1000));
+}
+
+void ReminderScheduler::MarkDirty() {
+    dirty_ = true;
+    if (save_timer_ == nullptr) {
+        return;
+    }
+    esp_timer_stop(save_timer_);
+    esp_timer_start_once(save_timer_, REMINDER_SAVE_DELAY_MS * 1000);
+}
+
+void ReminderScheduler::Save() {
+    // [[id, trigger, repeat, interval, message], ...], reminders waiting for the clock are kept in RAM only
+    cJSON* list = cJSON_CreateArray();
+    int count = 0;
+    for (const auto& reminder : heap_) {
+        if (reminder.provisional) {
+            continue;
+        }
+        cJSON* item = cJSON_CreateArray();
+        cJSON_AddItemToArray(item, cJSON_CreateNumber(reminder.id));
+        cJSON_AddItemToArray(item, cJSON_CreateNumber((double)reminder.trigger));
+        cJSON_AddItemToArray(item, cJSON_CreateNumber(reminder.repeat));
+        cJSON_AddItemToArray(item, cJSON_CreateNumber(reminder.interval_sec));
+        cJSON_AddItemToArray(item, cJSON_CreateString(reminder.message.c_str()));
+        cJSON_AddItemToArray(list, item);
+        count++;
+    }
+    char* str = cJSON_PrintUnformatted(list);
+    cJSON_Delete(list);
+    if (str == nullptr) {
+        ESP_LOGE(TAG, "Failed to serialize reminders");
+        return;
+    }
+
+    Settings settings("reminders", true);
+    settings.SetString("list", str);
+    settings.SetInt("next_id", next_id_);
+    cJSON_free(str);
+    dirty_ = false;
+    ESP_LOGI(TAG, "Saved %d reminders", count);
+}
+
+void ReminderScheduler::Load() {
+    Settings settings("reminders");
+    next_id_ = std::max<int32_t>(settings.GetInt("next_id", 1), 1);
+    std::string raw = settings.GetString("list", "[]");
+    cJSON* list = cJSON_Parse(raw.c_str());
+    if (list == nullptr) {
+        ESP_LOGW(TAG, "Invalid saved reminders, ignored");
+        return;
+    }
+
+    cJSON* item = nullptr;
+    cJSON_ArrayForEach(item, list) {
+        cJSON* id = cJSON_GetArrayItem(item, 0);
+        cJSON* trigger = cJSON_GetArrayItem(item, 1);
+        cJSON* repeat = cJSON_GetArrayItem(item, 2);
+        cJSON* interval = cJSON_GetArrayItem(item, 3);
+        cJSON* message = cJSON_GetArrayItem(item, 4);
+        if (!cJSON_IsNumber(id) || !cJSON_IsNumber(trigger) || !cJSON_IsNumber(repeat) ||
+            !cJSON_IsNumber(interval) || !cJSON_IsString(message)) {
+            continue;
+        }
+        heap_.push_back({ id->valueint, (int64_t)trigger->valuedouble, message->valuestring,
+            (ReminderRepeat)repeat->valueint, interval->valueint, false });
+        next_id_ = std::max(next_id_, id->valueint + 1);
+    }
+    cJSON_Delete(list);
+    std::make_heap(heap_.begin(), heap_.end(), TriggersLater);
+    ESP_LOGI(TAG, "Loaded %u reminders", (unsigned)heap_.size());
+}
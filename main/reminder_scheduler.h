@@ -0,0 +1,109 @@
+#ifndef REMINDER_SCHEDULER_H
+#define REMINDER_SCHEDULER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <functional>
+
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/event_groups.h>
+
+// Times before this are an unsynchronized clock (2025-01-01 00:00:00)
+#define REMINDER_MIN_VALID_TIME 1735689600LL
+// Longest single timer, so wall clock corrections are picked up
+#define REMINDER_MAX_TIMER_SEC 3600
+// Timer used while the clock is not synchronized and absolute reminders are waiting
+#define REMINDER_UNSYNCED_TIMER_SEC 10
+// Changes within this window are written to NVS together
+#define REMINDER_SAVE_DELAY_MS 3000
+#define REMINDER_TASK_STACK_SIZE 6144
+// Upper bound on pending reminders, keeps the NVS string well under its size limit
+#define REMINDER_MAX_COUNT 32
+
+enum ReminderRepeat {
+    kReminderRepeatNone = 0,
+    kReminderRepeatDaily = 1,
+    kReminderRepeatWeekdays = 2,
+    kReminderRepeatWeekly = 3,
+    kReminderRepeatInterval = 4,
+};
+
+struct Reminder {
+    int id;
+    int64_t trigger;        // Wall clock, seconds since the epoch in local time
+    std::string message;
+    ReminderRepeat repeat;
+    int32_t interval_sec;   // Only for kReminderRepeatInterval
+    bool provisional;       // Set while the clock is not synchronized, moved when it is
+};
+
+/*
+ * Reminders ordered in a binary min-heap on the trigger time.
+ *
+ * A single one-shot esp_timer is armed for the earliest trigger, nothing wakes
+ * up in between. Triggers are wall clock, a reminder for 08:00 fires at 08:00
+ * whatever the uptime, and survive a reboot: the list is written to NVS
+ * REMINDER_SAVE_DELAY_MS after the last change, so a burst of edits costs one
+ * write.
+ *
+ * A reminder set before the clock is synchronized is relative to the boot, it
+ * is moved by the clock jump once the time arrives.
+ *
+ * Fired reminders are handed to the callback in the scheduler task, which may
+ * block (an alarm ringing until dismissed); later reminders wait for it.
+ */
+class ReminderScheduler {
+public:
+    static ReminderScheduler& GetInstance() {
+        static ReminderScheduler instance;
+        return instance;
+    }
+
+    // Loads the saved reminders and starts the timer and the task
+    void Start(std::function<void(const Reminder&)> on_fire);
+
+    // Returns the id of the new reminder
+    int Add(int64_t trigger, const std::string& message, ReminderRepeat repeat = kReminderRepeatNone,
+        int32_t interval_sec = 0);
+    // Removes every reminder that matches, and returns them
+    std::vector<Reminder> Cancel(const std::function<bool(const Reminder&)>& match);
+    // Pending reminders, earliest first
+    std::vector<Reminder> List();
+
+    static bool IsClockValid();
+    static int64_t Now();
+    // Next trigger after `after` for a recurring reminder, 0 when it does not repeat
+    static int64_t NextTrigger(const Reminder& reminder, int64_t after);
+
+private:
+    ReminderScheduler() = default;
+    ReminderScheduler(const ReminderScheduler&) = delete;
+    ReminderScheduler& operator=(const ReminderScheduler&) = delete;
+
+    std::mutex mutex_;
+    std::vector<Reminder> heap_;
+    int next_id_ = 1;
+    bool dirty_ = false;
+    int64_t last_wall_ = 0;
+    int64_t last_uptime_ = -1;
+
+    esp_timer_handle_t due_timer_ = nullptr;
+    esp_timer_handle_t save_timer_ = nullptr;
+    EventGroupHandle_t event_group_ = nullptr;
+    std::function<void(const Reminder&)> on_fire_;
+
+    void Run();
+    void Push(Reminder reminder);
+    Reminder Pop();
+    void CheckClock();
+    void Arm();
+    void MarkDirty();
+    void Save();
+    void Load();
+};
+
+#endif // REMINDER_SCHEDULER_H
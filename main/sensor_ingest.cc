@@ -0,0 +1,227 @@
+#include "sensor_ingest.h"
+#include "server_message.h"
+
+#include <esp_log.h>
+
+#include <algorithm>
+
+#define TAG "SensorIngest"
+
+// WebSocket opcodes
+#define WS_OPCODE_CONTINUATION 0x0
+#define WS_OPCODE_TEXT 0x1
+#define WS_OPCODE_BINARY 0x2
+#define WS_OPCODE_CONTROL 0x8
+
+// Containers tracked in array_bits_
+#define SENSOR_INGEST_MAX_NESTING 32
+
+static const char* const kArrivedKeywords[] = { "在坐", "在卧" };
+static const char* const kLeftKeywords[] = { "离坐", "离卧" };
+
+static bool ContainsAny(const std::string& text, const char* const* keywords, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (text.find(keywords[i]) != std::string::npos) {
+            return true;
+        }
+    }
+    return false;
+}
+
+SensorIngest::SensorIngest() {
+    value_.reserve(SENSOR_INGEST_MAX_VALUE_SIZE);
+    message_.head.reserve(SENSOR_INGEST_HEAD_SIZE);
+}
+
+void SensorIngest::Feed(int op_code, bool fin, const char* data, size_t len, size_t payload_offset, size_t payload_len) {
+    // Control frames (ping, pong, close) may come between the fragments of a message
+    if (op_code >= WS_OPCODE_CONTROL) {
+        return;
+    }
+
+    if ((op_code == WS_OPCODE_TEXT || op_code == WS_OPCODE_BINARY) && payload_offset == 0) {
+        if (in_message_) {
+            ESP_LOGW(TAG, "Message of %u bytes not finished, dropped", (unsigned)message_.size);
+            dropped_++;
+        }
+        BeginMessage();
+        ignore_message_ = op_code == WS_OPCODE_BINARY;
+    } else if (!in_message_) {
+        // The start of this message was missed
+        return;
+    } else if (op_code != WS_OPCODE_CONTINUATION && op_code != WS_OPCODE_TEXT && op_code != WS_OPCODE_BINARY) {
+        return;
+    }
+
+    if (!ignore_message_ && !error_) {
+        message_.size += len;
+        if (message_.head.size() < SENSOR_INGEST_HEAD_SIZE) {
+            message_.head.append(data, std::min(len, SENSOR_INGEST_HEAD_SIZE - message_.head.size()));
+        }
+        Parse(data, len);
+    }
+
+    // Last piece of the last frame
+    if (fin && payload_offset + len >= payload_len) {
+        EndMessage();
+    }
+}
+
+void SensorIngest::Reset() {
+    in_message_ = false;
+}
+
+void SensorIngest::BeginMessage() {
+    in_message_ = true;
+    ignore_message_ = false;
+    error_ = false;
+    depth_ = 0;
+    array_bits_ = 0;
+    expect_key_ = false;
+    in_string_ = false;
+    escape_ = false;
+    value_overflow_ = false;
+    value_.clear();
+    for (auto& key : keys_) {
+        key.clear();
+    }
+    message_.info.clear();
+    message_.presence = kSensorPresenceUnknown;
+    message_.size = 0;
+    message_.skipped_values = 0;
+    message_.head.clear();
+}
+
+void SensorIngest::EndMessage() {
+    in_message_ = false;
+    if (ignore_message_) {
+        return;
+    }
+    if (error_ || depth_ != 0 || in_string_) {
+        ESP_LOGW(TAG, "Malformed message of %u bytes: %s", (unsigned)message_.size, message_.head.c_str());
+        dropped_++;
+        return;
+    }
+    messages_++;
+    if (on_message_) {
+        on_message_(message_);
+    }
+}
+
+void SensorIngest::Parse(const char* data, size_t len) {
+    const char* p = data;
+    const char* end = data + len;
+    while (p < end) {
+        if (in_string_) {
+            // Copy the run up to the closing quote or the next escape at once
+            const char* run = p;
+            while (p < end && *p != '"' && *p != '\\' && !escape_) {
+                p++;
+            }
+            if (!value_overflow_ && p > run) {
+                if (value_.size() + (p - run) > SENSOR_INGEST_MAX_VALUE_SIZE) {
+                    value_overflow_ = true;
+                } else {
+                    value_.append(run, p - run);
+                }
+            }
+            if (p >= end) {
+                break;
+            }
+            char c = *p++;
+            if (escape_) {
+                escape_ = false;
+            } else if (c == '\\') {
+                escape_ = true;
+            } else if (c == '"') {
+                in_string_ = false;
+                OnString();
+                continue;
+            }
+            // Escapes are kept raw, OnString() decodes the few values it needs
+            if (!value_overflow_) {
+                if (value_.size() + 1 > SENSOR_INGEST_MAX_VALUE_SIZE) {
+                    value_overflow_ = true;
+                } else {
+                    value_.push_back(c);
+                }
+            }
+            continue;
+        }
+
+        char c = *p++;
+        switch (c) {
+        case '"':
+            in_string_ = true;
+            string_is_key_ = depth_ > 0 && IsObject(depth_ - 1) && expect_key_;
+            value_overflow_ = false;
+            value_.clear();
+            break;
+        case '{':
+        case '[':
+            if (depth_ >= SENSOR_INGEST_MAX_NESTING) {
+                error_ = true;
+                return;
+            }
+            if (c == '[') {
+                array_bits_ |= 1u << depth_;
+            } else {
+                array_bits_ &= ~(1u << depth_);
+            }
+            if (depth_ < SENSOR_INGEST_MAX_DEPTH) {
+                keys_[depth_].clear();
+            }
+            depth_++;
+            expect_key_ = c == '{';
+            break;
+        case '}':
+        case ']':
+            if (depth_ == 0 || IsObject(depth_ - 1) != (c == '}')) {
+                error_ = true;
+                return;
+            }
+            depth_--;
+            expect_key_ = false;
+            break;
+        case ':':
+            expect_key_ = false;
+            break;
+        case ',':
+            expect_key_ = depth_ > 0 && IsObject(depth_ - 1);
+            break;
+        default:
+            // Whitespace, numbers and literals
+            break;
+        }
+    }
+}
+
+void SensorIngest::OnString() {
+    if (string_is_key_) {
+        if (depth_ <= SENSOR_INGEST_MAX_DEPTH) {
+            // A key too long to keep never matches
+            keys_[depth_ - 1] = value_overflow_ ? "" : value_;
+        }
+        return;
+    }
+
+    if (value_overflow_) {
+        message_.skipped_values++;
+        return;
+    }
+
+    // Only strings inside objects have a key
+    bool keyed = depth_ > 0 && IsObject(depth_ - 1);
+    std::string text = value_.find('\\') == std::string::npos ? value_ : UnescapeJsonString(value_);
+    if (keyed && depth_ == 2 && IsObject(0) && keys_[0] == "parameters" && keys_[1] == "info") {
+        message_.info = text;
+    }
+    // The presence is reported in a text field, wherever the server puts it
+    if (message_.presence != kSensorPresenceArrived) {
+        if (ContainsAny(text, kArrivedKeywords, sizeof(kArrivedKeywords) / sizeof(kArrivedKeywords[0]))) {
+            message_.presence = kSensorPresenceArrived;
+        } else if (ContainsAny(text, kLeftKeywords, sizeof(kLeftKeywords) / sizeof(kLeftKeywords[0]))) {
+            message_.presence = kSensorPresenceLeft;
+        }
+    }
+}
@@ -0,0 +1,85 @@
+#ifndef SENSOR_INGEST_H
+#define SENSOR_INGEST_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+// String values longer than this (base64 images) are skipped, never buffered
+#define SENSOR_INGEST_MAX_VALUE_SIZE 256
+// Objects nested deeper than this are still tokenized, their keys are not kept
+#define SENSOR_INGEST_MAX_DEPTH 4
+// Bytes of each message kept for the log
+#define SENSOR_INGEST_HEAD_SIZE 80
+
+enum SensorPresence {
+    kSensorPresenceUnknown,
+    kSensorPresenceArrived,     // 在坐 / 在卧
+    kSensorPresenceLeft,        // 离坐 / 离卧
+};
+
+struct SensorMessage {
+    std::string info;           // parameters.info, "alive" for the heartbeat
+    SensorPresence presence = kSensorPresenceUnknown;
+    size_t size = 0;
+    int skipped_values = 0;     // String values over SENSOR_INGEST_MAX_VALUE_SIZE
+    std::string head;           // First SENSOR_INGEST_HEAD_SIZE bytes, for the log
+};
+
+/*
+ * Incremental reader for the elderly monitor WebSocket.
+ *
+ * The client delivers a large frame in several WEBSOCKET_EVENT_DATA events,
+ * and a message may also be split into continuation frames. Every piece is
+ * fed to Feed() as it arrives: a single tokenizer runs across the pieces, so
+ * nothing is copied or parsed twice and a piece is never mistaken for a whole
+ * message. Only parameters.info and the presence keywords found in string
+ * values are kept; long string values such as images are skipped while they
+ * stream through. The callback runs once per complete text message.
+ */
+class SensorIngest {
+public:
+    SensorIngest();
+
+    void OnMessage(std::function<void(const SensorMessage&)> callback) { on_message_ = callback; }
+
+    // Arguments as in esp_websocket_event_data_t: op_code, fin, data_ptr,
+    // data_len, payload_offset and payload_len
+    void Feed(int op_code, bool fin, const char* data, size_t len, size_t payload_offset, size_t payload_len);
+    // Drops a partial message, call on disconnect
+    void Reset();
+
+    uint32_t messages() const { return messages_; }
+    uint32_t dropped() const { return dropped_; }
+
+private:
+    std::function<void(const SensorMessage&)> on_message_;
+
+    bool in_message_ = false;
+    bool ignore_message_ = false;   // Binary message
+    bool error_ = false;
+
+    // Tokenizer state, kept between pieces
+    int depth_ = 0;
+    uint32_t array_bits_ = 0;       // Bit n set when container n is an array
+    bool expect_key_ = false;
+    bool in_string_ = false;
+    bool escape_ = false;
+    bool string_is_key_ = false;
+    bool value_overflow_ = false;
+    std::string value_;             // Reused for every key and value
+    std::string keys_[SENSOR_INGEST_MAX_DEPTH];
+
+    SensorMessage message_;
+    uint32_t messages_ = 0;
+    uint32_t dropped_ = 0;
+
+    void BeginMessage();
+    void EndMessage();
+    void Parse(const char* data, size_t len);
+    void OnString();
+    bool IsObject(int level) const { return (array_bits_ & (1u << level)) == 0; }
+};
+
+#endif // SENSOR_INGEST_H
@@ -1,58 +1,289 @@
 #include "settings.h"
 
 #include <esp_log.h>
+#include <esp_system.h>
+#include <esp_timer.h>
 #include <nvs_flash.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <map>
+#include <mutex>
 
 #define TAG "Settings"
 
+enum PendingType {
+    kPendingString,
+    kPendingInt,
+    kPendingBool,
+};
+
+struct PendingValue {
+    PendingType type;
+    std::string text;
+    int32_t number;
+    // Tells whether the value changed while it was being committed
+    uint32_t generation;
+};
+
+// Write-back cache shared by all Settings instances
+struct SettingsCache {
+    std::mutex mutex;
+    // Held while writing the flash, Set*() never wait for it
+    std::mutex flush_mutex;
+    // Namespace, then key
+    std::map<std::string, std::map<std::string, PendingValue>> pending;
+    uint32_t generation = 0;
+    std::once_flag task_once;
+    TaskHandle_t task = nullptr;
+    // Statistics
+    uint32_t commits = 0;
+    uint32_t keys_written = 0;
+    uint32_t coalesced = 0;
+    uint32_t unchanged = 0;
+};
+
+static SettingsCache& Cache() {
+    static SettingsCache cache;
+    return cache;
+}
+
+static bool NvsGetString(nvs_handle_t handle, const char* key, std::string& value) {
+    size_t length = 0;
+    if (nvs_get_str(handle, key, nullptr, &length) != ESP_OK) {
+        return false;
+    }
+    value.resize(length);
+    ESP_ERROR_CHECK(nvs_get_str(handle, key, value.data(), &length));
+    while (!value.empty() && value.back() == '\0') {
+        value.pop_back();
+    }
+    return true;
+}
+
+static bool NvsGetInt(nvs_handle_t handle, const char* key, int32_t& value) {
+    return nvs_get_i32(handle, key, &value) == ESP_OK;
+}
+
+static bool NvsGetBool(nvs_handle_t handle, const char* key, bool& value) {
+    uint8_t stored;
+    if (nvs_get_u8(handle, key, &stored) != ESP_OK) {
+        return false;
+    }
+    value = stored != 0;
+    return true;
+}
+
+static bool SameValue(const PendingValue& a, const PendingValue& b) {
+    if (a.type != b.type) {
+        return false;
+    }
+    return a.type == kPendingString ? a.text == b.text : a.number == b.number;
+}
+
+static bool FindPending(const std::string& ns, const std::string& key, PendingType type, PendingValue& value) {
+    auto& cache = Cache();
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    auto keys = cache.pending.find(ns);
+    if (keys == cache.pending.end()) {
+        return false;
+    }
+    auto it = keys->second.find(key);
+    if (it == keys->second.end() || it->second.type != type) {
+        return false;
+    }
+    value = it->second;
+    return true;
+}
+
+static void CommitLoop() {
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        // Wait for the writes to settle, but not forever
+        int64_t start_time = esp_timer_get_time();
+        while (esp_timer_get_time() - start_time < SETTINGS_COMMIT_MAX_DELAY_MS * 1000LL &&
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(SETTINGS_COMMIT_DELAY_MS)) > 0) {
+        }
+        Settings::Flush();
+    }
+}
+
+// stored_equal: the flash already holds this value
+static void Queue(const std::string& ns, const std::string& key, PendingValue value, bool stored_equal) {
+    auto& cache = Cache();
+    {
+        std::lock_guard<std::mutex> lock(cache.mutex);
+        auto& keys = cache.pending[ns];
+        auto it = keys.find(key);
+        if (it != keys.end()) {
+            if (SameValue(it->second, value)) {
+                cache.unchanged++;
+                return;
+            }
+            cache.coalesced++;
+        } else if (stored_equal) {
+            cache.unchanged++;
+            if (keys.empty()) {
+                cache.pending.erase(ns);
+            }
+            return;
+        }
+        value.generation = ++cache.generation;
+        keys[key] = std::move(value);
+    }
+
+    std::call_once(cache.task_once, [&cache]() {
+        xTaskCreate([](void*) {
+            CommitLoop();
+            vTaskDelete(nullptr);
+        }, "settings", SETTINGS_TASK_STACK_SIZE, nullptr, 2, &cache.task);
+        esp_register_shutdown_handler(Settings::Flush);
+    });
+    if (cache.task != nullptr) {
+        xTaskNotifyGive(cache.task);
+    }
+}
+
+void Settings::Flush() {
+    auto& cache = Cache();
+    std::lock_guard<std::mutex> flush_lock(cache.flush_mutex);
+    decltype(cache.pending) batch;
+    {
+        std::lock_guard<std::mutex> lock(cache.mutex);
+        batch = cache.pending;
+    }
+    if (batch.empty()) {
+        return;
+    }
+
+    uint32_t commits = 0;
+    uint32_t keys_written = 0;
+    uint32_t unchanged = 0;
+    for (auto& [ns, keys] : batch) {
+        nvs_handle_t handle;
+        esp_err_t err = nvs_open(ns.c_str(), NVS_READWRITE, &handle);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to open namespace %s: %s", ns.c_str(), esp_err_to_name(err));
+            keys.clear();
+            continue;
+        }
+        int written = 0;
+        for (auto it = keys.begin(); it != keys.end();) {
+            const char* key = it->first.c_str();
+            const auto& value = it->second;
+            bool same = false;
+            if (value.type == kPendingString) {
+                std::string stored;
+                same = NvsGetString(handle, key, stored) && stored == value.text;
+                err = same ? ESP_OK : nvs_set_str(handle, key, value.text.c_str());
+            } else if (value.type == kPendingInt) {
+                int32_t stored;
+                same = NvsGetInt(handle, key, stored) && stored == value.number;
+                err = same ? ESP_OK : nvs_set_i32(handle, key, value.number);
+            } else {
+                bool stored;
+                same = NvsGetBool(handle, key, stored) && stored == (value.number != 0);
+                err = same ? ESP_OK : nvs_set_u8(handle, key, value.number != 0 ? 1 : 0);
+            }
+            if (err != ESP_OK) {
+                // Stays pending, retried with the next write
+                ESP_LOGE(TAG, "Failed to write %s.%s: %s", ns.c_str(), key, esp_err_to_name(err));
+                it = keys.erase(it);
+                continue;
+            }
+            if (same) {
+                unchanged++;
+            } else {
+                written++;
+            }
+            ++it;
+        }
+        if (written > 0) {
+            err = nvs_commit(handle);
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to commit %s: %s", ns.c_str(), esp_err_to_name(err));
+                keys.clear();
+            } else {
+                commits++;
+                keys_written += written;
+            }
+        }
+        nvs_close(handle);
+    }
+
+    // Drop what was committed, unless it was set again meanwhile
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    for (const auto& [ns, keys] : batch) {
+        auto pending_keys = cache.pending.find(ns);
+        if (pending_keys == cache.pending.end()) {
+            continue;
+        }
+        for (const auto& [key, value] : keys) {
+            auto it = pending_keys->second.find(key);
+            if (it != pending_keys->second.end() && it->second.generation == value.generation) {
+                pending_keys->second.erase(it);
+            }
+        }
+        if (pending_keys->second.empty()) {
+            cache.pending.erase(pending_keys);
+        }
+    }
+    cache.commits += commits;
+    cache.keys_written += keys_written;
+    cache.unchanged += unchanged;
+}
+
+void Settings::LogStats() {
+    auto& cache = Cache();
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    size_t pending = 0;
+    for (const auto& [ns, keys] : cache.pending) {
+        pending += keys.size();
+    }
+    ESP_LOGI(TAG, "%lu commits, %lu keys written, %lu writes coalesced, %lu unchanged, %u pending",
+        (unsigned long)cache.commits, (unsigned long)cache.keys_written, (unsigned long)cache.coalesced,
+        (unsigned long)cache.unchanged, (unsigned)pending);
+}
+
 Settings::Settings(const std::string& ns, bool read_write) : ns_(ns), read_write_(read_write) {
     nvs_open(ns.c_str(), read_write_ ? NVS_READWRITE : NVS_READONLY, &nvs_handle_);
 }
 
 Settings::~Settings() {
     if (nvs_handle_ != 0) {
-        if (read_write_ && dirty_) {
-            ESP_ERROR_CHECK(nvs_commit(nvs_handle_));
-        }
         nvs_close(nvs_handle_);
     }
 }
 
 std::string Settings::GetString(const std::string& key, const std::string& default_value) {
-    if (nvs_handle_ == 0) {
-        return default_value;
-    }
-
-    size_t length = 0;
-    if (nvs_get_str(nvs_handle_, key.c_str(), nullptr, &length) != ESP_OK) {
-        return default_value;
+    PendingValue pending;
+    if (FindPending(ns_, key, kPendingString, pending)) {
+        return pending.text;
     }
-
     std::string value;
-    value.resize(length);
-    ESP_ERROR_CHECK(nvs_get_str(nvs_handle_, key.c_str(), value.data(), &length));
-    while (!value.empty() && value.back() == '\0') {
-        value.pop_back();
+    if (nvs_handle_ == 0 || !NvsGetString(nvs_handle_, key.c_str(), value)) {
+        return default_value;
     }
     return value;
 }
 
 void Settings::SetString(const std::string& key, const std::string& value) {
     if (read_write_) {
-        ESP_ERROR_CHECK(nvs_set_str(nvs_handle_, key.c_str(), value.c_str()));
-        dirty_ = true;
+        std::string stored;
+        bool stored_equal = NvsGetString(nvs_handle_, key.c_str(), stored) && stored == value;
+        Queue(ns_, key, PendingValue{kPendingString, value, 0, 0}, stored_equal);
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
 }
 
 int32_t Settings::GetInt(const std::string& key, int32_t default_value) {
-    if (nvs_handle_ == 0) {
-        return default_value;
+    PendingValue pending;
+    if (FindPending(ns_, key, kPendingInt, pending)) {
+        return pending.number;
     }
-
     int32_t value;
-    if (nvs_get_i32(nvs_handle_, key.c_str(), &value) != ESP_OK) {
+    if (nvs_handle_ == 0 || !NvsGetInt(nvs_handle_, key.c_str(), value)) {
         return default_value;
     }
     return value;
@@ -60,29 +291,31 @@ int32_t Settings::GetInt(const std::string& key, int32_t default_value) {
 
 void Settings::SetInt(const std::string& key, int32_t value) {
     if (read_write_) {
-        ESP_ERROR_CHECK(nvs_set_i32(nvs_handle_, key.c_str(), value));
-        dirty_ = true;
+        int32_t stored;
+        bool stored_equal = NvsGetInt(nvs_handle_, key.c_str(), stored) && stored == value;
+        Queue(ns_, key, PendingValue{kPendingInt, "", value, 0}, stored_equal);
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
 }
 
 bool Settings::GetBool(const std::string& key, bool default_value) {
-    if (nvs_handle_ == 0) {
-        return default_value;
+    PendingValue pending;
+    if (FindPending(ns_, key, kPendingBool, pending)) {
+        return pending.number != 0;
     }
-
-    uint8_t value;
-    if (nvs_get_u8(nvs_handle_, key.c_str(), &value) != ESP_OK) {
+    bool value;
+    if (nvs_handle_ == 0 || !NvsGetBool(nvs_handle_, key.c_str(), value)) {
         return default_value;
     }
-    return value != 0;
+    return value;
 }
 
 void Settings::SetBool(const std::string& key, bool value) {
     if (read_write_) {
-        ESP_ERROR_CHECK(nvs_set_u8(nvs_handle_, key.c_str(), value ? 1 : 0));
-        dirty_ = true;
+        bool stored;
+        bool stored_equal = NvsGetBool(nvs_handle_, key.c_str(), stored) && stored == value;
+        Queue(ns_, key, PendingValue{kPendingBool, "", value ? 1 : 0, 0}, stored_equal);
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
@@ -90,9 +323,20 @@ void Settings::SetBool(const std::string& key, bool value) {
 
 void Settings::EraseKey(const std::string& key) {
     if (read_write_) {
+        // A commit in progress must not write the key back
+        auto& cache = Cache();
+        std::lock_guard<std::mutex> flush_lock(cache.flush_mutex);
+        {
+            std::lock_guard<std::mutex> lock(cache.mutex);
+            auto keys = cache.pending.find(ns_);
+            if (keys != cache.pending.end()) {
+                keys->second.erase(key);
+            }
+        }
         auto ret = nvs_erase_key(nvs_handle_, key.c_str());
         if (ret != ESP_ERR_NVS_NOT_FOUND) {
             ESP_ERROR_CHECK(ret);
+            ESP_ERROR_CHECK(nvs_commit(nvs_handle_));
         }
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
@@ -101,7 +345,14 @@ void Settings::EraseKey(const std::string& key) {
 
 void Settings::EraseAll() {
     if (read_write_) {
+        auto& cache = Cache();
+        std::lock_guard<std::mutex> flush_lock(cache.flush_mutex);
+        {
+            std::lock_guard<std::mutex> lock(cache.mutex);
+            cache.pending.erase(ns_);
+        }
         ESP_ERROR_CHECK(nvs_erase_all(nvs_handle_));
+        ESP_ERROR_CHECK(nvs_commit(nvs_handle_));
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
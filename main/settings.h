@@ -4,6 +4,22 @@
 #include <string>
 #include <nvs_flash.h>
 
+// Quiet time after the last write before the pending values are committed
+#define SETTINGS_COMMIT_DELAY_MS 1000
+// Longest a write waits while writes keep coming
+#define SETTINGS_COMMIT_MAX_DELAY_MS 5000
+#define SETTINGS_TASK_STACK_SIZE 4096
+
+/*
+ * Set*() do not touch the flash: the value goes to a write-back cache shared
+ * by all instances, and Get*() see it at once. A background task commits the
+ * cache once no write came for SETTINGS_COMMIT_DELAY_MS, all keys of a
+ * namespace in one nvs_commit, so a knob turned through twenty volume steps
+ * costs one flash write. Values equal to the stored ones are not written.
+ *
+ * The cache is flushed by esp_restart(). Call Flush() before powering off by
+ * other means (deep sleep) right after a write.
+ */
 class Settings {
 public:
     Settings(const std::string& ns, bool read_write = false);
@@ -15,14 +31,18 @@ public:
     void SetInt(const std::string& key, int32_t value);
     bool GetBool(const std::string& key, bool default_value = false);
     void SetBool(const std::string& key, bool value);
+    // Erasing is not deferred
     void EraseKey(const std::string& key);
     void EraseAll();
 
+    // Commits the pending values now
+    static void Flush();
+    static void LogStats();
+
 private:
     std::string ns_;
     nvs_handle_t nvs_handle_ = 0;
     bool read_write_ = false;
-    bool dirty_ = false;
 };
 
 #endif
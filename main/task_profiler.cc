@@ -0,0 +1,234 @@
+#include "task_profiler.h"
+
+#include <esp_log.h>
+#include <cJSON.h>
+
+#include <algorithm>
+#include <cstring>
+
+#define TAG "TaskProfiler"
+
+// Room for tasks created between uxTaskGetNumberOfTasks() and the snapshot
+#define TASK_PROFILER_SPARE_SLOTS 4
+
+static void PushSample(uint8_t* ring, uint8_t& head, uint8_t& count, uint8_t value) {
+    if (count < TASK_PROFILER_HISTORY) {
+        ring[(head + count) % TASK_PROFILER_HISTORY] = value;
+        count++;
+    } else {
+        ring[head] = value;
+        head = (head + 1) % TASK_PROFILER_HISTORY;
+    }
+}
+
+static cJSON* RingToJson(const uint8_t* ring, uint8_t head, uint8_t count) {
+    auto array = cJSON_CreateArray();
+    for (int i = 0; i < count; i++) {
+        cJSON_AddItemToArray(array, cJSON_CreateNumber(ring[(head + i) % TASK_PROFILER_HISTORY]));
+    }
+    return array;
+}
+
+static int RingAverage(const uint8_t* ring, uint8_t count) {
+    if (count == 0) {
+        return 0;
+    }
+    int sum = 0;
+    for (int i = 0; i < count; i++) {
+        sum += ring[i];
+    }
+    return (sum + count / 2) / count;
+}
+
+static int RingMax(const uint8_t* ring, uint8_t count) {
+    int max = 0;
+    for (int i = 0; i < count; i++) {
+        max = std::max<int>(max, ring[i]);
+    }
+    return max;
+}
+
+static int RingLast(const uint8_t* ring, uint8_t head, uint8_t count) {
+    return count > 0 ? ring[(head + count - 1) % TASK_PROFILER_HISTORY] : 0;
+}
+
+void TaskProfiler::Start() {
+    if (started_) {
+        return;
+    }
+    started_ = true;
+    xTaskCreate([](void* arg) {
+        ((TaskProfiler*)arg)->Run();
+        vTaskDelete(nullptr);
+    }, "task_profiler", TASK_PROFILER_TASK_STACK_SIZE, this, 1, nullptr);
+}
+
+void TaskProfiler::Run() {
+    while (true) {
+        Sample();
+        vTaskDelay(pdMS_TO_TICKS(TASK_PROFILER_INTERVAL_MS));
+    }
+}
+
+TaskProfiler::TaskRecord* TaskProfiler::FindRecord(TaskHandle_t handle) {
+    for (auto& record : records_) {
+        if (record.handle == handle) {
+            return &record;
+        }
+    }
+    return nullptr;
+}
+
+void TaskProfiler::Sample() {
+    // Only this task touches snapshot_, the lock is for records_
+    size_t needed = uxTaskGetNumberOfTasks() + TASK_PROFILER_SPARE_SLOTS;
+    if (snapshot_.size() < needed) {
+        snapshot_.resize(needed);
+    }
+    configRUN_TIME_COUNTER_TYPE total = 0;
+    UBaseType_t count = uxTaskGetSystemState(snapshot_.data(), snapshot_.size(), &total);
+    if (count == 0) {
+        ESP_LOGW(TAG, "Snapshot of %u tasks failed", (unsigned)snapshot_.size());
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Run time of all cores over the interval, 0 on the first sample
+    uint64_t elapsed = samples_ > 0 ? (uint64_t)(configRUN_TIME_COUNTER_TYPE)(total - last_total_) * CONFIG_FREERTOS_NUMBER_OF_CORES : 0;
+    last_total_ = total;
+    samples_++;
+
+    for (auto& record : records_) {
+        record.seen = false;
+    }
+    uint64_t idle = 0;
+    for (UBaseType_t i = 0; i < count; i++) {
+        const auto& status = snapshot_[i];
+        auto record = FindRecord(status.xHandle);
+        if (record == nullptr) {
+            records_.emplace_back();
+            record = &records_.back();
+            memset(record, 0, sizeof(TaskRecord));
+            record->handle = status.xHandle;
+            strncpy(record->name, status.pcTaskName, sizeof(record->name) - 1);
+            record->last_counter = status.ulRunTimeCounter;
+        } else if (elapsed > 0) {
+            configRUN_TIME_COUNTER_TYPE delta = status.ulRunTimeCounter - record->last_counter;
+            int percent = std::min<uint64_t>((uint64_t)delta * 100 / elapsed, 100);
+            PushSample(record->cpu, record->cpu_head, record->cpu_count, percent);
+            record->last_counter = status.ulRunTimeCounter;
+            if (strncmp(record->name, "IDLE", 4) == 0) {
+                idle += delta;
+            }
+        }
+        record->priority = status.uxCurrentPriority;
+#if CONFIG_FREERTOS_VTASKLIST_INCLUDE_COREID
+        record->core = status.xCoreID == tskNO_AFFINITY ? -1 : (int)status.xCoreID;
+#else
+        record->core = -1;
+#endif
+        // In bytes on ESP-IDF, the lowest value since the task started
+        record->stack_free_min = status.usStackHighWaterMark;
+        record->seen = true;
+    }
+
+    // Deleted tasks
+    records_.erase(std::remove_if(records_.begin(), records_.end(), [](const TaskRecord& record) {
+        return !record.seen;
+    }), records_.end());
+
+    if (elapsed > 0) {
+        int load = 100 - (int)std::min<uint64_t>(idle * 100 / elapsed, 100);
+        PushSample(load_, load_head_, load_count_, load);
+    }
+}
+
+std::string TaskProfiler::GetJson() {
+    /*
+     * {
+     *     "interval_ms": 2000, "samples": 120, "cores": 2,
+     *     "load": [12, 15, ...],
+     *     "tasks": [{ "name": "audio_input", "priority": 8, "core": 0, "cpu": 6, "cpu_avg": 5, "cpu_max": 9,
+     *                 "stack_free_min": 1200, "stack_low": false, "history": [5, 6, ...] }]
+     * }
+     * CPU values are percent of the whole chip, history and load are oldest first.
+     */
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<const TaskRecord*> sorted;
+    sorted.reserve(records_.size());
+    for (const auto& record : records_) {
+        sorted.push_back(&record);
+    }
+    std::stable_sort(sorted.begin(), sorted.end(), [](const TaskRecord* a, const TaskRecord* b) {
+        return RingAverage(a->cpu, a->cpu_count) > RingAverage(b->cpu, b->cpu_count);
+    });
+
+    auto root = cJSON_CreateObject();
+    cJSON_AddNumberToObject(root, "interval_ms", TASK_PROFILER_INTERVAL_MS);
+    cJSON_AddNumberToObject(root, "samples", samples_);
+    cJSON_AddNumberToObject(root, "cores", CONFIG_FREERTOS_NUMBER_OF_CORES);
+    cJSON_AddItemToObject(root, "load", RingToJson(load_, load_head_, load_count_));
+
+    auto tasks = cJSON_CreateArray();
+    for (auto record : sorted) {
+        auto task = cJSON_CreateObject();
+        cJSON_AddStringToObject(task, "name", record->name);
+        cJSON_AddNumberToObject(task, "priority", record->priority);
+        cJSON_AddNumberToObject(task, "core", record->core);
+        cJSON_AddNumberToObject(task, "cpu", RingLast(record->cpu, record->cpu_head, record->cpu_count));
+        cJSON_AddNumberToObject(task, "cpu_avg", RingAverage(record->cpu, record->cpu_count));
+        cJSON_AddNumberToObject(task, "cpu_max", RingMax(record->cpu, record->cpu_count));
+        cJSON_AddNumberToObject(task, "stack_free_min", record->stack_free_min);
+        cJSON_AddBoolToObject(task, "stack_low", record->stack_free_min < TASK_PROFILER_LOW_STACK_BYTES);
+        cJSON_AddItemToObject(task, "history", RingToJson(record->cpu, record->cpu_head, record->cpu_count));
+        cJSON_AddItemToArray(tasks, task);
+    }
+    cJSON_AddItemToObject(root, "tasks", tasks);
+
+    auto json_str = cJSON_PrintUnformatted(root);
+    std::string json(json_str);
+    cJSON_free(json_str);
+    cJSON_Delete(root);
+    return json;
+}
+
+void TaskProfiler::LogStats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (load_count_ == 0) {
+        return;
+    }
+    ESP_LOGI(TAG, "CPU load avg %d%% max %d%% over %u samples", RingAverage(load_, load_count_),
+        RingMax(load_, load_count_), (unsigned)load_count_);
+
+    // The three busiest tasks, idle excluded
+    const TaskRecord* top[3] = {};
+    for (const auto& record : records_) {
+        if (strncmp(record.name, "IDLE", 4) == 0) {
+            continue;
+        }
+        int average = RingAverage(record.cpu, record.cpu_count);
+        if (average == 0) {
+            continue;
+        }
+        for (int i = 0; i < 3; i++) {
+            if (top[i] == nullptr || average > RingAverage(top[i]->cpu, top[i]->cpu_count)) {
+                std::copy_backward(top + i, top + 2, top + 3);
+                top[i] = &record;
+                break;
+            }
+        }
+    }
+    for (auto record : top) {
+        if (record != nullptr) {
+            ESP_LOGI(TAG, "%s: cpu avg %d%% max %d%%, stack free min %lu", record->name,
+                RingAverage(record->cpu, record->cpu_count), RingMax(record->cpu, record->cpu_count),
+                (unsigned long)record->stack_free_min);
+        }
+    }
+    for (const auto& record : records_) {
+        if (record.stack_free_min < TASK_PROFILER_LOW_STACK_BYTES) {
+            ESP_LOGW(TAG, "%s: only %lu bytes of stack left at its deepest", record.name,
+                (unsigned long)record.stack_free_min);
+        }
+    }
+}
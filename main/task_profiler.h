@@ -0,0 +1,82 @@
+#ifndef TASK_PROFILER_H
+#define TASK_PROFILER_H
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#define TASK_PROFILER_INTERVAL_MS 2000
+// Samples kept per task, one minute at the default interval
+#define TASK_PROFILER_HISTORY 30
+// Free stack below this is reported as low
+#define TASK_PROFILER_LOW_STACK_BYTES 512
+#define TASK_PROFILER_TASK_STACK_SIZE 3072
+
+/*
+ * Periodic sampler of the FreeRTOS run time stats.
+ *
+ * Every TASK_PROFILER_INTERVAL_MS a low priority task takes a snapshot with
+ * uxTaskGetSystemState() and turns the run time counter deltas into CPU
+ * percentages, kept in a ring of TASK_PROFILER_HISTORY samples per task
+ * together with the total load (everything but the idle tasks). The stack
+ * high-water mark (minimum free stack since the task started) comes with
+ * each snapshot.
+ *
+ * Percentages are of the whole chip: a task using one core fully on a
+ * dual-core target reads 50%. Requires CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS,
+ * enabled in sdkconfig.defaults.
+ */
+class TaskProfiler {
+public:
+    static TaskProfiler& GetInstance() {
+        static TaskProfiler instance;
+        return instance;
+    }
+
+    void Start();
+
+    // Tasks sorted by average CPU, for the config server
+    std::string GetJson();
+    // Busiest tasks and tasks short of stack
+    void LogStats();
+
+private:
+    TaskProfiler() = default;
+    TaskProfiler(const TaskProfiler&) = delete;
+    TaskProfiler& operator=(const TaskProfiler&) = delete;
+
+    struct TaskRecord {
+        TaskHandle_t handle;
+        char name[configMAX_TASK_NAME_LEN];
+        UBaseType_t priority;
+        int core;
+        configRUN_TIME_COUNTER_TYPE last_counter;
+        uint32_t stack_free_min;
+        // Percent of the chip per sample, the oldest at cpu_head
+        uint8_t cpu[TASK_PROFILER_HISTORY];
+        uint8_t cpu_head;
+        uint8_t cpu_count;
+        bool seen;
+    };
+
+    std::mutex mutex_;
+    std::vector<TaskStatus_t> snapshot_;
+    std::vector<TaskRecord> records_;
+    configRUN_TIME_COUNTER_TYPE last_total_ = 0;
+    bool started_ = false;
+    uint32_t samples_ = 0;
+    // Total load per sample, same ring layout as TaskRecord::cpu
+    uint8_t load_[TASK_PROFILER_HISTORY] = {};
+    uint8_t load_head_ = 0;
+    uint8_t load_count_ = 0;
+
+    void Run();
+    void Sample();
+    TaskRecord* FindRecord(TaskHandle_t handle);
+};
+
+#endif // TASK_PROFILER_H
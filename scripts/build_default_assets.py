@@ -17,6 +17,7 @@ import shutil
 import sys
 import json
 import struct
+import zlib
 from datetime import datetime
 
 
@@ -350,7 +351,8 @@ def pack_assets_simple(target_path, include_path, out_file, assets_path, max_nam
     """
     merged_data = bytearray()
     file_info_list = []
-    skip_files = ['config.json']
+    skip_files = ['config.json', 'checksums.bin']
+    file_crc_list = []
 
     # Ensure output directory exists
     os.makedirs(os.path.dirname(out_file), exist_ok=True)
@@ -376,6 +378,16 @@ def pack_assets_simple(target_path, include_path, out_file, assets_path, max_nam
             bin_data = bin_file.read()
 
         merged_data.extend(bin_data)
+        file_crc_list.append((file_name, zlib.crc32(bin_data)))
+
+    # Per-file CRC32 table, the firmware verifies each file lazily on first access
+    checksum_table = bytearray()
+    for file_name, crc in file_crc_list:
+        checksum_table.extend(file_name.encode('utf-8')[:32].ljust(32, b'\0'))
+        checksum_table.extend(crc.to_bytes(4, byteorder='little'))
+    file_info_list.append(('checksums.bin', len(merged_data), len(checksum_table), 0, 0))
+    merged_data.extend(b'\x5A' * 2)
+    merged_data.extend(checksum_table)
 
     total_files = len(file_info_list)
 
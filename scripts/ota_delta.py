@@ -0,0 +1,201 @@
+#! /usr/bin/env python3
+"""
+Create and apply binary delta patches for firmware OTA (see main/delta_patcher.h)
+
+Usage:
+    python ota_delta.py create old.bin new.bin patch.bin
+    python ota_delta.py apply old.bin patch.bin out.bin
+
+The patch is built against the exact image currently running on the device,
+publish it in the OTA manifest as firmware.delta = {"url": ..., "from": <old version>}.
+"""
+import argparse
+import hashlib
+import struct
+import sys
+import zlib
+
+MAGIC = b"XZDP"
+VERSION = 1
+HEADER_FORMAT = "<4sHHII32s32s"
+HEADER_SIZE = struct.calcsize(HEADER_FORMAT)
+
+OP_END = 0x00
+OP_COPY = 0x01
+OP_ADD = 0x02
+OP_INSERT = 0x03
+
+# Matching parameters, the index samples the old image every INDEX_STEP bytes
+BLOCK_SIZE = 16
+INDEX_STEP = 4
+MIN_MATCH = 32
+
+
+def build_index(old):
+    index = {}
+    for i in range(0, len(old) - BLOCK_SIZE + 1, INDEX_STEP):
+        index.setdefault(old[i:i + BLOCK_SIZE], i)
+    return index
+
+
+def match_length(old, s, new, d):
+    length = 0
+    limit = min(len(old) - s, len(new) - d)
+    # Compare large slices first, then finish byte by byte
+    while length + 256 <= limit and old[s + length:s + length + 256] == new[d + length:d + length + 256]:
+        length += 256
+    while length < limit and old[s + length] == new[d + length]:
+        length += 1
+    return length
+
+
+def diff(old, new):
+    """Greedy block matcher: exact matches become COPY, the gaps in between are
+    encoded as ADD against the old image at the previous shift (small relocation
+    changes leave mostly zero bytes that compress well) or as INSERT."""
+    index = build_index(old)
+    commands = []
+    gap_start = 0
+    last_delta = 0
+
+    def emit_gap(start, end):
+        length = end - start
+        if length <= 0:
+            return
+        src = start + last_delta
+        if 0 <= src and src + length <= len(old):
+            delta = bytes((new[start + i] - old[src + i]) & 0xFF for i in range(length))
+            if delta.count(0) * 4 >= length:
+                commands.append((OP_ADD, src, length, delta))
+                return
+        commands.append((OP_INSERT, new[start:end]))
+
+    j = 0
+    n = len(new)
+    while j <= n - BLOCK_SIZE:
+        block = new[j:j + BLOCK_SIZE]
+        p = index.get(block)
+        if p is None:
+            j += 1
+            continue
+        # Prefer continuing at the current shift when it matches as well
+        candidate = j + last_delta
+        if 0 <= candidate <= len(old) - BLOCK_SIZE and old[candidate:candidate + BLOCK_SIZE] == block:
+            p = candidate
+
+        s, d = p, j
+        while d > gap_start and s > 0 and old[s - 1] == new[d - 1]:
+            s -= 1
+            d -= 1
+        length = match_length(old, s, new, d)
+        if length < MIN_MATCH:
+            j += 1
+            continue
+
+        emit_gap(gap_start, d)
+        commands.append((OP_COPY, s, length))
+        last_delta = s - d
+        j = d + length
+        gap_start = j
+    emit_gap(gap_start, n)
+    return commands
+
+
+def serialize(commands):
+    out = bytearray()
+    for command in commands:
+        op = command[0]
+        if op == OP_COPY:
+            out += struct.pack("<BII", OP_COPY, command[1], command[2])
+        elif op == OP_ADD:
+            out += struct.pack("<BII", OP_ADD, command[1], command[2])
+            out += command[3]
+        elif op == OP_INSERT:
+            out += struct.pack("<BI", OP_INSERT, len(command[1]))
+            out += command[1]
+    out.append(OP_END)
+    return bytes(out)
+
+
+def create_patch(old, new):
+    header = struct.pack(HEADER_FORMAT, MAGIC, VERSION, 0, len(old), len(new),
+                         hashlib.sha256(old).digest(), hashlib.sha256(new).digest())
+    return header + zlib.compress(serialize(diff(old, new)), 9)
+
+
+def apply_patch(old, patch):
+    magic, version, _, source_size, target_size, source_sha256, target_sha256 = \
+        struct.unpack_from(HEADER_FORMAT, patch)
+    if magic != MAGIC or version != VERSION:
+        raise ValueError("invalid patch header")
+    if source_size > len(old) or hashlib.sha256(old[:source_size]).digest() != source_sha256:
+        raise ValueError("patch does not match the source image")
+
+    body = zlib.decompress(patch[HEADER_SIZE:])
+    out = bytearray()
+    pos = 0
+    while True:
+        op = body[pos]
+        pos += 1
+        if op == OP_END:
+            break
+        if op in (OP_COPY, OP_ADD):
+            src, length = struct.unpack_from("<II", body, pos)
+            pos += 8
+            if src + length > source_size:
+                raise ValueError("source range out of bounds")
+            if op == OP_COPY:
+                out += old[src:src + length]
+            else:
+                out += bytes((old[src + i] + body[pos + i]) & 0xFF for i in range(length))
+                pos += length
+        elif op == OP_INSERT:
+            (length,) = struct.unpack_from("<I", body, pos)
+            pos += 4
+            out += body[pos:pos + length]
+            pos += length
+        else:
+            raise ValueError("unknown opcode 0x%02x" % op)
+
+    if len(out) != target_size or hashlib.sha256(out).digest() != target_sha256:
+        raise ValueError("target image verification failed")
+    return bytes(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Firmware delta patch tool")
+    subparsers = parser.add_subparsers(dest="command", required=True)
+    create = subparsers.add_parser("create", help="create a patch from old.bin to new.bin")
+    create.add_argument("old")
+    create.add_argument("new")
+    create.add_argument("patch")
+    apply = subparsers.add_parser("apply", help="apply a patch to old.bin")
+    apply.add_argument("old")
+    apply.add_argument("patch")
+    apply.add_argument("output")
+    args = parser.parse_args()
+
+    if args.command == "create":
+        with open(args.old, "rb") as f:
+            old = f.read()
+        with open(args.new, "rb") as f:
+            new = f.read()
+        patch = create_patch(old, new)
+        # Always round trip the patch before publishing it
+        if apply_patch(old, patch) != new:
+            print("Patch verification failed", file=sys.stderr)
+            sys.exit(1)
+        with open(args.patch, "wb") as f:
+            f.write(patch)
+        print(f"Patch {len(patch)} bytes for a {len(new)} bytes image ({len(patch) * 100 / len(new):.1f}%)")
+    else:
+        with open(args.old, "rb") as f:
+            old = f.read()
+        with open(args.patch, "rb") as f:
+            patch = f.read()
+        with open(args.output, "wb") as f:
+            f.write(apply_patch(old, patch))
+
+
+if __name__ == "__main__":
+    main()
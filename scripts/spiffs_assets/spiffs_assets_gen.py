@@ -12,6 +12,7 @@ import numpy as np
 import importlib
 import subprocess
 import urllib.request
+import zlib
 
 from PIL import Image
 from datetime import datetime
@@ -401,7 +402,8 @@ def pack_assets(config: PackModelsConfig):
 
     merged_data = bytearray()
     file_info_list = []
-    skip_files = ['config.json', 'lvgl_image_converter']
+    skip_files = ['config.json', 'lvgl_image_converter', 'checksums.bin']
+    file_crc_list = []
 
     file_list = sorted(os.listdir(target_path), key=sort_key)
     for filename in file_list:
@@ -437,6 +439,16 @@ def pack_assets(config: PackModelsConfig):
             bin_data = bin_file.read()
 
         merged_data.extend(bin_data)
+        file_crc_list.append((file_name, zlib.crc32(bin_data)))
+
+    # Per-file CRC32 table, the firmware verifies each file lazily on first access
+    checksum_table = bytearray()
+    for file_name, crc in file_crc_list:
+        checksum_table.extend(file_name.encode('utf-8')[:32].ljust(32, b'\0'))
+        checksum_table.extend(crc.to_bytes(4, byteorder='little'))
+    file_info_list.append(('checksums.bin', len(merged_data), len(checksum_table), 0, 0))
+    merged_data.extend(b'\x5A' * 2)
+    merged_data.extend(checksum_table)
 
     total_files = len(file_info_list)
 
@@ -0,0 +1,109 @@
+// Parses a recorded session of server text frames with ParseServerMessage(),
+// checks the fields against what the log holds and reports the time per frame.
+// With cJSON installed the DOM parse the fast path replaced is timed as well.
+#include "host_test.h"
+#include "server_message.h"
+
+#ifdef HAVE_CJSON
+#include <cJSON.h>
+#endif
+
+#include <cstring>
+
+#define ROUNDS 2000
+
+static int CountType(const std::vector<std::string>& lines, ServerMessageType type) {
+    int count = 0;
+    for (const auto& line : lines) {
+        ServerMessage message;
+        if (ParseServerMessage(line.data(), line.size(), message) && message.type == type) {
+            count++;
+        }
+    }
+    return count;
+}
+
+static void CheckFields(const std::vector<std::string>& lines) {
+    for (const auto& line : lines) {
+        ServerMessage message;
+        CHECK(ParseServerMessage(line.data(), line.size(), message));
+        CHECK(message.type != kServerMessageUnknown || message.type_name == "listen");
+        if (message.type != kServerMessageHello) {
+            CHECK(message.session_id == "a1b2c3d4");
+        }
+    }
+
+    // Nested objects are skipped, only top level fields are picked up
+    const std::string mcp = lines[12];
+    ServerMessage message;
+    CHECK(ParseServerMessage(mcp.data(), mcp.size(), message));
+    CHECK(message.type == kServerMessageMcp && message.needs_dom());
+    CHECK(message.text.data() == nullptr);
+
+    // Escapes stay in the view until unescaped
+    const std::string quoted = lines[7];
+    CHECK(ParseServerMessage(quoted.data(), quoted.size(), message));
+    CHECK(message.state == "sentence_start");
+    CHECK(UnescapeJsonString(message.text) == "适合出门散步，记得带上\"防晒霜\"哦。");
+    CHECK(UnescapeJsonString("\\u4f60\\ud83d\\ude00\\n") == "你😀\n");
+
+    const std::string goodbye = lines[30];
+    CHECK(ParseServerMessage(goodbye.data(), goodbye.size(), message));
+    CHECK(message.type == kServerMessageGoodbye && !message.needs_dom());
+
+    const char* broken[] = {"", "[]", "{\"type\":1}", "{\"text\":\"hi\"}", "{\"type\":\"tts\""};
+    for (auto data : broken) {
+        CHECK(!ParseServerMessage(data, strlen(data), message));
+    }
+}
+
+int main() {
+    auto lines = ReadLines("server_messages.log");
+    CHECK(lines.size() == 32);
+    if (lines.size() != 32) {
+        return HOST_TEST_RESULT();
+    }
+    CheckFields(lines);
+    CHECK(CountType(lines, kServerMessageTts) == 16);
+    CHECK(CountType(lines, kServerMessageLlm) == 5);
+
+    size_t bytes = 0;
+    for (const auto& line : lines) {
+        bytes += line.size();
+    }
+    size_t frames = lines.size() * ROUNDS;
+
+    int64_t start = HostNowUs();
+    size_t fields = 0;
+    for (int round = 0; round < ROUNDS; round++) {
+        for (const auto& line : lines) {
+            ServerMessage message;
+            ParseServerMessage(line.data(), line.size(), message);
+            fields += message.text.size() + message.state.size();
+        }
+    }
+    int64_t fast_us = HostNowUs() - start;
+    printf("ParseServerMessage: %zu frames, %.3f us/frame, %.1f MB/s (%zu)\n", frames,
+        (double)fast_us / frames, (double)bytes * ROUNDS / fast_us, fields);
+
+#ifdef HAVE_CJSON
+    start = HostNowUs();
+    fields = 0;
+    for (int round = 0; round < ROUNDS; round++) {
+        for (const auto& line : lines) {
+            auto root = cJSON_ParseWithLength(line.data(), line.size());
+            auto text = cJSON_GetObjectItem(root, "text");
+            if (cJSON_IsString(text)) {
+                fields += strlen(text->valuestring);
+            }
+            cJSON_Delete(root);
+        }
+    }
+    int64_t dom_us = HostNowUs() - start;
+    printf("cJSON_Parse:        %zu frames, %.3f us/frame, %.1fx slower (%zu)\n", frames,
+        (double)dom_us / frames, (double)dom_us / fast_us, fields);
+#else
+    printf("cJSON not found, DOM parse not compared\n");
+#endif
+    return HOST_TEST_RESULT();
+}
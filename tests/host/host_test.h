@@ -0,0 +1,47 @@
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Shared by the host tests: a failed CHECK is reported and makes main() return 1
+
+inline int g_host_test_failures = 0;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+            g_host_test_failures++; \
+        } \
+    } while (0)
+
+#define HOST_TEST_RESULT() (g_host_test_failures == 0 ? 0 : (fprintf(stderr, "%d checks failed\n", g_host_test_failures), 1))
+
+inline int64_t HostNowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// One entry per line, empty lines skipped
+inline std::vector<std::string> ReadLines(const std::string& path) {
+    std::vector<std::string> lines;
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line)) {
+        if (!line.empty()) {
+            lines.push_back(line);
+        }
+    }
+    return lines;
+}
+
+inline std::vector<uint8_t> ReadFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+#endif // HOST_TEST_H
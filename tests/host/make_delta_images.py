@@ -0,0 +1,57 @@
+#! /usr/bin/env python3
+"""
+Write two firmware-like images for test_delta_patcher: new.bin is old.bin with
+an inserted block, a removed block, shifted addresses in a relocated region,
+a changed version string and a longer tail.
+
+Usage:
+    python make_delta_images.py old.bin new.bin
+"""
+import random
+import struct
+import sys
+
+
+def make_old(rng, size):
+    # Code is repetitive: a small vocabulary of instruction words with address operands
+    words = [rng.getrandbits(32) for _ in range(512)]
+    out = bytearray()
+    while len(out) < size:
+        word = rng.choice(words)
+        if rng.random() < 0.2:
+            word = 0x3f400000 + rng.randrange(0, 0x40000, 4)
+        out += struct.pack("<I", word)
+    out[0] = 0xE9
+    out[48:48 + 32] = b"1.0.0".ljust(32, b"\0")
+    return out[:size]
+
+
+def make_new(rng, old):
+    new = bytearray(old)
+    # Relocation: the addresses in a region moved by 0x40
+    for i in range(len(new) // 2, len(new) // 2 + 64 * 1024, 4):
+        (word,) = struct.unpack_from("<I", new, i)
+        if 0x3f400000 <= word < 0x3f440000:
+            struct.pack_into("<I", new, i, word + 0x40)
+    new[48:48 + 32] = b"1.1.0".ljust(32, b"\0")
+    # New code in the first quarter, a removed function further on
+    insert_at = len(new) // 10
+    new[insert_at:insert_at] = bytes(rng.getrandbits(8) for _ in range(3000))
+    remove_at = len(new) // 3
+    del new[remove_at:remove_at + 1500]
+    new += bytes(rng.getrandbits(8) for _ in range(5000))
+    return new
+
+
+def main():
+    rng = random.Random(2024)
+    old = make_old(rng, 256 * 1024)
+    new = make_new(rng, old)
+    with open(sys.argv[1], "wb") as f:
+        f.write(old)
+    with open(sys.argv[2], "wb") as f:
+        f.write(new)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,46 @@
+// Feeds afsk_demod.cc from a sample buffer instead of the microphone
+#pragma once
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "display.h"
+
+enum DeviceState { kDeviceStateIdle, kDeviceStateWifiConfiguring };
+
+// Thrown when the input runs out or the device would restart, ends the receive loop
+struct AfskStop {
+    bool restarted;
+};
+
+inline void esp_restart() {
+    throw AfskStop{true};
+}
+
+class AudioService {
+public:
+    const std::vector<int16_t>* input = nullptr;
+    size_t position = 0;
+
+    bool ReadAudioData(std::vector<int16_t>& data, int sample_rate, int samples) {
+        if (input == nullptr || position + samples > input->size()) {
+            throw AfskStop{false};
+        }
+        data.assign(input->begin() + position, input->begin() + position + samples);
+        position += samples;
+        return true;
+    }
+};
+
+class Application {
+public:
+    DeviceState GetDeviceState() { return kDeviceStateWifiConfiguring; }
+    AudioService& GetAudioService() { return audio_service_; }
+
+private:
+    AudioService audio_service_;
+};
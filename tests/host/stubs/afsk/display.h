@@ -0,0 +1,6 @@
+#pragma once
+
+class Display {
+public:
+    void SetChatMessage(const char* role, const char* content) {}
+};
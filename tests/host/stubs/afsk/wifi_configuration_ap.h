@@ -0,0 +1,17 @@
+#pragma once
+
+#include <string>
+
+// Records the credentials the demodulator hands over
+class WifiConfigurationAp {
+public:
+    std::string ssid;
+    std::string password;
+
+    bool ConnectToWifi(const std::string& ssid, const std::string& password) {
+        this->ssid = ssid;
+        this->password = password;
+        return true;
+    }
+    void Save(const std::string& ssid, const std::string& password) {}
+};
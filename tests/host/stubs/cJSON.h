@@ -0,0 +1,44 @@
+// Link-only stand-in for cJSON: nothing parses, builders return empty nodes.
+// Tests that need real JSON use the installed cJSON (HAVE_CJSON).
+#pragma once
+
+#include <cstdlib>
+#include <cstring>
+
+typedef struct cJSON {
+    struct cJSON* next;
+    struct cJSON* child;
+    int type;
+    char* valuestring;
+    int valueint;
+    double valuedouble;
+    char* string;
+} cJSON;
+
+inline cJSON* cJSON_Parse(const char* value) { return nullptr; }
+inline cJSON* cJSON_ParseWithLength(const char* value, size_t length) { return nullptr; }
+inline void cJSON_Delete(cJSON* item) { delete item; }
+inline void cJSON_free(void* ptr) { free(ptr); }
+inline char* cJSON_PrintUnformatted(const cJSON* item) { return strdup("{}"); }
+inline char* cJSON_Print(const cJSON* item) { return strdup("{}"); }
+
+inline cJSON* cJSON_GetObjectItem(const cJSON* object, const char* name) { return nullptr; }
+inline cJSON* cJSON_GetArrayItem(const cJSON* array, int index) { return nullptr; }
+inline int cJSON_GetArraySize(const cJSON* array) { return 0; }
+inline bool cJSON_IsString(const cJSON* item) { return false; }
+inline bool cJSON_IsNumber(const cJSON* item) { return false; }
+inline bool cJSON_IsBool(const cJSON* item) { return false; }
+inline bool cJSON_IsTrue(const cJSON* item) { return false; }
+inline bool cJSON_IsObject(const cJSON* item) { return false; }
+inline bool cJSON_IsArray(const cJSON* item) { return false; }
+#define cJSON_ArrayForEach(element, array) for (element = nullptr; element != nullptr; )
+
+inline cJSON* cJSON_CreateObject() { return new cJSON(); }
+inline cJSON* cJSON_CreateArray() { return new cJSON(); }
+inline cJSON* cJSON_CreateNumber(double number) { return new cJSON(); }
+inline cJSON* cJSON_CreateString(const char* string) { return new cJSON(); }
+inline void cJSON_AddItemToObject(cJSON* object, const char* name, cJSON* item) { delete item; }
+inline void cJSON_AddItemToArray(cJSON* array, cJSON* item) { delete item; }
+inline cJSON* cJSON_AddStringToObject(cJSON* object, const char* name, const char* string) { return nullptr; }
+inline cJSON* cJSON_AddNumberToObject(cJSON* object, const char* name, double number) { return nullptr; }
+inline cJSON* cJSON_AddBoolToObject(cJSON* object, const char* name, bool boolean) { return nullptr; }
@@ -0,0 +1,4 @@
+// PDM is left out (no SOC_I2S_SUPPORTS_PDM_RX), only the standard mode types are needed
+#pragma once
+
+#include "i2s_std.h"
@@ -0,0 +1,57 @@
+// Host stand-in for the capability allocator, every capability is the C heap
+#pragma once
+
+#include <malloc.h>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+#define MALLOC_CAP_EXEC (1 << 0)
+#define MALLOC_CAP_32BIT (1 << 1)
+#define MALLOC_CAP_8BIT (1 << 2)
+#define MALLOC_CAP_DMA (1 << 3)
+#define MALLOC_CAP_SPIRAM (1 << 10)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+#define MALLOC_CAP_DEFAULT (1 << 12)
+
+typedef struct {
+    size_t total_free_bytes;
+    size_t total_allocated_bytes;
+    size_t largest_free_block;
+    size_t minimum_free_bytes;
+    size_t allocated_blocks;
+    size_t free_blocks;
+    size_t total_blocks;
+} multi_heap_info_t;
+
+inline void* heap_caps_malloc(size_t size, uint32_t caps) {
+    return malloc(size);
+}
+
+inline void* heap_caps_calloc(size_t n, size_t size, uint32_t caps) {
+    return calloc(n, size);
+}
+
+inline void* heap_caps_aligned_alloc(size_t alignment, size_t size, uint32_t caps) {
+    return aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+
+inline void heap_caps_free(void* ptr) {
+    free(ptr);
+}
+
+inline size_t heap_caps_get_allocated_size(void* ptr) {
+    return malloc_usable_size(ptr);
+}
+
+inline size_t heap_caps_get_total_size(uint32_t caps) {
+    return 0;
+}
+
+inline size_t heap_caps_get_free_size(uint32_t caps) {
+    return 0;
+}
+
+inline void heap_caps_get_info(multi_heap_info_t* info, uint32_t caps) {
+    *info = {};
+}
@@ -0,0 +1,5 @@
+#pragma once
+
+inline bool esp_ptr_external_ram(const void* ptr) {
+    return false;
+}
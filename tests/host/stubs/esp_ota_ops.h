@@ -0,0 +1,34 @@
+// Declarations only, the test that links ota.cc provides a fake flash behind them
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "esp_app_format.h"
+#include "esp_err.h"
+#include "esp_partition.h"
+
+typedef uint32_t esp_ota_handle_t;
+
+typedef enum {
+    ESP_OTA_IMG_NEW,
+    ESP_OTA_IMG_PENDING_VERIFY,
+    ESP_OTA_IMG_VALID,
+    ESP_OTA_IMG_INVALID,
+    ESP_OTA_IMG_ABORTED,
+    ESP_OTA_IMG_UNDEFINED,
+} esp_ota_img_states_t;
+
+#define OTA_SIZE_UNKNOWN 0xffffffff
+#define OTA_WITH_SEQUENTIAL_WRITES 0xfffffffe
+
+const esp_app_desc_t* esp_app_get_description();
+const esp_partition_t* esp_ota_get_running_partition();
+const esp_partition_t* esp_ota_get_next_update_partition(const esp_partition_t* start_from);
+esp_err_t esp_ota_begin(const esp_partition_t* partition, size_t image_size, esp_ota_handle_t* out_handle);
+esp_err_t esp_ota_write(esp_ota_handle_t handle, const void* data, size_t size);
+esp_err_t esp_ota_end(esp_ota_handle_t handle);
+esp_err_t esp_ota_abort(esp_ota_handle_t handle);
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t* partition);
+esp_err_t esp_ota_get_state_partition(const esp_partition_t* partition, esp_ota_img_states_t* state);
+esp_err_t esp_ota_mark_app_valid_cancel_rollback();
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+inline int64_t esp_timer_get_time() {
+    static const auto boot = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - boot).count();
+}
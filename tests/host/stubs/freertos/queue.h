@@ -0,0 +1,69 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+struct QueueDefinition {
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<std::vector<uint8_t>> items;
+    UBaseType_t length;
+    UBaseType_t item_size;
+};
+typedef QueueDefinition* QueueHandle_t;
+
+inline QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+    auto queue = new QueueDefinition();
+    queue->length = length;
+    queue->item_size = item_size;
+    return queue;
+}
+
+inline void vQueueDelete(QueueHandle_t queue) {
+    delete queue;
+}
+
+// Waits for pred with the lock held, false on timeout
+template <typename Pred>
+inline bool QueueWait(QueueHandle_t queue, std::unique_lock<std::mutex>& lock, TickType_t ticks, Pred pred) {
+    if (ticks == portMAX_DELAY) {
+        queue->changed.wait(lock, pred);
+        return true;
+    }
+    return queue->changed.wait_for(lock, std::chrono::milliseconds(ticks), pred);
+}
+
+inline BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticks) {
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    if (!QueueWait(queue, lock, ticks, [queue]() { return queue->items.size() < queue->length; })) {
+        return pdFAIL;
+    }
+    auto data = (const uint8_t*)item;
+    queue->items.emplace_back(data, data + queue->item_size);
+    queue->changed.notify_all();
+    return pdPASS;
+}
+
+inline BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticks) {
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    if (!QueueWait(queue, lock, ticks, [queue]() { return !queue->items.empty(); })) {
+        return pdFALSE;
+    }
+    if (queue->item_size > 0) {
+        memcpy(item, queue->items.front().data(), queue->item_size);
+    }
+    queue->items.pop_front();
+    queue->changed.notify_all();
+    return pdTRUE;
+}
+
+inline UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    return queue->items.size();
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+#include <thread>
+
+typedef void* TaskHandle_t;
+typedef void (*TaskFunction_t)(void*);
+
+inline BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stack_size, void* arg,
+    UBaseType_t priority, TaskHandle_t* handle) {
+    std::thread thread(function, arg);
+    if (handle != nullptr) {
+        *handle = (TaskHandle_t)(uintptr_t)std::hash<std::thread::id>()(thread.get_id());
+    }
+    thread.detach();
+    return pdPASS;
+}
+
+// Only deleting the calling task at its end is supported, the thread returns right after
+inline void vTaskDelete(TaskHandle_t task) {}
+
+inline void vTaskDelay(TickType_t ticks) {}
+
+inline UBaseType_t uxTaskPriorityGet(TaskHandle_t task) {
+    return 5;
+}
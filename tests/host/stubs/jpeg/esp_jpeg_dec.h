@@ -0,0 +1,152 @@
+// esp_new_jpeg decoder on libjpeg, link with JPEG::JPEG. Outputs GRAY, RGB888 and
+// RGB565_LE, scales by 1/2, 1/4 or 1/8 to sizes that are multiples of 8
+#pragma once
+
+#include <csetjmp>
+#include <cstdint>
+#include <cstdio>
+
+#include <jpeglib.h>
+
+typedef enum {
+    JPEG_PIXEL_FORMAT_GRAY = 0,
+    JPEG_PIXEL_FORMAT_RGB888,
+    JPEG_PIXEL_FORMAT_RGB565_BE,
+    JPEG_PIXEL_FORMAT_RGB565_LE,
+} jpeg_pixel_format_t;
+
+typedef enum {
+    JPEG_ROTATE_0D = 0,
+    JPEG_ROTATE_90D,
+    JPEG_ROTATE_180D,
+    JPEG_ROTATE_270D,
+} jpeg_rotate_t;
+
+typedef enum {
+    JPEG_ERR_OK = 0,
+    JPEG_ERR_FAIL = -1,
+    JPEG_ERR_NO_MEM = -2,
+    JPEG_ERR_INVALID_PARAM = -4,
+    JPEG_ERR_BAD_DATA = -5,
+    JPEG_ERR_UNSUPPORT_FMT = -6,
+} jpeg_error_t;
+
+typedef struct {
+    uint16_t width;
+    uint16_t height;
+} jpeg_resolution_t;
+
+typedef struct {
+    jpeg_pixel_format_t output_type;
+    jpeg_resolution_t scale;
+    jpeg_resolution_t clipper;
+    jpeg_rotate_t rotate;
+    bool block_enable;
+} jpeg_dec_config_t;
+
+typedef struct {
+    uint8_t* inbuf;
+    int inbuf_len;
+    int inbuf_remain;
+    uint8_t* outbuf;
+    int out_size;
+} jpeg_dec_io_t;
+
+typedef struct {
+    uint16_t width;
+    uint16_t height;
+} jpeg_dec_header_info_t;
+
+struct JpegHostDecoder {
+    struct Error {
+        jpeg_error_mgr manager;
+        jmp_buf jump;
+    };
+
+    jpeg_dec_config_t config;
+    jpeg_decompress_struct info;
+    Error error;
+};
+typedef JpegHostDecoder* jpeg_dec_handle_t;
+
+inline jpeg_error_t jpeg_dec_open(jpeg_dec_config_t* config, jpeg_dec_handle_t* handle) {
+    if (config->rotate != JPEG_ROTATE_0D || config->clipper.width != 0 ||
+        config->output_type == JPEG_PIXEL_FORMAT_RGB565_BE) {
+        return JPEG_ERR_UNSUPPORT_FMT;
+    }
+    auto dec = new JpegHostDecoder();
+    dec->config = *config;
+    dec->info.err = jpeg_std_error(&dec->error.manager);
+    dec->error.manager.error_exit = [](j_common_ptr info) {
+        longjmp(((JpegHostDecoder::Error*)info->err)->jump, 1);
+    };
+    dec->error.manager.output_message = [](j_common_ptr info) {};
+    jpeg_create_decompress(&dec->info);
+    *handle = dec;
+    return JPEG_ERR_OK;
+}
+
+inline jpeg_error_t jpeg_dec_close(jpeg_dec_handle_t dec) {
+    jpeg_destroy_decompress(&dec->info);
+    delete dec;
+    return JPEG_ERR_OK;
+}
+
+inline jpeg_error_t jpeg_dec_parse_header(jpeg_dec_handle_t dec, jpeg_dec_io_t* io, jpeg_dec_header_info_t* header) {
+    if (setjmp(dec->error.jump)) {
+        jpeg_abort_decompress(&dec->info);
+        return JPEG_ERR_BAD_DATA;
+    }
+    jpeg_mem_src(&dec->info, io->inbuf, io->inbuf_len);
+    jpeg_read_header(&dec->info, TRUE);
+    header->width = dec->info.image_width;
+    header->height = dec->info.image_height;
+    return JPEG_ERR_OK;
+}
+
+inline jpeg_error_t jpeg_dec_process(jpeg_dec_handle_t dec, jpeg_dec_io_t* io) {
+    auto& info = dec->info;
+    int denominator = 1;
+    const auto& scale = dec->config.scale;
+    if (scale.width != 0 || scale.height != 0) {
+        if (scale.width == 0 || scale.height == 0 || scale.width % 8 != 0 || scale.height % 8 != 0) {
+            return JPEG_ERR_INVALID_PARAM;
+        }
+        denominator = info.image_width / scale.width;
+        if ((denominator != 2 && denominator != 4 && denominator != 8) ||
+            (JDIMENSION)scale.width * denominator != info.image_width ||
+            (JDIMENSION)scale.height * denominator != info.image_height) {
+            return JPEG_ERR_INVALID_PARAM;
+        }
+    }
+    int pixel_size = 1;
+    if (dec->config.output_type == JPEG_PIXEL_FORMAT_GRAY) {
+        info.out_color_space = JCS_GRAYSCALE;
+    } else if (dec->config.output_type == JPEG_PIXEL_FORMAT_RGB888) {
+        info.out_color_space = JCS_RGB;
+        pixel_size = 3;
+    } else {
+        info.out_color_space = JCS_RGB565;
+        info.dither_mode = JDITHER_NONE;
+        pixel_size = 2;
+    }
+    info.scale_num = 1;
+    info.scale_denom = denominator;
+
+    if (setjmp(dec->error.jump)) {
+        jpeg_abort_decompress(&info);
+        return JPEG_ERR_BAD_DATA;
+    }
+    jpeg_start_decompress(&info);
+    size_t stride = (size_t)info.output_width * pixel_size;
+    if (stride * info.output_height > (size_t)io->out_size) {
+        jpeg_abort_decompress(&info);
+        return JPEG_ERR_NO_MEM;
+    }
+    while (info.output_scanline < info.output_height) {
+        JSAMPROW row = io->outbuf + stride * info.output_scanline;
+        jpeg_read_scanlines(&info, &row, 1);
+    }
+    jpeg_finish_decompress(&info);
+    return JPEG_ERR_OK;
+}
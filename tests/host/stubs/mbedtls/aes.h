@@ -0,0 +1,45 @@
+// mbedtls AES-CTR on top of the OpenSSL block cipher, link with OpenSSL::Crypto
+#pragma once
+
+#include <openssl/aes.h>
+
+#include <cstddef>
+
+// The low level block calls are deprecated in OpenSSL 3 but match this API one to one
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+
+typedef AES_KEY mbedtls_aes_context;
+
+inline void mbedtls_aes_init(mbedtls_aes_context* ctx) {}
+inline void mbedtls_aes_free(mbedtls_aes_context* ctx) {}
+
+inline int mbedtls_aes_setkey_enc(mbedtls_aes_context* ctx, const unsigned char* key, unsigned int keybits) {
+    return AES_set_encrypt_key(key, keybits, ctx) == 0 ? 0 : -0x0020;
+}
+
+// Same loop as mbedtls: one block of key stream per 16 bytes, big endian counter
+inline int mbedtls_aes_crypt_ctr(mbedtls_aes_context* ctx, size_t length, size_t* nc_off,
+    unsigned char nonce_counter[16], unsigned char stream_block[16], const unsigned char* input,
+    unsigned char* output) {
+    size_t n = *nc_off;
+    if (n > 15) {
+        return -0x0021;
+    }
+    for (size_t i = 0; i < length; i++) {
+        if (n == 0) {
+            AES_encrypt(nonce_counter, stream_block, ctx);
+            for (int j = 16; j > 0; j--) {
+                if (++nonce_counter[j - 1] != 0) {
+                    break;
+                }
+            }
+        }
+        output[i] = input[i] ^ stream_block[n];
+        n = (n + 1) & 0x0F;
+    }
+    *nc_off = n;
+    return 0;
+}
+
+#pragma GCC diagnostic pop
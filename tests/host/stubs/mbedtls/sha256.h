@@ -0,0 +1,32 @@
+// mbedtls SHA-256 on top of OpenSSL, link with OpenSSL::Crypto
+#pragma once
+
+#include <openssl/sha.h>
+
+// The low level digest calls are deprecated in OpenSSL 3 but match this API one to one
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+
+typedef SHA256_CTX mbedtls_sha256_context;
+
+inline void mbedtls_sha256_init(mbedtls_sha256_context* ctx) {}
+inline void mbedtls_sha256_free(mbedtls_sha256_context* ctx) {}
+
+inline int mbedtls_sha256_starts(mbedtls_sha256_context* ctx, int is224) {
+    return SHA256_Init(ctx) == 1 ? 0 : -1;
+}
+
+inline int mbedtls_sha256_update(mbedtls_sha256_context* ctx, const unsigned char* input, size_t ilen) {
+    return SHA256_Update(ctx, input, ilen) == 1 ? 0 : -1;
+}
+
+inline int mbedtls_sha256_finish(mbedtls_sha256_context* ctx, unsigned char output[32]) {
+    return SHA256_Final(output, ctx) == 1 ? 0 : -1;
+}
+
+inline int mbedtls_sha256(const unsigned char* input, size_t ilen, unsigned char output[32], int is224) {
+    SHA256(input, ilen, output);
+    return 0;
+}
+
+#pragma GCC diagnostic pop
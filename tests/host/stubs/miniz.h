@@ -0,0 +1,61 @@
+// The tinfl streaming inflater of miniz on top of zlib, link with ZLIB::ZLIB
+#pragma once
+
+#include <zlib.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+typedef uint8_t mz_uint8;
+typedef uint32_t mz_uint32;
+
+typedef struct tinfl_decompressor_tag {
+    z_stream stream;
+    bool started;
+} tinfl_decompressor;
+
+#define TINFL_LZ_DICT_SIZE 32768
+#define TINFL_FLAG_PARSE_ZLIB_HEADER 1
+#define TINFL_FLAG_HAS_MORE_INPUT 2
+#define TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF 4
+#define TINFL_FLAG_COMPUTE_ADLER32 8
+
+typedef enum {
+    TINFL_STATUS_FAILED = -1,
+    TINFL_STATUS_DONE = 0,
+    TINFL_STATUS_NEEDS_MORE_INPUT = 1,
+    TINFL_STATUS_HAS_MORE_OUTPUT = 2,
+} tinfl_status;
+
+#define tinfl_init(r) do { (r)->started = false; } while (0)
+
+// Unlike miniz the window lives in the zlib state, the output buffer is not used as the dictionary
+inline tinfl_status tinfl_decompress(tinfl_decompressor* r, const mz_uint8* in, size_t* in_size,
+    mz_uint8* out_start, mz_uint8* out_next, size_t* out_size, mz_uint32 flags) {
+    if (!r->started) {
+        memset(&r->stream, 0, sizeof(r->stream));
+        if (inflateInit2(&r->stream, (flags & TINFL_FLAG_PARSE_ZLIB_HEADER) ? MAX_WBITS : -MAX_WBITS) != Z_OK) {
+            return TINFL_STATUS_FAILED;
+        }
+        r->started = true;
+    }
+    r->stream.next_in = (Bytef*)in;
+    r->stream.avail_in = *in_size;
+    r->stream.next_out = out_next;
+    r->stream.avail_out = *out_size;
+    int ret = inflate(&r->stream, Z_NO_FLUSH);
+    *in_size -= r->stream.avail_in;
+    *out_size -= r->stream.avail_out;
+    if (ret == Z_STREAM_END) {
+        inflateEnd(&r->stream);
+        r->started = false;
+        return TINFL_STATUS_DONE;
+    }
+    if (ret != Z_OK && ret != Z_BUF_ERROR) {
+        inflateEnd(&r->stream);
+        r->started = false;
+        return TINFL_STATUS_FAILED;
+    }
+    return r->stream.avail_out == 0 ? TINFL_STATUS_HAS_MORE_OUTPUT : TINFL_STATUS_NEEDS_MORE_INPUT;
+}
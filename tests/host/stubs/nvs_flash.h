@@ -0,0 +1,7 @@
+#pragma once
+
+#include <cstdint>
+
+#include "esp_err.h"
+
+typedef uint32_t nvs_handle_t;
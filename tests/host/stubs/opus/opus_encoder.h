@@ -0,0 +1,19 @@
+// OpusEncoderWrapper that only records what the governor sets
+#pragma once
+
+class OpusEncoderWrapper {
+public:
+    void SetComplexity(int complexity) {
+        complexity_ = complexity;
+        complexity_calls_++;
+    }
+    void SetDtx(bool enable) {
+        dtx_ = enable;
+        dtx_calls_++;
+    }
+
+    int complexity_ = -1;
+    bool dtx_ = false;
+    int complexity_calls_ = 0;
+    int dtx_calls_ = 0;
+};
@@ -0,0 +1,5 @@
+#pragma once
+
+namespace Lang {
+    constexpr const char* CODE = "zh-CN";
+}
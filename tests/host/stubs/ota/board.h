@@ -0,0 +1,33 @@
+// Board and network for ota.cc, the test installs its HTTP server as the network.
+// Includes what ota.cc gets through the real board.h.
+#pragma once
+
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <sys/time.h>
+
+#include <memory>
+#include <string>
+
+#include "http.h"
+
+class NetworkInterface {
+public:
+    virtual ~NetworkInterface() = default;
+    virtual std::unique_ptr<Http> CreateHttp(int connect_id) = 0;
+};
+
+class Board {
+public:
+    static Board& GetInstance() {
+        static Board instance;
+        return instance;
+    }
+
+    NetworkInterface* GetNetwork() { return network; }
+    std::string GetUuid() { return "00000000-0000-0000-0000-000000000000"; }
+    std::string GetSystemInfoJson() { return "{}"; }
+
+    NetworkInterface* network = nullptr;
+};
@@ -0,0 +1,96 @@
+// esp_timer on a simulated clock: nothing fires until the test calls
+// EspTimerAdvance(), which runs the periodic timers tick by tick
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "esp_err.h"
+
+typedef void (*esp_timer_cb_t)(void* arg);
+typedef enum { ESP_TIMER_TASK, ESP_TIMER_ISR } esp_timer_dispatch_t;
+
+typedef struct {
+    esp_timer_cb_t callback;
+    void* arg;
+    esp_timer_dispatch_t dispatch_method;
+    const char* name;
+    bool skip_unhandled_events;
+} esp_timer_create_args_t;
+
+struct esp_timer {
+    esp_timer_cb_t callback;
+    void* arg;
+    bool running;
+    uint64_t period_us;
+    int64_t next_us;
+};
+typedef esp_timer* esp_timer_handle_t;
+
+inline int64_t g_esp_timer_now = 1000000;
+inline std::vector<esp_timer_handle_t> g_esp_timers;
+
+inline int64_t esp_timer_get_time() {
+    return g_esp_timer_now;
+}
+
+inline esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* handle) {
+    *handle = new esp_timer{args->callback, args->arg, false, 0, 0};
+    g_esp_timers.push_back(*handle);
+    return ESP_OK;
+}
+
+inline esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us) {
+    timer->running = true;
+    timer->period_us = period_us;
+    timer->next_us = g_esp_timer_now + period_us;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    timer->running = false;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+    g_esp_timers.erase(std::remove(g_esp_timers.begin(), g_esp_timers.end(), timer), g_esp_timers.end());
+    delete timer;
+    return ESP_OK;
+}
+
+inline bool EspTimerAnyRunning() {
+    for (auto timer : g_esp_timers) {
+        if (timer->running) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Moves the clock by us, each expiry fires late by jitter() microseconds.
+// after_tick runs after every callback.
+inline void EspTimerAdvance(int64_t us, std::function<int64_t()> jitter = nullptr,
+    std::function<void()> after_tick = nullptr) {
+    int64_t end = g_esp_timer_now + us;
+    while (true) {
+        esp_timer_handle_t next = nullptr;
+        for (auto timer : g_esp_timers) {
+            if (timer->running && (next == nullptr || timer->next_us < next->next_us)) {
+                next = timer;
+            }
+        }
+        if (next == nullptr || next->next_us > end) {
+            break;
+        }
+        int64_t late = jitter ? jitter() : 0;
+        g_esp_timer_now = std::max(g_esp_timer_now, next->next_us + late);
+        next->next_us += next->period_us;
+        next->callback(next->arg);
+        if (after_tick) {
+            after_tick();
+        }
+    }
+    g_esp_timer_now = std::max(g_esp_timer_now, end);
+}
@@ -0,0 +1,21 @@
+// The shutdown handlers are kept, EspRestart() runs them like esp_restart()
+#pragma once
+
+#include <vector>
+
+#include "esp_err.h"
+
+typedef void (*shutdown_handler_t)(void);
+
+inline std::vector<shutdown_handler_t> g_shutdown_handlers;
+
+inline esp_err_t esp_register_shutdown_handler(shutdown_handler_t handler) {
+    g_shutdown_handlers.push_back(handler);
+    return ESP_OK;
+}
+
+inline void EspRestart() {
+    for (auto handler : g_shutdown_handlers) {
+        handler();
+    }
+}
@@ -0,0 +1,30 @@
+// The settings commit task is created but never run, so nothing is written
+// behind the test's back. The notifications it would get are counted.
+#pragma once
+
+#include <freertos/FreeRTOS.h>
+
+typedef void* TaskHandle_t;
+typedef void (*TaskFunction_t)(void*);
+
+inline int g_tasks_created = 0;
+inline int g_task_notifications = 0;
+
+inline BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stack_size, void* arg,
+    UBaseType_t priority, TaskHandle_t* handle) {
+    g_tasks_created++;
+    if (handle != nullptr) {
+        *handle = (TaskHandle_t)(uintptr_t)g_tasks_created;
+    }
+    return pdPASS;
+}
+
+inline void vTaskDelete(TaskHandle_t task) {}
+
+inline void xTaskNotifyGive(TaskHandle_t task) {
+    g_task_notifications++;
+}
+
+inline uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks) {
+    return 0;
+}
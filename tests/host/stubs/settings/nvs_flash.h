@@ -0,0 +1,133 @@
+// NVS on a std::map: the values are typed like on the chip, every set and commit
+// is counted and g_nvs_fail_* make the next matching calls fail. g_nvs_on_set
+// runs inside each set, while Settings::Flush() is writing.
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <string>
+
+#include "esp_err.h"
+
+#define ESP_ERR_NVS_BASE 0x1100
+#define ESP_ERR_NVS_NOT_ENOUGH_SPACE (ESP_ERR_NVS_BASE + 0x05)
+#define ESP_ERR_NVS_NOT_FOUND (ESP_ERR_NVS_BASE + 0x02)
+#define ESP_ERR_NVS_INVALID_LENGTH (ESP_ERR_NVS_BASE + 0x0c)
+
+typedef uint32_t nvs_handle_t;
+typedef enum { NVS_READONLY, NVS_READWRITE } nvs_open_mode_t;
+
+enum NvsType { kNvsString, kNvsI32, kNvsU8 };
+
+struct NvsValue {
+    NvsType type;
+    std::string text;
+    int32_t number;
+};
+
+// Namespace, then key
+inline std::map<std::string, std::map<std::string, NvsValue>> g_nvs;
+inline std::map<nvs_handle_t, std::string> g_nvs_handles;
+inline nvs_handle_t g_nvs_next_handle = 1;
+inline int g_nvs_sets = 0;
+inline int g_nvs_commits = 0;
+// Sets of this key and commits fail while these are set
+inline std::string g_nvs_fail_key;
+inline bool g_nvs_fail_commit = false;
+inline std::function<void(const std::string& key)> g_nvs_on_set;
+
+inline esp_err_t nvs_open(const char* name, nvs_open_mode_t mode, nvs_handle_t* handle) {
+    if (mode == NVS_READONLY && g_nvs.find(name) == g_nvs.end()) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    g_nvs[name];
+    *handle = g_nvs_next_handle++;
+    g_nvs_handles[*handle] = name;
+    return ESP_OK;
+}
+
+inline void nvs_close(nvs_handle_t handle) {
+    g_nvs_handles.erase(handle);
+}
+
+inline const NvsValue* NvsFind(nvs_handle_t handle, const char* key, NvsType type) {
+    auto& keys = g_nvs[g_nvs_handles.at(handle)];
+    auto it = keys.find(key);
+    return it != keys.end() && it->second.type == type ? &it->second : nullptr;
+}
+
+inline esp_err_t NvsSet(nvs_handle_t handle, const char* key, NvsValue value) {
+    if (g_nvs_fail_key == key) {
+        return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+    }
+    g_nvs_sets++;
+    g_nvs[g_nvs_handles.at(handle)][key] = value;
+    if (g_nvs_on_set) {
+        g_nvs_on_set(key);
+    }
+    return ESP_OK;
+}
+
+inline esp_err_t nvs_get_str(nvs_handle_t handle, const char* key, char* out, size_t* length) {
+    auto value = NvsFind(handle, key, kNvsString);
+    if (value == nullptr) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    if (out != nullptr) {
+        if (*length < value->text.size() + 1) {
+            return ESP_ERR_NVS_INVALID_LENGTH;
+        }
+        memcpy(out, value->text.c_str(), value->text.size() + 1);
+    }
+    *length = value->text.size() + 1;
+    return ESP_OK;
+}
+
+inline esp_err_t nvs_get_i32(nvs_handle_t handle, const char* key, int32_t* out) {
+    auto value = NvsFind(handle, key, kNvsI32);
+    if (value == nullptr) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    *out = value->number;
+    return ESP_OK;
+}
+
+inline esp_err_t nvs_get_u8(nvs_handle_t handle, const char* key, uint8_t* out) {
+    auto value = NvsFind(handle, key, kNvsU8);
+    if (value == nullptr) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    *out = (uint8_t)value->number;
+    return ESP_OK;
+}
+
+inline esp_err_t nvs_set_str(nvs_handle_t handle, const char* key, const char* value) {
+    return NvsSet(handle, key, NvsValue{kNvsString, value, 0});
+}
+
+inline esp_err_t nvs_set_i32(nvs_handle_t handle, const char* key, int32_t value) {
+    return NvsSet(handle, key, NvsValue{kNvsI32, "", value});
+}
+
+inline esp_err_t nvs_set_u8(nvs_handle_t handle, const char* key, uint8_t value) {
+    return NvsSet(handle, key, NvsValue{kNvsU8, "", value});
+}
+
+inline esp_err_t nvs_erase_key(nvs_handle_t handle, const char* key) {
+    return g_nvs[g_nvs_handles.at(handle)].erase(key) > 0 ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+inline esp_err_t nvs_erase_all(nvs_handle_t handle) {
+    g_nvs[g_nvs_handles.at(handle)].clear();
+    return ESP_OK;
+}
+
+inline esp_err_t nvs_commit(nvs_handle_t handle) {
+    if (g_nvs_fail_commit) {
+        return ESP_FAIL;
+    }
+    g_nvs_commits++;
+    return ESP_OK;
+}
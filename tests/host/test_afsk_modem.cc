@@ -0,0 +1,184 @@
+// Modulates WiFi credentials the way scripts/sonic_wifi_config.html does, adds
+// white noise and runs the result through ReceiveWifiCredentialsFromAudio().
+// Sweeps the SNR for the legacy 100 bit/s AFSK and the fast 4-FSK mode.
+//
+//   test_afsk_modem [recording.wav]
+// decodes a 16 kHz 16-bit mono recording of the sender page instead.
+#include "host_test.h"
+#include "afsk_demod.h"
+
+#include <cmath>
+#include <cstring>
+#include <random>
+
+using namespace audio_wifi_config;
+
+#define INPUT_SAMPLE_RATE 16000
+#define TONE_AMPLITUDE 6000
+#define RUNS_PER_SNR 20
+
+static void AppendBits(std::vector<int>& bits, uint8_t byte) {
+    for (int i = 7; i >= 0; i--) {
+        bits.push_back((byte >> i) & 1);
+    }
+}
+
+// Start identifier, text, checksum, end identifier, one bit per 1/100 s
+static std::vector<float> ModulateLegacy(const std::string& text) {
+    std::vector<int> bits;
+    AppendBits(bits, 0x01);
+    AppendBits(bits, 0x02);
+    for (unsigned char c : text) {
+        AppendBits(bits, c);
+    }
+    AppendBits(bits, AudioDataBuffer::CalculateChecksum(text));
+    AppendBits(bits, 0x03);
+    AppendBits(bits, 0x04);
+
+    std::vector<float> signal;
+    int samples_per_bit = INPUT_SAMPLE_RATE / kBitRate;
+    for (size_t i = 0; i < bits.size(); i++) {
+        double frequency = bits[i] ? kMarkFrequency : kSpaceFrequency;
+        for (int j = 0; j < samples_per_bit; j++) {
+            signal.push_back(sin(2 * M_PI * frequency * (i * samples_per_bit + j) / INPUT_SAMPLE_RATE));
+        }
+    }
+    return signal;
+}
+
+// Preamble, sync word, length, text, checksum, each byte as two interleaved
+// Hamming(8,4) codewords, Gray coded tones. sample_rate skews the sender clock.
+static std::vector<float> ModulateFast(const std::string& text, double sample_rate = INPUT_SAMPLE_RATE) {
+    auto gray = [](int value) { return value ^ (value >> 1); };
+    std::vector<int> symbols;
+    for (int i = 0; i < 24; i++) {
+        symbols.push_back(i % 2 ? 3 : 0);
+    }
+    for (int i = 7; i >= 0; i--) {
+        symbols.push_back(gray((kMultiToneSyncWord >> (2 * i)) & 3));
+    }
+    std::vector<uint8_t> bytes = {(uint8_t)text.size()};
+    bytes.insert(bytes.end(), text.begin(), text.end());
+    bytes.push_back(AudioDataBuffer::CalculateChecksum(text));
+    for (auto byte : bytes) {
+        uint8_t high = MultiToneDataBuffer::EncodeHamming84(byte >> 4);
+        uint8_t low = MultiToneDataBuffer::EncodeHamming84(byte & 0x0f);
+        for (int j = 7; j >= 0; j--) {
+            symbols.push_back(gray((((high >> j) & 1) << 1) | ((low >> j) & 1)));
+        }
+    }
+    for (int i = 0; i < 4; i++) {
+        symbols.push_back(0);
+    }
+
+    std::vector<float> signal;
+    double phase = 0;
+    double position = 0;
+    double samples_per_symbol = sample_rate / kMultiToneSymbolRate;
+    for (int symbol : symbols) {
+        double frequency = kMultiToneBaseFrequency + kMultiToneSpacing * symbol;
+        position += samples_per_symbol;
+        int count = (int)position;
+        position -= count;
+        for (int j = 0; j < count; j++) {
+            phase += 2 * M_PI * frequency / sample_rate;
+            signal.push_back(sin(phase));
+        }
+    }
+    return signal;
+}
+
+static std::vector<int16_t> AddNoise(const std::vector<float>& signal, double snr_db, int lead_in, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::normal_distribution<double> normal(0, 1);
+    double noise = TONE_AMPLITUDE / sqrt(2) / pow(10, snr_db / 20);
+    auto sample = [](double value) { return (int16_t)std::max(-32768.0, std::min(32767.0, value)); };
+    std::vector<int16_t> input;
+    for (int i = 0; i < lead_in; i++) {
+        input.push_back(sample(noise * normal(rng)));
+    }
+    for (float x : signal) {
+        input.push_back(sample(TONE_AMPLITUDE * x + noise * normal(rng)));
+    }
+    for (int i = 0; i < INPUT_SAMPLE_RATE / 5; i++) {
+        input.push_back(sample(noise * normal(rng)));
+    }
+    return input;
+}
+
+// Returns the credentials the receive loop connected with, empty if none
+static std::string Receive(const std::vector<int16_t>& input) {
+    Application app;
+    WifiConfigurationAp wifi_ap;
+    Display display;
+    app.GetAudioService().input = &input;
+    try {
+        ReceiveWifiCredentialsFromAudio(&app, &wifi_ap, &display);
+    } catch (const AfskStop&) {
+    }
+    return wifi_ap.ssid.empty() ? "" : wifi_ap.ssid + "\n" + wifi_ap.password;
+}
+
+static void CheckHamming() {
+    for (uint8_t nibble = 0; nibble < 16; nibble++) {
+        uint8_t codeword = MultiToneDataBuffer::EncodeHamming84(nibble);
+        bool corrected = true;
+        CHECK(MultiToneDataBuffer::DecodeHamming84(codeword, &corrected) == nibble && !corrected);
+        for (int bit = 0; bit < 8; bit++) {
+            CHECK(MultiToneDataBuffer::DecodeHamming84(codeword ^ (1 << bit), &corrected) == nibble && corrected);
+        }
+    }
+}
+
+static int DecodeWav(const char* path) {
+    auto file = ReadFile(path);
+    if (file.size() < 44 || memcmp(file.data(), "RIFF", 4) != 0) {
+        fprintf(stderr, "%s is not a WAV file\n", path);
+        return 1;
+    }
+    // Assumes the canonical 44 byte header
+    std::vector<int16_t> input((file.size() - 44) / 2);
+    memcpy(input.data(), file.data() + 44, input.size() * 2);
+    auto text = Receive(input);
+    printf("%s\n", text.empty() ? "nothing decoded" : text.c_str());
+    return text.empty() ? 1 : 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1) {
+        return DecodeWav(argv[1]);
+    }
+    CheckHamming();
+
+    const std::string text = "MyHomeWiFi-2.4G\nsecret_pass_1234!";
+    auto legacy = ModulateLegacy(text);
+    auto fast = ModulateFast(text);
+    // A sender clock 0.1% off either way
+    auto fast_slow = ModulateFast(text, INPUT_SAMPLE_RATE * 1.001);
+    auto fast_quick = ModulateFast(text, INPUT_SAMPLE_RATE * 0.999);
+    printf("legacy %.2f s, fast %.2f s on air\n", legacy.size() / (double)INPUT_SAMPLE_RATE,
+        fast.size() / (double)INPUT_SAMPLE_RATE);
+
+    for (double snr : {30.0, 10.0, 6.0, 3.0, 0.0}) {
+        int legacy_ok = 0, fast_ok = 0, skewed_ok = 0;
+        for (int run = 0; run < RUNS_PER_SNR; run++) {
+            // Lead-in varies the bit alignment
+            int lead_in = run * 37;
+            legacy_ok += Receive(AddNoise(legacy, snr, lead_in, run)) == text;
+            fast_ok += Receive(AddNoise(fast, snr, lead_in, run)) == text;
+            skewed_ok += Receive(AddNoise(fast_slow, snr, lead_in, run)) == text;
+            skewed_ok += Receive(AddNoise(fast_quick, snr, lead_in, run)) == text;
+        }
+        printf("SNR %4.1f dB: legacy %2d/%d, fast %2d/%d, fast with skewed clock %2d/%d\n", snr,
+            legacy_ok, RUNS_PER_SNR, fast_ok, RUNS_PER_SNR, skewed_ok, 2 * RUNS_PER_SNR);
+        // Legacy has no timing recovery, some alignments lose it even without noise
+        if (snr >= 10) {
+            CHECK(legacy_ok >= RUNS_PER_SNR / 2);
+        }
+        if (snr >= 3) {
+            CHECK(fast_ok == RUNS_PER_SNR);
+            CHECK(skewed_ok == 2 * RUNS_PER_SNR);
+        }
+    }
+    return HOST_TEST_RESULT();
+}
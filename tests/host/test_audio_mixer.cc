@@ -0,0 +1,183 @@
+// AudioMixer on constant signals, so every output sample can be computed: a gain
+// change ramps linearly in Q15 over AUDIO_MIXER_RAMP_MS whatever the read size,
+// a notification ducks the speech to 30% and lets it back up once it ran out,
+// and sums beyond 16 bits saturate instead of wrapping.
+#include "host_test.h"
+#include "audio_mixer.h"
+
+#include <algorithm>
+#include <vector>
+
+#define SAMPLE_RATE 16000
+#define RAMP_SAMPLES (SAMPLE_RATE * AUDIO_MIXER_RAMP_MS / 1000)
+#define SPEECH 0
+#define NOTIFICATION 1
+#define FRAME_SAMPLES 160
+#define ROUNDS 1000
+
+static std::vector<int16_t> Constant(int16_t value, size_t samples) {
+    return std::vector<int16_t>(samples, value);
+}
+
+// Reads everything in pieces of piece samples
+static std::vector<int16_t> ReadAll(AudioMixer& mixer, size_t piece) {
+    std::vector<int16_t> out;
+    std::vector<int16_t> buffer(piece);
+    size_t n;
+    while ((n = mixer.Read(buffer.data(), piece)) > 0) {
+        out.insert(out.end(), buffer.begin(), buffer.begin() + n);
+    }
+    return out;
+}
+
+// What a Q15 ramp from start to target gives for value, j samples into the ramp
+static int16_t Ramped(int16_t value, int32_t start, int32_t target, size_t j) {
+    int32_t gain = j < RAMP_SAMPLES ? start + (int32_t)((int64_t)(target - start) * (int64_t)j / RAMP_SAMPLES) : target;
+    return (int16_t)(value * gain >> 15);
+}
+
+static void TestGainRamp() {
+    const int16_t value = 20000;
+    const int32_t half = 50 * (1 << 15) / 100;
+    for (size_t piece : { (size_t)1, (size_t)7, (size_t)FRAME_SAMPLES, (size_t)RAMP_SAMPLES, (size_t)1000 }) {
+        AudioMixer mixer;
+        mixer.SetSampleRate(SAMPLE_RATE);
+        auto pcm = Constant(value, 2000);
+        mixer.Write(SPEECH, pcm.data(), pcm.size());
+
+        // Unity gain passes the samples through
+        std::vector<int16_t> head(100);
+        CHECK(mixer.Read(head.data(), head.size()) == head.size());
+        CHECK(std::all_of(head.begin(), head.end(), [&](int16_t s) { return s == value; }));
+
+        mixer.SetGain(SPEECH, 50);
+        auto out = ReadAll(mixer, piece);
+        CHECK(out.size() == pcm.size() - head.size());
+        int wrong = 0;
+        for (size_t j = 0; j < out.size(); j++) {
+            wrong += out[j] != Ramped(value, 1 << 15, half, j);
+        }
+        if (wrong > 0) {
+            fprintf(stderr, "Reads of %u samples: %d samples off the ramp\n", (unsigned)piece, wrong);
+        }
+        CHECK(wrong == 0);
+        CHECK(out.back() == value / 2);
+    }
+
+    // Back to unity in the middle of the ramp: it turns around from where it is
+    AudioMixer mixer;
+    mixer.SetSampleRate(SAMPLE_RATE);
+    auto pcm = Constant(value, 2000);
+    mixer.Write(SPEECH, pcm.data(), pcm.size());
+    std::vector<int16_t> out(RAMP_SAMPLES / 2);
+    mixer.Read(out.data(), 1);
+    mixer.SetGain(SPEECH, 0);
+    mixer.Read(out.data(), out.size());
+    int32_t reached = (1 << 15) - (int32_t)((int64_t)(1 << 15) * (int64_t)out.size() / RAMP_SAMPLES);
+    CHECK(out.back() == Ramped(value, 1 << 15, 0, out.size() - 1));
+    mixer.SetGain(SPEECH, 100);
+    auto rest = ReadAll(mixer, FRAME_SAMPLES);
+    CHECK(rest[0] == (int16_t)(value * reached >> 15));
+    CHECK(std::is_sorted(rest.begin(), rest.end()) && rest.back() == value);
+    // Unity again once the ramp is done
+    mixer.Write(SPEECH, pcm.data(), 10);
+    CHECK(mixer.Read(out.data(), 10) == 10 && out[0] == value);
+}
+
+static void TestDucking() {
+    const int16_t speech = 10000;
+    const int16_t chime = 1000;
+    const int32_t ducked = 30 * (1 << 15) / 100;
+    AudioMixer mixer;
+    mixer.SetSampleRate(SAMPLE_RATE);
+    mixer.SetDucking(NOTIFICATION, 30);
+
+    auto speech_pcm = Constant(speech, 4000);
+    auto chime_pcm = Constant(chime, 1600);
+    mixer.Write(SPEECH, speech_pcm.data(), speech_pcm.size());
+    std::vector<int16_t> out(FRAME_SAMPLES);
+    mixer.Read(out.data(), out.size());
+    CHECK(out[0] == speech && out.back() == speech);
+
+    // The chime plays at its own gain, the speech goes down to 30%
+    mixer.Write(NOTIFICATION, chime_pcm.data(), chime_pcm.size());
+    std::vector<int16_t> during;
+    for (size_t i = 0; i < chime_pcm.size(); i += FRAME_SAMPLES) {
+        mixer.Read(out.data(), out.size());
+        during.insert(during.end(), out.begin(), out.end());
+    }
+    int wrong = 0;
+    for (size_t j = 0; j < during.size(); j++) {
+        wrong += during[j] != Ramped(speech, 1 << 15, ducked, j) + chime;
+    }
+    CHECK(wrong == 0);
+    CHECK(during.back() == (speech * ducked >> 15) + chime);
+    printf("Ducked to 30%%: %d + %d over %d samples, then %d\n", speech, chime, RAMP_SAMPLES, during.back());
+
+    // Once the chime ran out the speech ramps back up
+    CHECK(mixer.Available(NOTIFICATION) == 0);
+    auto after = ReadAll(mixer, FRAME_SAMPLES);
+    wrong = 0;
+    for (size_t j = 0; j < after.size(); j++) {
+        wrong += after[j] != Ramped(speech, ducked, 1 << 15, j);
+    }
+    CHECK(wrong == 0);
+    CHECK(after.back() == speech);
+}
+
+static void TestSaturation() {
+    AudioMixer mixer;
+    mixer.SetSampleRate(SAMPLE_RATE);
+    int16_t loud[] = { 30000, -30000, 20000, -20000, 16384, INT16_MAX, INT16_MIN };
+    int16_t other[] = { 30000, -30000, 20000, -20000, 16384, INT16_MAX, INT16_MIN };
+    int16_t expected[] = { INT16_MAX, INT16_MIN, INT16_MAX, INT16_MIN, INT16_MAX, INT16_MAX, INT16_MIN };
+    mixer.Write(SPEECH, loud, 7);
+    mixer.Write(NOTIFICATION, other, 7);
+    int16_t out[7];
+    CHECK(mixer.Read(out, 7) == 7);
+    CHECK(std::equal(out, out + 7, expected));
+
+    // Four full scale voices, no wrap around
+    for (int voice = 0; voice < AUDIO_MIXER_MAX_VOICES; voice++) {
+        auto pcm = Constant(voice % 2 ? INT16_MIN : INT16_MAX, 100);
+        mixer.Write(voice, pcm.data(), pcm.size());
+    }
+    auto mixed = ReadAll(mixer, 33);
+    CHECK(mixed.size() == 100);
+    CHECK(std::all_of(mixed.begin(), mixed.end(), [](int16_t s) { return s == -2; }));
+
+    // Cancelling voices do not clip
+    int16_t up[] = { 25000 };
+    int16_t down[] = { -24000 };
+    mixer.Write(SPEECH, up, 1);
+    mixer.Write(NOTIFICATION, down, 1);
+    CHECK(mixer.Read(out, 1) == 1 && out[0] == 1000);
+}
+
+static void Bench() {
+    AudioMixer mixer;
+    mixer.SetSampleRate(SAMPLE_RATE);
+    mixer.SetDucking(NOTIFICATION, 30);
+    auto speech = Constant(8000, FRAME_SAMPLES);
+    auto chime = Constant(-3000, FRAME_SAMPLES);
+    std::vector<int16_t> out(FRAME_SAMPLES);
+    int64_t checksum = 0;
+    int64_t start = HostNowUs();
+    for (int i = 0; i < ROUNDS; i++) {
+        mixer.Write(SPEECH, speech.data(), speech.size());
+        mixer.Write(NOTIFICATION, chime.data(), chime.size());
+        mixer.Read(out.data(), out.size());
+        checksum += out[0];
+    }
+    double us = (double)(HostNowUs() - start) / ROUNDS;
+    printf("Two voices, %d ms frame mixed in %.2f us on the host\n", FRAME_SAMPLES * 1000 / SAMPLE_RATE, us);
+    CHECK(checksum != 0);
+}
+
+int main() {
+    TestGainRamp();
+    TestDucking();
+    TestSaturation();
+    Bench();
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,99 @@
+// Applies a patch made by scripts/ota_delta.py with DeltaPatcher and compares
+// the result with the target image, for several network read sizes. The
+// images come from make_delta_images.py, see CMakeLists.txt.
+//
+//   test_delta_patcher old.bin new.bin patch.bin
+#include "host_test.h"
+#include "delta_patcher.h"
+
+#include <mbedtls/sha256.h>
+
+#include <algorithm>
+#include <cstring>
+
+static bool Apply(const std::vector<uint8_t>& source, const std::vector<uint8_t>& patch, size_t read_size,
+    std::vector<uint8_t>& target) {
+    DeltaPatchHeader header;
+    if (!DeltaPatcher::ParseHeader(patch.data(), patch.size(), header)) {
+        return false;
+    }
+    target.clear();
+    DeltaPatcher patcher(header,
+        [&source](size_t offset, uint8_t* data, size_t size) {
+            if (offset + size > source.size()) {
+                return false;
+            }
+            memcpy(data, source.data() + offset, size);
+            return true;
+        },
+        [&target](const uint8_t* data, size_t size) {
+            target.insert(target.end(), data, data + size);
+            return true;
+        });
+    if (!patcher.Initialize()) {
+        return false;
+    }
+    for (size_t offset = DELTA_PATCH_HEADER_SIZE; offset < patch.size(); offset += read_size) {
+        if (!patcher.Feed(patch.data() + offset, std::min(read_size, patch.size() - offset))) {
+            return false;
+        }
+    }
+    return patcher.Finish();
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 4) {
+        fprintf(stderr, "usage: %s old.bin new.bin patch.bin\n", argv[0]);
+        return 1;
+    }
+    auto source = ReadFile(argv[1]);
+    auto expected = ReadFile(argv[2]);
+    auto patch = ReadFile(argv[3]);
+    CHECK(!source.empty() && !expected.empty() && patch.size() > DELTA_PATCH_HEADER_SIZE);
+
+    DeltaPatchHeader header;
+    CHECK(DeltaPatcher::ParseHeader(patch.data(), patch.size(), header));
+    CHECK(header.source_size == source.size() && header.target_size == expected.size());
+    uint8_t digest[32];
+    mbedtls_sha256(source.data(), source.size(), digest, 0);
+    CHECK(memcmp(digest, header.source_sha256, sizeof(digest)) == 0);
+    mbedtls_sha256(expected.data(), expected.size(), digest, 0);
+    CHECK(memcmp(digest, header.target_sha256, sizeof(digest)) == 0);
+
+    // From single bytes to a TCP segment to the whole body at once
+    std::vector<uint8_t> target;
+    for (size_t read_size : {(size_t)1, (size_t)7, (size_t)1460, (size_t)4096, patch.size()}) {
+        bool ok = Apply(source, patch, read_size, target);
+        CHECK(ok && target == expected);
+        if (!ok || target != expected) {
+            fprintf(stderr, "read size %zu: %zu of %zu bytes\n", read_size, target.size(), expected.size());
+        }
+    }
+
+    // A flipped byte in the compressed body is caught by inflate or the target hash
+    auto corrupt = patch;
+    corrupt[DELTA_PATCH_HEADER_SIZE + (corrupt.size() - DELTA_PATCH_HEADER_SIZE) / 2] ^= 0x10;
+    if (Apply(source, corrupt, 4096, target)) {
+        mbedtls_sha256(target.data(), target.size(), digest, 0);
+        CHECK(memcmp(digest, header.target_sha256, sizeof(digest)) != 0);
+    }
+    // A truncated patch never completes
+    std::vector<uint8_t> truncated(patch.begin(), patch.begin() + patch.size() / 2);
+    CHECK(!Apply(source, truncated, 4096, target));
+    // Nor does one applied to a shorter source
+    std::vector<uint8_t> short_source(source.begin(), source.begin() + source.size() / 2);
+    CHECK(!Apply(short_source, patch, 4096, target));
+    auto bad_magic = patch;
+    bad_magic[0] = 'Y';
+    CHECK(!DeltaPatcher::ParseHeader(bad_magic.data(), bad_magic.size(), header));
+
+    const int rounds = 20;
+    auto start = HostNowUs();
+    for (int i = 0; i < rounds; i++) {
+        Apply(source, patch, 1460, target);
+    }
+    auto elapsed_us = HostNowUs() - start;
+    printf("%zu byte target from a %zu byte patch (%.1f%%), applied at %.1f MB/s\n", expected.size(), patch.size(),
+        100.0 * patch.size() / expected.size(), (double)expected.size() * rounds / elapsed_us);
+    return HOST_TEST_RESULT();
+}
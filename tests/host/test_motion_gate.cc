@@ -0,0 +1,310 @@
+// MotionGate over JPEG sequences polled every 5 s, decoded through the
+// esp_new_jpeg API on libjpeg. The built-in sequence is rendered and encoded
+// here: an empty room with sensor noise, the IR light switching on, a person
+// walking in, lying still on the floor and leaving, then a long quiet stretch.
+// Checks which frames are uploaded and reports the uploads avoided, and times
+// the grayscale scaled decode against the full RGB565 decode it replaced
+// (copied below from the previous motion_gate.cc).
+//
+// Recorded sequences can be replayed too, one directory of JPEG files per
+// argument, in file name order: test_motion_gate <dir>...
+#include "host_test.h"
+#include "motion_gate.h"
+
+#include <esp_jpeg_dec.h>
+
+#include <algorithm>
+#include <cmath>
+#include <dirent.h>
+#include <functional>
+#include <random>
+
+#define POLL_MS 5000
+#define QUALITY 75
+
+struct Scene {
+    int width = 640;
+    int height = 480;
+    double light = 1.0;
+    // Infrared night mode, no colour
+    bool infrared = false;
+    // Person as a box, -1 when nobody is there
+    int person_x = -1;
+    int person_y = 0;
+    int person_width = 0;
+    int person_height = 0;
+};
+
+static std::string EncodeJpeg(const std::vector<uint8_t>& rgb, int width, int height) {
+    jpeg_compress_struct info;
+    jpeg_error_mgr error;
+    info.err = jpeg_std_error(&error);
+    jpeg_create_compress(&info);
+    unsigned char* buffer = nullptr;
+    unsigned long size = 0;
+    jpeg_mem_dest(&info, &buffer, &size);
+    info.image_width = width;
+    info.image_height = height;
+    info.input_components = 3;
+    info.in_color_space = JCS_RGB;
+    jpeg_set_defaults(&info);
+    jpeg_set_quality(&info, QUALITY, TRUE);
+    jpeg_start_compress(&info, TRUE);
+    while (info.next_scanline < info.image_height) {
+        JSAMPROW row = (JSAMPROW)rgb.data() + (size_t)info.next_scanline * width * 3;
+        jpeg_write_scanlines(&info, &row, 1);
+    }
+    jpeg_finish_compress(&info);
+    jpeg_destroy_compress(&info);
+    std::string jpeg((const char*)buffer, size);
+    free(buffer);
+    return jpeg;
+}
+
+// A wall, a floor, a window and a sofa, with sensor noise on every frame
+static std::string Render(const Scene& scene, std::mt19937& random) {
+    std::normal_distribution<double> noise(0, 4);
+    std::vector<uint8_t> rgb((size_t)scene.width * scene.height * 3);
+    for (int y = 0; y < scene.height; y++) {
+        for (int x = 0; x < scene.width; x++) {
+            double fx = (double)x / scene.width;
+            double fy = (double)y / scene.height;
+            double r = 170 - 40 * fy, g = 160 - 40 * fy, b = 140 - 30 * fy;
+            if (fy > 0.65) {
+                r = 120; g = 90; b = 60;
+            }
+            if (fx > 0.1 && fx < 0.3 && fy > 0.15 && fy < 0.45) {
+                r = 200; g = 220; b = 240;
+            }
+            if (fx > 0.55 && fx < 0.9 && fy > 0.5 && fy < 0.75) {
+                r = 60; g = 80; b = 130;
+            }
+            if (scene.person_x >= 0 && x >= scene.person_x && x < scene.person_x + scene.person_width &&
+                y >= scene.person_y && y < scene.person_y + scene.person_height) {
+                r = 235; g = 235; b = 225;
+            }
+            if (scene.infrared) {
+                r = g = b = 0.3 * r + 0.6 * g + 0.1 * b;
+            }
+            uint8_t* pixel = &rgb[((size_t)y * scene.width + x) * 3];
+            double n = noise(random);
+            pixel[0] = (uint8_t)std::clamp(r * scene.light + n, 0.0, 255.0);
+            pixel[1] = (uint8_t)std::clamp(g * scene.light + n, 0.0, 255.0);
+            pixel[2] = (uint8_t)std::clamp(b * scene.light + n, 0.0, 255.0);
+        }
+    }
+    return EncodeJpeg(rgb, scene.width, scene.height);
+}
+
+// The previous thumbnail: full RGB565 decode, then a box filter with the luma taken per pixel
+static bool ReferenceThumbnail(const std::string& jpeg_data, uint8_t* thumbnail) {
+    const size_t cells = MOTION_GATE_GRID_WIDTH * MOTION_GATE_GRID_HEIGHT;
+    jpeg_dec_config_t dec_cfg = {};
+    dec_cfg.output_type = JPEG_PIXEL_FORMAT_RGB565_LE;
+    dec_cfg.rotate = JPEG_ROTATE_0D;
+    jpeg_dec_handle_t dec = nullptr;
+    if (jpeg_dec_open(&dec_cfg, &dec) != JPEG_ERR_OK) {
+        return false;
+    }
+    jpeg_dec_io_t io = {};
+    io.inbuf = (uint8_t*)jpeg_data.data();
+    io.inbuf_len = jpeg_data.size();
+    jpeg_dec_header_info_t header = {};
+    if (jpeg_dec_parse_header(dec, &io, &header) != JPEG_ERR_OK) {
+        jpeg_dec_close(dec);
+        return false;
+    }
+    int width = header.width;
+    int height = header.height;
+    std::vector<uint16_t> rgb((size_t)width * height);
+    io.outbuf = (uint8_t*)rgb.data();
+    io.out_size = rgb.size() * 2;
+    bool ok = jpeg_dec_process(dec, &io) == JPEG_ERR_OK;
+    jpeg_dec_close(dec);
+    if (!ok) {
+        return false;
+    }
+    std::vector<uint32_t> sums(cells, 0);
+    std::vector<uint32_t> counts(cells, 0);
+    for (int y = 0; y < height; y++) {
+        const uint16_t* row = rgb.data() + (size_t)y * width;
+        uint32_t* row_sums = sums.data() + (y * MOTION_GATE_GRID_HEIGHT / height) * MOTION_GATE_GRID_WIDTH;
+        uint32_t* row_counts = counts.data() + (y * MOTION_GATE_GRID_HEIGHT / height) * MOTION_GATE_GRID_WIDTH;
+        for (int x = 0; x < width; x++) {
+            uint16_t pixel = row[x];
+            uint32_t r = (pixel >> 11) << 3;
+            uint32_t g = ((pixel >> 5) & 0x3F) << 2;
+            uint32_t b = (pixel & 0x1F) << 3;
+            int cell = x * MOTION_GATE_GRID_WIDTH / width;
+            row_sums[cell] += (77 * r + 150 * g + 29 * b) >> 8;
+            row_counts[cell]++;
+        }
+    }
+    for (size_t i = 0; i < cells; i++) {
+        thumbnail[i] = (uint8_t)(sums[i] / counts[i]);
+    }
+    return true;
+}
+
+struct Phase {
+    const char* name;
+    int frames;
+    int uploads;
+};
+
+// Returns the uploads of every phase of the built-in sequence
+static std::vector<Phase> RunSequence(int width, int height, double& decode_us, double& reference_us,
+    int& decisions_differ) {
+    std::mt19937 random(11);
+    MotionGate gate;
+    MotionGate reference_gate;
+    int64_t now_ms = 0;
+    std::vector<Phase> phases;
+    decode_us = reference_us = 0;
+    decisions_differ = 0;
+    int frames = 0;
+
+    auto play = [&](const char* name, int count, const std::function<void(Scene&, int)>& update) {
+        Phase phase = {name, count, 0};
+        for (int i = 0; i < count; i++) {
+            Scene scene;
+            scene.width = width;
+            scene.height = height;
+            update(scene, i);
+            std::string jpeg = Render(scene, random);
+            now_ms += POLL_MS;
+
+            int64_t start = HostNowUs();
+            bool upload = gate.ShouldAnalyze(jpeg, now_ms);
+            decode_us += HostNowUs() - start;
+            phase.uploads += upload;
+
+            uint8_t thumbnail[MOTION_GATE_GRID_WIDTH * MOTION_GATE_GRID_HEIGHT];
+            start = HostNowUs();
+            CHECK(ReferenceThumbnail(jpeg, thumbnail));
+            reference_us += HostNowUs() - start;
+            decisions_differ += reference_gate.ShouldAnalyze(thumbnail, now_ms) != upload;
+            frames++;
+        }
+        phases.push_back(phase);
+    };
+
+    int person_width = width / 10;
+    int person_height = height * 4 / 10;
+    auto standing = [&](Scene& scene, int x) {
+        scene.person_x = x;
+        scene.person_y = height / 3;
+        scene.person_width = person_width;
+        scene.person_height = person_height;
+    };
+    play("empty room", 40, [](Scene&, int) {});
+    play("lights dimmed", 10, [](Scene& scene, int) { scene.light = 0.7; });
+    play("infrared on", 10, [](Scene& scene, int) { scene.light = 0.7; scene.infrared = true; });
+    play("walking in", 6, [&](Scene& scene, int i) {
+        scene.light = 0.7;
+        scene.infrared = true;
+        standing(scene, width / 20 + i * width / 8);
+    });
+    play("lying still", 30, [&](Scene& scene, int) {
+        scene.light = 0.7;
+        scene.infrared = true;
+        scene.person_x = width / 2;
+        scene.person_y = height * 3 / 4;
+        scene.person_width = person_height;
+        scene.person_height = person_width;
+    });
+    play("leaving", 3, [&](Scene& scene, int i) {
+        scene.light = 0.7;
+        scene.infrared = true;
+        standing(scene, width / 2 + i * width / 7);
+    });
+    play("empty room again", 70, [](Scene& scene, int) { scene.light = 0.7; scene.infrared = true; });
+
+    decode_us /= frames;
+    reference_us /= frames;
+    return phases;
+}
+
+static void TestSequence(int width, int height) {
+    double decode_us, reference_us;
+    int decisions_differ;
+    auto phases = RunSequence(width, height, decode_us, reference_us, decisions_differ);
+    int frames = 0, uploads = 0;
+    printf("%dx%d, polled every %d s:\n", width, height, POLL_MS / 1000);
+    for (const auto& phase : phases) {
+        printf("  %-18s %3d frames, %2d uploaded\n", phase.name, phase.frames, phase.uploads);
+        frames += phase.frames;
+        uploads += phase.uploads;
+    }
+    printf("  %d of %d uploads avoided (%.0f%%), decode %.0f us per frame (%.0f us with the full RGB565 decode), "
+        "%d decisions differ from it\n", frames - uploads, frames, 100.0 * (frames - uploads) / frames, decode_us,
+        reference_us, decisions_differ);
+
+    // The first frame, never the noise. Only the mean brightness is taken out, dimming
+    // changes the contrast and may cost one upload, the IR switch none
+    CHECK(phases[0].uploads == 1);
+    CHECK(phases[1].uploads <= 1);
+    CHECK(phases[2].uploads == 0);
+    // Every step of somebody walking
+    CHECK(phases[3].uploads == phases[3].frames);
+    // The fall once, not every poll while nothing moves
+    CHECK(phases[4].uploads >= 1 && phases[4].uploads <= 2);
+    CHECK(phases[5].uploads == phases[5].frames);
+    // The room empty again, then only the forced upload every MOTION_GATE_FORCE_INTERVAL_MS
+    CHECK(phases[6].uploads == 70 * POLL_MS / MOTION_GATE_FORCE_INTERVAL_MS + 1);
+    CHECK(decisions_differ == 0);
+}
+
+static void TestUndecodable() {
+    MotionGate gate;
+    std::mt19937 random(1);
+    Scene scene;
+    CHECK(gate.ShouldAnalyze(Render(scene, random), POLL_MS));
+    CHECK(!gate.ShouldAnalyze(Render(scene, random), 2 * POLL_MS));
+    // What cannot be looked at is uploaded, and does not move the references
+    CHECK(gate.ShouldAnalyze(std::string("not a jpeg"), 3 * POLL_MS));
+    std::string truncated = Render(scene, random).substr(0, 300);
+    CHECK(gate.ShouldAnalyze(truncated, 4 * POLL_MS));
+    CHECK(!gate.ShouldAnalyze(Render(scene, random), 5 * POLL_MS));
+    Scene tiny;
+    tiny.width = 16;
+    tiny.height = 16;
+    CHECK(gate.ShouldAnalyze(Render(tiny, random), 6 * POLL_MS));
+}
+
+static void ReplayDirectory(const std::string& path) {
+    std::vector<std::string> files;
+    if (auto dir = opendir(path.c_str())) {
+        while (auto entry = readdir(dir)) {
+            std::string name = entry->d_name;
+            auto dot = name.rfind('.');
+            if (dot != std::string::npos && (name.substr(dot) == ".jpg" || name.substr(dot) == ".jpeg")) {
+                files.push_back(path + "/" + name);
+            }
+        }
+        closedir(dir);
+    }
+    std::sort(files.begin(), files.end());
+    MotionGate gate;
+    int64_t now_ms = 0;
+    int uploads = 0;
+    for (const auto& file : files) {
+        auto data = ReadFile(file);
+        uploads += gate.ShouldAnalyze(std::string(data.begin(), data.end()), now_ms += POLL_MS);
+    }
+    printf("%s: %d of %u uploads avoided\n", path.c_str(), (int)files.size() - uploads, (unsigned)files.size());
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1) {
+        for (int i = 1; i < argc; i++) {
+            ReplayDirectory(argv[i]);
+        }
+        return 0;
+    }
+    // 640x480 is decoded at 1/8, 480x270 cannot be scaled to multiples of 8
+    TestSequence(640, 480);
+    TestSequence(480, 270);
+    TestUndecodable();
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,177 @@
+// NoAudioCodec::Write() and Read() against the conversion loops they replaced
+// (copied below from the previous no_audio_codec.cc): the I2S words written and
+// the samples read must be identical for every volume, frame length and input
+// range. Also times both versions per frame.
+#include "host_test.h"
+#include "audio/codecs/no_audio_codec.h"
+
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+// AudioCodec without the settings and the board
+AudioCodec::AudioCodec() {}
+AudioCodec::~AudioCodec() {}
+void AudioCodec::SetOutputVolume(int volume) { output_volume_ = volume; }
+void AudioCodec::EnableInput(bool enable) { input_enabled_ = enable; }
+void AudioCodec::EnableOutput(bool enable) { output_enabled_ = enable; }
+void AudioCodec::OutputData(std::vector<int16_t>& data) { Write(data.data(), data.size()); }
+bool AudioCodec::InputData(std::vector<int16_t>& data) { return Read(data.data(), data.size()) > 0; }
+void AudioCodec::Start() {}
+
+static std::vector<int32_t> ReferenceWrite(const int16_t* data, int samples, int output_volume) {
+    std::vector<int32_t> buffer(samples);
+
+    // output_volume_: 0-100
+    // volume_factor_: 0-65536
+    int32_t volume_factor = pow(double(output_volume) / 100.0, 2) * 65536;
+    for (int i = 0; i < samples; i++) {
+        int64_t temp = int64_t(data[i]) * volume_factor; // 使用 int64_t 进行乘法运算
+        if (temp > INT32_MAX) {
+            buffer[i] = INT32_MAX;
+        } else if (temp < INT32_MIN) {
+            buffer[i] = INT32_MIN;
+        } else {
+            buffer[i] = static_cast<int32_t>(temp);
+        }
+    }
+    return buffer;
+}
+
+static void ReferenceRead(const int32_t* bit32_buffer, int16_t* dest, int samples) {
+    for (int i = 0; i < samples; i++) {
+        int32_t value = bit32_buffer[i] >> 12;
+        dest[i] = (value > INT16_MAX) ? INT16_MAX : (value < -INT16_MAX) ? -INT16_MAX : (int16_t)value;
+    }
+}
+
+class TestCodec : public NoAudioCodecDuplex {
+public:
+    TestCodec() : NoAudioCodecDuplex(16000, 24000, GPIO_NUM_0, GPIO_NUM_1, GPIO_NUM_2, GPIO_NUM_3) {}
+
+    using NoAudioCodec::Read;
+    using NoAudioCodec::Write;
+
+    // Bypasses SetOutputVolume() like AudioCodec::Start() restoring the setting
+    void SetVolumeDirectly(int volume) { output_volume_ = volume; }
+};
+
+static std::vector<int32_t> g_written;
+static const std::vector<int32_t>* g_to_read = nullptr;
+
+static std::vector<int16_t> RandomSamples(std::mt19937& rng, size_t count) {
+    std::vector<int16_t> samples(count);
+    for (auto& sample : samples) {
+        sample = (int16_t)rng();
+    }
+    // The extremes are where saturation differs
+    if (count >= 3) {
+        samples[0] = INT16_MIN;
+        samples[1] = INT16_MAX;
+        samples[2] = -1;
+    }
+    return samples;
+}
+
+static void CheckWrite(TestCodec& codec, std::mt19937& rng) {
+    for (int volume = 0; volume <= 130; volume++) {
+        // Alternate the two ways the volume gets set
+        if (volume % 2 == 0) {
+            codec.SetOutputVolume(volume);
+        } else {
+            codec.SetVolumeDirectly(volume);
+        }
+        for (int samples : {0, 1, 3, 4, 5, 240, 961}) {
+            auto input = RandomSamples(rng, samples);
+            g_written.clear();
+            CHECK(codec.Write(input.data(), samples) == samples);
+            auto expected = ReferenceWrite(input.data(), samples, volume);
+            if (g_written != expected) {
+                fprintf(stderr, "Write differs at volume %d, %d samples\n", volume, samples);
+                CHECK(g_written == expected);
+            }
+        }
+    }
+}
+
+static void CheckRead(TestCodec& codec, std::mt19937& rng) {
+    for (int samples : {1, 3, 4, 5, 240, 961, 4003}) {
+        std::vector<int32_t> words(samples);
+        for (auto& word : words) {
+            word = (int32_t)rng();
+        }
+        const int32_t extremes[] = {INT32_MIN, INT32_MAX, -(32768 << 12), 32767 << 12, (32768 << 12) - 1, -1, 0};
+        for (size_t i = 0; i < sizeof(extremes) / sizeof(extremes[0]) && i < words.size(); i++) {
+            words[i] = extremes[i];
+        }
+        g_to_read = &words;
+        std::vector<int16_t> output(samples), expected(samples);
+        CHECK(codec.Read(output.data(), samples) == samples);
+        ReferenceRead(words.data(), expected.data(), samples);
+        if (output != expected) {
+            fprintf(stderr, "Read differs for %d samples\n", samples);
+            CHECK(output == expected);
+        }
+    }
+}
+
+static void Benchmark(TestCodec& codec, std::mt19937& rng) {
+    const int frame = 960;
+    const int rounds = 20000;
+    auto input = RandomSamples(rng, frame);
+    codec.SetOutputVolume(80);
+
+    auto start = HostNowUs();
+    for (int i = 0; i < rounds; i++) {
+        codec.Write(input.data(), frame);
+    }
+    double write_us = (double)(HostNowUs() - start) / rounds;
+    start = HostNowUs();
+    size_t sink = 0;
+    for (int i = 0; i < rounds; i++) {
+        sink += ReferenceWrite(input.data(), frame, 80)[i % frame];
+    }
+    double reference_write_us = (double)(HostNowUs() - start) / rounds;
+
+    std::vector<int32_t> words(frame);
+    for (auto& word : words) {
+        word = (int32_t)rng();
+    }
+    g_to_read = &words;
+    std::vector<int16_t> output(frame);
+    start = HostNowUs();
+    for (int i = 0; i < rounds; i++) {
+        codec.Read(output.data(), frame);
+    }
+    double read_us = (double)(HostNowUs() - start) / rounds;
+    start = HostNowUs();
+    for (int i = 0; i < rounds; i++) {
+        std::vector<int32_t> buffer(words);
+        ReferenceRead(buffer.data(), output.data(), frame);
+        sink += output[i % frame];
+    }
+    double reference_read_us = (double)(HostNowUs() - start) / rounds;
+    printf("%d samples per frame: write %.2f us (previous %.2f us), read %.2f us (previous %.2f us) (%zu)\n",
+        frame, write_us, reference_write_us, read_us, reference_read_us, sink & 1);
+}
+
+int main() {
+    i2s_host_write = [](i2s_chan_handle_t handle, const void* data, size_t size) {
+        auto words = (const int32_t*)data;
+        g_written.assign(words, words + size / sizeof(int32_t));
+        return size;
+    };
+    i2s_host_read = [](i2s_chan_handle_t handle, void* data, size_t size) {
+        size = std::min(size, g_to_read->size() * sizeof(int32_t));
+        memcpy(data, g_to_read->data(), size);
+        return size;
+    };
+
+    std::mt19937 rng(7);
+    TestCodec codec;
+    CheckWrite(codec, rng);
+    CheckRead(codec, rng);
+    Benchmark(codec, rng);
+    return HOST_TEST_RESULT();
+}
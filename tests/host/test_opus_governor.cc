@@ -0,0 +1,220 @@
+// OpusEncodeGovernor against a model of the encoder on an ESP32-S3: the wall time
+// of a 60 ms frame grows with the complexity and is stretched by the share of the
+// core other tasks take. Walks through idle, loaded and overloaded phases, a
+// single late frame and the recovery, then a send queue behind a link that slows
+// down, and prints how often the budget was missed next to a fixed complexity.
+#include "host_test.h"
+#include "opus_encode_governor.h"
+
+#include <algorithm>
+#include <climits>
+#include <random>
+#include <vector>
+
+#define FRAME_MS 60
+#define FRAME_US (FRAME_MS * 1000)
+#define BUDGET_US (FRAME_US * CONFIG_OPUS_ENCODE_BUDGET_PERCENT / 100)
+#define WINDOW_FRAMES OPUS_GOVERNOR_WINDOW_FRAMES
+#define FRAMES_PER_MINUTE (60000 / FRAME_MS)
+// 2400 ms of packets, as AudioService
+#define SEND_QUEUE_CAPACITY 40
+
+struct EncoderModel {
+    std::mt19937 random{1};
+    // Wall time over CPU time, 2 when another task takes half of the core
+    double load = 1.0;
+
+    int64_t Encode(int complexity) {
+        std::uniform_real_distribution<double> noise(0.9, 1.1);
+        return (int64_t)((2000 + 1400 * complexity) * load * noise(random));
+    }
+};
+
+struct RunStats {
+    int frames = 0;
+    int over_budget = 0;
+    int over_frame = 0;
+    int changes = 0;
+    // First frame from which the average stayed under the budget, -1 if it did not
+    int settled_at = -1;
+    double complexity_sum = 0;
+};
+
+static RunStats Run(OpusEncodeGovernor& governor, OpusEncoderWrapper& encoder, EncoderModel& model, int frames) {
+    RunStats stats;
+    int calls = encoder.complexity_calls_;
+    for (int i = 0; i < frames; i++) {
+        // The frame is encoded with what the governor set after the previous one
+        int64_t us = model.Encode(encoder.complexity_);
+        governor.OnFrameEncoded(us);
+        stats.frames++;
+        stats.over_budget += us > BUDGET_US;
+        stats.over_frame += us > FRAME_US;
+        stats.complexity_sum += encoder.complexity_;
+        if (governor.average_encode_us() > BUDGET_US) {
+            stats.settled_at = -1;
+        } else if (stats.settled_at < 0) {
+            stats.settled_at = i;
+        }
+    }
+    stats.changes = encoder.complexity_calls_ - calls;
+    return stats;
+}
+
+// Share of frames over the budget at a fixed complexity, what the encoder did before the governor
+static double FixedOverBudget(int complexity, double load, int frames) {
+    EncoderModel model;
+    model.load = load;
+    int over = 0;
+    for (int i = 0; i < frames; i++) {
+        over += model.Encode(complexity) > BUDGET_US;
+    }
+    return 100.0 * over / frames;
+}
+
+static void Report(const char* phase, double load, const RunStats& stats) {
+    printf("%-22s load x%.1f: complexity avg %.2f, %d changes, %5.1f%% over budget (%5.1f%% at fixed %d), "
+        "%d over the frame, average under budget after %d frames\n",
+        phase, load, stats.complexity_sum / stats.frames, stats.changes, 100.0 * stats.over_budget / stats.frames,
+        FixedOverBudget(OPUS_GOVERNOR_MAX_COMPLEXITY, load, stats.frames), OPUS_GOVERNOR_MAX_COMPLEXITY,
+        stats.over_frame, stats.settled_at);
+}
+
+static void TestComplexity() {
+    OpusEncoderWrapper encoder;
+    OpusEncodeGovernor governor(&encoder, FRAME_MS, false);
+    EncoderModel model;
+    CHECK(encoder.complexity_ == 0 && !encoder.dtx_);
+
+    // Idle: one level per window up to the cap, never over the budget
+    auto idle = Run(governor, encoder, model, FRAMES_PER_MINUTE);
+    Report("idle", model.load, idle);
+    CHECK(encoder.complexity_ == OPUS_GOVERNOR_MAX_COMPLEXITY);
+    CHECK(idle.changes == OPUS_GOVERNOR_MAX_COMPLEXITY);
+    CHECK(idle.over_budget == 0);
+
+    // More than half of the core taken: one step down within a window or two, then no hunting
+    model.load = 2.2;
+    auto loaded = Run(governor, encoder, model, 2 * FRAMES_PER_MINUTE);
+    Report("loaded", model.load, loaded);
+    CHECK(loaded.settled_at >= 0 && loaded.settled_at <= 2 * WINDOW_FRAMES);
+    CHECK(loaded.changes <= 2);
+    CHECK(loaded.over_frame == 0);
+    int loaded_complexity = encoder.complexity_;
+    CHECK(loaded_complexity < OPUS_GOVERNOR_MAX_COMPLEXITY && loaded_complexity > 0);
+
+    // Heavier still: a step per window until the average fits again
+    model.load = 3.5;
+    auto overloaded = Run(governor, encoder, model, 2 * FRAMES_PER_MINUTE);
+    Report("overloaded", model.load, overloaded);
+    int steps = loaded_complexity - encoder.complexity_;
+    CHECK(steps > 0);
+    CHECK(overloaded.settled_at >= 0 && overloaded.settled_at <= (steps + 1) * WINDOW_FRAMES);
+    CHECK(overloaded.changes == steps);
+    CHECK(overloaded.over_frame == 0);
+
+    // Load gone: back to the cap once the hold-off after the last step down ran out
+    model.load = 1.0;
+    auto recovered = Run(governor, encoder, model, FRAMES_PER_MINUTE);
+    Report("recovered", model.load, recovered);
+    CHECK(encoder.complexity_ == OPUS_GOVERNOR_MAX_COMPLEXITY);
+    CHECK(recovered.over_budget == 0);
+
+    // A frame longer than the frame itself drops two levels at once
+    int before = encoder.complexity_;
+    governor.OnFrameEncoded(FRAME_US + 10000);
+    printf("late frame: complexity %d -> %d\n", before, encoder.complexity_);
+    CHECK(encoder.complexity_ == before - 2);
+    // And holds off the way up for OPUS_GOVERNOR_HOLDOFF_WINDOWS windows
+    Run(governor, encoder, model, OPUS_GOVERNOR_HOLDOFF_WINDOWS * WINDOW_FRAMES);
+    CHECK(encoder.complexity_ == before - 2);
+    Run(governor, encoder, model, 3 * WINDOW_FRAMES);
+    CHECK(encoder.complexity_ == before);
+}
+
+// One packet per frame, or a few bytes only when DTX is on and the frame is silent
+struct UplinkSim {
+    std::mt19937 random{3};
+    OpusEncodeGovernor* governor = nullptr;
+    size_t queued = 0;
+    bool dtx = false;
+    int frame = 0;
+    // Frames the codec task had to wait for room in the send queue
+    int stalls = 0;
+    std::vector<int> switches;
+
+    void Run(double link_packets_per_frame, int frames) {
+        std::bernoulli_distribution silent(0.5);
+        std::poisson_distribution<int> sent(link_packets_per_frame);
+        for (int i = 0; i < frames; i++, frame++) {
+            if (!(dtx && silent(random))) {
+                if (queued < SEND_QUEUE_CAPACITY) {
+                    queued++;
+                } else {
+                    stalls++;
+                }
+            }
+            queued -= std::min<size_t>(queued, sent(random));
+            if (governor != nullptr) {
+                governor->OnSendQueueDepth(queued, SEND_QUEUE_CAPACITY);
+                if (governor->dtx() != dtx) {
+                    dtx = governor->dtx();
+                    switches.push_back(frame);
+                }
+            }
+        }
+    }
+};
+
+static void TestUplink() {
+    OpusEncoderWrapper encoder;
+    OpusEncodeGovernor governor(&encoder, FRAME_MS, false);
+    int dtx_calls = encoder.dtx_calls_;
+
+    // 20 s of a link that carries 0.7 packets per frame between two good minutes
+    auto play = [](UplinkSim& sim) {
+        sim.Run(1.5, FRAMES_PER_MINUTE);
+        sim.Run(0.7, 20000 / FRAME_MS);
+        sim.Run(1.5, FRAMES_PER_MINUTE);
+    };
+    UplinkSim uplink;
+    uplink.governor = &governor;
+    play(uplink);
+    UplinkSim plain;
+    play(plain);
+    CHECK(!governor.uplink_congested() && !encoder.dtx_);
+    CHECK(encoder.dtx_calls_ - dtx_calls == (int)uplink.switches.size());
+
+    // DTX drains the queue below a quarter and it fills up again while the link stays slow,
+    // the hysteresis keeps a noisy queue from switching on every frame
+    int shortest = INT_MAX;
+    for (size_t i = 1; i < uplink.switches.size(); i++) {
+        shortest = std::min(shortest, uplink.switches[i] - uplink.switches[i - 1]);
+    }
+    printf("slow link for 20 s: %d DTX switches at least %d ms apart, %d frames waited for the send queue "
+        "(%d without DTX)\n", (int)uplink.switches.size(), shortest * FRAME_MS, uplink.stalls, plain.stalls);
+    CHECK(uplink.switches.size() >= 2 && uplink.switches.size() % 2 == 0);
+    CHECK(shortest * FRAME_MS >= 1000);
+    CHECK(uplink.stalls < plain.stalls);
+
+    // Forced DTX holds regardless of the link, and the default comes back after it
+    governor.SetDtxForced(true);
+    CHECK(encoder.dtx_);
+    governor.OnSendQueueDepth(0, SEND_QUEUE_CAPACITY);
+    CHECK(encoder.dtx_);
+    governor.SetDtxForced(false);
+    CHECK(!encoder.dtx_);
+
+    OpusEncoderWrapper dtx_encoder;
+    OpusEncodeGovernor dtx_governor(&dtx_encoder, FRAME_MS, true);
+    dtx_governor.OnSendQueueDepth(SEND_QUEUE_CAPACITY, SEND_QUEUE_CAPACITY);
+    dtx_governor.OnSendQueueDepth(0, SEND_QUEUE_CAPACITY);
+    CHECK(dtx_encoder.dtx_ && dtx_encoder.dtx_calls_ == 1);
+}
+
+int main() {
+    printf("budget %d us per %d ms frame, complexity cap %d\n", BUDGET_US, FRAME_MS, OPUS_GOVERNOR_MAX_COMPLEXITY);
+    TestComplexity();
+    TestUplink();
+    return HOST_TEST_RESULT();
+}
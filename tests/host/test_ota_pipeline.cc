@@ -0,0 +1,304 @@
+// Runs Ota::StartUpgradeFromUrl() against a simulated HTTP server and flash:
+// the server paces its reads to a given bandwidth and can drop the connection
+// at chosen offsets, the flash paces esp_ota_write() the same way. Checks the
+// written image and the resume paths, then measures how much of the flash
+// time the reader/writer pipeline hides behind the download.
+#include "host_test.h"
+#include "ota.h"
+#include "settings.h"
+#include "system_info.h"
+
+#include <esp_ota_ops.h>
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <set>
+#include <thread>
+
+#define IMAGE_HEADER_SIZE (sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t) + sizeof(esp_app_desc_t))
+#define TCP_SEGMENT_SIZE 1460
+
+// Sleeps until size bytes at bytes_per_second have passed since the pacer started
+class Pacer {
+public:
+    explicit Pacer(double bytes_per_second) : bytes_per_second_(bytes_per_second) {}
+
+    void Consume(size_t size) {
+        if (bytes_per_second_ <= 0) {
+            return;
+        }
+        if (bytes_ == 0) {
+            start_ = std::chrono::steady_clock::now();
+        }
+        bytes_ += size;
+        std::this_thread::sleep_until(start_ + std::chrono::microseconds((int64_t)(bytes_ * 1e6 / bytes_per_second_)));
+    }
+
+private:
+    double bytes_per_second_;
+    size_t bytes_ = 0;
+    std::chrono::steady_clock::time_point start_;
+};
+
+struct FlashSim {
+    esp_partition_t running = {0x10000, 4 * 1024 * 1024, "ota_0"};
+    esp_partition_t update = {0x410000, 4 * 1024 * 1024, "ota_1"};
+    esp_app_desc_t app_desc = {};
+    std::vector<uint8_t> written;
+    double bytes_per_second = 0;
+    int64_t write_us = 0;
+    bool begun = false;
+    bool aborted = false;
+    bool boot_set = false;
+
+    void Reset(double rate) {
+        written.clear();
+        bytes_per_second = rate;
+        write_us = 0;
+        begun = aborted = boot_set = false;
+    }
+};
+
+static FlashSim g_flash;
+static std::unique_ptr<Pacer> g_flash_pacer;
+
+const esp_app_desc_t* esp_app_get_description() {
+    strcpy(g_flash.app_desc.version, "1.0.0");
+    return &g_flash.app_desc;
+}
+
+const esp_partition_t* esp_ota_get_running_partition() {
+    return &g_flash.running;
+}
+
+const esp_partition_t* esp_ota_get_next_update_partition(const esp_partition_t* start_from) {
+    return &g_flash.update;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t* partition, size_t src_offset, void* dst, size_t size) {
+    return ESP_FAIL;
+}
+
+esp_err_t esp_ota_begin(const esp_partition_t* partition, size_t image_size, esp_ota_handle_t* out_handle) {
+    g_flash.begun = true;
+    g_flash_pacer = std::make_unique<Pacer>(g_flash.bytes_per_second);
+    *out_handle = 1;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_write(esp_ota_handle_t handle, const void* data, size_t size) {
+    auto start = HostNowUs();
+    auto bytes = (const uint8_t*)data;
+    g_flash.written.insert(g_flash.written.end(), bytes, bytes + size);
+    g_flash_pacer->Consume(size);
+    g_flash.write_us += HostNowUs() - start;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_end(esp_ota_handle_t handle) {
+    return !g_flash.written.empty() && g_flash.written[0] == 0xe9 ? ESP_OK : ESP_ERR_OTA_VALIDATE_FAILED;
+}
+
+esp_err_t esp_ota_abort(esp_ota_handle_t handle) {
+    g_flash.aborted = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t* partition) {
+    g_flash.boot_set = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_get_state_partition(const esp_partition_t* partition, esp_ota_img_states_t* state) {
+    *state = ESP_OTA_IMG_VALID;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_mark_app_valid_cancel_rollback() {
+    return ESP_OK;
+}
+
+std::string SystemInfo::GetMacAddress() { return "00:00:00:00:00:00"; }
+std::string SystemInfo::GetUserAgent() { return "host-test/1.0.0"; }
+
+// Settings are only read by the version check, which is not run here
+Settings::Settings(const std::string& ns, bool read_write) : ns_(ns), read_write_(read_write) {}
+Settings::~Settings() {}
+std::string Settings::GetString(const std::string& key, const std::string& default_value) { return default_value; }
+void Settings::SetString(const std::string& key, const std::string& value) {}
+int32_t Settings::GetInt(const std::string& key, int32_t default_value) { return default_value; }
+void Settings::SetInt(const std::string& key, int32_t value) {}
+
+class ServerSim : public NetworkInterface {
+public:
+    std::vector<uint8_t> image;
+    // Absolute offsets where a connection drops, each once
+    std::set<size_t> breaks;
+    bool range_support = true;
+    double bytes_per_second = 0;
+    int opens = 0;
+    int range_requests = 0;
+
+    std::unique_ptr<Http> CreateHttp(int connect_id) override;
+};
+
+class HttpSim : public Http {
+public:
+    explicit HttpSim(ServerSim& server) : server_(server), pacer_(server.bytes_per_second) {}
+
+    void SetHeader(const std::string& key, const std::string& value) override {
+        if (key == "Range") {
+            offset_ = std::stoul(value.substr(strlen("bytes=")));
+        }
+    }
+    void SetContent(std::string&& content) override {}
+
+    bool Open(const std::string& method, const std::string& url) override {
+        server_.opens++;
+        if (offset_ > 0) {
+            server_.range_requests++;
+            status_ = !server_.range_support ? 200 : offset_ < server_.image.size() ? 206 : 416;
+            if (status_ == 200) {
+                offset_ = 0;
+            }
+        }
+        return true;
+    }
+    void Close() override {}
+    int GetStatusCode() override { return status_; }
+    size_t GetBodyLength() override { return server_.image.size() - offset_; }
+
+    int Read(char* buffer, size_t buffer_size) override {
+        auto next_break = server_.breaks.upper_bound(offset_);
+        if (server_.breaks.count(offset_) > 0) {
+            server_.breaks.erase(offset_);
+            return -1;
+        }
+        size_t end = std::min(server_.image.size(), offset_ + std::min<size_t>(buffer_size, TCP_SEGMENT_SIZE));
+        if (next_break != server_.breaks.end()) {
+            end = std::min(end, *next_break);
+        }
+        if (end <= offset_) {
+            return 0;
+        }
+        memcpy(buffer, server_.image.data() + offset_, end - offset_);
+        pacer_.Consume(end - offset_);
+        int n = end - offset_;
+        offset_ = end;
+        return n;
+    }
+
+    std::string ReadAll() override { return ""; }
+
+private:
+    ServerSim& server_;
+    Pacer pacer_;
+    size_t offset_ = 0;
+    int status_ = 200;
+};
+
+std::unique_ptr<Http> ServerSim::CreateHttp(int connect_id) {
+    return std::make_unique<HttpSim>(*this);
+}
+
+static std::vector<uint8_t> MakeImage(size_t size, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> image(size);
+    for (auto& byte : image) {
+        byte = rng();
+    }
+    image[0] = 0xe9;
+    esp_app_desc_t desc = {};
+    strcpy(desc.version, "2.0.0");
+    if (size >= IMAGE_HEADER_SIZE) {
+        memcpy(image.data() + sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t), &desc, sizeof(desc));
+    }
+    return image;
+}
+
+static bool Upgrade(ServerSim& server, double flash_bytes_per_second = 0) {
+    g_flash.Reset(flash_bytes_per_second);
+    Board::GetInstance().network = &server;
+    Ota ota;
+    int last_progress = -1;
+    bool success = ota.StartUpgradeFromUrl("http://ota.local/firmware.bin", [&](int progress, size_t speed) {
+        CHECK(progress >= last_progress);
+        last_progress = progress;
+    });
+    if (success) {
+        CHECK(last_progress == 100);
+    }
+    return success;
+}
+
+static void CheckResume() {
+    ServerSim server;
+    server.image = MakeImage(200 * 1024 + 123, 1);
+
+    CHECK(Upgrade(server));
+    CHECK(g_flash.written == server.image && g_flash.boot_set);
+    CHECK(server.range_requests == 0);
+
+    // Dropped before the image header was complete
+    server.breaks = {100};
+    CHECK(Upgrade(server));
+    CHECK(g_flash.written == server.image && g_flash.boot_set);
+    CHECK(server.range_requests == 1);
+
+    // Dropped right after the header, on a chunk boundary, twice in a row and before the last byte
+    server.breaks = {IMAGE_HEADER_SIZE, 16 * 1024, 70000, 70001, server.image.size() - 1};
+    server.range_requests = 0;
+    CHECK(Upgrade(server));
+    CHECK(g_flash.written == server.image && g_flash.boot_set);
+    CHECK(server.range_requests == 5);
+
+    // More drops than the retries allowed per upgrade
+    server.breaks = {1000, 2000, 3000, 4000, 5000, 6000};
+    CHECK(!Upgrade(server));
+    CHECK(g_flash.aborted && !g_flash.boot_set);
+
+    // Without range support a resume would restart from zero, sequential writes cannot
+    server.breaks = {100000};
+    server.range_support = false;
+    CHECK(!Upgrade(server));
+    CHECK(g_flash.aborted && !g_flash.boot_set);
+    server.breaks = {100};
+    CHECK(!Upgrade(server));
+    CHECK(!g_flash.begun && !g_flash.boot_set);
+
+    // Shorter than an image header
+    ServerSim tiny;
+    tiny.image = MakeImage(IMAGE_HEADER_SIZE - 1, 2);
+    CHECK(!Upgrade(tiny));
+    CHECK(!g_flash.begun);
+}
+
+static void MeasurePipeline() {
+    // Scaled down to keep the test short, only the ratio of the two rates matters
+    const double network_rate = 4e6;
+    const double flash_rate = 3e6;
+    ServerSim server;
+    server.image = MakeImage(1024 * 1024, 3);
+    server.bytes_per_second = network_rate;
+
+    auto start = HostNowUs();
+    CHECK(Upgrade(server, flash_rate));
+    auto elapsed_us = HostNowUs() - start;
+    CHECK(g_flash.written == server.image);
+
+    double network_us = server.image.size() * 1e6 / network_rate;
+    double serial_us = network_us + g_flash.write_us;
+    printf("1 MB image: network %.0f ms + flash %.0f ms, downloaded in %.0f ms, %.0f%% of the flash time hidden\n",
+        network_us / 1000, g_flash.write_us / 1000.0, elapsed_us / 1000.0,
+        100.0 * (serial_us - elapsed_us) / g_flash.write_us);
+    // Reading and writing one after the other would take the sum
+    CHECK(elapsed_us < serial_us * 0.8);
+}
+
+int main() {
+    CheckResume();
+    MeasurePipeline();
+    return HOST_TEST_RESULT();
+}
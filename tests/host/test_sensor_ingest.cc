@@ -0,0 +1,185 @@
+// SensorIngest over the recorded elderly monitor messages in sensor_frames.log:
+// heartbeats, presence reports with the keywords \u-escaped as the server sends
+// them, and camera messages carrying base64 images. Each message is replayed the
+// way esp_websocket_client delivers it, whole, in pieces of its receive buffer,
+// as continuation frames with a ping between them and a byte at a time, and must
+// give the same result every time. Then the broken cases: a message cut off by a
+// disconnect or by the next message, binary and malformed frames.
+#include "host_test.h"
+#include "sensor_ingest.h"
+
+#include <algorithm>
+#include <vector>
+
+#define LOG_FILE "sensor_frames.log"
+// WEBSOCKET_BUFFER_SIZE_BYTE, the receive buffer of esp_websocket_client
+#define CLIENT_BUFFER_SIZE 1024
+#define ROUNDS 200
+
+#define OPCODE_CONTINUATION 0x0
+#define OPCODE_TEXT 0x1
+#define OPCODE_BINARY 0x2
+#define OPCODE_PING 0x9
+
+struct Result {
+    std::string info;
+    SensorPresence presence;
+    size_t size;
+    int skipped_values;
+
+    bool operator==(const Result& other) const {
+        return info == other.info && presence == other.presence && size == other.size &&
+            skipped_values == other.skipped_values;
+    }
+};
+
+struct Replay {
+    SensorIngest ingest;
+    std::vector<Result> results;
+
+    Replay() {
+        ingest.OnMessage([this](const SensorMessage& message) {
+            results.push_back({ message.info, message.presence, message.size, message.skipped_values });
+        });
+    }
+
+    // One frame, handed over in pieces of at most piece bytes
+    void Frame(int op_code, bool fin, const std::string& payload, size_t piece) {
+        size_t offset = 0;
+        do {
+            size_t len = std::min(piece, payload.size() - offset);
+            ingest.Feed(op_code, fin, payload.data() + offset, len, offset, payload.size());
+            offset += len;
+        } while (offset < payload.size());
+    }
+
+    // A message split into frames of frame_size bytes, each received in pieces
+    void Message(const std::string& message, size_t frame_size, size_t piece) {
+        for (size_t offset = 0; offset < message.size(); offset += frame_size) {
+            bool fin = offset + frame_size >= message.size();
+            Frame(offset == 0 ? OPCODE_TEXT : OPCODE_CONTINUATION, fin, message.substr(offset, frame_size), piece);
+            if (!fin) {
+                Frame(OPCODE_PING, true, "", piece);
+            }
+        }
+    }
+};
+
+static void TestRecorded(const std::vector<std::string>& messages) {
+    Replay whole;
+    for (auto& message : messages) {
+        whole.Message(message, message.size(), message.size());
+    }
+    CHECK(whole.results.size() == messages.size());
+    CHECK(whole.ingest.dropped() == 0);
+
+    int heartbeats = 0, arrived = 0, left = 0, skipped = 0;
+    for (size_t i = 0; i < whole.results.size(); i++) {
+        auto& result = whole.results[i];
+        CHECK(result.size == messages[i].size());
+        heartbeats += result.info == "alive";
+        arrived += result.presence == kSensorPresenceArrived;
+        left += result.presence == kSensorPresenceLeft;
+        skipped += result.skipped_values;
+    }
+    printf("%d messages: %d heartbeats, %d arrived, %d left, %d images skipped\n",
+        (int)messages.size(), heartbeats, arrived, left, skipped);
+    CHECK(heartbeats == 8 && arrived == 3 && left == 3 && skipped == 3);
+    // The escapes are decoded, info is plain text
+    CHECK(whole.results[2].info == "在坐" && whole.results[7].info == "在卧");
+
+    struct Delivery {
+        const char* name;
+        size_t frame_size;
+        size_t piece;
+    } deliveries[] = {
+        { "client buffer", SIZE_MAX, CLIENT_BUFFER_SIZE },
+        { "continuation frames", 500, CLIENT_BUFFER_SIZE },
+        { "frames in pieces", 700, 333 },
+        { "byte by byte", SIZE_MAX, 1 },
+    };
+    for (auto& delivery : deliveries) {
+        Replay replay;
+        for (auto& message : messages) {
+            replay.Message(message, std::min(delivery.frame_size, message.size()), delivery.piece);
+        }
+        bool same = replay.results.size() == whole.results.size() &&
+            std::equal(replay.results.begin(), replay.results.end(), whole.results.begin());
+        if (!same) {
+            fprintf(stderr, "%s: %d messages, differs from the whole frames\n", delivery.name,
+                (int)replay.results.size());
+        }
+        CHECK(same);
+        CHECK(replay.ingest.dropped() == 0);
+    }
+}
+
+static void TestBroken(const std::vector<std::string>& messages) {
+    const std::string& heartbeat = messages[1];
+    const std::string& image = messages[7];
+    Replay replay;
+
+    // Disconnect in the middle of an image, the next message starts clean
+    for (size_t offset = 0; offset < 3000; offset += CLIENT_BUFFER_SIZE) {
+        replay.ingest.Feed(OPCODE_TEXT, true, image.data() + offset, CLIENT_BUFFER_SIZE, offset, image.size());
+    }
+    replay.ingest.Reset();
+    replay.Message(heartbeat, heartbeat.size(), CLIENT_BUFFER_SIZE);
+    CHECK(replay.results.size() == 1 && replay.results[0].info == "alive");
+
+    // The rest of a frame whose start was missed is not taken for a message
+    replay.results.clear();
+    replay.ingest.Feed(OPCODE_TEXT, true, image.data() + 3000, 1000, 3000, image.size());
+    CHECK(replay.results.empty());
+
+    // A new message before the last one ended drops the last one
+    uint32_t dropped = replay.ingest.dropped();
+    replay.ingest.Feed(OPCODE_TEXT, false, image.data(), 2000, 0, 2000);
+    replay.Message(heartbeat, heartbeat.size(), CLIENT_BUFFER_SIZE);
+    CHECK(replay.results.size() == 1 && replay.ingest.dropped() == dropped + 1);
+
+    // Binary frames are ignored, malformed text is counted and dropped
+    replay.results.clear();
+    replay.Frame(OPCODE_BINARY, true, "{\"parameters\":{\"info\":\"alive\"}}", CLIENT_BUFFER_SIZE);
+    replay.Message("{\"parameters\":]", 15, CLIENT_BUFFER_SIZE);
+    replay.Message("{\"parameters\":{\"info\":\"al", 25, CLIENT_BUFFER_SIZE);
+    CHECK(replay.results.empty() && replay.ingest.dropped() == dropped + 3);
+
+    // An escaped quote or brace inside a string does not end it
+    replay.Message("{\"parameters\":{\"k\":\"a\\\"}b\",\"info\":\"alive\"}}", 100, 1);
+    CHECK(replay.results.size() == 1 && replay.results[0].info == "alive");
+    // Only parameters.info at the top level is the info
+    replay.results.clear();
+    replay.Message("{\"a\":{\"parameters\":{\"info\":\"alive\"}},\"s\":\"\\u79bb\\u5367\"}", 100, 5);
+    CHECK(replay.results.size() == 1 && replay.results[0].info.empty() &&
+        replay.results[0].presence == kSensorPresenceLeft);
+}
+
+static void Bench(const std::vector<std::string>& messages) {
+    size_t bytes = 0;
+    for (auto& message : messages) {
+        bytes += message.size();
+    }
+    Replay replay;
+    int64_t start = HostNowUs();
+    for (int i = 0; i < ROUNDS; i++) {
+        for (auto& message : messages) {
+            replay.Message(message, message.size(), CLIENT_BUFFER_SIZE);
+        }
+    }
+    double us = (double)(HostNowUs() - start) / ROUNDS;
+    printf("%u bytes in %.1f us on the host, %.0f MB/s\n", (unsigned)bytes, us, bytes / us);
+    CHECK(replay.results.size() == messages.size() * ROUNDS);
+}
+
+int main() {
+    auto messages = ReadLines(LOG_FILE);
+    CHECK(messages.size() == 17);
+    if (messages.size() != 17) {
+        return HOST_TEST_RESULT();
+    }
+    TestRecorded(messages);
+    TestBroken(messages);
+    Bench(messages);
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,214 @@
+// ServoMotionEngine on a simulated clock: the esp_timer stub fires the 10 ms tick
+// a little late each time and the LEDC stub records the duty, the poses below are
+// read back from that duty (about 0.22 degree per step). Checks the pulse mapping,
+// the timing of linear moves and queues, that gaits follow their sine, that the
+// pose never jumps between motions, cancellation and the speed limiter.
+#include "host_test.h"
+#include "servo_motion.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <random>
+
+#define CHANNELS 6
+// The last tick comes at most this late after the motion ends
+#define TICK_SLACK_US (SERVO_MOTION_TICK_US + 1500)
+
+static std::mt19937 g_random(7);
+
+// Up to 1.5 ms late, the esp_timer task shares the core with audio
+static int64_t Jitter() {
+    return g_random() % 1500;
+}
+
+static double AngleOf(int channel) {
+    uint32_t duty = g_ledc_duty[LEDC_CHANNEL_1 + channel];
+    return (duty * 20000.0 / 8191 - 500) * 180 / 2000;
+}
+
+// Runs the timer for at most us. Time is counted from the first tick, where the
+// motion starts, returns when the engine went idle or -1 if it did not
+static int64_t RunUntilIdle(ServoMotionEngine& engine, int64_t us, std::function<void(int64_t)> probe = nullptr) {
+    int64_t start = -1;
+    int64_t idle_at = -1;
+    EspTimerAdvance(us, Jitter, [&]() {
+        if (start < 0) {
+            start = esp_timer_get_time();
+        }
+        int64_t elapsed = esp_timer_get_time() - start;
+        if (probe) {
+            probe(elapsed);
+        }
+        if (idle_at < 0 && engine.IsIdle()) {
+            idle_at = elapsed;
+        }
+    });
+    return idle_at;
+}
+
+static void TestDutyMapping(ServoMotionEngine& engine) {
+    // Whole degrees give the duty of the float formula the board oscillators used
+    int mismatches = 0;
+    int target[SERVO_MOTION_MAX_CHANNELS] = {};
+    for (int angle = 0; angle <= 180; angle++) {
+        target[0] = angle;
+        engine.Queue(ServoMotion::MoveTo(1, target, 0));
+        RunUntilIdle(engine, 50000);
+        uint32_t expected = (uint32_t)(((angle / 180.0) * 2.0 + 0.5) * 8191 / 20.0);
+        if (g_ledc_duty[LEDC_CHANNEL_1] != expected) {
+            fprintf(stderr, "%d degrees: duty %u, expected %u\n", angle, (unsigned)g_ledc_duty[LEDC_CHANNEL_1],
+                (unsigned)expected);
+            mismatches++;
+        }
+    }
+    CHECK(mismatches == 0);
+}
+
+static void TestLinearMove(ServoMotionEngine& engine) {
+    int home[SERVO_MOTION_MAX_CHANNELS] = {90, 90, 90, 90, 45, 135};
+    engine.Queue(ServoMotion::MoveTo(0x3f, home, 0));
+    CHECK(RunUntilIdle(engine, 50000) >= 0);
+
+    int target[SERVO_MOTION_MAX_CHANNELS] = {120, 60, 90, 90, 45, 135};
+    engine.Queue(ServoMotion::MoveTo(0x3f, target, 500));
+    double max_error = 0;
+    int64_t took = RunUntilIdle(engine, 800000, [&](int64_t elapsed) {
+        double t = std::min(elapsed / 500000.0, 1.0);
+        max_error = std::max(max_error, std::fabs(AngleOf(0) - (90 + 30 * t)));
+        max_error = std::max(max_error, std::fabs(AngleOf(1) - (90 - 30 * t)));
+    });
+    printf("move 30 degrees in 500 ms: max error %.3f degrees, idle after %lld us\n", max_error, (long long)took);
+    CHECK(max_error < 0.3);
+    CHECK(took >= 500000 && took < 500000 + TICK_SLACK_US);
+    CHECK(engine.GetPosition(0) == 120 && engine.GetPosition(1) == 60);
+}
+
+static void TestGaitQueue(ServoMotionEngine& engine) {
+    int amplitude[SERVO_MOTION_MAX_CHANNELS] = {30, 30, 20, 20, 0, 0};
+    int offset[SERVO_MOTION_MAX_CHANNELS] = {0, 0, 4, -4, 0, 0};
+    double phase[SERVO_MOTION_MAX_CHANNELS] = {0, 0, M_PI / 2, M_PI / 2, 0, 0};
+    int home[SERVO_MOTION_MAX_CHANNELS] = {90, 90, 90, 90, 45, 135};
+
+    // 300 ms move, 2.5 cycles of 1000 ms, 300 ms move: 3.1 s back to back
+    engine.Queue(ServoMotion::MoveTo(0x3f, home, 300));
+    engine.Queue(ServoMotion::Oscillate(0x3f, amplitude, offset, 1000, phase, 2.5f));
+    engine.Queue(ServoMotion::MoveTo(0x3f, home, 300));
+    double max_error = 0;
+    int64_t took = RunUntilIdle(engine, 5000000, [&](int64_t elapsed) {
+        // Skip the blend over the first keyframe
+        double t = (elapsed - 300000) / 1e6;
+        if (t < 0.04 || t > 2.5) {
+            return;
+        }
+        for (int i = 0; i < 4; i++) {
+            double ideal = 90 + offset[i] + amplitude[i] * std::sin(2 * M_PI * t + phase[i]);
+            max_error = std::max(max_error, std::fabs(AngleOf(i) - ideal));
+        }
+    });
+    printf("gait of 2.5 cycles between two moves: max error %.3f degrees, idle after %lld us (3100000 ideal)\n",
+        max_error, (long long)took);
+    CHECK(max_error < 0.4);
+    CHECK(took >= 3100000 && took < 3100000 + TICK_SLACK_US);
+    CHECK(engine.GetPosition(0) == 90 && engine.GetPosition(4) == 45);
+}
+
+static void TestContinuity(ServoMotionEngine& engine) {
+    int amplitude[SERVO_MOTION_MAX_CHANNELS] = {30, 30, 20, 20, 0, 0};
+    int offset[SERVO_MOTION_MAX_CHANNELS] = {};
+    double phase[SERVO_MOTION_MAX_CHANNELS] = {0, 0, M_PI / 2, M_PI / 2, 0, 0};
+    int target[SERVO_MOTION_MAX_CHANNELS] = {150, 30, 90, 90, 45, 135};
+
+    // The gait stops in the middle of its swing, the move has to take over its speed
+    engine.Queue(ServoMotion::Oscillate(0x3f, amplitude, offset, 600, phase, 1.3f));
+    engine.Queue(ServoMotion::MoveTo(0x3f, target, 400));
+    double max_step = 0;
+    double previous = AngleOf(0);
+    RunUntilIdle(engine, 2000000, [&](int64_t) {
+        max_step = std::max(max_step, std::fabs(AngleOf(0) - previous));
+        previous = AngleOf(0);
+    });
+    // Peak gait speed is 30 * 2 pi / 0.6 s = 314 degrees per second, 3.6 degrees per late tick
+    printf("continuity: largest step between ticks %.3f degrees\n", max_step);
+    CHECK(max_step < 4.0);
+    CHECK(engine.GetPosition(0) == 150);
+}
+
+static void TestCancel(ServoMotionEngine& engine) {
+    int home[SERVO_MOTION_MAX_CHANNELS] = {90, 90, 90, 90, 45, 135};
+    engine.Queue(ServoMotion::MoveTo(0x3f, home, 1000));
+    engine.Queue(ServoMotion::MoveTo(0x3f, home, 1000));
+    EspTimerAdvance(300000, Jitter);
+    int held = engine.GetPosition(0);
+    uint32_t duty = g_ledc_duty[LEDC_CHANNEL_1];
+    engine.Cancel();
+    CHECK(engine.IsIdle());
+    CHECK(engine.WaitUntilIdle(0));
+    EspTimerAdvance(200000, Jitter);
+    printf("cancel: held at %d degrees\n", held);
+    CHECK(held > 90 && held < 150);
+    CHECK(engine.GetPosition(0) == held && g_ledc_duty[LEDC_CHANNEL_1] == duty);
+    CHECK(!EspTimerAnyRunning());
+}
+
+static void TestSpeedLimit(ServoMotionEngine& engine) {
+    for (int i = 0; i < CHANNELS; i++) {
+        engine.SetSpeedLimit(i, 240);
+    }
+    int from = engine.GetPosition(0);
+    int target[SERVO_MOTION_MAX_CHANNELS] = {30, 90, 90, 90, 45, 135};
+    engine.Queue(ServoMotion::MoveTo(0x3f, target, 0));
+    double max_speed = 0;
+    double previous = AngleOf(0);
+    int64_t previous_time = esp_timer_get_time();
+    int64_t took = RunUntilIdle(engine, 2000000, [&](int64_t) {
+        int64_t now = esp_timer_get_time();
+        max_speed = std::max(max_speed, std::fabs(AngleOf(0) - previous) * 1e6 / (now - previous_time));
+        previous = AngleOf(0);
+        previous_time = now;
+    });
+    double expected = std::abs(from - 30) / 240.0 * 1e6;
+    printf("speed limit 240 degrees/s: %d degrees in %lld us (%.0f expected), peak %.0f degrees/s\n",
+        from - 30, (long long)took, expected, max_speed);
+    CHECK(std::fabs(took - expected) < TICK_SLACK_US * 2);
+    // One duty step of rounding on top of the limit
+    CHECK(max_speed < 240 * 1.1);
+    CHECK(engine.GetPosition(0) == 30);
+    for (int i = 0; i < CHANNELS; i++) {
+        engine.SetSpeedLimit(i, 0);
+    }
+}
+
+static void BenchTick(ServoMotionEngine& engine) {
+    int amplitude[SERVO_MOTION_MAX_CHANNELS] = {30, 30, 20, 20, 10, 10};
+    int offset[SERVO_MOTION_MAX_CHANNELS] = {};
+    double phase[SERVO_MOTION_MAX_CHANNELS] = {0, M_PI, M_PI / 2, M_PI / 2, 0, M_PI};
+    engine.Queue(ServoMotion::Oscillate(0x3f, amplitude, offset, 1000, phase, 60));
+    int writes = g_ledc_writes;
+    int ticks = 0;
+    int64_t start = HostNowUs();
+    EspTimerAdvance(60 * 1000000LL + SERVO_MOTION_TICK_US * 2, nullptr, [&]() { ticks++; });
+    int64_t elapsed = HostNowUs() - start;
+    printf("60 s gait on %d servos: %d ticks, %.2f us per tick on the host, %.1f LEDC writes per second per servo\n",
+        CHANNELS, ticks, (double)elapsed / ticks, (g_ledc_writes - writes) / 60.0 / CHANNELS);
+    CHECK(engine.IsIdle());
+}
+
+int main() {
+    ServoMotionEngine engine(CHANNELS);
+    for (int i = 0; i < CHANNELS; i++) {
+        engine.Attach(i, i);
+    }
+    // Nothing runs until the first motion
+    CHECK(engine.IsIdle() && !EspTimerAnyRunning());
+
+    TestDutyMapping(engine);
+    TestLinearMove(engine);
+    TestGaitQueue(engine);
+    TestContinuity(engine);
+    TestCancel(engine);
+    TestSpeedLimit(engine);
+    BenchTick(engine);
+    CHECK(!EspTimerAnyRunning());
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,183 @@
+// The Settings write-back cache over a map-backed NVS: a burst of writes becomes
+// one set and one commit, values equal to the stored ones are not written, a
+// value set again while Flush() writes the old one stays pending, failed writes
+// and commits keep their values for the next flush, erasing drops what is
+// pending, and esp_restart() flushes through the shutdown handler.
+#include "host_test.h"
+#include "settings.h"
+
+#include <esp_system.h>
+#include <freertos/task.h>
+
+#define VOLUME_STEPS 100
+
+static void ResetCounters() {
+    g_nvs_sets = 0;
+    g_nvs_commits = 0;
+}
+
+static int32_t StoredInt(const std::string& ns, const std::string& key, int32_t missing = -1) {
+    auto& keys = g_nvs[ns];
+    auto it = keys.find(key);
+    return it != keys.end() && it->second.type == kNvsI32 ? it->second.number : missing;
+}
+
+static void TestCoalesce() {
+    ResetCounters();
+    Settings settings("audio", true);
+    for (int i = 1; i <= VOLUME_STEPS; i++) {
+        settings.SetInt("volume", i);
+    }
+    settings.SetString("voice", "bright");
+    settings.SetBool("muted", true);
+
+    // Readers see the values before they reach the flash
+    CHECK(settings.GetInt("volume") == VOLUME_STEPS);
+    CHECK(settings.GetString("voice") == "bright");
+    CHECK(settings.GetBool("muted"));
+    CHECK(g_nvs_sets == 0 && g_nvs_commits == 0);
+    // The commit task is started once and told about every write
+    CHECK(g_tasks_created == 1);
+    CHECK(g_task_notifications == VOLUME_STEPS + 2);
+    CHECK(g_shutdown_handlers.size() == 1);
+
+    Settings::Flush();
+    printf("%d volume steps and two other keys: %d sets, %d commits\n", VOLUME_STEPS, g_nvs_sets, g_nvs_commits);
+    CHECK(g_nvs_sets == 3 && g_nvs_commits == 1);
+    CHECK(StoredInt("audio", "volume") == VOLUME_STEPS);
+
+    // Nothing left to write
+    Settings::Flush();
+    CHECK(g_nvs_sets == 3 && g_nvs_commits == 1);
+
+    // Another instance reads what was committed
+    Settings reader("audio");
+    CHECK(reader.GetInt("volume") == VOLUME_STEPS && reader.GetString("voice") == "bright" && reader.GetBool("muted"));
+}
+
+static void TestUnchanged() {
+    ResetCounters();
+    Settings settings("audio", true);
+    // Equal to the stored value, not even queued
+    settings.SetInt("volume", VOLUME_STEPS);
+    // Changed and changed back before the commit, written back unchanged
+    settings.SetBool("muted", false);
+    settings.SetBool("muted", true);
+    CHECK(settings.GetBool("muted"));
+    Settings::Flush();
+    CHECK(g_nvs_sets == 0 && g_nvs_commits == 0);
+
+    // The same key with another type is a different value
+    settings.SetString("volume", "loud");
+    CHECK(settings.GetString("volume") == "loud" && settings.GetInt("volume") == VOLUME_STEPS);
+    Settings::Flush();
+    CHECK(g_nvs_sets == 1 && g_nvs["audio"]["volume"].type == kNvsString);
+}
+
+static void TestSetWhileFlushing() {
+    ResetCounters();
+    Settings settings("display", true);
+    settings.SetInt("brightness", 10);
+    settings.SetInt("theme", 1);
+
+    // The user moves the slider again while the first value is being written
+    bool set_again = false;
+    g_nvs_on_set = [&](const std::string& key) {
+        if (key == "brightness" && !set_again) {
+            set_again = true;
+            settings.SetInt("brightness", 20);
+        }
+    };
+    Settings::Flush();
+    g_nvs_on_set = nullptr;
+    CHECK(set_again);
+    CHECK(StoredInt("display", "brightness") == 10 && StoredInt("display", "theme") == 1);
+    // The newer value was not dropped with the one that was committed
+    CHECK(settings.GetInt("brightness") == 20);
+
+    Settings::Flush();
+    CHECK(StoredInt("display", "brightness") == 20);
+    CHECK(g_nvs_sets == 3 && g_nvs_commits == 2);
+    Settings::Flush();
+    CHECK(g_nvs_sets == 3);
+}
+
+static void TestFailedWrites() {
+    ResetCounters();
+    Settings settings("wifi", true);
+    settings.SetString("ssid", "home");
+    settings.SetInt("channel", 6);
+
+    // One key does not fit, the other is committed
+    g_nvs_fail_key = "ssid";
+    Settings::Flush();
+    CHECK(StoredInt("wifi", "channel") == 6 && g_nvs["wifi"].count("ssid") == 0);
+    CHECK(settings.GetString("ssid") == "home");
+    g_nvs_fail_key.clear();
+    Settings::Flush();
+    CHECK(g_nvs["wifi"]["ssid"].text == "home");
+    CHECK(g_nvs_sets == 2 && g_nvs_commits == 2);
+
+    // A failed commit keeps all keys of the namespace pending
+    settings.SetInt("channel", 11);
+    settings.SetString("ssid", "office");
+    g_nvs_fail_commit = true;
+    Settings::Flush();
+    g_nvs_fail_commit = false;
+    CHECK(g_nvs_commits == 2);
+    CHECK(settings.GetInt("channel") == 11 && settings.GetString("ssid") == "office");
+    Settings::Flush();
+    CHECK(StoredInt("wifi", "channel") == 11 && g_nvs["wifi"]["ssid"].text == "office");
+}
+
+static void TestErase() {
+    ResetCounters();
+    Settings settings("board", true);
+    settings.SetInt("stored", 1);
+    Settings::Flush();
+
+    // Pending only: gone without reaching the flash
+    settings.SetInt("fresh", 5);
+    settings.EraseKey("fresh");
+    CHECK(settings.GetInt("fresh", -1) == -1);
+    // Stored and pending: the erase wins over the pending value
+    settings.SetInt("stored", 2);
+    settings.EraseKey("stored");
+    CHECK(settings.GetInt("stored", -1) == -1);
+    Settings::Flush();
+    CHECK(g_nvs["board"].empty());
+    CHECK(g_nvs_sets == 1);
+
+    // EraseAll drops the pending values of its namespace only
+    Settings other("other", true);
+    settings.SetInt("a", 1);
+    other.SetInt("b", 2);
+    settings.EraseAll();
+    CHECK(settings.GetInt("a", -1) == -1 && other.GetInt("b") == 2);
+    Settings::Flush();
+    CHECK(g_nvs["board"].empty() && StoredInt("other", "b") == 2);
+}
+
+static void TestRestart() {
+    Settings settings("audio", true);
+    settings.SetInt("volume", 42);
+    settings.SetString("voice", "calm");
+    CHECK(StoredInt("audio", "volume") != 42);
+    EspRestart();
+    CHECK(StoredInt("audio", "volume") == 42 && g_nvs["audio"]["voice"].text == "calm");
+    // Read-only instances do not queue anything
+    Settings reader("audio");
+    reader.SetInt("volume", 1);
+    CHECK(reader.GetInt("volume") == 42);
+    CHECK(g_tasks_created == 1 && g_shutdown_handlers.size() == 1);
+}
+
+int main() {
+    TestCoalesce();
+    TestUnchanged();
+    TestSetWhileFlushing();
+    TestFailedWrites();
+    TestErase();
+    TestRestart();
+    return HOST_TEST_RESULT();
+}
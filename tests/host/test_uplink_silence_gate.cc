@@ -0,0 +1,148 @@
+// UplinkSilenceGate fed frame scripts: 'S' is speech, '.' a frame the VAD calls
+// silent and 'd' a DTX frame the VAD calls speech. Checks one script frame by
+// frame at 60 ms, then random conversations at every frame duration: the
+// hangover after speech is sent, silence is broken by a keepalive frame at least
+// every UPLINK_SILENCE_KEEPALIVE_MS, the frames just before speech go out ahead
+// of it, timestamps stay in order and every frame is either sent or counted.
+#include "host_test.h"
+#include "uplink_silence_gate.h"
+
+#include <random>
+#include <string>
+
+#define FRAME_MS 60
+#define RANDOM_SCRIPTS 200
+#define SPEECH_BYTES 40
+
+struct Run {
+    std::vector<bool> sent;
+    // Index of the frame whose Process() sent this one, -1 if it was not sent
+    std::vector<int> sent_at;
+    std::vector<uint32_t> order;
+};
+
+// Timestamps are frame index * frame_ms, so the sent frames can be told apart
+static Run Feed(UplinkSilenceGate& gate, const std::string& script, int frame_ms) {
+    Run run;
+    run.sent.resize(script.size());
+    run.sent_at.resize(script.size(), -1);
+    std::vector<std::unique_ptr<AudioStreamPacket>> out;
+    for (size_t i = 0; i < script.size(); i++) {
+        auto packet = std::make_unique<AudioStreamPacket>();
+        packet->frame_duration = frame_ms;
+        packet->timestamp = i * frame_ms;
+        packet->payload.resize(script[i] == 'd' ? OPUS_DTX_FRAME_MAX_BYTES : SPEECH_BYTES);
+        out.clear();
+        gate.Process(std::move(packet), script[i] != '.', out);
+        for (auto& sent : out) {
+            uint32_t index = sent->timestamp / frame_ms;
+            run.sent[index] = true;
+            run.sent_at[index] = i;
+            run.order.push_back(index);
+        }
+    }
+    return run;
+}
+
+static std::string Expect(const std::vector<bool>& sent) {
+    std::string marks;
+    for (bool s : sent) {
+        marks += s ? '+' : '-';
+    }
+    return marks;
+}
+
+static void TestDisabled() {
+    UplinkSilenceGate gate;
+    gate.Configure(FRAME_MS);
+    auto run = Feed(gate, "SS........................dd", FRAME_MS);
+    CHECK(Expect(run.sent) == std::string(28, '+'));
+    CHECK(gate.total_frames() == 0);
+}
+
+static void TestScript() {
+    UplinkSilenceGate gate;
+    gate.Configure(FRAME_MS);
+    gate.SetEnabled(true);
+    // 5 frames of hangover (300 ms), a keepalive every 6 frames (360 ms), two frames
+    // of preroll in front of the speech. DTX frames count as silence.
+    const std::string script = "SSS....dd....ddd.......S.SS......S";
+    const std::string expect = "++++++++-----+-----+-+++++++++++++";
+    auto run = Feed(gate, script, FRAME_MS);
+    if (Expect(run.sent) != expect) {
+        fprintf(stderr, "script %s\nsent   %s\nwanted %s\n", script.c_str(), Expect(run.sent).c_str(), expect.c_str());
+    }
+    CHECK(Expect(run.sent) == expect);
+    CHECK(std::is_sorted(run.order.begin(), run.order.end()));
+    CHECK(gate.total_frames() == script.size());
+    CHECK(gate.suppressed_frames() == 11);
+
+    // Frames still held when the gate is turned off are counted as suppressed
+    Feed(gate, "S.......", FRAME_MS);
+    gate.SetEnabled(false);
+    CHECK(gate.suppressed_frames() == 13);
+    // Enabling again starts over
+    gate.SetEnabled(true);
+    CHECK(gate.total_frames() == 0 && gate.suppressed_frames() == 0);
+}
+
+static void TestRandom() {
+    std::mt19937 random(37);
+    uint32_t total = 0, suppressed = 0;
+    for (int frame_ms : { 10, 20, 40, 60, 120 }) {
+        int hangover = UPLINK_SILENCE_HANGOVER_MS / frame_ms;
+        for (int n = 0; n < RANDOM_SCRIPTS; n++) {
+            // Talk spurts and pauses of up to 3 s, with DTX frames in the pauses
+            std::string script;
+            while (script.size() < 500) {
+                script.append(1 + random() % (1000 / frame_ms), 'S');
+                for (int i = random() % (3000 / frame_ms); i > 0; i--) {
+                    script += random() % 4 == 0 ? 'd' : '.';
+                }
+            }
+
+            UplinkSilenceGate gate;
+            gate.Configure(frame_ms);
+            gate.SetEnabled(true);
+            auto run = Feed(gate, script, frame_ms);
+            int errors = 0;
+            int silent_run = 0;
+            int since_sent = 0;
+            for (size_t i = 0; i < script.size(); i++) {
+                bool speech = script[i] == 'S';
+                silent_run = speech ? 0 : silent_run + 1;
+                since_sent = run.sent[i] ? 0 : since_sent + 1;
+                // Speech and the hangover after it are sent
+                errors += (speech || silent_run <= hangover) && !run.sent[i];
+                // Keepalive
+                errors += since_sent * frame_ms >= UPLINK_SILENCE_KEEPALIVE_MS;
+                // Preroll: the frames before speech go out with it, back to one that
+                // went out on its own, older held frames cannot follow that one
+                for (size_t j = 1; speech && j <= UPLINK_SILENCE_PREROLL_FRAMES && j <= i; j++) {
+                    if (run.sent_at[i - j] == (int)(i - j)) {
+                        break;
+                    }
+                    errors += run.sent_at[i - j] != (int)i;
+                }
+            }
+            errors += !std::is_sorted(run.order.begin(), run.order.end());
+            gate.SetEnabled(false);
+            errors += run.order.size() + gate.suppressed_frames() != script.size();
+            if (errors > 0) {
+                fprintf(stderr, "%d ms frames, script %d: %d errors\n", frame_ms, n, errors);
+            }
+            CHECK(errors == 0);
+            total += script.size();
+            suppressed += gate.suppressed_frames();
+        }
+    }
+    printf("%u of %u frames suppressed in the random conversations (%.0f%%)\n", (unsigned)suppressed,
+        (unsigned)total, suppressed * 100.0 / total);
+}
+
+int main() {
+    TestDisabled();
+    TestScript();
+    TestRandom();
+    return HOST_TEST_RESULT();
+}